@@ -139,6 +139,30 @@ public final class IjkMediaPlayer extends AbstractMediaPlayer {
     public static final int FFP_PROP_INT64_BIT_RATE                         = 20100;
     public static final int FFP_PROP_INT64_TCP_SPEED                        = 20200;
     public static final int FFP_PROP_INT64_LATEST_SEEK_LOAD_DURATION        = 20300;
+    public static final int FFP_PROP_INT64_STREAM_OPEN_DURATION             = 20301;
+    public static final int FFP_PROP_INT64_PROBE_CACHE_HIT                  = 20302;
+    public static final int FFP_PROP_INT64_TRICK_PLAY_RATE                  = 20303;
+    public static final int FFP_PROP_INT64_LIVE_LATENCY                     = 20304;
+    public static final int FFP_PROP_INT64_DECODE_TIME_P50                  = 20310;
+    public static final int FFP_PROP_INT64_DECODE_TIME_P95                  = 20311;
+    public static final int FFP_PROP_INT64_DECODE_TIME_P99                  = 20312;
+    public static final int FFP_PROP_INT64_DECODE_TIME_MAX                  = 20313;
+    public static final int FFP_PROP_INT64_QUEUE_WAIT_P50                   = 20314;
+    public static final int FFP_PROP_INT64_QUEUE_WAIT_P95                   = 20315;
+    public static final int FFP_PROP_INT64_QUEUE_WAIT_P99                   = 20316;
+    public static final int FFP_PROP_INT64_QUEUE_WAIT_MAX                   = 20317;
+    public static final int FFP_PROP_INT64_DISPLAY_DELAY_P50                = 20318;
+    public static final int FFP_PROP_INT64_DISPLAY_DELAY_P95                = 20319;
+    public static final int FFP_PROP_INT64_DISPLAY_DELAY_P99                = 20320;
+    public static final int FFP_PROP_INT64_DISPLAY_DELAY_MAX                = 20321;
+    public static final int FFP_PROP_INT64_PRESENT_JITTER_P50               = 20322;
+    public static final int FFP_PROP_INT64_PRESENT_JITTER_P95               = 20323;
+    public static final int FFP_PROP_INT64_PRESENT_JITTER_P99               = 20324;
+    public static final int FFP_PROP_INT64_PRESENT_JITTER_MAX               = 20325;
+    public static final int FFP_PROP_INT64_AV_SYNC_ERROR_P50                = 20326;
+    public static final int FFP_PROP_INT64_AV_SYNC_ERROR_P95                = 20327;
+    public static final int FFP_PROP_INT64_AV_SYNC_ERROR_P99                = 20328;
+    public static final int FFP_PROP_INT64_AV_SYNC_ERROR_MAX                = 20329;
     public static final int FFP_PROP_INT64_IMMEDIATE_RECONNECT              = 20211;
     //----------------------------------------
 
@@ -838,6 +862,40 @@ public final class IjkMediaPlayer extends AbstractMediaPlayer {
         return _getPropertyLong(FFP_PROP_INT64_LATEST_SEEK_LOAD_DURATION, 0);
     }
 
+    public long getStreamOpenDuration() {
+        return _getPropertyLong(FFP_PROP_INT64_STREAM_OPEN_DURATION, 0);
+    }
+
+    public boolean isProbeCacheHit() {
+        return _getPropertyLong(FFP_PROP_INT64_PROBE_CACHE_HIT, 0) != 0;
+    }
+
+    /**
+     * Keyframe-only playback for scrubbing, 4..64 plays forward, -64..-4 backward,
+     * audio is muted meanwhile. 0 resumes normal playback at the shown keyframe.
+     */
+    public void setTrickPlayRate(int rate) {
+        _setPropertyLong(FFP_PROP_INT64_TRICK_PLAY_RATE, rate);
+    }
+
+    public int getTrickPlayRate() {
+        return (int) _getPropertyLong(FFP_PROP_INT64_TRICK_PLAY_RATE, 0);
+    }
+
+    public long getLiveLatency() {
+        return _getPropertyLong(FFP_PROP_INT64_LIVE_LATENCY, 0);
+    }
+
+    /**
+     * Per video frame timing in microseconds, property is one of
+     * FFP_PROP_INT64_DECODE_TIME_P50 .. FFP_PROP_INT64_AV_SYNC_ERROR_MAX.
+     */
+    public long getFrameTimingStat(int property) {
+        if (property < FFP_PROP_INT64_DECODE_TIME_P50 || property > FFP_PROP_INT64_AV_SYNC_ERROR_MAX)
+            return 0;
+        return _getPropertyLong(property, 0);
+    }
+
     private native float _getPropertyFloat(int property, float defaultValue);
     private native void  _setPropertyFloat(int property, float value);
     private native long  _getPropertyLong(int property, long defaultValue);
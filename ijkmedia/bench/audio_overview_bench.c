@@ -0,0 +1,64 @@
+//
+//  audio_overview_bench.c
+//  IJKMediaPlayerKit
+//
+//  Audio overview generation with 1 to 8 segments.
+//
+
+#include "../tools/mr_audio_overview.c"
+
+/*
+ * make FFMPEG_PREFIX=<ffmpeg install dir> overviewbench && ./overviewbench <local file> [samples per peak]
+ * generates the same sidecar with 1, 2, 4 and 8 segments, then maps it and walks every level
+ */
+int main(int argc, char **argv)
+{
+    MRAudioOverviewOptions opt = {0};
+    MRAudioOverview *ov = NULL;
+    char *sidecar;
+    int64_t begin;
+    int ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [samples per peak]\n", argv[0]);
+        return 1;
+    }
+    opt.stream_index     = -1;
+    opt.samples_per_peak = argc > 2 ? atoi(argv[2]) : 0;
+    sidecar = av_asprintf("%s.overview", argv[1]);
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int threads = 1; threads <= MR_OVERVIEW_MAX_THREADS; threads *= 2) {
+        opt.threads = threads;
+        begin = av_gettime_relative();
+        ret = mr_audio_overview_generate(argv[1], &opt, sidecar);
+        if (ret < 0) {
+            fprintf(stderr, "generate failed:%s\n", av_err2str(ret));
+            return 1;
+        }
+        printf("%d threads: %.1fms\n", threads, (av_gettime_relative() - begin) / 1000.0);
+    }
+
+    begin = av_gettime_relative();
+    ret = mr_audio_overview_open(sidecar, &ov);
+    if (ret < 0) {
+        fprintf(stderr, "open failed:%s\n", av_err2str(ret));
+        return 1;
+    }
+    printf("mapped in %.3fms: %d Hz, %d channels, %.3fs, %.1f LUFS, peak %.1f dBFS\n", (av_gettime_relative() - begin) / 1000.0,
+           mr_audio_overview_sample_rate(ov), mr_audio_overview_channels(ov),
+           mr_audio_overview_nb_samples(ov) / (double)mr_audio_overview_sample_rate(ov),
+           mr_audio_overview_loudness(ov), mr_audio_overview_sample_peak(ov));
+    for (int l = 0; l < mr_audio_overview_nb_levels(ov); l++) {
+        int count = 0, samples = 0, min = 0, max = 0;
+        const MRAudioPeak *peaks = mr_audio_overview_level(ov, l, &count, &samples);
+        for (int i = 0; i < count; i++) {
+            min = FFMIN(min, peaks[i].min);
+            max = FFMAX(max, peaks[i].max);
+        }
+        printf("level %d: %d peaks of %d samples, range %d~%d\n", l, count, samples, min, max);
+    }
+    mr_audio_overview_close(&ov);
+    av_free(sidecar);
+    return 0;
+}
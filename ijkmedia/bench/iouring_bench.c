@@ -0,0 +1,209 @@
+//
+//  iouring_bench.c
+//  IJKMediaPlayerKit
+//
+//  Cache file writes through io_uring against pwrite and the old locked write.
+//
+
+#include "../ijkplayer/ijkavformat/ijkiouring.c"
+
+#if IJKIO_HAVE_IO_URING
+
+/*
+ * Replays the ijkio cache file traffic: one writer appending 4 KB chunks to
+ * the cache file while a reader serves random 4 KB reads out of the part that
+ * is already committed, both sharing the cache's file_mutex.
+ *
+ *   locked:   write()/read() with file_mutex held across the syscall (old ijkiocache)
+ *   unlocked: pwrite()/pread() outside file_mutex, the lock only covers bookkeeping
+ *   uring:    writes queued on an io_uring, completions committed in batches
+ *
+ * make FFMPEG_PREFIX=<ffmpeg install dir> uringbench
+ * ./uringbench [cache file path] [size in MB]
+ */
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_CHUNK_SIZE (4 * 1024)
+#define BENCH_DEPTH      16
+
+enum { BENCH_LOCKED, BENCH_UNLOCKED, BENCH_URING };
+
+typedef struct BenchContext {
+    pthread_mutex_t mutex;
+    int      fd;
+    int      mode;
+    int64_t  total;
+    int64_t  committed;
+    int      done;
+    int64_t  reads;
+    int64_t  read_wait_us;
+} BenchContext;
+
+static int64_t bench_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *bench_reader(void *arg)
+{
+    BenchContext *b = arg;
+    uint8_t buf[BENCH_CHUNK_SIZE];
+    uint64_t rnd = 0x9E3779B97F4A7C15ULL;
+
+    while (1) {
+        int64_t t0 = bench_now_us(), committed, pos;
+
+        pthread_mutex_lock(&b->mutex);
+        b->read_wait_us += bench_now_us() - t0;
+        if (b->done) {
+            pthread_mutex_unlock(&b->mutex);
+            break;
+        }
+        committed = b->committed;
+        if (committed < BENCH_CHUNK_SIZE) {
+            pthread_mutex_unlock(&b->mutex);
+            continue;
+        }
+        rnd ^= rnd << 13;
+        rnd ^= rnd >> 7;
+        rnd ^= rnd << 17;
+        pos = (int64_t)(rnd % (uint64_t)(committed / BENCH_CHUNK_SIZE)) * BENCH_CHUNK_SIZE;
+        if (b->mode == BENCH_LOCKED) {
+            lseek(b->fd, pos, SEEK_SET);
+            if (read(b->fd, buf, sizeof(buf)) < 0)
+                break;
+            pthread_mutex_unlock(&b->mutex);
+        } else {
+            pthread_mutex_unlock(&b->mutex);
+            if (pread(b->fd, buf, sizeof(buf), pos) < 0)
+                break;
+        }
+        b->reads++;
+    }
+    return NULL;
+}
+
+static void bench_commit(BenchContext *b, int64_t size)
+{
+    pthread_mutex_lock(&b->mutex);
+    b->committed += size;
+    pthread_mutex_unlock(&b->mutex);
+}
+
+static int bench_write(BenchContext *b)
+{
+    static uint8_t bufs[BENCH_DEPTH][BENCH_CHUNK_SIZE];
+    IjkIOUringCompletion cqes[BENCH_DEPTH];
+    IjkIOUring *ring = NULL;
+    int64_t pos = 0;
+    int slot = 0;
+
+    if (b->mode == BENCH_URING) {
+        ring = ijkio_uring_create(BENCH_DEPTH);
+        if (!ring)
+            return -1;
+    }
+
+    for (pos = 0; pos < b->total; pos += BENCH_CHUNK_SIZE) {
+        memset(bufs[slot], (int)(pos / BENCH_CHUNK_SIZE), BENCH_CHUNK_SIZE);
+        if (b->mode == BENCH_LOCKED) {
+            pthread_mutex_lock(&b->mutex);
+            lseek(b->fd, pos, SEEK_SET);
+            if (write(b->fd, bufs[slot], BENCH_CHUNK_SIZE) != BENCH_CHUNK_SIZE)
+                return -1;
+            b->committed += BENCH_CHUNK_SIZE;
+            pthread_mutex_unlock(&b->mutex);
+        } else if (b->mode == BENCH_UNLOCKED) {
+            if (pwrite(b->fd, bufs[slot], BENCH_CHUNK_SIZE, pos) != BENCH_CHUNK_SIZE)
+                return -1;
+            bench_commit(b, BENCH_CHUNK_SIZE);
+        } else {
+            int n;
+            if (ijkio_uring_inflight(ring) == BENCH_DEPTH) {
+                n = ijkio_uring_reap(ring, cqes, BENCH_DEPTH, BENCH_DEPTH / 2);
+                if (n < 0)
+                    return -1;
+                /* writes complete in any order, commit the batch as a whole like the cache does per range */
+                bench_commit(b, (int64_t)n * BENCH_CHUNK_SIZE);
+            }
+            if (ijkio_uring_queue_write(ring, b->fd, bufs[slot], BENCH_CHUNK_SIZE, pos, slot) < 0)
+                return -1;
+        }
+        slot = (slot + 1) % BENCH_DEPTH;
+    }
+
+    if (ring) {
+        while (ijkio_uring_inflight(ring) > 0) {
+            int n = ijkio_uring_reap(ring, cqes, BENCH_DEPTH, ijkio_uring_inflight(ring));
+            if (n < 0)
+                return -1;
+            bench_commit(b, (int64_t)n * BENCH_CHUNK_SIZE);
+        }
+        ijkio_uring_destroyp(&ring);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *names[] = { "locked", "unlocked", "uring" };
+    const char *path = argc > 1 ? argv[1] : "uringbench.tmp";
+    int64_t total = (argc > 2 ? strtoll(argv[2], NULL, 10) : 256) * 1024 * 1024;
+
+    for (int mode = BENCH_LOCKED; mode <= BENCH_URING; mode++) {
+        BenchContext b = {0};
+        pthread_t reader;
+        int64_t t0, t1;
+
+        pthread_mutex_init(&b.mutex, NULL);
+        b.fd    = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        b.mode  = mode;
+        b.total = total;
+        if (b.fd < 0)
+            return 1;
+
+        pthread_create(&reader, NULL, bench_reader, &b);
+        t0 = bench_now_us();
+        if (bench_write(&b) < 0) {
+            printf("%-8s: unavailable\n", names[mode]);
+        } else {
+            t1 = bench_now_us();
+            pthread_mutex_lock(&b.mutex);
+            b.done = 1;
+            pthread_mutex_unlock(&b.mutex);
+            pthread_join(reader, NULL);
+            printf("%-8s: write %7.1f MB/s, %8"PRId64" concurrent reads (%7.0f/s), reader waited %6"PRId64" ms on file_mutex\n",
+                   names[mode], total / 1048576.0 / ((t1 - t0) / 1e6), b.reads,
+                   b.reads / ((t1 - t0) / 1e6), b.read_wait_us / 1000);
+        }
+        if (!b.done) {
+            pthread_mutex_lock(&b.mutex);
+            b.done = 1;
+            pthread_mutex_unlock(&b.mutex);
+            pthread_join(reader, NULL);
+        }
+        close(b.fd);
+        pthread_mutex_destroy(&b.mutex);
+    }
+    unlink(path);
+    return 0;
+}
+
+#else
+
+#include <stdio.h>
+
+int main(void)
+{
+    fprintf(stderr, "built without io_uring\n");
+    return 1;
+}
+
+#endif /* IJKIO_HAVE_IO_URING */
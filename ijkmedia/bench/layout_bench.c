@@ -0,0 +1,256 @@
+//
+//  layout_bench.c
+//  IJKMediaPlayerKit
+//
+//  False sharing between the VideoState roles.
+//
+
+#include "../ijkplayer/ff_ffplay_def.c"
+
+/*
+ * False sharing benchmark of the VideoState layout.
+ *
+ * Every player runs an audio callback, a refresh thread and a video decoder that
+ * write the hot fields of their role and read the clocks of the others between
+ * short stretches of work, once on VideoState and once on the same fields in the
+ * order VideoState had them before the split. Iterations per second of each role
+ * are the throughput the layout leaves to the real work.
+ *
+ * make FFMPEG_PREFIX=<ffmpeg install dir> layoutbench
+ * ./layoutbench [players] [seconds] [work per iteration]
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define BENCH_LINE 64
+
+enum {
+    BENCH_AUDIO,
+    BENCH_REFRESH,
+    BENCH_VIDEO_DEC,
+    BENCH_ROLE_NB
+};
+
+static const char *bench_role_names[BENCH_ROLE_NB] = { "audio callback", "refresh", "video decoder" };
+
+/* the hot fields in their order before the split, with what sat between them */
+typedef struct LegacyLayout {
+    Clock audclk;
+    Clock vidclk;
+    Clock extclk;
+    FrameQueue pictq;
+    FrameQueue sampq;
+    Decoder auddec;
+    Decoder viddec;
+    int audio_stream;
+    int av_sync_type;
+    void *handle;
+    double audio_clock;
+    int audio_clock_serial;
+    double audio_diff_cum;
+    double audio_diff_avg_coef;
+    double audio_diff_threshold;
+    int audio_diff_avg_count;
+    AVStream *audio_st;
+    PacketQueue audioq;
+    int audio_hw_buf_size;
+    uint8_t *audio_buf;
+    uint8_t *audio_buf1;
+    short *audio_new_buf;
+    unsigned int audio_buf_size;
+    unsigned int audio_buf1_size;
+    unsigned int audio_new_buf_size;
+    int audio_buf_index;
+    int audio_volume;
+    int muted;
+    struct AudioParams audio_src;
+    struct AudioParams audio_tgt;
+    struct SwrContext *swr_ctx;
+    int frame_drops_early;
+    int frame_drops_late;
+    int continuous_frame_drops_early;
+    int show_mode;
+    int16_t sample_array[SAMPLE_ARRAY_SIZE];
+    int sample_array_index;
+    int last_i_start;
+    double last_vis_time;
+    double frame_timer;
+    double frame_last_returned_time;
+    double frame_last_filter_delay;
+} LegacyLayout;
+
+typedef struct BenchFields {
+    Clock *audclk;
+    Clock *vidclk;
+    double *audio_clock;
+    int *audio_buf_index;
+    double *frame_timer;
+    int *frame_drops_late;
+    double *frame_last_returned_time;
+    int *frame_drops_early;
+    int *continuous_frame_drops_early;
+} BenchFields;
+
+typedef struct BenchThread {
+    pthread_t tid;
+    BenchFields *fields;
+    int role;
+    int64_t iterations;
+} BenchThread;
+
+#define BENCH_STORE(lvalue, value) (*(volatile __typeof__(lvalue) *)&(lvalue) = (value))
+#define BENCH_LOAD(lvalue)         (*(volatile __typeof__(lvalue) *)&(lvalue))
+
+static int bench_stop;
+static int bench_work_units = 100;
+
+static void bench_set_clock(Clock *c, double pts, double now)
+{
+    BENCH_STORE(c->pts, pts);
+    BENCH_STORE(c->last_updated, now);
+    BENCH_STORE(c->pts_drift, pts - now);
+}
+
+static void *bench_thread(void *arg)
+{
+    BenchThread *t = arg;
+    BenchFields *f = t->fields;
+    volatile double work = 1.0;
+    double sink = 0;
+    int64_t n;
+
+    for (n = 0; !__atomic_load_n(&bench_stop, __ATOMIC_RELAXED); n++) {
+        for (int i = 0; i < bench_work_units; i++)
+            work = work * 1.0000001 + 1e-9;
+
+        switch (t->role) {
+        case BENCH_AUDIO:
+            BENCH_STORE(*f->audio_buf_index, (int)n);
+            BENCH_STORE(*f->audio_clock, (double)n);
+            bench_set_clock(f->audclk, (double)n, (double)n);
+            break;
+        case BENCH_REFRESH:
+            sink += BENCH_LOAD(f->audclk->pts_drift) + BENCH_LOAD(f->vidclk->pts);
+            BENCH_STORE(*f->frame_timer, (double)n);
+            BENCH_STORE(*f->frame_drops_late, (int)n);
+            bench_set_clock(f->vidclk, (double)n, (double)n);
+            break;
+        case BENCH_VIDEO_DEC:
+            sink += BENCH_LOAD(f->audclk->pts_drift);
+            BENCH_STORE(*f->frame_last_returned_time, (double)n);
+            BENCH_STORE(*f->frame_drops_early, (int)n);
+            BENCH_STORE(*f->continuous_frame_drops_early, (int)n);
+            break;
+        }
+    }
+    t->iterations = n + (sink == 0.5);
+    return NULL;
+}
+
+#define BENCH_FIELDS(s) { &(s)->audclk, &(s)->vidclk, &(s)->audio_clock, &(s)->audio_buf_index, \
+    &(s)->frame_timer, &(s)->frame_drops_late, &(s)->frame_last_returned_time,                 \
+    &(s)->frame_drops_early, &(s)->continuous_frame_drops_early }
+
+/* pairs of fields of different roles on one line, the false sharing left in a layout */
+static int bench_shared_lines(const char *name, const void *base, const BenchFields *f)
+{
+    const struct { const char *name; const void *ptr; size_t size; int role; } fields[] = {
+        { "audclk",                       f->audclk,                       sizeof(Clock),  BENCH_AUDIO },
+        { "audio_clock",                  f->audio_clock,                  sizeof(double), BENCH_AUDIO },
+        { "audio_buf_index",              f->audio_buf_index,              sizeof(int),    BENCH_AUDIO },
+        { "vidclk",                       f->vidclk,                       sizeof(Clock),  BENCH_REFRESH },
+        { "frame_timer",                  f->frame_timer,                  sizeof(double), BENCH_REFRESH },
+        { "frame_drops_late",             f->frame_drops_late,             sizeof(int),    BENCH_REFRESH },
+        { "frame_last_returned_time",     f->frame_last_returned_time,     sizeof(double), BENCH_VIDEO_DEC },
+        { "frame_drops_early",            f->frame_drops_early,            sizeof(int),    BENCH_VIDEO_DEC },
+        { "continuous_frame_drops_early", f->continuous_frame_drops_early, sizeof(int),    BENCH_VIDEO_DEC },
+    };
+    int nb = sizeof(fields) / sizeof(fields[0]);
+    int shared = 0;
+
+    for (int i = 0; i < nb; i++) {
+        size_t a0 = (const char *)fields[i].ptr - (const char *)base;
+        size_t a1 = a0 + fields[i].size - 1;
+
+        for (int j = i + 1; j < nb; j++) {
+            size_t b0 = (const char *)fields[j].ptr - (const char *)base;
+            size_t b1 = b0 + fields[j].size - 1;
+
+            if (fields[i].role == fields[j].role)
+                continue;
+            if (a0 / BENCH_LINE <= b1 / BENCH_LINE && b0 / BENCH_LINE <= a1 / BENCH_LINE) {
+                printf("  %s: %s (%s) and %s (%s) share a line\n", name,
+                       fields[i].name, bench_role_names[fields[i].role],
+                       fields[j].name, bench_role_names[fields[j].role]);
+                shared++;
+            }
+        }
+    }
+    return shared;
+}
+
+static void bench_run(const char *name, int players, int seconds, BenchFields *fields)
+{
+    BenchThread *threads = calloc(players * BENCH_ROLE_NB, sizeof(BenchThread));
+    int64_t total[BENCH_ROLE_NB] = { 0 };
+
+    __atomic_store_n(&bench_stop, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < players * BENCH_ROLE_NB; i++) {
+        threads[i].fields = &fields[i / BENCH_ROLE_NB];
+        threads[i].role   = i % BENCH_ROLE_NB;
+        pthread_create(&threads[i].tid, NULL, bench_thread, &threads[i]);
+    }
+    sleep(seconds);
+    __atomic_store_n(&bench_stop, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < players * BENCH_ROLE_NB; i++) {
+        pthread_join(threads[i].tid, NULL);
+        total[threads[i].role] += threads[i].iterations;
+    }
+
+    printf("%-8s", name);
+    for (int r = 0; r < BENCH_ROLE_NB; r++)
+        printf("  %s %8.2f Mit/s", bench_role_names[r], total[r] / (double)seconds / 1e6);
+    printf("\n");
+    free(threads);
+}
+
+int main(int argc, char **argv)
+{
+    long cpus    = sysconf(_SC_NPROCESSORS_ONLN);
+    int players  = argc > 1 ? atoi(argv[1]) : (int)FFMAX(cpus / BENCH_ROLE_NB, 1);
+    int seconds  = argc > 2 ? atoi(argv[2]) : 2;
+    BenchFields *split_fields  = calloc(players, sizeof(BenchFields));
+    BenchFields *legacy_fields = calloc(players, sizeof(BenchFields));
+    VideoState **split   = calloc(players, sizeof(VideoState *));
+    LegacyLayout **legacy = calloc(players, sizeof(LegacyLayout *));
+
+    if (argc > 3)
+        bench_work_units = atoi(argv[3]);
+
+    for (int i = 0; i < players; i++) {
+        split[i]  = ffp_mallocz_cacheline(sizeof(VideoState));
+        legacy[i] = ffp_mallocz_cacheline(sizeof(LegacyLayout));
+        split_fields[i]  = (BenchFields)BENCH_FIELDS(split[i]);
+        legacy_fields[i] = (BenchFields)BENCH_FIELDS(legacy[i]);
+    }
+
+    printf("%d players x %d threads on %ld cpus, %d work units per iteration, %ds per run\n",
+           players, BENCH_ROLE_NB, cpus, bench_work_units, seconds);
+    printf("lines written by more than one role: split %d, legacy %d\n",
+           bench_shared_lines("split", split[0], &split_fields[0]),
+           bench_shared_lines("legacy", legacy[0], &legacy_fields[0]));
+
+    bench_run("legacy", players, seconds, legacy_fields);
+    bench_run("split", players, seconds, split_fields);
+
+    for (int i = 0; i < players; i++) {
+        ffp_freep_cacheline(&split[i]);
+        ffp_freep_cacheline(&legacy[i]);
+    }
+    free(split);
+    free(legacy);
+    free(split_fields);
+    free(legacy_fields);
+    return 0;
+}
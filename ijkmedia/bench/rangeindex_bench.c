@@ -0,0 +1,211 @@
+//
+//  rangeindex_bench.c
+//  IJKMediaPlayerKit
+//
+//  Range index against the IjkAVTree the ijkio cache used before.
+//
+
+#include "../ijkplayer/ijkavutil/ijkrangeindex.c"
+
+/*
+ * Compares the range index with the IjkAVTree of calloc'd entries that the
+ * ijkio cache used before, replaying the cache writer: 4 KB appends to the
+ * cache file with a random seek every few MB, plus a demuxer-style lookup per
+ * write and a burst of random lookups at the end.
+ *
+ * make rangebench
+ * ./rangebench [file size in MB] [seek interval in MB]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_CHUNK_SIZE (4 * 1024)
+#define BENCH_LOOKUPS    (4 * 1024 * 1024)
+
+static int64_t bench_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t bench_rand_state = 0x9E3779B97F4A7C15ULL;
+static int64_t bench_rand(int64_t max)
+{
+    bench_rand_state ^= bench_rand_state << 13;
+    bench_rand_state ^= bench_rand_state >> 7;
+    bench_rand_state ^= bench_rand_state << 17;
+    return (int64_t)(bench_rand_state % (uint64_t)max);
+}
+
+static int tree_cmp(const void *key, const void *node)
+{
+    return FFDIFFSIGN(*(const int64_t *)key, ((const IjkRangeEntry *) node)->logical_pos);
+}
+
+static int tree_enu_free(void *opaque, void *elem)
+{
+    free(elem);
+    return 0;
+}
+
+static int tree_enu_count(void *opaque, void *elem)
+{
+    (*(int *)opaque)++;
+    return 0;
+}
+
+typedef struct BenchCursor {
+    int64_t file_size;
+    int64_t seek_interval;
+    int64_t logical_pos;
+    int64_t physical_pos;
+    int64_t since_seek;
+} BenchCursor;
+
+/* returns the cached range end if pos is covered, pos otherwise */
+static int64_t tree_skip_cached(struct IjkAVTreeNode *root, int64_t pos)
+{
+    IjkRangeEntry *next[2] = {NULL, NULL};
+    IjkRangeEntry *entry = ijk_av_tree_find(root, &pos, tree_cmp, (void **)next);
+    if (!entry)
+        entry = next[0];
+    if (entry && entry->logical_pos <= pos && pos < entry->logical_pos + entry->size)
+        return entry->logical_pos + entry->size;
+    return pos;
+}
+
+static int64_t index_skip_cached(IjkRangeIndex *index, int64_t pos)
+{
+    IjkRangeEntry *entry = ijk_range_index_find(index, pos, NULL);
+    if (entry && pos < entry->logical_pos + entry->size)
+        return entry->logical_pos + entry->size;
+    return pos;
+}
+
+static int bench_next_write(BenchCursor *cur)
+{
+    if (cur->since_seek >= cur->seek_interval || cur->logical_pos + BENCH_CHUNK_SIZE > cur->file_size) {
+        cur->logical_pos = bench_rand(cur->file_size / BENCH_CHUNK_SIZE) * BENCH_CHUNK_SIZE;
+        cur->since_seek  = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static void bench_tree(int64_t file_size, int64_t seek_interval)
+{
+    struct IjkAVTreeNode *root = NULL;
+    BenchCursor cur = { file_size, seek_interval, 0, 0, 0 };
+    int64_t start, write_us, lookup_us;
+    int64_t hits = 0;
+    int nb_entries = 0;
+
+    start = bench_now_us();
+    while (cur.physical_pos < file_size) {
+        IjkRangeEntry *entry, *next[2] = {NULL, NULL};
+
+        bench_next_write(&cur);
+        cur.logical_pos = tree_skip_cached(root, cur.logical_pos);
+        if (cur.logical_pos + BENCH_CHUNK_SIZE > file_size) {
+            cur.since_seek = cur.seek_interval;
+            continue;
+        }
+
+        entry = ijk_av_tree_find(root, &cur.logical_pos, tree_cmp, (void **)next);
+        if (!entry)
+            entry = next[0];
+        if (!entry ||
+            entry->logical_pos  + entry->size != cur.logical_pos ||
+            entry->physical_pos + entry->size != cur.physical_pos) {
+            struct IjkAVTreeNode *node = ijk_av_tree_node_alloc();
+            entry = malloc(sizeof(*entry));
+            entry->logical_pos  = cur.logical_pos;
+            entry->physical_pos = cur.physical_pos;
+            entry->size         = BENCH_CHUNK_SIZE;
+            ijk_av_tree_insert(&root, entry, tree_cmp, &node);
+        } else {
+            entry->size += BENCH_CHUNK_SIZE;
+        }
+
+        cur.logical_pos  += BENCH_CHUNK_SIZE;
+        cur.physical_pos += BENCH_CHUNK_SIZE;
+        cur.since_seek   += BENCH_CHUNK_SIZE;
+    }
+    write_us = bench_now_us() - start;
+
+    start = bench_now_us();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        int64_t pos = bench_rand(file_size);
+        IjkRangeEntry *next[2] = {NULL, NULL};
+        IjkRangeEntry *entry = ijk_av_tree_find(root, &pos, tree_cmp, (void **)next);
+        if (!entry)
+            entry = next[0];
+        if (entry && pos < entry->logical_pos + entry->size)
+            hits++;
+    }
+    lookup_us = bench_now_us() - start;
+
+    ijk_av_tree_enumerate(root, &nb_entries, NULL, tree_enu_count);
+    printf("avtree     : entries %8d, write %8"PRId64" us, %d lookups %8"PRId64" us, hits %"PRId64"\n",
+           nb_entries, write_us, BENCH_LOOKUPS, lookup_us, hits);
+
+    ijk_av_tree_enumerate(root, NULL, NULL, tree_enu_free);
+    ijk_av_tree_destroy(root);
+}
+
+static void bench_index(int64_t file_size, int64_t seek_interval)
+{
+    IjkRangeIndex index = {0};
+    BenchCursor cur = { file_size, seek_interval, 0, 0, 0 };
+    int64_t start, write_us, lookup_us;
+    int64_t hits = 0;
+
+    start = bench_now_us();
+    while (cur.physical_pos < file_size) {
+        bench_next_write(&cur);
+        cur.logical_pos = index_skip_cached(&index, cur.logical_pos);
+        if (cur.logical_pos + BENCH_CHUNK_SIZE > file_size) {
+            cur.since_seek = cur.seek_interval;
+            continue;
+        }
+
+        ijk_range_index_add(&index, cur.logical_pos, cur.physical_pos, BENCH_CHUNK_SIZE);
+
+        cur.logical_pos  += BENCH_CHUNK_SIZE;
+        cur.physical_pos += BENCH_CHUNK_SIZE;
+        cur.since_seek   += BENCH_CHUNK_SIZE;
+    }
+    write_us = bench_now_us() - start;
+
+    start = bench_now_us();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        int64_t pos = bench_rand(file_size);
+        IjkRangeEntry *entry = ijk_range_index_find(&index, pos, NULL);
+        if (entry && pos < entry->logical_pos + entry->size)
+            hits++;
+    }
+    lookup_us = bench_now_us() - start;
+
+    printf("rangeindex : entries %8d, write %8"PRId64" us, %d lookups %8"PRId64" us, hits %"PRId64"\n",
+           index.nb_entries, write_us, BENCH_LOOKUPS, lookup_us, hits);
+
+    ijk_range_index_clear(&index);
+}
+
+int main(int argc, char **argv)
+{
+    int64_t file_size     = (argc > 1 ? strtoll(argv[1], NULL, 10) : 4096) * 1024 * 1024;
+    int64_t seek_interval = (argc > 2 ? strtoll(argv[2], NULL, 10) : 8) * 1024 * 1024;
+
+    printf("cache %"PRId64" MB, seek every %"PRId64" MB, %d byte writes\n",
+           file_size >> 20, seek_interval >> 20, BENCH_CHUNK_SIZE);
+
+    bench_rand_state = 0x9E3779B97F4A7C15ULL;
+    bench_tree(file_size, seek_interval);
+    bench_rand_state = 0x9E3779B97F4A7C15ULL;
+    bench_index(file_size, seek_interval);
+    return 0;
+}
@@ -0,0 +1,274 @@
+//
+//  threadpool_bench.c
+//  IJKMediaPlayerKit
+//
+//  Shared thread pool against the single queue pool it replaced.
+//
+
+#include "../ijkplayer/ijkavutil/ijkthreadpool.c"
+
+/*
+ * Contention benchmark of this pool against the single queue pool it replaced.
+ *
+ *   burst:    producers outside the pool queue tiny tasks as fast as they can,
+ *             the old pool rejects them with IJK_THREADPOOL_QUEUE_FULL past 1024
+ *   priority: playback critical tasks queued behind a backlog of background work,
+ *             latency from submit to start
+ *   wait:     submit and wait for a tiny task, round trip of a future
+ *
+ * make FFMPEG_PREFIX=<ffmpeg install dir> poolbench
+ * ./poolbench [threads] [producers] [tasks per producer]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_BACKGROUND_TASKS 1000
+#define BENCH_BACKGROUND_US    200
+#define BENCH_CRITICAL_TASKS   50
+
+typedef struct LegacyPool {
+    pthread_mutex_t lock;
+    pthread_cond_t notify;
+    pthread_t threads[MAX_THREADS];
+    Runable functions[MAX_QUEUE];
+    void *args[MAX_QUEUE];
+    int thread_count;
+    int head;
+    int count;
+    int shutdown;
+} LegacyPool;
+
+static void *legacy_thread(void *arg)
+{
+    LegacyPool *pool = arg;
+
+    for (;;) {
+        Runable function;
+        void *in_arg;
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->count == 0 && !pool->shutdown)
+            pthread_cond_wait(&pool->notify, &pool->lock);
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        function   = pool->functions[pool->head];
+        in_arg     = pool->args[pool->head];
+        pool->head = (pool->head + 1) % MAX_QUEUE;
+        pool->count--;
+        pthread_mutex_unlock(&pool->lock);
+        function(in_arg, NULL);
+    }
+    return NULL;
+}
+
+static LegacyPool *legacy_create(int thread_count)
+{
+    LegacyPool *pool = calloc(1, sizeof(LegacyPool));
+    int i;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->notify, NULL);
+    pool->thread_count = thread_count;
+    for (i = 0; i < thread_count; i++)
+        pthread_create(&pool->threads[i], NULL, legacy_thread, pool);
+    return pool;
+}
+
+static int legacy_add(LegacyPool *pool, Runable function, void *in_arg)
+{
+    pthread_mutex_lock(&pool->lock);
+    if (pool->count == MAX_QUEUE) {
+        pthread_mutex_unlock(&pool->lock);
+        return IJK_THREADPOOL_QUEUE_FULL;
+    }
+    pool->functions[(pool->head + pool->count) % MAX_QUEUE] = function;
+    pool->args[(pool->head + pool->count) % MAX_QUEUE]      = in_arg;
+    pool->count++;
+    pthread_cond_signal(&pool->notify);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+static void legacy_destroy(LegacyPool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->notify);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->thread_count; i++)
+        pthread_join(pool->threads[i], NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->notify);
+    free(pool);
+}
+
+typedef struct BenchContext {
+    IjkThreadPoolContext *pool;
+    LegacyPool *legacy;
+    int tasks;
+    int64_t done;
+    int64_t rejected;
+    int64_t latency_us;
+} BenchContext;
+
+typedef struct BenchStamp {
+    BenchContext *b;
+    int64_t queued_us;
+} BenchStamp;
+
+static int64_t bench_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void bench_spin_us(int64_t us)
+{
+    int64_t end = bench_now_us() + us;
+    while (bench_now_us() < end)
+        ;
+}
+
+static void bench_tiny_task(void *in_arg, void *out_arg)
+{
+    BenchContext *b = in_arg;
+    volatile int sink = 0;
+    int i;
+
+    for (i = 0; i < 200; i++)
+        sink += i;
+    __atomic_add_fetch(&b->done, 1, __ATOMIC_RELAXED);
+}
+
+static void bench_background_task(void *in_arg, void *out_arg)
+{
+    bench_spin_us(BENCH_BACKGROUND_US);
+}
+
+static void bench_critical_task(void *in_arg, void *out_arg)
+{
+    BenchStamp *stamp = in_arg;
+
+    __atomic_add_fetch(&stamp->b->latency_us, bench_now_us() - stamp->queued_us, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stamp->b->done, 1, __ATOMIC_RELAXED);
+}
+
+static void *bench_producer(void *arg)
+{
+    BenchContext *b = arg;
+    int i;
+
+    for (i = 0; i < b->tasks; i++) {
+        if (b->pool) {
+            ijk_threadpool_add(b->pool, bench_tiny_task, b, NULL, IJK_THREADPOOL_PRIORITY_CRITICAL);
+            continue;
+        }
+        while (legacy_add(b->legacy, bench_tiny_task, b) == IJK_THREADPOOL_QUEUE_FULL) {
+            __atomic_add_fetch(&b->rejected, 1, __ATOMIC_RELAXED);
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void bench_wait_done(BenchContext *b, int64_t count)
+{
+    while (__atomic_load_n(&b->done, __ATOMIC_RELAXED) < count)
+        sched_yield();
+}
+
+static void bench_burst(const char *name, BenchContext *b, int producers)
+{
+    pthread_t threads[MAX_THREADS];
+    int64_t t0 = bench_now_us(), t1;
+    int i;
+
+    for (i = 0; i < producers; i++)
+        pthread_create(&threads[i], NULL, bench_producer, b);
+    for (i = 0; i < producers; i++)
+        pthread_join(threads[i], NULL);
+    bench_wait_done(b, (int64_t)producers * b->tasks);
+    t1 = bench_now_us();
+    printf("burst    %-13s: %8.0f tasks/s, %8"PRId64" QUEUE_FULL retries\n",
+           name, (double)producers * b->tasks / ((t1 - t0) / 1e6), b->rejected);
+}
+
+static void bench_priority(const char *name, BenchContext *b)
+{
+    BenchStamp stamps[BENCH_CRITICAL_TASKS];
+    int i;
+
+    for (i = 0; i < BENCH_BACKGROUND_TASKS; i++) {
+        if (b->pool)
+            ijk_threadpool_add(b->pool, bench_background_task, NULL, NULL, IJK_THREADPOOL_PRIORITY_BACKGROUND);
+        else
+            legacy_add(b->legacy, bench_background_task, NULL);
+    }
+    for (i = 0; i < BENCH_CRITICAL_TASKS; i++) {
+        stamps[i].b         = b;
+        stamps[i].queued_us = bench_now_us();
+        if (b->pool)
+            ijk_threadpool_add(b->pool, bench_critical_task, &stamps[i], NULL, IJK_THREADPOOL_PRIORITY_CRITICAL);
+        else
+            legacy_add(b->legacy, bench_critical_task, &stamps[i]);
+        bench_spin_us(1000);
+    }
+    bench_wait_done(b, BENCH_CRITICAL_TASKS);
+    printf("priority %-13s: critical task waits %8.0f us on average behind %d background tasks\n",
+           name, (double)b->latency_us / BENCH_CRITICAL_TASKS, BENCH_BACKGROUND_TASKS);
+}
+
+int main(int argc, char **argv)
+{
+    int threads   = argc > 1 ? atoi(argv[1]) : 4;
+    int producers = argc > 2 ? atoi(argv[2]) : 4;
+    int tasks     = argc > 3 ? atoi(argv[3]) : 100000;
+    BenchContext b;
+    int64_t t0;
+    int i;
+
+    if (threads <= 0 || threads > MAX_THREADS || producers <= 0 || producers > MAX_THREADS || tasks <= 0)
+        return 1;
+
+    memset(&b, 0, sizeof(b));
+    b.legacy = legacy_create(threads);
+    b.tasks  = tasks;
+    bench_burst("single queue", &b, producers);
+    legacy_destroy(b.legacy);
+
+    memset(&b, 0, sizeof(b));
+    b.pool  = ijk_threadpool_create(threads, 64, 0);
+    b.tasks = tasks;
+    bench_burst("work stealing", &b, producers);
+    ijk_threadpool_destroy(b.pool, IJK_LEISURELY_SHUTDOWN);
+
+    memset(&b, 0, sizeof(b));
+    b.legacy = legacy_create(threads);
+    bench_priority("single queue", &b);
+    legacy_destroy(b.legacy);
+
+    memset(&b, 0, sizeof(b));
+    b.pool = ijk_threadpool_create(threads, 64, 0);
+    bench_priority("work stealing", &b);
+    ijk_threadpool_destroy(b.pool, IJK_IMMEDIATE_SHUTDOWN);
+
+    memset(&b, 0, sizeof(b));
+    b.pool = ijk_threadpool_create(threads, 64, 0);
+    t0 = bench_now_us();
+    for (i = 0; i < 10000; i++) {
+        IjkThreadPoolFuture *future = NULL;
+        ijk_threadpool_submit(b.pool, bench_tiny_task, &b, NULL, IJK_THREADPOOL_PRIORITY_CRITICAL, &future);
+        ijk_threadpool_future_wait(future, -1);
+        ijk_threadpool_future_releasep(&future);
+    }
+    printf("wait     %-13s: %8.1f us per submit and wait\n", "work stealing", (bench_now_us() - t0) / 10000.0);
+    ijk_threadpool_destroy(b.pool, IJK_LEISURELY_SHUTDOWN);
+    return 0;
+}
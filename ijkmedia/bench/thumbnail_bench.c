@@ -0,0 +1,59 @@
+//
+//  thumbnail_bench.c
+//  IJKMediaPlayerKit
+//
+//  Thumbnail extraction with 1 to 8 demuxers.
+//
+
+#include "../tools/mr_thumbnail.c"
+
+/*
+ * make FFMPEG_PREFIX=<ffmpeg install dir> thumbnailbench && ./thumbnailbench <local file> [count] [width]
+ * extracts the same thumbnails with 1, 2, 4 and 8 demuxers, then a jpeg storyboard
+ */
+int main(int argc, char **argv)
+{
+    MRThumbnailOptions opt = {0};
+    MRThumbnail *thumbs = NULL;
+    MRThumbnail sprite = {0};
+    int count = 0, columns = 0, rows = 0;
+    int64_t begin;
+    int ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [count] [width]\n", argv[0]);
+        return 1;
+    }
+    opt.count = argc > 2 ? atoi(argv[2]) : 32;
+    opt.width = argc > 3 ? atoi(argv[3]) : 160;
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int threads = 1; threads <= MR_THUMBNAIL_MAX_THREADS; threads *= 2) {
+        for (int format = MR_THUMBNAIL_RGBA; format <= MR_THUMBNAIL_JPEG; format++) {
+            opt.threads = threads;
+            opt.format  = format;
+            begin = av_gettime_relative();
+            ret = mr_thumbnail_extract(argv[1], &opt, &thumbs, &count);
+            if (ret < 0) {
+                fprintf(stderr, "extract failed:%s\n", av_err2str(ret));
+                return 1;
+            }
+            printf("%d threads %s: %d thumbnails %dx%d in %.1fms\n", threads, format == MR_THUMBNAIL_JPEG ? "jpeg" : "rgba",
+                   count, thumbs[0].width, thumbs[0].height, (av_gettime_relative() - begin) / 1000.0);
+            mr_thumbnail_free(&thumbs, count);
+        }
+    }
+
+    opt.threads = 0;
+    opt.format  = MR_THUMBNAIL_JPEG;
+    begin = av_gettime_relative();
+    ret = mr_storyboard_extract(argv[1], &opt, &sprite, &columns, &rows);
+    if (ret < 0) {
+        fprintf(stderr, "storyboard failed:%s\n", av_err2str(ret));
+        return 1;
+    }
+    printf("storyboard %dx%d tiles, %dx%d jpeg of %d bytes in %.1fms\n", columns, rows,
+           sprite.width, sprite.height, sprite.size, (av_gettime_relative() - begin) / 1000.0);
+    mr_storyboard_free(&sprite);
+    return 0;
+}
@@ -0,0 +1,65 @@
+//
+//  tonemap_bench.c
+//  IJKMediaPlayerKit
+//
+//  CPU tone mapping of a 10 bit frame.
+//
+
+#include "../ijksdl/ffmpeg/ijksdl_tonemap.c"
+
+#include <stdio.h>
+#include "libavutil/time.h"
+
+//make FFMPEG_PREFIX=<ffmpeg install dir> tonemapbench && ./tonemapbench [width] [height]
+int main(int argc, char **argv)
+{
+    const int w = argc > 1 ? atoi(argv[1]) : 3840;
+    const int h = argc > 2 ? atoi(argv[2]) : 2160;
+    const int runs = 20;
+    AVFrame *src = av_frame_alloc();
+    AVFrame *dst = av_frame_alloc();
+
+    src->format = AV_PIX_FMT_P010LE;
+    src->width  = w;
+    src->height = h;
+    src->color_trc       = AVCOL_TRC_SMPTE2084;
+    src->color_primaries = AVCOL_PRI_BT2020;
+    src->colorspace      = AVCOL_SPC_BT2020_NCL;
+    src->color_range     = AVCOL_RANGE_MPEG;
+    dst->format = AV_PIX_FMT_YUV420P;
+    dst->width  = w;
+    dst->height = h;
+    if (av_frame_get_buffer(src, 0) < 0 || av_frame_get_buffer(dst, 0) < 0)
+        return 1;
+    //a luma ramp over the whole PQ range with chroma sweeping the gamut
+    for (int y = 0; y < h; y++) {
+        uint16_t *l = (uint16_t *)(src->data[0] + y * src->linesize[0]);
+        for (int x = 0; x < w; x++)
+            l[x] = (64 + 876 * x / w) << 6;
+    }
+    for (int y = 0; y < h / 2; y++) {
+        uint16_t *c = (uint16_t *)(src->data[1] + y * src->linesize[1]);
+        for (int x = 0; x < w / 2; x++) {
+            c[2 * x]     = (64 + 896 * y / (h / 2)) << 6;
+            c[2 * x + 1] = (64 + 896 * x / (w / 2)) << 6;
+        }
+    }
+
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        for (int op = IJK_TONEMAP_BT2390; op <= IJK_TONEMAP_HABLE; op++) {
+            IJKToneMap *tm = ijk_tonemap_create(op, threads);
+            int64_t begin;
+
+            ijk_tonemap_convert(tm, src, dst->format, dst->data, dst->linesize);
+            begin = av_gettime_relative();
+            for (int i = 0; i < runs; i++)
+                ijk_tonemap_convert(tm, src, dst->format, dst->data, dst->linesize);
+            printf("%dx%d %s threads %d: %.2f ms per frame\n", w, h, op == IJK_TONEMAP_HABLE ? "hable" : "bt2390",
+                   threads, (av_gettime_relative() - begin) / 1000.0 / runs);
+            ijk_tonemap_freep(&tm);
+        }
+    }
+    av_frame_free(&src);
+    av_frame_free(&dst);
+    return 0;
+}
@@ -0,0 +1,86 @@
+//
+//  yuv2rgba_bench.c
+//  IJKMediaPlayerKit
+//
+//  SIMD yuv to rgba kernels against the C ones.
+//
+
+#include "../ijksdl/soft/ijksdl_yuv2rgba.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * make yuv2rgbabench && ./yuv2rgbabench [width] [height]
+ * checks the simd kernel against the c one on random pictures, then times both
+ */
+int main(int argc, char **argv)
+{
+    int width  = argc > 1 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    uint8_t *y  = malloc(width * height);
+    uint8_t *u  = malloc(cw * ch);
+    uint8_t *v  = malloc(cw * ch);
+    uint8_t *uv = malloc(cw * ch * 2);
+    uint8_t *simd = malloc(width * height * 4);
+    uint8_t *ref  = malloc(width * height * 4);
+    const uint8_t *i420[3] = { y, u, v };
+    const uint8_t *nv12[2] = { y, uv };
+    int i420_linesize[3] = { width, cw, cw };
+    int nv12_linesize[2] = { width, cw * 2 };
+    IJK_YUV2RGBA c;
+
+    srand(1);
+    for (int i = 0; i < width * height; i++)
+        y[i] = rand();
+    for (int i = 0; i < cw * ch; i++) {
+        u[i] = uv[2 * i]     = rand();
+        v[i] = uv[2 * i + 1] = rand();
+    }
+
+    for (int matrix = YUV_2_RGB_Color_Matrix_BT601; matrix <= YUV_2_RGB_Color_Matrix_BT2020; matrix++) {
+        for (int full_range = 0; full_range <= 1; full_range++) {
+            IJK_YUV2RGBA_init(&c, matrix, full_range, 1.3f, 1.8f, 1.5f);
+            IJK_YUV2RGBA_convertI420(&c, i420, i420_linesize, simd, width * 4, width, height);
+            c.use_simd = 0;
+            IJK_YUV2RGBA_convertI420(&c, i420, i420_linesize, ref, width * 4, width, height);
+            if (memcmp(simd, ref, width * height * 4)) {
+                printf("i420 %s mismatch, matrix %d full range %d\n", IJK_YUV2RGBA_simdName(), matrix, full_range);
+                return 1;
+            }
+            c.use_simd = 1;
+            IJK_YUV2RGBA_convertNV12(&c, nv12, nv12_linesize, simd, width * 4, width, height);
+            c.use_simd = 0;
+            IJK_YUV2RGBA_convertNV12(&c, nv12, nv12_linesize, ref, width * 4, width, height);
+            if (memcmp(simd, ref, width * height * 4)) {
+                printf("nv12 %s mismatch, matrix %d full range %d\n", IJK_YUV2RGBA_simdName(), matrix, full_range);
+                return 1;
+            }
+        }
+    }
+    printf("%s matches c for %dx%d\n", IJK_YUV2RGBA_simdName(), width, height);
+
+    IJK_YUV2RGBA_init(&c, YUV_2_RGB_Color_Matrix_BT709, 0, 1.0f, 1.0f, 1.0f);
+    for (int use_simd = 0; use_simd <= 1; use_simd++) {
+        double begin;
+        c.use_simd = use_simd;
+        begin = now_ms();
+        for (int i = 0; i < 100; i++)
+            IJK_YUV2RGBA_convertI420(&c, i420, i420_linesize, simd, width * 4, width, height);
+        printf("i420 %s: %.3fms per picture\n", use_simd ? IJK_YUV2RGBA_simdName() : "c", (now_ms() - begin) / 100);
+        begin = now_ms();
+        for (int i = 0; i < 100; i++)
+            IJK_YUV2RGBA_convertNV12(&c, nv12, nv12_linesize, simd, width * 4, width, height);
+        printf("nv12 %s: %.3fms per picture\n", use_simd ? IJK_YUV2RGBA_simdName() : "c", (now_ms() - begin) / 100);
+    }
+    return 0;
+}
@@ -59,6 +59,9 @@ LOCAL_SRC_FILES += ijkavformat/ijkmediadatasource.c
 LOCAL_SRC_FILES += ijkavformat/ijkio.c
 LOCAL_SRC_FILES += ijkavformat/ijkiomanager.c
 LOCAL_SRC_FILES += ijkavformat/ijkiocache.c
+LOCAL_SRC_FILES += ijkavformat/ijkioblockcache.c
+LOCAL_SRC_FILES += ijkavformat/ijkiofilemap.c
+LOCAL_SRC_FILES += ijkavformat/ijkiouring.c
 LOCAL_SRC_FILES += ijkavformat/ijkioffio.c
 LOCAL_SRC_FILES += ijkavformat/ijkioandroidio.c
 LOCAL_SRC_FILES += ijkavformat/ijkioprotocol.c
@@ -74,6 +77,7 @@ LOCAL_SRC_FILES += ijkavutil/ijkdict.c
 LOCAL_SRC_FILES += ijkavutil/ijkutils.c
 LOCAL_SRC_FILES += ijkavutil/ijkthreadpool.c
 LOCAL_SRC_FILES += ijkavutil/ijktree.c
+LOCAL_SRC_FILES += ijkavutil/ijkrangeindex.c
 LOCAL_SRC_FILES += ijkavutil/ijkfifo.c
 LOCAL_SRC_FILES += ijkavutil/ijkstl.cpp
 
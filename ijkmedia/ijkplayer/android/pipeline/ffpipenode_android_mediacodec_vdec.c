@@ -481,8 +481,7 @@ static int feed_input_buffer2(JNIEnv *env, IJKFF_Pipenode *node, int64_t timeUs,
 #endif
         AVPacket pkt;
         do {
-            if (d->queue->nb_packets == 0)
-                SDL_CondSignal(d->empty_queue_cond);
+            decoder_signal_empty_queue(d);
             if (ffp_packet_queue_get_or_buffering(ffp, d->queue, &pkt, &d->pkt_serial, &d->finished) < 0) {
                 ret = -1;
                 goto fail;
@@ -726,8 +725,7 @@ static int feed_input_buffer(JNIEnv *env, IJKFF_Pipenode *node, int64_t timeUs,
 #endif
         AVPacket pkt;
         do {
-            if (d->queue->nb_packets == 0)
-                SDL_CondSignal(d->empty_queue_cond);
+            decoder_signal_empty_queue(d);
             if (ffp_packet_queue_get_or_buffering(ffp, d->queue, &pkt, &d->pkt_serial, &d->finished) < 0) {
                 ret = -1;
                 goto fail;
@@ -1481,7 +1479,7 @@ static int drain_output_buffer2(JNIEnv *env, IJKFF_Pipenode *node, int64_t timeU
                 double diff = dpts - ffp_get_master_clock(is);
                 if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD &&
                     diff - is->frame_last_filter_delay < 0 &&
-                    is->viddec.pkt_serial == is->vidclk.serial &&
+                    is->viddec.pkt_serial == ffp_get_video_clock_serial(is) &&
                     is->videoq.nb_packets) {
                     is->frame_drops_early++;
                     is->continuous_frame_drops_early++;
@@ -1622,7 +1620,7 @@ static int func_run_sync(IJKFF_Pipenode *node)
                     double diff = dpts - ffp_get_master_clock(is);
                     if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD &&
                         diff - is->frame_last_filter_delay < 0 &&
-                        is->viddec.pkt_serial == is->vidclk.serial &&
+                        is->viddec.pkt_serial == ffp_get_video_clock_serial(is) &&
                         is->videoq.nb_packets) {
                         is->frame_drops_early++;
                         is->continuous_frame_drops_early++;
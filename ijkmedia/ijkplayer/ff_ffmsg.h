@@ -42,6 +42,9 @@
 #define FFP_MSG_COMPONENT_OPEN              409
 #define FFP_MSG_VIDEO_SEEK_RENDERING_START  410
 #define FFP_MSG_AUDIO_SEEK_RENDERING_START  411
+#define FFP_MSG_NEXT_ITEM_FAILED            412     /* arg1 = error, the preloaded item can't follow gaplessly */
+#define FFP_MSG_NEXT_ITEM_STARTED           413     /* arg1 = duration of the item in milliseconds */
+#define FFP_MSG_TRICK_PLAY_END              414     /* arg1 = position in milliseconds, trick play hit the start or end and stopped */
 
 #define FFP_MSG_BUFFERING_START             500
 #define FFP_MSG_BUFFERING_END               501
@@ -98,6 +101,32 @@
 #define FFP_PROP_INT64_TRAFFIC_STATISTIC_BYTE_COUNT     20204
 
 #define FFP_PROP_INT64_LATEST_SEEK_LOAD_DURATION        20300
+#define FFP_PROP_INT64_STREAM_OPEN_DURATION             20301
+#define FFP_PROP_INT64_PROBE_CACHE_HIT                  20302
+#define FFP_PROP_INT64_TRICK_PLAY_RATE                  20303   /* 0 off, 4..64 forward, -64..-4 backward */
+#define FFP_PROP_INT64_LIVE_LATENCY                     20304   /* ms behind the live edge, live-target-latency-ms only */
+
+/* per video frame distributions in us, in FFP_FRAME_HIST_* order, 4 ids each */
+#define FFP_PROP_INT64_DECODE_TIME_P50                  20310
+#define FFP_PROP_INT64_DECODE_TIME_P95                  20311
+#define FFP_PROP_INT64_DECODE_TIME_P99                  20312
+#define FFP_PROP_INT64_DECODE_TIME_MAX                  20313
+#define FFP_PROP_INT64_QUEUE_WAIT_P50                   20314
+#define FFP_PROP_INT64_QUEUE_WAIT_P95                   20315
+#define FFP_PROP_INT64_QUEUE_WAIT_P99                   20316
+#define FFP_PROP_INT64_QUEUE_WAIT_MAX                   20317
+#define FFP_PROP_INT64_DISPLAY_DELAY_P50                20318
+#define FFP_PROP_INT64_DISPLAY_DELAY_P95                20319
+#define FFP_PROP_INT64_DISPLAY_DELAY_P99                20320
+#define FFP_PROP_INT64_DISPLAY_DELAY_MAX                20321
+#define FFP_PROP_INT64_PRESENT_JITTER_P50               20322
+#define FFP_PROP_INT64_PRESENT_JITTER_P95               20323
+#define FFP_PROP_INT64_PRESENT_JITTER_P99               20324
+#define FFP_PROP_INT64_PRESENT_JITTER_MAX               20325
+#define FFP_PROP_INT64_AV_SYNC_ERROR_P50                20326
+#define FFP_PROP_INT64_AV_SYNC_ERROR_P95                20327
+#define FFP_PROP_INT64_AV_SYNC_ERROR_P99                20328
+#define FFP_PROP_INT64_AV_SYNC_ERROR_MAX                20329
 
 #define FFP_PROP_INT64_CACHE_STATISTIC_PHYSICAL_POS     20205
 
@@ -39,6 +39,26 @@ typedef struct AVMessage {
     struct AVMessage *next;
 } AVMessage;
 
+/*
+ * Updates posted over and over with only the latest one worth showing. A put
+ * of such a message stores its args in the slot of its type and links a
+ * marker into the queue only if none is queued yet, the consumer reads the
+ * args when it gets to the marker. A slow consumer so sees one update of each
+ * type at the position of the oldest one instead of falling behind on all of them.
+ */
+#define MSG_QUEUE_COALESCE_SLOTS 3
+
+typedef struct MessageCoalesceSlot {
+    uint64_t args;  // arg1 in the low 32 bits, arg2 in the high ones
+    int queued;
+} MessageCoalesceSlot;
+
+/*
+ * Producers never take mutex, they swap themselves into in_head of an
+ * intrusive MPSC list (Vyukov) and only lock to signal when consumer_waiting
+ * is set. mutex serializes the consumer side: get, flush and remove move the
+ * linked messages over to first_msg/last_msg and work on that list.
+ */
 typedef struct MessageQueue {
     AVMessage *first_msg, *last_msg;
     int nb_messages;
@@ -46,9 +66,19 @@ typedef struct MessageQueue {
     SDL_mutex *mutex;
     SDL_cond *cond;
 
+    AVMessage *in_head;
+    AVMessage *in_tail;
+    AVMessage in_stub;
+    int consumer_waiting;
+
+    // pushed by the consumer side, popped by the one producer holding recycle_busy
     AVMessage *recycle_msg;
+    int recycle_busy;
     int recycle_count;
     int alloc_count;
+    int coalesce_count;
+
+    MessageCoalesceSlot coalesce[MSG_QUEUE_COALESCE_SLOTS];
 } MessageQueue;
 
 inline static void msg_free_res(AVMessage *msg)
@@ -60,56 +90,155 @@ inline static void msg_free_res(AVMessage *msg)
     msg->obj = NULL;
 }
 
-inline static int msg_queue_put_private(MessageQueue *q, AVMessage *msg)
+inline static int msg_coalesce_slot(int what)
 {
-    AVMessage *msg1;
+    switch (what) {
+        case FFP_MSG_BUFFERING_UPDATE:          return 0;
+        case FFP_MSG_BUFFERING_BYTES_UPDATE:    return 1;
+        case FFP_MSG_BUFFERING_TIME_UPDATE:     return 2;
+        default:                                return -1;
+    }
+}
 
-    if (q->abort_request)
-        return -1;
+inline static AVMessage *msg_queue_alloc_msg(MessageQueue *q)
+{
+    AVMessage *msg = NULL;
 
 #ifdef FFP_MERGE
-    msg1 = av_malloc(sizeof(AVMessage));
+    msg = av_malloc(sizeof(AVMessage));
 #else
-    msg1 = q->recycle_msg;
-    if (msg1) {
-        q->recycle_msg = msg1->next;
-        q->recycle_count++;
+    // a producer losing the race allocates instead of waiting, one popper at a time keeps the stack free of ABA
+    if (!__atomic_exchange_n(&q->recycle_busy, 1, __ATOMIC_ACQUIRE)) {
+        msg = __atomic_load_n(&q->recycle_msg, __ATOMIC_ACQUIRE);
+        while (msg && !__atomic_compare_exchange_n(&q->recycle_msg, &msg, msg->next, 1, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            ;
+        __atomic_store_n(&q->recycle_busy, 0, __ATOMIC_RELEASE);
+    }
+    if (msg) {
+        __atomic_add_fetch(&q->recycle_count, 1, __ATOMIC_RELAXED);
     } else {
-        q->alloc_count++;
-        msg1 = av_malloc(sizeof(AVMessage));
+        __atomic_add_fetch(&q->alloc_count, 1, __ATOMIC_RELAXED);
+        msg = av_malloc(sizeof(AVMessage));
     }
 #ifdef FFP_SHOW_MSG_RECYCLE
     int total_count = q->recycle_count + q->alloc_count;
     if (!(total_count % 10)) {
-        av_log(NULL, AV_LOG_DEBUG, "msg-recycle \t%d + \t%d = \t%d\n", q->recycle_count, q->alloc_count, total_count);
+        av_log(NULL, AV_LOG_DEBUG, "msg-recycle \t%d + \t%d = \t%d, coalesced \t%d\n", q->recycle_count, q->alloc_count, total_count, q->coalesce_count);
     }
 #endif
 #endif
-    if (!msg1)
-        return -1;
+    return msg;
+}
 
-    *msg1 = *msg;
-    msg1->next = NULL;
-
-    if (!q->last_msg)
-        q->first_msg = msg1;
-    else
-        q->last_msg->next = msg1;
-    q->last_msg = msg1;
-    q->nb_messages++;
-    SDL_CondSignal(q->cond);
-    return 0;
+inline static void msg_queue_recycle_l(MessageQueue *q, AVMessage *msg)
+{
+#ifdef FFP_MERGE
+    av_free(msg);
+#else
+    AVMessage *head = __atomic_load_n(&q->recycle_msg, __ATOMIC_RELAXED);
+    do {
+        msg->next = head;
+    } while (!__atomic_compare_exchange_n(&q->recycle_msg, &head, msg, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#endif
+}
+
+inline static void msg_queue_link(MessageQueue *q, AVMessage *msg)
+{
+    AVMessage *prev;
+
+    __atomic_store_n(&msg->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&q->in_head, msg, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&prev->next, msg, __ATOMIC_RELEASE);
+}
+
+/* NULL when empty, or when a producer swapped in_head but did not link prev->next yet */
+inline static AVMessage *msg_queue_unlink_l(MessageQueue *q)
+{
+    AVMessage *tail = q->in_tail;
+    AVMessage *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &q->in_stub) {
+        if (!next)
+            return NULL;
+        q->in_tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        q->in_tail = next;
+        return tail;
+    }
+    if (tail != __atomic_load_n(&q->in_head, __ATOMIC_ACQUIRE))
+        return NULL;
+    // tail is the last one, put the stub behind it so tail can be handed out
+    msg_queue_link(q, &q->in_stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        q->in_tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+inline static void msg_queue_drain_l(MessageQueue *q)
+{
+    AVMessage *msg;
+
+    while ((msg = msg_queue_unlink_l(q)) != NULL) {
+        msg->next = NULL;
+        if (!q->last_msg)
+            q->first_msg = msg;
+        else
+            q->last_msg->next = msg;
+        q->last_msg = msg;
+        q->nb_messages++;
+    }
+}
+
+inline static void msg_queue_drop_l(MessageQueue *q, AVMessage *msg)
+{
+    int slot = msg->obj ? -1 : msg_coalesce_slot(msg->what);
+
+    if (slot >= 0)
+        __atomic_store_n(&q->coalesce[slot].queued, 0, __ATOMIC_SEQ_CST);
+    msg_free_res(msg);
+    msg_queue_recycle_l(q, msg);
 }
 
 inline static int msg_queue_put(MessageQueue *q, AVMessage *msg)
 {
-    int ret;
+    AVMessage *msg1;
+    int slot;
 
-    SDL_LockMutex(q->mutex);
-    ret = msg_queue_put_private(q, msg);
-    SDL_UnlockMutex(q->mutex);
+    if (__atomic_load_n(&q->abort_request, __ATOMIC_ACQUIRE))
+        return -1;
 
-    return ret;
+    slot = msg->obj ? -1 : msg_coalesce_slot(msg->what);
+    if (slot >= 0) {
+        MessageCoalesceSlot *s = &q->coalesce[slot];
+        __atomic_store_n(&s->args, (uint32_t)msg->arg1 | ((uint64_t)(uint32_t)msg->arg2 << 32), __ATOMIC_SEQ_CST);
+        if (__atomic_exchange_n(&s->queued, 1, __ATOMIC_SEQ_CST)) {
+            __atomic_add_fetch(&q->coalesce_count, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+
+    msg1 = msg_queue_alloc_msg(q);
+    if (!msg1) {
+        if (slot >= 0)
+            __atomic_store_n(&q->coalesce[slot].queued, 0, __ATOMIC_SEQ_CST);
+        return -1;
+    }
+
+    *msg1 = *msg;
+    msg_queue_link(q, msg1);
+
+    if (__atomic_load_n(&q->consumer_waiting, __ATOMIC_SEQ_CST)) {
+        SDL_LockMutex(q->mutex);
+        SDL_CondSignal(q->cond);
+        SDL_UnlockMutex(q->mutex);
+    }
+    return 0;
 }
 
 inline static void msg_init_msg(AVMessage *msg)
@@ -159,7 +288,8 @@ inline static void msg_queue_put_simple4(MessageQueue *q, int what, int arg1, in
     msg.obj = av_malloc(obj_len);
     memcpy(msg.obj, obj, obj_len);
     msg.free_l = msg_obj_free_l;
-    msg_queue_put(q, &msg);
+    if (msg_queue_put(q, &msg) < 0)
+        msg_free_res(&msg);
 }
 
 inline static void msg_queue_put_str(MessageQueue *q, int what, const char *str)
@@ -178,6 +308,8 @@ inline static void msg_queue_init(MessageQueue *q)
     q->mutex = SDL_CreateMutex();
     q->cond = SDL_CreateCond();
     q->abort_request = 1;
+    q->in_head = &q->in_stub;
+    q->in_tail = &q->in_stub;
 }
 
 inline static void msg_queue_flush(MessageQueue *q)
@@ -185,14 +317,10 @@ inline static void msg_queue_flush(MessageQueue *q)
     AVMessage *msg, *msg1;
 
     SDL_LockMutex(q->mutex);
+    msg_queue_drain_l(q);
     for (msg = q->first_msg; msg != NULL; msg = msg1) {
         msg1 = msg->next;
-#ifdef FFP_MERGE
-        av_freep(&msg);
-#else
-        msg->next = q->recycle_msg;
-        q->recycle_msg = msg;
-#endif
+        msg_queue_drop_l(q, msg);
     }
     q->last_msg = NULL;
     q->first_msg = NULL;
@@ -222,7 +350,7 @@ inline static void msg_queue_abort(MessageQueue *q)
 {
     SDL_LockMutex(q->mutex);
 
-    q->abort_request = 1;
+    __atomic_store_n(&q->abort_request, 1, __ATOMIC_RELEASE);
 
     SDL_CondSignal(q->cond);
 
@@ -232,13 +360,26 @@ inline static void msg_queue_abort(MessageQueue *q)
 inline static void msg_queue_start(MessageQueue *q)
 {
     SDL_LockMutex(q->mutex);
-    q->abort_request = 0;
+    __atomic_store_n(&q->abort_request, 0, __ATOMIC_RELEASE);
+    SDL_UnlockMutex(q->mutex);
 
     AVMessage msg;
     msg_init_msg(&msg);
     msg.what = FFP_MSG_FLUSH;
-    msg_queue_put_private(q, &msg);
-    SDL_UnlockMutex(q->mutex);
+    msg_queue_put(q, &msg);
+}
+
+/* called with mutex held and nothing to return */
+inline static void msg_queue_wait_l(MessageQueue *q)
+{
+    __atomic_store_n(&q->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+    if (q->in_tail == &q->in_stub && __atomic_load_n(&q->in_head, __ATOMIC_SEQ_CST) == &q->in_stub) {
+        SDL_CondWait(q->cond, q->mutex);
+    } else {
+        // a producer is between its two stores and may be preempted there, poll instead of spinning
+        SDL_CondWaitTimeout(q->cond, q->mutex, 1);
+    }
+    __atomic_store_n(&q->consumer_waiting, 0, __ATOMIC_RELAXED);
 }
 
 /* return < 0 if aborted, 0 if no msg and > 0 if msg.  */
@@ -246,6 +387,7 @@ inline static int msg_queue_get(MessageQueue *q, AVMessage *msg, int block)
 {
     AVMessage *msg1;
     int ret;
+    int slot;
 
     SDL_LockMutex(q->mutex);
 
@@ -255,6 +397,9 @@ inline static int msg_queue_get(MessageQueue *q, AVMessage *msg, int block)
             break;
         }
 
+        if (!q->first_msg)
+            msg_queue_drain_l(q);
+
         msg1 = q->first_msg;
         if (msg1) {
             q->first_msg = msg1->next;
@@ -263,19 +408,23 @@ inline static int msg_queue_get(MessageQueue *q, AVMessage *msg, int block)
             q->nb_messages--;
             *msg = *msg1;
             msg1->obj = NULL;
-#ifdef FFP_MERGE
-            av_free(msg1);
-#else
-            msg1->next = q->recycle_msg;
-            q->recycle_msg = msg1;
-#endif
+            slot = msg->obj ? -1 : msg_coalesce_slot(msg->what);
+            if (slot >= 0) {
+                // clear queued first, an update stored after the load below links a new marker
+                uint64_t args;
+                __atomic_store_n(&q->coalesce[slot].queued, 0, __ATOMIC_SEQ_CST);
+                args = __atomic_load_n(&q->coalesce[slot].args, __ATOMIC_SEQ_CST);
+                msg->arg1 = (int)(uint32_t)args;
+                msg->arg2 = (int)(uint32_t)(args >> 32);
+            }
+            msg_queue_recycle_l(q, msg1);
             ret = 1;
             break;
         } else if (!block) {
             ret = 0;
             break;
         } else {
-            SDL_CondWait(q->cond, q->mutex);
+            msg_queue_wait_l(q);
         }
     }
     SDL_UnlockMutex(q->mutex);
@@ -287,6 +436,10 @@ inline static void msg_queue_remove(MessageQueue *q, int what)
     AVMessage **p_msg, *msg, *last_msg;
     SDL_LockMutex(q->mutex);
 
+    if (!q->abort_request) {
+        msg_queue_drain_l(q);
+    }
+
     last_msg = q->first_msg;
 
     if (!q->abort_request && q->first_msg) {
@@ -296,13 +449,7 @@ inline static void msg_queue_remove(MessageQueue *q, int what)
 
             if (msg->what == what) {
                 *p_msg = msg->next;
-#ifdef FFP_MERGE
-                av_free(msg);
-#else
-                msg_free_res(msg);
-                msg->next = q->recycle_msg;
-                q->recycle_msg = msg;
-#endif
+                msg_queue_drop_l(q, msg);
                 q->nb_messages--;
             } else {
                 last_msg = msg;
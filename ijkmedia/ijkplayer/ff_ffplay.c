@@ -34,6 +34,7 @@
 #include <signal.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <sched.h>
 
 #include "libavutil/avstring.h"
 #include "libavutil/eval.h"
@@ -74,7 +75,12 @@
 #include "ijkplayer.h"
 #include "ff_frame_queue.h"
 #include "ff_packet_list.h"
+#include "ff_probe_cache.h"
+#include "ff_preload.h"
+#include "ff_player_group.h"
+#include "ff_mosaic.h"
 #include "ff_subtitle.h"
+#include "ff_trace.h"
 #include "ijksdl/ijksdl_gpu.h"
 #include <stdatomic.h>
 #if defined(__ANDROID__)
@@ -135,6 +141,7 @@ int cmp_audio_fmts(enum AVSampleFormat fmt1, int64_t channel_count1,
 static void free_picture(Frame *vp);
 static double consume_audio_buffer(FFPlayer *ffp, double diff);
 static void update_sample_display(FFPlayer *ffp, uint8_t *samples, int samples_size);
+static void stream_wake_read_thread(void *opaque);
 
 static int packet_queue_get_or_buffering(FFPlayer *ffp, PacketQueue *q, AVPacket *pkt, int *serial, int *finished)
 {
@@ -201,6 +208,7 @@ static int packet_queue_get_or_buffering(FFPlayer *ffp, PacketQueue *q, AVPacket
 static int decoder_decode_frame(FFPlayer *ffp, Decoder *d, AVFrame *frame, AVSubtitle *sub) {
     
     int status = 0;
+    int64_t call_start;
     for (;;) {
         
         if (d->queue->serial == d->pkt_serial) {
@@ -212,10 +220,16 @@ static int decoder_decode_frame(FFPlayer *ffp, Decoder *d, AVFrame *frame, AVSub
                     goto abort_end;
                 }
 
+                FFTRACE_BEGIN("avcodec_receive_frame");
                 switch (d->avctx->codec_type) {
                     case AVMEDIA_TYPE_VIDEO:
+                        call_start = av_gettime_relative();
                         ret = avcodec_receive_frame(d->avctx, frame);
+                        d->decode_time += av_gettime_relative() - call_start;
                         if (ret >= 0) {
+                            /* wall time of the codec calls, frame threading moves most of the work elsewhere */
+                            ff_histogram_record(&ffp->stat.frame_hist[FFP_FRAME_HIST_DECODE_TIME], d->decode_time);
+                            d->decode_time = 0;
                             int vdec_type = frame->format == AV_PIX_FMT_VIDEOTOOLBOX ? FFP_PROPV_DECODER_AVCODEC_HW : FFP_PROPV_DECODER_AVCODEC;
                             
                             if (ffp->node_vdec->vdec_type == FFP_PROPV_DECODER_UNKNOWN) {
@@ -282,6 +296,7 @@ static int decoder_decode_frame(FFPlayer *ffp, Decoder *d, AVFrame *frame, AVSub
                     default:
                         break;
                 }
+                FFTRACE_END("avcodec_receive_frame");
                 if (ret == AVERROR_EOF) {
                     d->finished = d->pkt_serial;
                     avcodec_flush_buffers(d->avctx);
@@ -301,8 +316,7 @@ static int decoder_decode_frame(FFPlayer *ffp, Decoder *d, AVFrame *frame, AVSub
         }
         
         do {
-            if (d->queue->nb_packets == 0)
-                SDL_CondSignal(d->empty_queue_cond);
+            decoder_signal_empty_queue(d);
             if (d->packet_pending) {
                 d->packet_pending = 0;
             } else {
@@ -316,6 +330,7 @@ static int decoder_decode_frame(FFPlayer *ffp, Decoder *d, AVFrame *frame, AVSub
                     avcodec_flush_buffers(d->avctx);
                     d->finished = 0;
                     d->hw_failed_count = 0;
+                    d->decode_time = 0;
                     d->next_pts = d->start_pts;
                     d->next_pts_tb = d->start_pts_tb;
                 }
@@ -342,7 +357,12 @@ static int decoder_decode_frame(FFPlayer *ffp, Decoder *d, AVFrame *frame, AVSub
                 status = -1;
                 goto abort_end;
             }
+            FFTRACE_BEGIN("avcodec_send_packet");
+            call_start = av_gettime_relative();
             int send = avcodec_send_packet(d->avctx, d->pkt);
+            if (d->avctx->codec_type == AVMEDIA_TYPE_VIDEO)
+                d->decode_time += av_gettime_relative() - call_start;
+            FFTRACE_END("avcodec_send_packet");
             if (send == AVERROR(EAGAIN)) {
                 av_log(d->avctx, AV_LOG_ERROR, "Receive_frame and send_packet both returned EAGAIN, which is an API violation.\n");
                 d->packet_pending = 1;
@@ -537,6 +557,7 @@ static void stream_component_close(FFPlayer *ffp, int stream_index)
     case AVMEDIA_TYPE_VIDEO:
         decoder_abort(&is->viddec, &is->pictq);
         decoder_destroy(&is->viddec);
+        ff_mosaic_destroyp(&is->mosaic);
         break;
     default:
         break;
@@ -560,12 +581,22 @@ static void stream_component_close(FFPlayer *ffp, int stream_index)
     }
 }
 
+/* a chained input interrupts through its preloader, close it first */
+static void stream_chain_close(AVFormatContext **pic, FFPreloader **preloader)
+{
+    avformat_close_input(pic);
+    ff_preloader_destroyp(preloader);
+}
+
 static void stream_close(FFPlayer *ffp)
 {
     av_log(NULL, AV_LOG_INFO, "stream_close will close\n");
     VideoState *is = ffp->is;
+    /* the group can't wake a read_thread that is going away */
+    ff_player_group_set_wake(ffp, NULL, NULL);
     /* XXX: use a special url_shutdown call to abort parse cleanly */
     is->abort_request = 1;
+    stream_wake_read_thread(is);
     packet_queue_abort(&is->videoq);
     packet_queue_abort(&is->audioq);
     ff_sub_abort(is->ffSub);
@@ -577,6 +608,11 @@ static void stream_close(FFPlayer *ffp)
         stream_component_close(ffp, is->video_stream);
     
     avformat_close_input(&is->ic);
+    stream_chain_close(&is->chain_ic, &is->chain_preloader);
+    stream_chain_close(&is->prev_chain_ic, &is->prev_chain_preloader);
+    stream_chain_close(&is->chain_next_ic, &is->chain_next_preloader);
+    ff_preloader_destroyp(&is->preloader);
+    av_dict_free(&is->format_opts);
     
     av_log(NULL, AV_LOG_DEBUG, "wait for video_refresh_tid\n");
     SDL_WaitThread(is->video_refresh_tid, NULL);
@@ -592,6 +628,7 @@ static void stream_close(FFPlayer *ffp)
     SDL_DestroyCond(is->audio_accurate_seek_cond);
     SDL_DestroyCond(is->video_accurate_seek_cond);
     SDL_DestroyCond(is->continue_read_thread);
+    SDL_DestroyMutex(is->continue_read_mutex);
     SDL_DestroyMutex(is->accurate_seek_mutex);
     SDL_DestroyMutex(is->play_mutex);
 #if !CONFIG_AVFILTER
@@ -607,8 +644,8 @@ static void stream_close(FFPlayer *ffp)
     }
 #endif
     av_free(is->filename);
-    av_free(is);
-    ffp->is = NULL;
+    ffp_freep_cacheline(&ffp->is);
+    set_clock(&ffp->position_clk, NAN, -1);
     av_log(NULL, AV_LOG_INFO, "stream_close did close\n");
 }
 
@@ -625,16 +662,105 @@ static void video_display2(FFPlayer *ffp)
         video_image_display2(ffp);
 }
 
-static double _get_clock_apply_delay(Clock *c, int apply)
+#define CLOCK_LOAD(c, field, dst) __atomic_load(&(c)->field, &(dst), __ATOMIC_RELAXED)
+#define CLOCK_STORE(c, field, val) do {                         \
+        __typeof__((c)->field) clock_val__ = (val);            \
+        __atomic_store(&(c)->field, &clock_val__, __ATOMIC_RELAXED); \
+    } while (0)
+
+// spins on an odd seq before yielding, a writer holds it for a few stores unless preempted
+#define CLOCK_SPIN_LIMIT 64
+
+/* waits for the writer holding an odd seq, yields to it once spinning didn't help */
+static void clock_backoff(int *spins)
 {
-    if (*c->queue_serial != c->serial)
-        return NAN;
-    if (c->paused) {
-        return c->pts + (apply ? c->extra_delay : 0);
-    } else {
-        double time = av_gettime_relative() / 1000000.0;
-        return c->pts_drift + time - (time - c->last_updated) * (1.0 - c->speed) + (apply ? c->extra_delay : 0);
+    if (++*spins >= CLOCK_SPIN_LIMIT) {
+        *spins = 0;
+        sched_yield();
+    }
+}
+
+/*
+ * the audio callback, the refresh thread, read_thread and pause all write clocks,
+ * taking seq from even to odd by cas keeps them one at a time
+ */
+static void clock_write_begin(Clock *c)
+{
+    unsigned seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
+    int spins = 0;
+
+    while ((seq & 1) || !__atomic_compare_exchange_n(&c->seq, &seq, seq + 1, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        clock_backoff(&spins);
+        seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
     }
+    // the odd seq is visible before any of the stores that follow
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void clock_write_end(Clock *c)
+{
+    __atomic_add_fetch(&c->seq, 1, __ATOMIC_RELEASE);
+}
+
+/* never takes a lock, retries only while a writer is inside its few stores */
+static void clock_read(Clock *c, ClockState *s)
+{
+    unsigned seq;
+    int spins = 0;
+
+    do {
+        while ((seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE)) & 1)
+            clock_backoff(&spins);
+        CLOCK_LOAD(c, pts, s->pts);
+        CLOCK_LOAD(c, pts_drift, s->pts_drift);
+        CLOCK_LOAD(c, last_updated, s->last_updated);
+        CLOCK_LOAD(c, speed, s->speed);
+        CLOCK_LOAD(c, serial, s->serial);
+        CLOCK_LOAD(c, paused, s->paused);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&c->seq, __ATOMIC_RELAXED) != seq);
+}
+
+/* the fields as seen by the writer between clock_write_begin() and clock_write_end() */
+static void clock_read_l(Clock *c, ClockState *s)
+{
+    s->pts          = c->pts;
+    s->pts_drift    = c->pts_drift;
+    s->last_updated = c->last_updated;
+    s->speed        = c->speed;
+    s->serial       = c->serial;
+    s->paused       = c->paused;
+}
+
+static double clock_state_get(Clock *c, const ClockState *s, double delay, double time)
+{
+    if (__atomic_load_n(c->queue_serial, __ATOMIC_RELAXED) != s->serial)
+        return NAN;
+    if (s->paused)
+        return s->pts + delay;
+    return s->pts_drift + time - (time - s->last_updated) * (1.0 - s->speed) + delay;
+}
+
+static void clock_store_l(Clock *c, double pts, int serial, double time)
+{
+    CLOCK_STORE(c, pts, pts);
+    CLOCK_STORE(c, last_updated, time);
+    CLOCK_STORE(c, pts_drift, pts - time);
+    CLOCK_STORE(c, serial, serial);
+#ifdef FFP_SHOW_SYNC_CLOCK
+    av_log(NULL,AV_LOG_INFO,"set %s clock %f\n",c->name,pts);
+#endif
+}
+
+static double _get_clock_apply_delay(Clock *c, int apply)
+{
+    ClockState s;
+    float delay = 0;
+
+    clock_read(c, &s);
+    if (apply)
+        CLOCK_LOAD(c, extra_delay, delay);
+    return clock_state_get(c, &s, delay, av_gettime_relative() / 1000000.0);
 }
 
 static double get_clock(Clock *c)
@@ -647,15 +773,30 @@ static double get_clock_with_delay(Clock *c)
     return _get_clock_apply_delay(c, 1);
 }
 
+static double get_clock_pts(Clock *c)
+{
+    ClockState s;
+    clock_read(c, &s);
+    return s.pts;
+}
+
+static double get_clock_speed(Clock *c)
+{
+    double speed;
+    CLOCK_LOAD(c, speed, speed);
+    return speed;
+}
+
+static int get_clock_serial(Clock *c)
+{
+    return __atomic_load_n(&c->serial, __ATOMIC_RELAXED);
+}
+
 static void set_clock_at(Clock *c, double pts, int serial, double time)
 {
-    c->pts = pts;
-    c->last_updated = time;
-    c->pts_drift = c->pts - time;
-    c->serial = serial;
-#ifdef FFP_SHOW_SYNC_CLOCK
-    av_log(NULL,AV_LOG_INFO,"set %s clock %f\n",c->name,c->pts);
-#endif
+    clock_write_begin(c);
+    clock_store_l(c, pts, serial, time);
+    clock_write_end(c);
 }
 
 static void set_clock(Clock *c, double pts, int serial)
@@ -664,24 +805,58 @@ static void set_clock(Clock *c, double pts, int serial)
     set_clock_at(c, pts, serial, time);
 }
 
+/* restart the clock at time from its current value, within one write so no reader sees it jump */
+static void clock_rebase_l(Clock *c, double time)
+{
+    ClockState s;
+
+    clock_read_l(c, &s);
+    clock_store_l(c, clock_state_get(c, &s, 0, time), s.serial, time);
+}
+
+static void set_clock_now(Clock *c)
+{
+    double time = av_gettime_relative() / 1000000.0;
+
+    clock_write_begin(c);
+    clock_rebase_l(c, time);
+    clock_write_end(c);
+}
+
+static void set_clock_paused(Clock *c, int paused)
+{
+    clock_write_begin(c);
+    CLOCK_STORE(c, paused, paused);
+    clock_write_end(c);
+}
+
 static void set_clock_extral_delay(Clock *c, float delay)
 {
-    c->extra_delay = delay;
+    CLOCK_STORE(c, extra_delay, delay);
 }
 
 float get_clock_extral_delay(Clock *c)
 {
-    return c ? c->extra_delay : 0.0;
+    float delay = 0.0;
+
+    if (c)
+        CLOCK_LOAD(c, extra_delay, delay);
+    return delay;
 }
 
 static void set_clock_speed(Clock *c, double speed)
 {
-    set_clock(c, get_clock(c), c->serial);
-    c->speed = speed;
+    double time = av_gettime_relative() / 1000000.0;
+
+    clock_write_begin(c);
+    clock_rebase_l(c, time);
+    CLOCK_STORE(c, speed, speed);
+    clock_write_end(c);
 }
 
 static void init_clock(Clock *c, int *queue_serial, char *name)
 {
+    c->seq = 0;
     c->speed = 1.0;
     c->paused = 0;
     c->queue_serial = queue_serial;
@@ -691,10 +866,15 @@ static void init_clock(Clock *c, int *queue_serial, char *name)
 
 static void sync_clock_to_slave(Clock *c, Clock *slave)
 {
+    double time = av_gettime_relative() / 1000000.0;
+    ClockState s;
     double clock = get_clock(c);
-    double slave_clock = get_clock(slave);
+    double slave_clock;
+
+    clock_read(slave, &s);
+    slave_clock = clock_state_get(slave, &s, 0, time);
     if (!isnan(slave_clock) && (isnan(clock) || fabs(clock - slave_clock) > AV_NOSYNC_THRESHOLD))
-        set_clock(c, slave_clock, slave->serial);
+        set_clock_at(c, slave_clock, s.serial, time);
 }
 
 static int get_master_sync_type(VideoState *is) {
@@ -713,22 +893,21 @@ static int get_master_sync_type(VideoState *is) {
     }
 }
 
-static double _get_master_clock_apply_delay(VideoState *is, int apply)
+static Clock *get_master_clock_ref(VideoState *is)
 {
-    double val;
-
     switch (get_master_sync_type(is)) {
         case AV_SYNC_VIDEO_MASTER:
-            val = _get_clock_apply_delay(&is->vidclk, apply);
-            break;
+            return &is->vidclk;
         case AV_SYNC_AUDIO_MASTER:
-            val = _get_clock_apply_delay(&is->audclk, apply);
-            break;
+            return &is->audclk;
         default:
-            val = _get_clock_apply_delay(&is->extclk, apply);
-            break;
+            return &is->extclk;
     }
-    return val;
+}
+
+static double _get_master_clock_apply_delay(VideoState *is, int apply)
+{
+    return _get_clock_apply_delay(get_master_clock_ref(is), apply);
 }
 
 static double get_master_clock_with_delay(VideoState *is)
@@ -745,17 +924,59 @@ static double get_master_clock(VideoState *is)
 static void check_external_clock_speed(VideoState *is) {
    if ((is->video_stream >= 0 && is->videoq.nb_packets <= EXTERNAL_CLOCK_MIN_FRAMES) ||
        (is->audio_stream >= 0 && is->audioq.nb_packets <= EXTERNAL_CLOCK_MIN_FRAMES)) {
-       set_clock_speed(&is->extclk, FFMAX(EXTERNAL_CLOCK_SPEED_MIN, is->extclk.speed - EXTERNAL_CLOCK_SPEED_STEP));
+       set_clock_speed(&is->extclk, FFMAX(EXTERNAL_CLOCK_SPEED_MIN, get_clock_speed(&is->extclk) - EXTERNAL_CLOCK_SPEED_STEP));
    } else if ((is->video_stream < 0 || is->videoq.nb_packets > EXTERNAL_CLOCK_MAX_FRAMES) &&
               (is->audio_stream < 0 || is->audioq.nb_packets > EXTERNAL_CLOCK_MAX_FRAMES)) {
-       set_clock_speed(&is->extclk, FFMIN(EXTERNAL_CLOCK_SPEED_MAX, is->extclk.speed + EXTERNAL_CLOCK_SPEED_STEP));
+       set_clock_speed(&is->extclk, FFMIN(EXTERNAL_CLOCK_SPEED_MAX, get_clock_speed(&is->extclk) + EXTERNAL_CLOCK_SPEED_STEP));
    } else {
-       double speed = is->extclk.speed;
+       double speed = get_clock_speed(&is->extclk);
        if (speed != 1.0)
            set_clock_speed(&is->extclk, speed + EXTERNAL_CLOCK_SPEED_STEP * (1.0 - speed) / fabs(1.0 - speed));
    }
 }
 
+/* realtime protocols, or http-flv, LAS and live HLS that have no duration */
+static int stream_is_live(VideoState *is)
+{
+    return is->realtime || (is->ic && is->ic->duration <= 0);
+}
+
+/* the rate set by the user times the catch-up speed of low-latency live */
+static float ffp_effective_playback_rate(FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+
+    if (is && is->live_speed > 0)
+        return ffp->pf_playback_rate * is->live_speed;
+    return ffp->pf_playback_rate;
+}
+
+/* wake read_thread for a request, or because a queue dropped to its low-water mark */
+static void stream_wake_read_thread(void *opaque)
+{
+    VideoState *is = opaque;
+
+    SDL_LockMutex(is->continue_read_mutex);
+    is->continue_read_pending = 1;
+    SDL_CondSignal(is->continue_read_thread);
+    SDL_UnlockMutex(is->continue_read_mutex);
+}
+
+/* called from read_thread, sleeps until stream_wake_read_thread() or timeout_ms if >= 0 */
+static void stream_wait_read_thread(VideoState *is, int timeout_ms)
+{
+    SDL_LockMutex(is->continue_read_mutex);
+    if (timeout_ms >= 0) {
+        if (!is->continue_read_pending && !is->abort_request)
+            SDL_CondWaitTimeout(is->continue_read_thread, is->continue_read_mutex, timeout_ms);
+    } else {
+        while (!is->continue_read_pending && !is->abort_request)
+            SDL_CondWait(is->continue_read_thread, is->continue_read_mutex);
+    }
+    is->continue_read_pending = 0;
+    SDL_UnlockMutex(is->continue_read_mutex);
+}
+
 /* seek in the stream */
 static int stream_seek(VideoState *is, int64_t pos, int64_t rel, int by_bytes)
 {
@@ -769,7 +990,7 @@ static int stream_seek(VideoState *is, int64_t pos, int64_t rel, int by_bytes)
             is->seek_flags |= AVSEEK_FLAG_BACKWARD;
         is->seek_req = 1;
         is->viddec.start_seek_time = SDL_GetTickHR();
-        SDL_CondSignal(is->continue_read_thread);
+        stream_wake_read_thread(is);
         return 0;
     }
     return -1;
@@ -780,24 +1001,30 @@ static void stream_toggle_pause_l(FFPlayer *ffp, int pause_on)
 {
     VideoState *is = ffp->is;
     if (is->paused && !pause_on) {
-        is->frame_timer += av_gettime_relative() / 1000000.0 - is->vidclk.last_updated;
+        ClockState vidclk;
+
+        clock_read(&is->vidclk, &vidclk);
+        is->frame_timer += av_gettime_relative() / 1000000.0 - vidclk.last_updated;
 
 #ifdef FFP_MERGE
         if (is->read_pause_return != AVERROR(ENOSYS)) {
-            is->vidclk.paused = 0;
+            set_clock_paused(&is->vidclk, 0);
         }
 #endif
-        set_clock(&is->vidclk, get_clock(&is->vidclk), is->vidclk.serial);
-        set_clock(&is->audclk, get_clock(&is->audclk), is->audclk.serial);
+        set_clock_now(&is->vidclk);
+        set_clock_now(&is->audclk);
     } else {
     }
-    set_clock(&is->extclk, get_clock(&is->extclk), is->extclk.serial);
-    if (is->step && (is->pause_req || is->buffering_on)) {
-        is->paused = is->vidclk.paused = is->extclk.paused = pause_on;
-    } else {
-        is->paused = is->audclk.paused = is->vidclk.paused = is->extclk.paused = pause_on;
+    set_clock_now(&is->extclk);
+    is->paused = pause_on;
+    set_clock_paused(&is->vidclk, pause_on);
+    set_clock_paused(&is->extclk, pause_on);
+    if (!is->step || !(is->pause_req || is->buffering_on)) {
+        set_clock_paused(&is->audclk, pause_on);
         SDL_AoutPauseAudio(ffp->aout, pause_on);
     }
+    /* read_thread pauses network streams itself */
+    stream_wake_read_thread(is);
 }
 
 static void stream_update_pause_l(FFPlayer *ffp)
@@ -822,8 +1049,8 @@ static void toggle_pause_l(FFPlayer *ffp, int pause_on)
     //we konw the get_clock return pts after pause.
     //during the period from last update clock to the current pause event, no one has updated the clock (pts),so after pause get_positon is on average 50ms slow(my test movie,audio pts update every 100ms)
     if ((is->pause_req && !pause_on) || (!is->pause_req && pause_on)) {
-        set_clock(&is->vidclk, get_clock(&is->vidclk), is->vidclk.serial);
-        set_clock(&is->audclk, get_clock(&is->audclk), is->audclk.serial);
+        set_clock_now(&is->vidclk);
+        set_clock_now(&is->audclk);
     }
     
     is->pause_req = pause_on;
@@ -867,6 +1094,10 @@ static double compute_target_delay(FFPlayer *ffp, double delay, VideoState *is)
        if it is the best guess */
     sync_threshold = FFMAX(AV_SYNC_THRESHOLD_MIN, FFMIN(AV_SYNC_THRESHOLD_MAX, delay));
     
+    /* trick play paces keyframes from read_thread, each one is shown as soon as it is decoded */
+    if (is->trick_rate)
+        return 0;
+
     /* update delay to follow master synchronisation source */
     if (get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER) {
         /* if video is slave, we try to correct big delays by
@@ -904,7 +1135,7 @@ static double compute_target_delay(FFPlayer *ffp, double delay, VideoState *is)
     }
     //for only video stream movie,using playbackRate speed play.
     else if (fabsf(ffp->pf_playback_rate) > 0.00001){
-        delay = delay / ffp->pf_playback_rate;
+        delay = delay / ffp_effective_playback_rate(ffp);
     }
 
     if (ffp) {
@@ -937,12 +1168,33 @@ static void update_video_pts(VideoState *is, double pts, int64_t pos, int serial
     sync_clock_to_slave(&is->extclk, &is->vidclk);
 }
 
+/* called once for every frame that gets displayed, target_time is when it was due */
+static void video_refresh_statistic(FFPlayer *ffp, Frame *vp, double target_time)
+{
+    VideoState *is = ffp->is;
+    FFHistogram *hist = ffp->stat.frame_hist;
+    int64_t now = av_gettime_relative();
+    double diff;
+
+    if (vp->queued_time > 0)
+        ff_histogram_record(&hist[FFP_FRAME_HIST_DISPLAY_DELAY], now - vp->queued_time);
+    if (!isnan(target_time))
+        ff_histogram_record(&hist[FFP_FRAME_HIST_PRESENT_JITTER], llabs(now - (int64_t)(target_time * 1000000.0)));
+    if (get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER) {
+        diff = vp->pts - get_master_clock_with_delay(is);
+        if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD)
+            ff_histogram_record(&hist[FFP_FRAME_HIST_AV_SYNC_ERROR], (int64_t)(fabs(diff) * 1000000.0));
+    }
+}
+
 /* called to display each frame */
 static void video_refresh(FFPlayer *opaque, double *remaining_time)
 {
     FFPlayer *ffp = opaque;
     VideoState *is = ffp->is;
     double time;
+    Frame *shown_vp = NULL;
+    double shown_target_time = NAN;
     
     //applay subtitle preference changed when the palyer was paused.
     if (is->paused && is->force_refresh_sub_changed) {
@@ -951,8 +1203,15 @@ static void video_refresh(FFPlayer *opaque, double *remaining_time)
         return;
     }
     
-    if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime)
-        check_external_clock_speed(is);
+    if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK) {
+        /* low-latency live drives the speed from read_thread instead of the queue fullness */
+        if (ffp->live_target_latency_ms > 0 && stream_is_live(is)) {
+            if (get_clock_speed(&is->extclk) != is->live_speed)
+                set_clock_speed(&is->extclk, is->live_speed);
+        } else if (is->realtime) {
+            check_external_clock_speed(is);
+        }
+    }
 
     if (!ffp->display_disable && is->show_mode != SHOW_MODE_VIDEO && is->audio_st) {
         time = av_gettime_relative() / 1000000.0;
@@ -1090,7 +1349,9 @@ retry:
                 }
                 
                 duration = vp_duration(is, vp, nextvp);
-                if(!is->step && (ffp->framedrop > 0 || (ffp->framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) && time > is->frame_timer + duration) {
+                /* late frames are always dropped while low-latency live catches up */
+                if(!is->step && (ffp->framedrop > 0 || (ffp->framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER) || is->live_speed > 1.0f) && time > is->frame_timer + duration) {
+                    FFTRACE_ASYNC_END("video frame", FFTRACE_ID(vp->pts));
                     frame_queue_next(&is->pictq);
                     ff_sub_drop_old_frames(is->ffSub);
                     goto retry;
@@ -1099,6 +1360,8 @@ retry:
             
             frame_queue_next(&is->pictq);
             is->force_refresh = 1;
+            shown_vp = vp;
+            shown_target_time = is->frame_timer;
 
             SDL_LockMutex(ffp->is->play_mutex);
             if (is->step) {
@@ -1128,8 +1391,14 @@ retry:
         }
 display:
         /* display picture */
-        if (!ffp->display_disable && is->force_refresh && is->show_mode == SHOW_MODE_VIDEO && is->pictq.rindex_shown)
+        if (!ffp->display_disable && is->force_refresh && is->show_mode == SHOW_MODE_VIDEO && is->pictq.rindex_shown) {
+            FFTRACE_BEGIN("video_display");
             video_display2(ffp);
+            FFTRACE_END("video_display");
+            FFTRACE_ASYNC_END("video frame", FFTRACE_ID(frame_queue_peek_last(&is->pictq)->pts));
+            if (shown_vp)
+                video_refresh_statistic(ffp, shown_vp, shown_target_time);
+        }
     }
     is->force_refresh = 0;
     
@@ -1237,6 +1506,7 @@ static int queue_picture(FFPlayer *ffp, AVFrame *src_frame, double pts, double d
     Frame *vp;
     int video_accurate_seek_fail = 0;
     int64_t now = 0;
+    int ret;
     
     monkey_log(NULL, AV_LOG_INFO,"xql video queue_picture\n");
     
@@ -1372,7 +1642,10 @@ static int queue_picture(FFPlayer *ffp, AVFrame *src_frame, double pts, double d
 
     monkey_log("will put frame, dropped vframe_count=%d, pts=%lf\n", is->drop_vframe_count, pts);
     
-    if (!(vp = frame_queue_peek_writable(&is->pictq)))
+    FFTRACE_BEGIN("frame_queue_peek_writable");
+    vp = frame_queue_peek_writable(&is->pictq);
+    FFTRACE_END("frame_queue_peek_writable");
+    if (!vp)
         return -1;
 
     vp->sar = src_frame->sample_aspect_ratio;
@@ -1425,6 +1698,15 @@ static int queue_picture(FFPlayer *ffp, AVFrame *src_frame, double pts, double d
                     }
                 }
             }
+        #else
+            //software vout, its simd kernels take 8 bit 4:2:0 only
+            if (src_format == AV_PIX_FMT_NV12) {
+                overlay_format = SDL_FCC_NV12;
+            } else if (src_format == AV_PIX_FMT_YUVJ420P || src_frame->color_range == AVCOL_RANGE_JPEG) {
+                overlay_format = SDL_FCC_J420;
+            } else {
+                overlay_format = SDL_FCC_I420;
+            }
         #endif
             //
             ffp->vout->overlay_format = overlay_format;
@@ -1544,7 +1826,10 @@ static int queue_picture(FFPlayer *ffp, AVFrame *src_frame, double pts, double d
 #endif
 #endif
         // FIXME: set swscale options
-        if (SDL_VoutFillFrameYUVOverlay(vp->bmp, src_frame) < 0) {
+        FFTRACE_BEGIN("fill_overlay");
+        ret = SDL_VoutFillFrameYUVOverlay(vp->bmp, src_frame);
+        FFTRACE_END("fill_overlay");
+        if (ret < 0) {
             av_log(NULL, AV_LOG_FATAL, "Cannot initialize the conversion context\n");
             return -3;
         }
@@ -1556,6 +1841,7 @@ static int queue_picture(FFPlayer *ffp, AVFrame *src_frame, double pts, double d
         vp->duration = duration;
         vp->pos = pos;
         vp->serial = serial;
+        vp->queued_time = av_gettime_relative();
         vp->sar = src_frame->sample_aspect_ratio;
         vp->bmp->sar_num = vp->sar.num;
         vp->bmp->sar_den = vp->sar.den;
@@ -1569,6 +1855,7 @@ static int queue_picture(FFPlayer *ffp, AVFrame *src_frame, double pts, double d
         av_frame_move_ref(vp->frame, src_frame);
 #endif
         frame_queue_push(&is->pictq);
+        FFTRACE_ASYNC_STEP("video frame", FFTRACE_ID(pts), "queued");
         /*
          paused player firstly,then seek stream,because frame queue is full,waiting readable slot;
          after seek file,flushed packet queue,step to display next frame,will buffet out frame queue,because the frame queue's serial is not equal videoq's serail.
@@ -1606,11 +1893,20 @@ static void ffp_track_statistic_l(FFPlayer *ffp, AVStream *st, PacketQueue *q, F
     }
 }
 
+static void ffp_back_buffer_statistic_l(FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+
+    if (ffp->back_buffer_duration_ms > 0)
+        ffp->stat.buf_backwards = is->audioq.back_size + is->videoq.back_size;
+}
+
 static void ffp_audio_statistic_l(FFPlayer *ffp)
 {
     VideoState *is = ffp->is;
     
     ffp_track_statistic_l(ffp, is->audio_st, &is->audioq, &is->sampq, &ffp->stat.audio_cache);
+    ffp_back_buffer_statistic_l(ffp);
 
     if (ffp->is_manifest) {
           las_set_audio_cached_duration_ms(&ffp->las_player_statistic, ffp->stat.audio_cache.duration);
@@ -1621,6 +1917,7 @@ static void ffp_video_statistic_l(FFPlayer *ffp)
 {
     VideoState *is = ffp->is;
     ffp_track_statistic_l(ffp, is->video_st, &is->videoq, &is->pictq, &ffp->stat.video_cache);
+    ffp_back_buffer_statistic_l(ffp);
     if (ffp->is_manifest) {
         las_set_video_cached_duration_ms(&ffp->las_player_statistic, ffp->stat.video_cache.duration);
     }
@@ -1686,6 +1983,7 @@ static int get_video_frame(FFPlayer *ffp, AVFrame *frame)
 
         if (frame->pts != AV_NOPTS_VALUE)
             dpts = av_q2d(is->video_st->time_base) * frame->pts;
+        FFTRACE_ASYNC_STEP("video frame", FFTRACE_ID(dpts), "decoded");
 
         frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(is->ic, is->video_st, frame);
 
@@ -1695,7 +1993,7 @@ static int get_video_frame(FFPlayer *ffp, AVFrame *frame)
                 double diff = dpts - get_master_clock_with_delay(is);
                 if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD &&
                     diff - is->frame_last_filter_delay < 0 &&
-                    is->viddec.pkt_serial == is->vidclk.serial &&
+                    is->viddec.pkt_serial == get_clock_serial(&is->vidclk) &&
                     is->videoq.nb_packets) {
                     is->frame_drops_early++;
                     is->continuous_frame_drops_early++;
@@ -1704,6 +2002,7 @@ static int get_video_frame(FFPlayer *ffp, AVFrame *frame)
                     } else {
                         ffp->stat.drop_frame_count++;
                         ffp->stat.drop_frame_rate = (float)(ffp->stat.drop_frame_count) / (float)(ffp->stat.decode_frame_count);
+                        FFTRACE_ASYNC_END("video frame", FFTRACE_ID(dpts));
                         av_frame_unref(frame);
                         got_picture = 0;
                     }
@@ -1995,6 +2294,7 @@ static int audio_thread(void *arg)
     
     if (!frame)
         return AVERROR(ENOMEM);
+    FFTRACE_THREAD("ff_audio_dec");
 
     do {
         ffp_audio_statistic_l(ffp);
@@ -2198,6 +2498,7 @@ static int ffplay_video_thread(void *arg)
     FFPlayer *ffp = arg;
     VideoState *is = ffp->is;
     AVFrame *frame = av_frame_alloc();
+    AVFrame *mosaic_frame = av_frame_alloc();
     double pts;
     double duration;
     int ret;
@@ -2217,9 +2518,12 @@ static int ffplay_video_thread(void *arg)
     ffp_notify_msg2(ffp, FFP_MSG_VIDEO_ROTATION_CHANGED, ffp_get_video_rotate_degrees(ffp));
 #endif
 
-    if (!frame) {
+    if (!frame || !mosaic_frame) {
+        av_frame_free(&frame);
+        av_frame_free(&mosaic_frame);
         return AVERROR(ENOMEM);
     }
+    FFTRACE_THREAD("ff_video_dec");
 
     for (;;) {
         ret = get_video_frame(ffp, frame);
@@ -2287,6 +2591,10 @@ static int ffplay_video_thread(void *arg)
 #endif
             duration = (frame_rate.num && frame_rate.den ? av_q2d((AVRational){frame_rate.den, frame_rate.num}) : 0);
             pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
+            if (is->mosaic && ff_mosaic_compose(is->mosaic, frame, pts, mosaic_frame) >= 0) {
+                av_frame_unref(frame);
+                av_frame_move_ref(frame, mosaic_frame);
+            }
             ret = queue_picture(ffp, frame, pts, duration, frame->pkt_pos, is->viddec.pkt_serial);
             av_frame_unref(frame);
 #if CONFIG_AVFILTER
@@ -2304,6 +2612,7 @@ static int ffplay_video_thread(void *arg)
 #endif
     av_log(NULL, AV_LOG_INFO, "convert image convert_frame_count = %d,err = %d\n", convert_frame_count,ret);
     av_frame_free(&frame);
+    av_frame_free(&mosaic_frame);
     return ret;
 }
 
@@ -2556,14 +2865,15 @@ reload:
         int bytes_per_sample = av_get_bytes_per_sample(is->audio_tgt.fmt);
         resampled_data_size = len2 * is->audio_tgt.ch_layout.nb_channels * bytes_per_sample;
 #if defined(__ANDROID__)
-        if (ffp->soundtouch_enable && ffp->pf_playback_rate != 1.0f && !is->abort_request) {
+        float playback_rate = ffp_effective_playback_rate(ffp);
+        if (ffp->soundtouch_enable && playback_rate != 1.0f && !is->abort_request) {
             av_fast_malloc(&is->audio_new_buf, &is->audio_new_buf_size, out_size * translate_time);
             for (int i = 0; i < (resampled_data_size / 2); i++)
             {
                 is->audio_new_buf[i] = (is->audio_buf1[i * 2] | (is->audio_buf1[i * 2 + 1] << 8));
             }
 
-            int ret_len = ijk_soundtouch_translate(is->handle, is->audio_new_buf, (float)(ffp->pf_playback_rate), (float)(1.0f/ffp->pf_playback_rate),
+            int ret_len = ijk_soundtouch_translate(is->handle, is->audio_new_buf, playback_rate, 1.0f / playback_rate,
                     resampled_data_size / 2, bytes_per_sample, is->audio_tgt.channels, af->frame->sample_rate);
             if (ret_len > 0) {
                 is->audio_buf = (uint8_t*)is->audio_new_buf;
@@ -2658,10 +2968,11 @@ static double consume_audio_buffer(FFPlayer *ffp, double diff)
     if (!isnan(is->audio_clock)) {
         double pts = 0.0;
         if (!gotFrame && rest_len == 0) {
-            if (!isnan(is->audclk.pts)) {
+            double audclk_pts = get_clock_pts(&is->audclk);
+            if (!isnan(audclk_pts)) {
                 //none audio frame,already used out. is->audio_clock is the lastest audio frame pts and audio_write_buf_size is audio_buf_size(512 = SDL_AUDIO_MIN_BUFFER_SIZE / is->audio_tgt.frame_size * is->audio_tgt.frame_size).
                 //use last pts and increase by audio callback eated bytes.
-                pts = is->audclk.pts + (double)(len_want) / is->audio_tgt.bytes_per_sec;
+                pts = audclk_pts + (double)(len_want) / is->audio_tgt.bytes_per_sec;
             }
         } else {
             int audio_write_buf_size = is->audio_buf_size - is->audio_buf_index;
@@ -2672,7 +2983,7 @@ static double consume_audio_buffer(FFPlayer *ffp, double diff)
         sync_clock_to_slave(&is->extclk, &is->audclk);
         
         //when use step play mode,we use video pts sync audio,so drop the behind audio.
-        double video_pts = is->step ? is->vidclk.pts : get_clock_with_delay(&is->vidclk);
+        double video_pts = is->step ? get_clock_pts(&is->vidclk) : get_clock_with_delay(&is->vidclk);
         if (!isnan(video_pts)) {
             //audio pts is behind,need fast forwad,otherwise cause video picture delay and not smoothly!
             double threshold = is->step ? AV_SYNC_THRESHOLD_MIN : AV_SYNC_THRESHOLD_MAX;
@@ -2701,15 +3012,16 @@ static void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
     }
 
     ffp->audio_callback_time = av_gettime_relative();
+    FFTRACE_THREAD("ff_aout");
 
     if (ffp->pf_playback_rate_changed) {
         ffp->pf_playback_rate_changed = 0;
 #if defined(__ANDROID__)
         if (!ffp->soundtouch_enable) {
-            SDL_AoutSetPlaybackRate(ffp->aout, ffp->pf_playback_rate);
+            SDL_AoutSetPlaybackRate(ffp->aout, ffp_effective_playback_rate(ffp));
         }
 #else
-        SDL_AoutSetPlaybackRate(ffp->aout, ffp->pf_playback_rate);
+        SDL_AoutSetPlaybackRate(ffp->aout, ffp_effective_playback_rate(ffp));
 #endif
     }
     if (ffp->pf_playback_volume_changed) {
@@ -2717,6 +3029,7 @@ static void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
         SDL_AoutSetPlaybackVolume(ffp->aout, ffp->pf_playback_volume);
     }
     int gotFrame = 0;
+    FFTRACE_BEGIN("sdl_audio_callback");
     while (len > 0) {
         if (is->audio_buf_index >= is->audio_buf_size) {
            audio_size = audio_decode_frame(ffp);
@@ -2758,14 +3071,16 @@ static void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
         stream += rest_len;
         is->audio_buf_index += rest_len;
     }
+    FFTRACE_END("sdl_audio_callback");
     /* Let's assume the audio driver that is used by SDL has two periods. */
     if (!isnan(is->audio_clock)) {
         double pts = 0.0;
         if (len_want - len == 0) {
-            if (!isnan(is->audclk.pts)) {
+            double audclk_pts = get_clock_pts(&is->audclk);
+            if (!isnan(audclk_pts)) {
                 //none audio frame,already used out. is->audio_clock is the lastest audio frame pts and audio_write_buf_size is audio_buf_size(512 = SDL_AUDIO_MIN_BUFFER_SIZE / is->audio_tgt.frame_size * is->audio_tgt.frame_size).
                 //use last pts and increase by audio callback eated bytes.
-                pts = is->audclk.pts + (double)(len_want) / is->audio_tgt.bytes_per_sec;
+                pts = audclk_pts + (double)(len_want) / is->audio_tgt.bytes_per_sec;
                 set_clock_at(&is->audclk, pts, is->audio_clock_serial, ffp->audio_callback_time / 1000000.0);
                 sync_clock_to_slave(&is->extclk, &is->audclk);
             }
@@ -2778,7 +3093,7 @@ static void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
             
             if (is->video_stream >= 0 && is->viddec.finished != is->videoq.serial && is->auddec.finished != is->audioq.serial && 0 == is->audio_accurate_seek_req) {
                 //when use step play mode,we use video pts sync audio,so drop the behind audio.
-                double video_pts = is->step ? is->vidclk.pts : get_clock(&is->vidclk);
+                double video_pts = is->step ? get_clock_pts(&is->vidclk) : get_clock(&is->vidclk);
                 //audio pts is behind,need fast forwad,otherwise cause video picture delay and not smoothly!
                 double threshold = is->step ? AV_SYNC_THRESHOLD_MIN : AV_SYNC_THRESHOLD_MAX;
                 double diff = video_pts - get_clock(&is->audclk) - get_clock_extral_delay(&is->audclk);
@@ -3029,6 +3344,24 @@ static void _ijkmeta_set_stream(FFPlayer* ffp, int type, int stream)
     }
 }
 
+/*
+ * keep played packets of st so short backward seeks are served from memory, the back
+ * list has its own byte cap and stays out of the max_buffer_size budget of read_thread
+ */
+static void stream_config_back_buffer(FFPlayer *ffp, PacketQueue *q, AVStream *st)
+{
+    int64_t max_duration = 0;
+    int max_size = ffp->back_buffer_max_bytes;
+
+    if (ffp->back_buffer_duration_ms > 0 && !(st->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        max_duration = av_rescale_q(ffp->back_buffer_duration_ms, (AVRational){1, 1000}, st->time_base);
+        if (max_size <= 0)
+            max_size = (ffp->dcc.max_buffer_size > 0 ? ffp->dcc.max_buffer_size : DEFAULT_QUEUE_SIZE) / 4;
+    }
+    if (packet_queue_set_back_buffer(q, max_duration, max_size) < 0)
+        av_log(NULL, AV_LOG_WARNING, "back buffer of stream %d disabled\n", st->index);
+}
+
 /* open a given stream. Return 0 if OK */
 static int stream_component_open(FFPlayer *ffp, int stream_index)
 {
@@ -3079,6 +3412,11 @@ static int stream_component_open(FFPlayer *ffp, int stream_index)
     }
 
     avctx->codec_id = codec->id;
+
+    /* background tiles of a group trade resolution for decode time where the decoder can */
+    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO && !stream_lowres &&
+        ff_player_group_tier(ffp) == FFP_TIER_BACKGROUND)
+        stream_lowres = FFMIN(1, codec->max_lowres);
     
     if(stream_lowres > codec->max_lowres){
         av_log(avctx, AV_LOG_WARNING, "The maximum value for lowres supported by the decoder is %d\n",
@@ -3091,15 +3429,21 @@ static int stream_component_open(FFPlayer *ffp, int stream_index)
         avctx->flags2 |= AV_CODEC_FLAG2_FAST;
 
     opts = filter_codec_opts(ffp->codec_opts, avctx->codec_id, ic, st, (AVCodec *)codec);
-    if (!av_dict_get(opts, "threads", NULL, 0))
-        av_dict_set(&opts, "threads", "auto", 0);
+    if (!av_dict_get(opts, "threads", NULL, 0)) {
+        int threads = avctx->codec_type == AVMEDIA_TYPE_VIDEO ? ff_player_group_decoder_threads(ffp) : 0;
+        if (threads > 0)
+            av_dict_set_int(&opts, "threads", threads, 0);
+        else
+            av_dict_set(&opts, "threads", "auto", 0);
+    }
     if (stream_lowres)
         av_dict_set_int(&opts, "lowres", stream_lowres, 0);
     
 #ifdef __APPLE__
     if (avctx->codec_type == AVMEDIA_TYPE_VIDEO && !(st->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
         ALOGI("videotoolbox hwaccel switch:%s\n",ffp->videotoolbox_hwaccel ? "on" : "off");
-        if (ffp->videotoolbox_hwaccel) {
+        // the mosaic scales pictures on the cpu
+        if (ffp->videotoolbox_hwaccel && !ffp->mosaic_inputs) {
             enum AVHWDeviceType type = av_hwdevice_find_type_by_name("videotoolbox");
             const AVCodecHWConfig *config = NULL;
             for (int i = 0;; i++) {
@@ -3182,8 +3526,9 @@ static int stream_component_open(FFPlayer *ffp, int stream_index)
 
         is->audio_stream = stream_index;
         is->audio_st = st;
+        stream_config_back_buffer(ffp, &is->audioq, st);
 
-        if((ret = decoder_init(&is->auddec, avctx, &is->audioq, is->continue_read_thread)) < 0)
+        if((ret = decoder_init(&is->auddec, avctx, &is->audioq, stream_wake_read_thread, is)) < 0)
             goto fail;
         if ((is->ic->iformat->flags & (AVFMT_NOBINSEARCH | AVFMT_NOGENSEARCH | AVFMT_NO_BYTE_SEEK)) && !is->ic->iformat->read_seek) {
             is->auddec.start_pts = is->audio_st->start_time;
@@ -3197,6 +3542,17 @@ static int stream_component_open(FFPlayer *ffp, int stream_index)
     case AVMEDIA_TYPE_VIDEO:
         is->video_stream = stream_index;
         is->video_st = st;
+        is->group_keyframes_only = 0;
+        stream_config_back_buffer(ffp, &is->videoq, st);
+
+        if (ffp->mosaic_inputs) {
+            is->mosaic = ff_mosaic_create(ffp->mosaic_inputs, ffp->mosaic_columns,
+                                          ffp->mosaic_width  ? ffp->mosaic_width  : avctx->width,
+                                          ffp->mosaic_height ? ffp->mosaic_height : avctx->height,
+                                          ffp->mosaic_benchmark);
+            if (!is->mosaic)
+                av_log(ffp, AV_LOG_WARNING, "mosaic could not be created, playing the video alone\n");
+        }
 
         if (ffp->async_init_decoder) {
             while (!is->initialized_decoder) {
@@ -3207,14 +3563,14 @@ static int stream_component_open(FFPlayer *ffp, int stream_index)
                 ret = ffpipeline_config_video_decoder(ffp->pipeline, ffp);
             }
             if (ret || !ffp->node_vdec) {
-                if((ret = decoder_init(&is->viddec, avctx, &is->videoq, is->continue_read_thread)) < 0)
+                if((ret = decoder_init(&is->viddec, avctx, &is->videoq, stream_wake_read_thread, is)) < 0)
                     goto fail;
                 ffp->node_vdec = ffpipeline_open_video_decoder(ffp->pipeline, ffp);
                 if (!ffp->node_vdec)
                     goto fail;
             }
         } else {
-            if((ret = decoder_init(&is->viddec, avctx, &is->videoq, is->continue_read_thread)) < 0)
+            if((ret = decoder_init(&is->viddec, avctx, &is->videoq, stream_wake_read_thread, is)) < 0)
                 goto fail;
             ffp->node_vdec = ffpipeline_open_video_decoder(ffp->pipeline, ffp);
             if (!ffp->node_vdec)
@@ -3261,6 +3617,8 @@ static int stream_component_open(FFPlayer *ffp, int stream_index)
     default:
         break;
     }
+    /* a stream selected while read_thread sleeps on full queues needs packets */
+    stream_wake_read_thread(is);
     goto out;
 
 fail:
@@ -3287,6 +3645,648 @@ static int stream_has_enough_packets(AVStream *st, int stream_id, PacketQueue *q
            queue->nb_packets > min_frames;
 }
 
+/*
+ * low-water callback of audioq and videoq, each byte mark is only a share of
+ * is->low_water_size, so wait for the other queue unless a packet mark was hit
+ * or nothing else is armed
+ */
+static void stream_low_water(void *opaque)
+{
+    VideoState *is = opaque;
+    PacketQueue *aq = &is->audioq;
+    PacketQueue *vq = &is->videoq;
+
+    if (is->low_water_size >= 0 && aq->size + vq->size > is->low_water_size &&
+        aq->nb_packets > aq->low_water_packets && vq->nb_packets > vq->low_water_packets &&
+        (aq->low_water_armed || vq->low_water_armed))
+        return;
+    stream_wake_read_thread(is);
+}
+
+/*
+ * arm the queue levels at which read_thread reads again, well below where its full
+ * check turns false so a decoder taking one packet does not wake it: half the byte
+ * budget, split between the queues by their size, or MIN_FRAMES / 2 packets in a
+ * queue when they all had enough
+ * returns 1 if a queue is already there, -1 if no mark can be reached by decoding
+ */
+static int stream_arm_low_water(FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+    PacketQueue *queues[2] = {&is->audioq, &is->videoq};
+    int use[2];
+    int64_t queued = (int64_t)is->audioq.size + is->videoq.size;
+    int64_t sub_size = ff_sub_frame_cache_remaining(is->ffSub);
+    int64_t mark = -1;
+    int enough = stream_has_enough_packets(is->audio_st, is->audio_stream, &is->audioq, MIN_FRAMES)
+                 && stream_has_enough_packets(is->video_st, is->video_stream, &is->videoq, MIN_FRAMES)
+                 && ff_sub_has_enough_packets(is->ffSub, MIN_FRAMES);
+    int armed = 0;
+
+    use[0] = is->audio_stream >= 0 && !is->audioq.abort_request;
+    use[1] = is->video_stream >= 0 && !is->videoq.abort_request &&
+             !(is->video_st && (is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC));
+
+    if (queued + sub_size > ffp->dcc.max_buffer_size)
+        mark = FFMAX(ffp->dcc.max_buffer_size / 2 - sub_size, 0);
+    is->low_water_size = (int)mark;
+
+    /* disarm first so the callback of one queue never sees stale marks of the other */
+    for (int i = 0; i < 2; i++)
+        packet_queue_arm_low_water(queues[i], -1, -1);
+
+    for (int i = 0; i < 2; i++) {
+        PacketQueue *q = queues[i];
+        int64_t size = -1;
+
+        if (!use[i])
+            continue;
+        if (mark >= 0)
+            size = queued > 0 ? q->size * mark / queued : 0;
+        if (!enough && size < 0)
+            continue;
+        if (packet_queue_arm_low_water(q, enough ? MIN_FRAMES / 2 : -1, (int)size))
+            return 1;
+        armed++;
+    }
+    return armed ? 0 : -1;
+}
+
+/*
+ * restart the queues at the keyframe at or before target among the packets already
+ * queued or, with a back buffer, already played, as long as it lies after min_time
+ * returns 1 if the queues were restarted, restart_time receives the keyframe time,
+ * -1 if only audio could be and both queues were flushed for a demuxer seek instead
+ */
+static int stream_restart_in_buffer(FFPlayer *ffp, int64_t target, int64_t min_time, int64_t *restart_time)
+{
+    VideoState *is = ffp->is;
+    int has_video = is->video_st && !(is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC);
+    int has_audio = is->audio_st != NULL;
+    int64_t key_time = target;
+    int64_t audio_time = target;
+    int video_index = 0;
+    int audio_index = 0;
+    int ret = 0;
+    int partial = 0;
+
+    if (!has_video && !has_audio)
+        return 0;
+    /* embedded subtitle packets are sparse and decoded ahead, let the demuxer seek resend them */
+    if (ff_sub_current_stream_type(is->ffSub) == 1)
+        return 0;
+
+    if (has_video)
+        SDL_LockMutex(is->videoq.mutex);
+    if (has_audio)
+        SDL_LockMutex(is->audioq.mutex);
+
+    if (has_video) {
+        video_index = packet_queue_find_seek_point_l(&is->videoq, is->video_st->time_base, target, 1, &key_time);
+        if (video_index < 0)
+            goto end;
+    }
+    if (has_audio) {
+        /* start audio together with the keyframe video restarts from */
+        audio_index = packet_queue_find_seek_point_l(&is->audioq, is->audio_st->time_base, key_time, 0, &audio_time);
+        if (audio_index < 0)
+            goto end;
+    }
+    if ((has_video ? key_time : audio_time) <= min_time)
+        goto end;
+
+    /* a rewind allocates a new fifo, restart audio first so a failure leaves video untouched */
+    if (has_audio && packet_queue_restart_at_l(&is->audioq, audio_index) < 0)
+        goto end;
+    if (has_video && packet_queue_restart_at_l(&is->videoq, video_index) < 0) {
+        /* audio already moved to a new serial, flush both so they restart together */
+        partial = has_audio;
+        goto end;
+    }
+    ret = 1;
+    if (restart_time)
+        *restart_time = has_video ? key_time : audio_time;
+
+    av_log(NULL, AV_LOG_INFO, "restart in buffer: target %"PRId64", restart at %"PRId64", video entry %d audio entry %d\n",
+           target, key_time, video_index, audio_index);
+end:
+    if (has_audio)
+        SDL_UnlockMutex(is->audioq.mutex);
+    if (has_video)
+        SDL_UnlockMutex(is->videoq.mutex);
+    if (partial) {
+        packet_queue_flush(&is->audioq);
+        packet_queue_flush(&is->videoq);
+        ret = -1;
+    }
+    return ret;
+}
+
+/* serve a seek from the packet queues, returns 1 if they were restarted, 0 to seek the demuxer */
+static int stream_seek_in_buffer(FFPlayer *ffp, int64_t target)
+{
+    VideoState *is = ffp->is;
+
+    if (!ffp->enable_inbuffer_seek || (is->seek_flags & AVSEEK_FLAG_BYTE))
+        return 0;
+    return stream_restart_in_buffer(ffp, target, INT64_MIN, NULL) > 0;
+}
+
+static void stream_update_live_edge(VideoState *is)
+{
+    int64_t edge = is->audio_st ? is->audio_read_end : is->video_read_end;
+
+    if (edge != AV_NOPTS_VALUE && (is->live_edge == AV_NOPTS_VALUE || edge > is->live_edge)) {
+        is->live_edge      = edge;
+        is->live_edge_time = av_gettime_relative();
+    }
+}
+
+/* seconds the master clock is behind the live edge, the edge moves on with the wall clock between packets */
+static double stream_live_latency(VideoState *is)
+{
+    double clock = get_master_clock(is);
+
+    if (is->live_edge == AV_NOPTS_VALUE || isnan(clock))
+        return NAN;
+    return is->live_edge / (double)AV_TIME_BASE + (av_gettime_relative() - is->live_edge_time) / 1000000.0 - clock;
+}
+
+/* jump skip seconds ahead to the newest keyframe queued there, returns 1 if the queues were restarted */
+static int stream_live_skip(FFPlayer *ffp, double skip)
+{
+    VideoState *is = ffp->is;
+    double clock = get_master_clock(is);
+    int64_t pos = (int64_t)(clock * AV_TIME_BASE);
+    int64_t target = pos + (int64_t)(skip * AV_TIME_BASE);
+    int64_t restart_time = AV_NOPTS_VALUE;
+    int ret = stream_restart_in_buffer(ffp, target, pos, &restart_time);
+
+    if (ret == 0)
+        return 0;
+    if (ret < 0) {
+        /* the queues are flushed already, read_thread seeks on its next pass */
+        stream_seek(is, target, 0, 0);
+        av_log(ffp, AV_LOG_INFO, "live: seeking from %.3f to %.3f\n", clock, target / (double)AV_TIME_BASE);
+        return 1;
+    }
+
+    SDL_AoutFlushAudio(ffp->aout);
+    if (is->video_stream >= 0 && ffp->node_vdec)
+        ffpipenode_flush(ffp->node_vdec);
+    set_clock(&is->extclk, restart_time / (double)AV_TIME_BASE, 0);
+    av_log(ffp, AV_LOG_INFO, "live: skipped from %.3f to keyframe at %.3f\n", clock, restart_time / (double)AV_TIME_BASE);
+    return 1;
+}
+
+/*
+ * low-latency live, called from read_thread: play faster while the master clock is
+ * behind the live edge by more than live-target-latency-ms and skip to the newest
+ * keyframe past live-max-latency-ms
+ */
+static void stream_live_latency_control(FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+    double now = av_gettime_relative() / 1000000.0;
+    double target = ffp->live_target_latency_ms / 1000.0;
+    double max_latency = ffp->live_max_latency_ms > 0 ? ffp->live_max_latency_ms / 1000.0 : 3 * target;
+    double latency;
+    float speed;
+
+    if (now < is->live_next_check)
+        return;
+    is->live_next_check = now + LIVE_LATENCY_CHECK_INTERVAL;
+
+    latency = stream_live_latency(is);
+    if (isnan(latency))
+        return;
+    ffp->stat.live_latency = (int64_t)(FFMAX(latency, 0) * 1000);
+
+    if (is->paused || is->buffering_on || is->trick_rate || is->seek_req) {
+        speed = 1.0f;
+    } else if (latency > max_latency && stream_live_skip(ffp, latency - target)) {
+        speed = 1.0f;
+    } else {
+        /* quantized, the audio output is only told about real changes */
+        double excess = FFMAX(latency - target, 0);
+        speed = 1.0f + (float)(floor(excess * LIVE_CATCHUP_GAIN / LIVE_CATCHUP_STEP) * LIVE_CATCHUP_STEP);
+        speed = FFMIN(speed, ffp->live_max_catchup_rate / 100.0f);
+    }
+
+    if (speed != is->live_speed) {
+        av_log(ffp, AV_LOG_DEBUG, "live: latency %.3fs, catch-up speed %.2f\n", latency, speed);
+        is->live_speed = speed;
+        ffp->pf_playback_rate_changed = 1;
+    }
+}
+
+static int stream_chain_compatible(AVStream *cur, AVStream *next)
+{
+    AVCodecParameters *a = cur->codecpar;
+    AVCodecParameters *b = next->codecpar;
+
+    /*
+     * the open decoder carries on: new extradata reaches it as packet side data, size,
+     * pixel format, sample rate and layout changes come out of it like mid-stream ones
+     */
+    return a->codec_type == b->codec_type && a->codec_id == b->codec_id;
+}
+
+/* on the first packet read after a switch of items, hand the decoder the extradata of its item */
+static void stream_chain_new_extradata(VideoState *is, AVStream *src, AVPacket *pkt)
+{
+    int type = pkt->stream_index == is->audio_stream ? AVMEDIA_TYPE_AUDIO : AVMEDIA_TYPE_VIDEO;
+    uint8_t *side;
+
+    if (!is->chain_extradata_req[type])
+        return;
+    is->chain_extradata_req[type] = 0;
+    if (src->codecpar->extradata_size <= 0)
+        return;
+    side = av_packet_new_side_data(pkt, AV_PKT_DATA_NEW_EXTRADATA, src->codecpar->extradata_size);
+    if (side)
+        memcpy(side, src->codecpar->extradata, src->codecpar->extradata_size);
+}
+
+/* move a packet of chain_ic onto the matching stream and timeline of is->ic */
+static int stream_chain_map_packet(VideoState *is, AVFormatContext *ic, AVPacket *pkt)
+{
+    AVStream *src = ic->streams[pkt->stream_index];
+    AVStream *dst;
+    int64_t shift;
+
+    if (is->audio_st && pkt->stream_index == is->chain_stream[AVMEDIA_TYPE_AUDIO]) {
+        dst = is->audio_st;
+        pkt->stream_index = is->audio_stream;
+    } else if (is->video_st && pkt->stream_index == is->chain_stream[AVMEDIA_TYPE_VIDEO]) {
+        dst = is->video_st;
+        pkt->stream_index = is->video_stream;
+    } else {
+        return AVERROR(EINVAL);
+    }
+
+    shift = av_rescale_q(is->chain_start - (ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0),
+                         AV_TIME_BASE_Q, dst->time_base);
+    if (pkt->pts != AV_NOPTS_VALUE)
+        pkt->pts = av_rescale_q(pkt->pts, src->time_base, dst->time_base) + shift;
+    if (pkt->dts != AV_NOPTS_VALUE)
+        pkt->dts = av_rescale_q(pkt->dts, src->time_base, dst->time_base) + shift;
+    pkt->duration  = av_rescale_q(pkt->duration, src->time_base, dst->time_base);
+    pkt->time_base = dst->time_base;
+    stream_chain_new_extradata(is, src, pkt);
+    return 0;
+}
+
+static void stream_update_read_end(int64_t *read_end, AVStream *st, AVPacket *pkt)
+{
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    int64_t end;
+
+    if (ts == AV_NOPTS_VALUE)
+        return;
+    end = av_rescale_q(ts + pkt->duration, st->time_base, AV_TIME_BASE_Q);
+    if (*read_end == AV_NOPTS_VALUE || end > *read_end)
+        *read_end = end;
+}
+
+/*
+ * continue reading with the next item once *pic is exhausted, the one a seek gave
+ * back or else the preloaded one. returns 1 when *pic was replaced, 0 while the
+ * item is still opening, <0 to end playback as usual
+ */
+static int stream_chain_next(FFPlayer *ffp, AVFormatContext **pic)
+{
+    VideoState *is = ffp->is;
+    int has_video = is->video_st && !(is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC);
+    FFPreloader *preloader = NULL;
+    AVFormatContext *ic = NULL;
+    AVPacket *pkt = NULL;
+    int st_index[AVMEDIA_TYPE_NB];
+    int prebuffered = 0;
+    int ret;
+
+    if (is->chain_next_ic) {
+        ic = is->chain_next_ic;
+        is->chain_next_ic = NULL;
+        preloader = is->chain_next_preloader;
+        is->chain_next_preloader = NULL;
+        memcpy(st_index, is->chain_next_stream, sizeof(st_index));
+        ret = avformat_seek_file(ic, -1, INT64_MIN, ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0, INT64_MAX, 0);
+        if (ret < 0)
+            goto fail;
+    } else {
+        SDL_LockMutex(is->play_mutex);
+        preloader = is->preloader;
+        ret = preloader ? ff_preloader_poll(preloader) : AVERROR(EINVAL);
+        if (ret == 0) {
+            SDL_UnlockMutex(is->play_mutex);
+            return 0;
+        }
+        is->preloader = NULL;
+        SDL_UnlockMutex(is->play_mutex);
+        if (ret < 0)
+            goto fail;
+
+        ic = ff_preloader_take(preloader, st_index);
+        prebuffered = 1;
+    }
+    ret = AVERROR(EINVAL);
+    if (!ic)
+        goto fail;
+    if (is->audio_st && (st_index[AVMEDIA_TYPE_AUDIO] < 0 ||
+                         !stream_chain_compatible(is->audio_st, ic->streams[st_index[AVMEDIA_TYPE_AUDIO]])))
+        goto fail;
+    if (has_video && (st_index[AVMEDIA_TYPE_VIDEO] < 0 ||
+                      !stream_chain_compatible(is->video_st, ic->streams[st_index[AVMEDIA_TYPE_VIDEO]])))
+        goto fail;
+    if (!(pkt = av_packet_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* audio is the master clock, start the next item right where its audio ends */
+    is->prev_chain_start    = is->chain_ic ? is->chain_start : AV_NOPTS_VALUE;
+    is->prev_chain_duration = is->chain_duration;
+    is->chain_start         = is->audio_st && is->audio_read_end != AV_NOPTS_VALUE ? is->audio_read_end : is->video_read_end;
+    if (is->chain_start == AV_NOPTS_VALUE)
+        is->chain_start = 0;
+    is->chain_duration      = ic->duration;
+    is->chain_started       = 0;
+    memcpy(is->prev_chain_stream, is->chain_stream, sizeof(is->chain_stream));
+    is->chain_stream[AVMEDIA_TYPE_AUDIO] = st_index[AVMEDIA_TYPE_AUDIO];
+    is->chain_stream[AVMEDIA_TYPE_VIDEO] = has_video ? st_index[AVMEDIA_TYPE_VIDEO] : -1;
+
+    is->chain_extradata_req[AVMEDIA_TYPE_AUDIO] = 1;
+    is->chain_extradata_req[AVMEDIA_TYPE_VIDEO] = 1;
+    while (prebuffered && ff_preloader_read_packet(preloader, pkt) >= 0) {
+        if (stream_chain_map_packet(is, ic, pkt) < 0) {
+            av_packet_unref(pkt);
+        } else if (pkt->stream_index == is->audio_stream) {
+            stream_update_read_end(&is->audio_read_end, is->audio_st, pkt);
+            packet_queue_put(&is->audioq, pkt);
+        } else {
+            stream_update_read_end(&is->video_read_end, is->video_st, pkt);
+            packet_queue_put(&is->videoq, pkt);
+        }
+    }
+    av_packet_free(&pkt);
+
+    /* the previous item stays open until chain_start, seeks before it go back there */
+    stream_chain_close(&is->prev_chain_ic, &is->prev_chain_preloader);
+    is->prev_chain_ic        = is->chain_ic;
+    is->prev_chain_preloader = is->chain_preloader;
+    is->chain_ic        = ic;
+    is->chain_preloader = preloader;
+    *pic = ic;
+    av_log(ffp, AV_LOG_INFO, "gapless transition to %s at %"PRId64"\n", ic->url, is->chain_start);
+    return 1;
+fail:
+    stream_chain_close(&ic, &preloader);
+    av_log(ffp, AV_LOG_WARNING, "next item can't follow gaplessly: %s\n", av_err2str(ret));
+    ffp_notify_msg2(ffp, FFP_MSG_NEXT_ITEM_FAILED, ret);
+    return ret;
+}
+
+/*
+ * go back to reading the previous item for a seek before chain_start while that item
+ * still plays, chain_ic is kept to follow it again. returns 1 when *pic was replaced
+ */
+static int stream_chain_rollback(VideoState *is, AVFormatContext **pic, int64_t seek_target)
+{
+    /* no prev_chain_ic after the first transition means the previous item is is->ic */
+    if (!is->chain_ic || is->chain_started || (is->seek_flags & AVSEEK_FLAG_BYTE) ||
+        seek_target >= is->chain_start ||
+        (!is->prev_chain_ic && is->prev_chain_start != AV_NOPTS_VALUE))
+        return 0;
+
+    stream_chain_close(&is->chain_next_ic, &is->chain_next_preloader);
+    is->chain_next_ic        = is->chain_ic;
+    is->chain_next_preloader = is->chain_preloader;
+    memcpy(is->chain_next_stream, is->chain_stream, sizeof(is->chain_stream));
+
+    is->chain_ic             = is->prev_chain_ic;
+    is->chain_preloader      = is->prev_chain_preloader;
+    is->prev_chain_ic        = NULL;
+    is->prev_chain_preloader = NULL;
+    memcpy(is->chain_stream, is->prev_chain_stream, sizeof(is->chain_stream));
+    is->chain_start    = is->prev_chain_start;
+    is->chain_duration = is->prev_chain_duration;
+    is->chain_started  = is->chain_ic != NULL;
+    is->prev_chain_start = AV_NOPTS_VALUE;
+    is->chain_extradata_req[AVMEDIA_TYPE_AUDIO] = 1;
+    is->chain_extradata_req[AVMEDIA_TYPE_VIDEO] = 1;
+
+    *pic = is->chain_ic ? is->chain_ic : is->ic;
+    av_log(NULL, AV_LOG_INFO, "seek back into %s before the gapless transition\n", (*pic)->url);
+    return 1;
+}
+
+static int stream_seek_file(VideoState *is, AVFormatContext *ic, int64_t seek_min, int64_t seek_target, int64_t seek_max)
+{
+    /* only the item being read and the one before are open, seeks stay inside the one being read */
+    if (ic != is->ic && !(is->seek_flags & AVSEEK_FLAG_BYTE)) {
+        int64_t shift = (ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0) - is->chain_start;
+
+        seek_target = FFMAX(seek_target, is->chain_start) + shift;
+        if (seek_min != INT64_MIN)
+            seek_min = FFMIN(seek_min + shift, seek_target);
+        if (seek_max != INT64_MAX)
+            seek_max = FFMAX(seek_max + shift, seek_target);
+    }
+    return avformat_seek_file(ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
+}
+
+#define TRICK_PLAY_MIN_RATE         4
+#define TRICK_PLAY_MAX_RATE         64
+#define TRICK_PLAY_MIN_INTERVAL     40000   // at most 25 keyframes per second, in us
+#define TRICK_PLAY_MAX_SCAN_PACKETS 4096
+
+/* switch keyframe-only playback on or off as requested by ffp_set_trick_play_rate() */
+static void stream_trick_play_toggle(FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+    int rate = is->trick_req_rate;
+    double clock = get_master_clock(is);
+    int64_t pos = isnan(clock) ? is->seek_pos : (int64_t)(clock * AV_TIME_BASE);
+
+    is->trick_req = 0;
+    if (!!rate == !!is->trick_rate) {
+        /* only the speed changes, restart pacing from the keyframe on screen */
+        if (rate) {
+            is->trick_origin_pos  = is->trick_last_key != AV_NOPTS_VALUE ? is->trick_last_key : pos;
+            is->trick_origin_time = av_gettime_relative();
+            is->trick_paused_time = 0;
+        }
+        is->trick_rate = rate;
+        return;
+    }
+
+    if (rate) {
+        is->trick_rate            = rate;
+        is->trick_origin_pos      = pos;
+        is->trick_origin_time     = av_gettime_relative();
+        is->trick_paused_time     = 0;
+        is->trick_last_key        = AV_NOPTS_VALUE;
+        is->trick_next_step       = 0;
+        is->trick_saved_sync_type = is->av_sync_type;
+        /* the clock follows the keyframes on screen */
+        is->av_sync_type          = AV_SYNC_VIDEO_MASTER;
+        is->video_st->discard     = AVDISCARD_NONKEY;
+        if (is->viddec.avctx) {
+            is->trick_saved_skip_frame   = is->viddec.avctx->skip_frame;
+            is->viddec.avctx->skip_frame = AVDISCARD_NONKEY;
+        }
+        /* nothing is decoded for audio while scrubbing */
+        if (is->audio_st) {
+            is->audio_st->discard = AVDISCARD_ALL;
+            packet_queue_flush(&is->audioq);
+            SDL_AoutFlushAudio(ffp->aout);
+        }
+        packet_queue_flush(&is->videoq);
+        if (ffp->node_vdec)
+            ffpipenode_flush(ffp->node_vdec);
+        ffp_toggle_buffering(ffp, 0);
+        av_log(ffp, AV_LOG_INFO, "trick play %dx from %"PRId64"\n", rate, pos);
+    } else {
+        pos = is->trick_last_key != AV_NOPTS_VALUE ? is->trick_last_key : pos;
+        is->trick_rate        = 0;
+        is->av_sync_type      = is->trick_saved_sync_type;
+        is->video_st->discard = is->group_keyframes_only ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+        if (is->viddec.avctx)
+            is->viddec.avctx->skip_frame = is->trick_saved_skip_frame;
+        if (is->audio_st)
+            is->audio_st->discard = AVDISCARD_DEFAULT;
+        /* regular playback resumes from the keyframe on screen */
+        stream_seek(is, pos, 0, 0);
+        av_log(ffp, AV_LOG_INFO, "trick play off at %"PRId64"\n", pos);
+    }
+}
+
+/* background tiles of a player group only decode keyframes, trick play keeps its own */
+static void stream_update_group_tier(FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+    int keyframes_only;
+
+    if (!is->video_st || !is->viddec.avctx || is->trick_rate)
+        return;
+
+    keyframes_only = ff_player_group_tier(ffp) == FFP_TIER_BACKGROUND;
+    if (keyframes_only == is->group_keyframes_only)
+        return;
+
+    is->group_keyframes_only = keyframes_only;
+    if (keyframes_only) {
+        is->group_saved_skip_frame   = is->viddec.avctx->skip_frame;
+        is->video_st->discard        = AVDISCARD_NONKEY;
+        is->viddec.avctx->skip_frame = AVDISCARD_NONKEY;
+    } else {
+        is->video_st->discard        = AVDISCARD_DEFAULT;
+        is->viddec.avctx->skip_frame = is->group_saved_skip_frame;
+    }
+    av_log(ffp, AV_LOG_INFO, "player group: %s\n", keyframes_only ? "keyframes only" : "all frames");
+}
+
+/* queue the first keyframe past the last one shown at or around target, 1 when one was queued */
+static int stream_trick_play_queue_key(FFPlayer *ffp, AVFormatContext *ic, AVPacket *pkt, int64_t target, int64_t now)
+{
+    VideoState *is = ffp->is;
+    AVStream *st = is->video_st;
+    int64_t key;
+    int forward = is->trick_rate > 0;
+    int ret;
+
+    if (avformat_index_get_entries_count(st) > 0) {
+        /* step through the keyframe index, no need to read what lies between */
+        const AVIndexEntry *e = avformat_index_get_entry_from_timestamp(st, av_rescale_q(target, AV_TIME_BASE_Q, st->time_base),
+                                                                        AVSEEK_FLAG_BACKWARD);
+        if (!e)
+            return 0;
+        key = av_rescale_q(e->timestamp, st->time_base, AV_TIME_BASE_Q);
+        if (is->trick_last_key != AV_NOPTS_VALUE && (forward ? key <= is->trick_last_key : key >= is->trick_last_key))
+            return 0;
+        ret = avformat_seek_file(ic, is->video_stream, INT64_MIN, e->timestamp, e->timestamp, 0);
+    } else {
+        ret = avformat_seek_file(ic, -1, INT64_MIN, target, target, 0);
+    }
+    if (ret < 0)
+        return ret;
+
+    for (int i = 0; i < TRICK_PLAY_MAX_SCAN_PACKETS; i++) {
+        if ((ret = av_read_frame(ic, pkt)) < 0)
+            return ret;
+        if (pkt->stream_index == is->video_stream && (pkt->flags & AV_PKT_FLAG_KEY)) {
+            int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            key = ts != AV_NOPTS_VALUE ? av_rescale_q(ts, st->time_base, AV_TIME_BASE_Q) : target;
+            /* without an index the demuxer may land on the keyframe already shown */
+            if (is->trick_last_key == AV_NOPTS_VALUE || (forward ? key > is->trick_last_key : key < is->trick_last_key)) {
+                is->trick_last_key  = key;
+                is->trick_next_step = now + TRICK_PLAY_MIN_INTERVAL;
+                packet_queue_put(&is->videoq, pkt);
+                /* drain the decoder so the keyframe comes out now, not with the next one */
+                packet_queue_put_nullpacket(&is->videoq, pkt, is->video_stream);
+                return 1;
+            }
+            if (!forward) {
+                av_packet_unref(pkt);
+                return 0;
+            }
+        }
+        av_packet_unref(pkt);
+    }
+    return 0;
+}
+
+/*
+ * queue the keyframe closest to where trick play should be by now, returns 1 when
+ * one was queued, 0 when it is not time for the next step, <0 on read errors.
+ * once nothing is left before the start or past the end, trick play hands back to
+ * regular playback from the last keyframe and posts FFP_MSG_TRICK_PLAY_END.
+ */
+static int stream_trick_play_step(FFPlayer *ffp, AVFormatContext *ic, AVPacket *pkt)
+{
+    VideoState *is = ffp->is;
+    int64_t now = av_gettime_relative();
+    int64_t start = ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0;
+    int64_t target;
+    int forward = is->trick_rate > 0;
+    int at_boundary;
+    int ret;
+
+    /* the trick clock stands still while paused, resuming shifts the origin past the pause */
+    if (is->paused) {
+        if (!is->trick_paused_time)
+            is->trick_paused_time = now;
+        return 0;
+    }
+    if (is->trick_paused_time) {
+        is->trick_origin_time += now - is->trick_paused_time;
+        is->trick_paused_time  = 0;
+    }
+
+    /* one keyframe in flight, the next step starts once it is on screen */
+    if (now < is->trick_next_step || is->videoq.nb_packets > 0 || frame_queue_nb_remaining(&is->pictq) > 1)
+        return 0;
+
+    target = is->trick_origin_pos + (now - is->trick_origin_time) * is->trick_rate;
+    at_boundary = forward ? ic->duration > 0 && target >= start + ic->duration : target <= start;
+    target = FFMAX(target, start);
+    if (ic->duration > 0)
+        target = FFMIN(target, start + ic->duration);
+
+    ret = stream_trick_play_queue_key(ffp, ic, pkt, target, now);
+    if (at_boundary && (ret == 0 || ret == AVERROR_EOF)) {
+        int64_t pos = is->trick_last_key != AV_NOPTS_VALUE ? is->trick_last_key : target;
+
+        av_log(ffp, AV_LOG_INFO, "trick play reached the %s at %"PRId64"\n", forward ? "end" : "start", pos);
+        ffp_notify_msg2(ffp, FFP_MSG_TRICK_PLAY_END, (int)fftime_to_milliseconds(pos - start));
+        is->trick_req_rate = 0;
+        is->trick_req      = 1;
+        return 0;
+    }
+    return ret;
+}
+
 static int is_realtime(AVFormatContext *s)
 {
     if(   !strcmp(s->iformat->name, "rtp")
@@ -3367,7 +4367,6 @@ static int read_thread(void *arg)
     int completed = 0;
     int pkt_in_play_range = 0;
     AVDictionaryEntry *t;
-    SDL_mutex *wait_mutex = SDL_CreateMutex();
     int scan_all_pmts_set = 0;
     int64_t pkt_ts;
     int last_error = 0;
@@ -3375,13 +4374,12 @@ static int read_thread(void *arg)
     int64_t io_tick_counter = 0;
     int init_ijkmeta = 0;
     int64_t icy_last_update_time = 0;
+    int64_t open_start_time = av_gettime_relative();
+    char probe_validator[256] = {0};
+    int cached_st_index[AVMEDIA_TYPE_NB];
+    int probe_cache_hit = 0;
     
-    if (!wait_mutex) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
-        ret = AVERROR(ENOMEM);
-        goto fail;
-    }
-
+    FFTRACE_THREAD("ff_read");
     memset(st_index, -1, sizeof(st_index));
     is->eof = 0;
 
@@ -3433,6 +4431,7 @@ static int read_thread(void *arg)
 //        is->filename = av_strdup(ijk_io->get_dummy_url(ijk_io));
 //    }
     
+    av_dict_copy(&is->format_opts, ffp->format_opts, 0);
     err = avformat_open_input(&ic, is->filename, is->iformat, &ffp->format_opts);
     if (err < 0) {
         ret = -1;
@@ -3466,7 +4465,14 @@ static int read_thread(void *arg)
     //orig_nb_streams = ic->nb_streams;
 
 
-    if (ffp->find_stream_info) {
+    if (ffp->find_stream_info && ffp->probe_cache_dir &&
+        ff_probe_cache_validator(ic, is->filename, ffp->probe_cache_validator, probe_validator, sizeof(probe_validator)) >= 0) {
+        probe_cache_hit = ff_probe_cache_load(ffp->probe_cache_dir, is->filename, probe_validator, ic, cached_st_index) >= 0;
+    }
+
+    if (probe_cache_hit) {
+        ffp_notify_msg1(ffp, FFP_MSG_FIND_STREAM_INFO);
+    } else if (ffp->find_stream_info) {
         AVDictionary **opts = setup_find_stream_info_opts(ic, ffp->codec_opts);
         int orig_nb_streams = ic->nb_streams;
 
@@ -3497,6 +4503,10 @@ static int read_thread(void *arg)
             goto fail;
         }
     }
+    ffp->stat.probe_cache_hit = probe_cache_hit;
+    ffp->stat.stream_open_duration = (av_gettime_relative() - open_start_time) / 1000;
+    av_log(ffp, AV_LOG_INFO, "stream info ready in %"PRId64" ms%s\n",
+           ffp->stat.stream_open_duration, probe_cache_hit ? " (probe cache hit)" : "");
     if (ic->pb)
         ic->pb->eof_reached = 0; // FIXME hack, ffplay maybe should not use avio_feof() to test for the end
 
@@ -3556,6 +4566,13 @@ static int read_thread(void *arg)
             }
         }
     }
+    if (probe_cache_hit) {
+        /* take the streams chosen when the cache was written unless the user asked for others */
+        for (i = 0; i < AVMEDIA_TYPE_NB; i++) {
+            if (st_index[i] < 0 && cached_st_index[i] >= 0 && ic->streams[cached_st_index[i]]->codecpar->codec_type == i)
+                st_index[i] = cached_st_index[i];
+        }
+    }
     if (video_stream_count > 1 && st_index[AVMEDIA_TYPE_VIDEO] < 0) {
         st_index[AVMEDIA_TYPE_VIDEO] = first_h264_stream;
         av_log(NULL, AV_LOG_WARNING, "multiple video stream found, prefer first h264 stream: %d\n", first_h264_stream);
@@ -3579,6 +4596,11 @@ static int read_thread(void *arg)
                                  st_index[AVMEDIA_TYPE_VIDEO]),
                                 NULL, 0);
 
+    if (probe_validator[0] && !probe_cache_hit) {
+        if (ff_probe_cache_store(ffp->probe_cache_dir, is->filename, probe_validator, ic, st_index) < 0)
+            av_log(ffp, AV_LOG_WARNING, "could not store probe result of %s\n", is->filename);
+    }
+
     is->show_mode = ffp->show_mode;
 #ifdef FFP_MERGE // bbc: dunno if we need this
     if (st_index[AVMEDIA_TYPE_VIDEO] >= 0) {
@@ -3640,6 +4662,11 @@ static int read_thread(void *arg)
     
     if (ffp->dcc.max_buffer_size == 0) {
         reset_buffer_size(ffp);
+        /* the default back buffer limit follows the buffer size decided above */
+        if (is->audio_st)
+            stream_config_back_buffer(ffp, &is->audioq, is->audio_st);
+        if (is->video_st)
+            stream_config_back_buffer(ffp, &is->videoq, is->video_st);
     }
     
     if (is->video_stream < 0 && is->audio_stream < 0) {
@@ -3675,8 +4702,15 @@ static int read_thread(void *arg)
         ffp->vout->z_rotate_degrees = deg;
         ffp_notify_msg2(ffp, FFP_MSG_VIDEO_Z_ROTATE_DEGREE, deg);
         AVCodecParameters *codecpar = is->video_st->codecpar;
-        ffp_notify_msg3(ffp, FFP_MSG_VIDEO_SIZE_CHANGED, codecpar->width, codecpar->height);
-        ffp_notify_msg3(ffp, FFP_MSG_SAR_CHANGED, codecpar->sample_aspect_ratio.num, codecpar->sample_aspect_ratio.den);
+        if (is->mosaic) {
+            int width, height;
+            ff_mosaic_get_size(is->mosaic, &width, &height);
+            ffp_notify_msg3(ffp, FFP_MSG_VIDEO_SIZE_CHANGED, width, height);
+            ffp_notify_msg3(ffp, FFP_MSG_SAR_CHANGED, 1, 1);
+        } else {
+            ffp_notify_msg3(ffp, FFP_MSG_VIDEO_SIZE_CHANGED, codecpar->width, codecpar->height);
+            ffp_notify_msg3(ffp, FFP_MSG_SAR_CHANGED, codecpar->sample_aspect_ratio.num, codecpar->sample_aspect_ratio.den);
+        }
     }
     ffp->prepared = true;
     ffp_notify_msg1(ffp, FFP_MSG_PREPARED);
@@ -3697,6 +4731,12 @@ static int read_thread(void *arg)
     for (;;) {
         if (is->abort_request)
             break;
+        if (is->chain_ic && !is->chain_started &&
+            get_master_clock(is) * AV_TIME_BASE >= is->chain_start) {
+            is->chain_started = 1;
+            stream_chain_close(&is->prev_chain_ic, &is->prev_chain_preloader);
+            ffp_notify_msg2(ffp, FFP_MSG_NEXT_ITEM_STARTED, (int)fftime_to_milliseconds(is->chain_duration));
+        }
 #ifdef FFP_MERGE
         if (is->paused != is->last_paused) {
             is->last_paused = is->paused;
@@ -3716,6 +4756,10 @@ static int read_thread(void *arg)
             continue;
         }
 #endif
+        if (is->trick_req)
+            stream_trick_play_toggle(ffp);
+        if (ffp->live_target_latency_ms > 0 && stream_is_live(is))
+            stream_live_latency_control(ffp);
         if (is->seek_req) {
             int64_t seek_target_origin = is->seek_pos;
             int64_t seek_target = is->seek_pos;
@@ -3737,18 +4781,27 @@ static int read_thread(void *arg)
             //fix after seek audio queue not flush cause wrong sound.
             SDL_AoutFlushAudio(ffp->aout);
             ffp_notify_msg3(ffp, FFP_MSG_BUFFERING_UPDATE, 0, 0);
-            ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
+            int seek_in_buffer = stream_seek_in_buffer(ffp, seek_target);
+            if (seek_in_buffer) {
+                ret = 0;
+            } else {
+                stream_chain_rollback(is, &ic, seek_target);
+                ret = stream_seek_file(is, ic, seek_min, seek_target, seek_max);
+            }
             if (ret < 0) {
                 av_log(NULL, AV_LOG_ERROR,
-                       "%s: error while seeking\n", is->ic->url);
+                       "%s: error while seeking\n", ic->url);
             } else {
-                if (is->audio_stream >= 0)
+                if (is->audio_stream >= 0 && !seek_in_buffer)
                     packet_queue_flush(&is->audioq);
                 if (is->video_stream >= 0) {
                     if (ffp->node_vdec) {
                         ffpipenode_flush(ffp->node_vdec);
                     }
-                    packet_queue_flush(&is->videoq);
+                    if (!seek_in_buffer)
+                        packet_queue_flush(&is->videoq);
+                    else if (is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC)
+                        packet_queue_flush(&is->videoq);
                 }
                 ff_sub_packet_queue_flush(is->ffSub);
                 if (is->seek_flags & AVSEEK_FLAG_BYTE) {
@@ -3757,6 +4810,17 @@ static int read_thread(void *arg)
                    set_clock(&is->extclk, seek_target_origin / (double)AV_TIME_BASE, 0);
                 }
 
+                if (!seek_in_buffer) {
+                    is->audio_read_end = AV_NOPTS_VALUE;
+                    is->video_read_end = AV_NOPTS_VALUE;
+                    is->live_edge      = AV_NOPTS_VALUE;
+                }
+                if (is->trick_rate) {
+                    is->trick_origin_pos  = seek_target;
+                    is->trick_origin_time = av_gettime_relative();
+                    is->trick_paused_time = 0;
+                    is->trick_last_key    = AV_NOPTS_VALUE;
+                }
                 is->latest_video_seek_load_serial = is->videoq.serial;
                 is->latest_audio_seek_load_serial = is->audioq.serial;
                 is->latest_seek_load_start_at = av_gettime();
@@ -3846,12 +4910,26 @@ static int read_thread(void *arg)
             is->queue_attachments_req = 0;
         }
 
+        stream_update_group_tier(ffp);
+
+        if (is->trick_rate) {
+            ret = stream_trick_play_step(ffp, ic, pkt);
+            if (ret <= 0) {
+                if (ret < 0 && ret != AVERROR_EOF)
+                    av_log(ffp, AV_LOG_WARNING, "trick play step failed: %s\n", av_err2str(ret));
+                /* paced by the clock, not by the queues */
+                stream_wait_read_thread(is, 10);
+            }
+            continue;
+        }
+
         /* if the queue are full, no need to read more */
         if (ffp->infinite_buffer < 1 && !is->seek_req &&
 #ifdef FFP_MERGE
               (is->audioq.size + is->videoq.size + is->subtitleq.size > MAX_QUEUE_SIZE)
 #else
-               (is->audioq.size + is->videoq.size + ff_sub_frame_cache_remaining(is->ffSub) > ffp->dcc.max_buffer_size
+               (is->audioq.size + is->videoq.size
+                + ff_sub_frame_cache_remaining(is->ffSub) > ffp->dcc.max_buffer_size
 #endif
             || (   stream_has_enough_packets(is->audio_st, is->audio_stream, &is->audioq, MIN_FRAMES)
                 && stream_has_enough_packets(is->video_st, is->video_stream, &is->videoq, MIN_FRAMES)
@@ -3859,10 +4937,12 @@ static int read_thread(void *arg)
             if (!is->eof) {
                 ffp_toggle_buffering(ffp, 0);
             }
-            /* wait 10 ms */
-            SDL_LockMutex(wait_mutex);
-            SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 10);
-            SDL_UnlockMutex(wait_mutex);
+            /* sleep until the decoders take the queues well below full */
+            ret = stream_arm_low_water(ffp);
+            if (ret == 0)
+                stream_wait_read_thread(is, -1);
+            else if (ret < 0)
+                stream_wait_read_thread(is, 10);
             continue;
         }
         if ((!is->paused || completed) &&
@@ -3878,11 +4958,9 @@ static int read_thread(void *arg)
                 ffp_statistic_l(ffp);
                 if (completed) {
                     av_log(ffp, AV_LOG_INFO, "ffp_toggle_buffering: eof\n");
-                    SDL_LockMutex(wait_mutex);
-                    // infinite wait may block shutdown
+                    // seeks and shutdown wake the thread
                     while(!is->abort_request && !is->seek_req)
-                        SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 100);
-                    SDL_UnlockMutex(wait_mutex);
+                        stream_wait_read_thread(is, -1);
                     if (!is->abort_request)
                         continue;
                 } else {
@@ -3903,8 +4981,29 @@ static int read_thread(void *arg)
             }
         }
         
+        /* the group holds reads back to this player's share of its bandwidth */
+        int io_delay = ff_player_group_io_delay(ffp);
+        if (io_delay > 0) {
+            stream_wait_read_thread(is, io_delay);
+            continue;
+        }
+
         pkt->flags = 0;
+        FFTRACE_BEGIN("av_read_frame");
         ret = av_read_frame(ic, pkt);
+        FFTRACE_END("av_read_frame");
+        if (ret >= 0)
+            ff_player_group_io_consume(ffp, pkt->size);
+        if (ret < 0 && (is->preloader || is->chain_next_ic) && !is->eof &&
+            (ret == AVERROR_EOF || avio_feof(ic->pb)) && !(ic->pb && ic->pb->error)) {
+            int chain = stream_chain_next(ffp, &ic);
+            if (chain >= 0) {
+                /* hold the end of stream back while the next item is still opening */
+                if (chain == 0)
+                    stream_wait_read_thread(is, 10);
+                continue;
+            }
+        }
         if (ret < 0) {
             int pb_eof = 0;
             int pb_error = 0;
@@ -3952,10 +5051,10 @@ static int read_thread(void *arg)
             }
             if (is->eof) {
                 ffp_toggle_buffering(ffp, 0);
-                //SDL_Delay(100);
-                SDL_LockMutex(wait_mutex);
-                SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 100);
-                SDL_UnlockMutex(wait_mutex);
+                /* only polls for the decoders to drain, then waits on the completed path above */
+                stream_wait_read_thread(is, 100);
+            } else {
+                stream_wait_read_thread(is, 10);
             }
 //            ffpplay code
 //            if (ic->pb && ic->pb->error) {
@@ -3965,16 +5064,19 @@ static int read_thread(void *arg)
 //                    break;
 //            }
             
-            SDL_LockMutex(wait_mutex);
-            SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 10);
-            SDL_UnlockMutex(wait_mutex);
             ffp_statistic_l(ffp);
             continue;
         } else {
             is->eof = 0;
         }
+        if (ic != is->ic && stream_chain_map_packet(is, ic, pkt) < 0) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        if (ic == is->ic && (pkt->stream_index == is->audio_stream || pkt->stream_index == is->video_stream))
+            stream_chain_new_extradata(is, ic->streams[pkt->stream_index], pkt);
         
-        monkey_log("av_read_frame %s : %0.2f\n",pkt->stream_index == is->audio_stream ? "audio" : "video", pkt->pts * av_q2d(ic->streams[pkt->stream_index]->time_base));
+        monkey_log("av_read_frame %s : %0.2f\n",pkt->stream_index == is->audio_stream ? "audio" : "video", pkt->pts * av_q2d(is->ic->streams[pkt->stream_index]->time_base));
         
         int64_t now = av_gettime_relative() / 1000;
         if (now - icy_last_update_time > ffp->icy_update_period) {
@@ -3996,13 +5098,13 @@ static int read_thread(void *arg)
                 //packet_queue_put(&is->videoq, &flush_pkt);
             }
         }
-        AVStream *st = ic->streams[pkt->stream_index];
+        AVStream *st = is->ic->streams[pkt->stream_index];
         /* check if packet is in play range specified by user, then queue, otherwise discard */
         stream_start_time = st->start_time;
         pkt_ts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
         pkt_in_play_range = ffp->duration == AV_NOPTS_VALUE ||
                 (pkt_ts - (stream_start_time != AV_NOPTS_VALUE ? stream_start_time : 0)) *
-                av_q2d(ic->streams[pkt->stream_index]->time_base) -
+                av_q2d(st->time_base) -
                 (double)(ffp->start_time != AV_NOPTS_VALUE ? ffp->start_time : 0) / AV_TIME_BASE
                 <= ((double)ffp->duration / AV_TIME_BASE);
         if (!pkt_in_play_range) {
@@ -4010,9 +5112,14 @@ static int read_thread(void *arg)
         } else {
             int stream_index = pkt->stream_index;
             if (stream_index == is->audio_stream) {
+                stream_update_read_end(&is->audio_read_end, st, pkt);
+                stream_update_live_edge(is);
                 packet_queue_put(&is->audioq, pkt);
             } else if (stream_index == is->video_stream
                        && !(is->video_st && (is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC))) {
+                stream_update_read_end(&is->video_read_end, st, pkt);
+                stream_update_live_edge(is);
+                FFTRACE_ASYNC_BEGIN("video frame", FFTRACE_ID(pkt->pts == AV_NOPTS_VALUE ? NAN : pkt->pts * av_q2d(st->time_base)));
                 packet_queue_put(&is->videoq, pkt);
             } else {
                 int sub_pending_stream;
@@ -4070,7 +5177,6 @@ static int read_thread(void *arg)
     if (!ffp->prepared || !is->abort_request) {
         ffp_notify_msg2(ffp, FFP_MSG_ERROR, last_error);
     }
-    SDL_DestroyMutex(wait_mutex);
     return 0;
 }
 
@@ -4080,7 +5186,7 @@ static VideoState *stream_open(FFPlayer *ffp, const char *filename, AVInputForma
     assert(!ffp->is);
     VideoState *is;
 
-    is = av_mallocz(sizeof(VideoState));
+    is = ffp_mallocz_cacheline(sizeof(VideoState));
     if (!is)
         return NULL;
     is->video_stream = -1;
@@ -4091,6 +5197,14 @@ static VideoState *stream_open(FFPlayer *ffp, const char *filename, AVInputForma
     is->iformat = iformat;
     is->ytop    = 0;
     is->xleft   = 0;
+    memset(is->chain_stream, -1, sizeof(is->chain_stream));
+    is->chain_start      = AV_NOPTS_VALUE;
+    is->prev_chain_start = AV_NOPTS_VALUE;
+    is->trick_last_key   = AV_NOPTS_VALUE;
+    is->audio_read_end   = AV_NOPTS_VALUE;
+    is->video_read_end   = AV_NOPTS_VALUE;
+    is->live_edge        = AV_NOPTS_VALUE;
+    is->live_speed       = 1.0f;
 #if defined(__ANDROID__)
     if (ffp->soundtouch_enable) {
         is->handle = ijk_soundtouch_create();
@@ -4116,6 +5230,14 @@ static VideoState *stream_open(FFPlayer *ffp, const char *filename, AVInputForma
         goto fail;
     }
 
+    if (!(is->continue_read_mutex = SDL_CreateMutex())) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
+        goto fail;
+    }
+    packet_queue_set_low_water_cb(&is->videoq, stream_low_water, is);
+    packet_queue_set_low_water_cb(&is->audioq, stream_low_water, is);
+    is->videoq.wait_histogram = &ffp->stat.frame_hist[FFP_FRAME_HIST_QUEUE_WAIT];
+
     if (!(is->video_accurate_seek_cond = SDL_CreateCond())) {
         av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
         ffp->enable_accurate_seek = 0;
@@ -4148,11 +5270,12 @@ static VideoState *stream_open(FFPlayer *ffp, const char *filename, AVInputForma
 
     is->video_refresh_tid = SDL_CreateThreadEx(&is->_video_refresh_tid, video_refresh_thread, ffp, "ff_vout");
     if (!is->video_refresh_tid) {
-        av_freep(&ffp->is);
+        ffp_freep_cacheline(&ffp->is);
         return NULL;
     }
 
     is->initialized_decoder = 0;
+    ff_player_group_set_wake(ffp, stream_wake_read_thread, is);
     is->read_tid = SDL_CreateThreadEx(&is->_read_tid, read_thread, ffp, "ff_read");
     if (!is->read_tid) {
         av_log(NULL, AV_LOG_FATAL, "SDL_CreateThread(): %s\n", SDL_GetError());
@@ -4162,7 +5285,7 @@ static VideoState *stream_open(FFPlayer *ffp, const char *filename, AVInputForma
     if (ffp->async_init_decoder && !ffp->video_disable && ffp->video_mime_type && strlen(ffp->video_mime_type) > 0
                     && ffp->mediacodec_default_name && strlen(ffp->mediacodec_default_name) > 0) {
         if (ffp->mediacodec_all_videos || ffp->mediacodec_avc || ffp->mediacodec_hevc || ffp->mediacodec_mpeg2) {
-            decoder_init(&is->viddec, NULL, &is->videoq, is->continue_read_thread);
+            decoder_init(&is->viddec, NULL, &is->videoq, stream_wake_read_thread, is);
             ffp->node_vdec = ffpipeline_init_video_decoder(ffp->pipeline, ffp);
         }
     }
@@ -4196,17 +5319,21 @@ fail:
 // FFP_MERGE: options
 // FFP_MERGE: show_usage
 // FFP_MERGE: show_help_default
+static void ffp_publish_position(FFPlayer *ffp);
 static int video_refresh_thread(void *arg)
 {
     FFPlayer *ffp = arg;
     VideoState *is = ffp->is;
     double remaining_time = 0.0;
+    FFTRACE_THREAD("ff_vout");
     while (!is->abort_request) {
         if (remaining_time > 0.0)
             av_usleep((int)(int64_t)(remaining_time * 1000000.0));
         remaining_time = REFRESH_RATE;
         if (is->show_mode != SHOW_MODE_NONE && (!is->paused || is->force_refresh || is->step_on_seeking || is->force_refresh_sub_changed))
             video_refresh(ffp, &remaining_time);
+        if (is->ic)
+            ffp_publish_position(ffp);
     }
     //clean GLView's attach,because the attach retained sub_overlay;
     //otherwise sub_overlay will be free in main thread!
@@ -4385,13 +5512,14 @@ static const char *ijk_version_info(void)
 
 FFPlayer *ffp_create(void)
 {
-    FFPlayer* ffp = (FFPlayer*) av_mallocz(sizeof(FFPlayer));
+    FFPlayer* ffp = (FFPlayer*) ffp_mallocz_cacheline(sizeof(FFPlayer));
     if (!ffp)
         return NULL;
 
     msg_queue_init(&ffp->msg_queue);
     ffp->af_mutex = SDL_CreateMutex();
     ffp->vf_mutex = SDL_CreateMutex();
+    init_clock(&ffp->position_clk, &ffp->position_clk.serial, "position");
 
     ffp_reset_internal(ffp);
     ffp->av_class = &ffp_context_class;
@@ -4416,6 +5544,8 @@ void ffp_destroy(FFPlayer *ffp)
         ffp->is = NULL;
     }
 
+    ff_player_group_leave(ffp);
+
     SDL_VoutFreeP(&ffp->vout);
     SDL_AoutFreeP(&ffp->aout);
     SDL_GPUFreeP(&ffp->gpu);
@@ -4432,7 +5562,7 @@ void ffp_destroy(FFPlayer *ffp)
 
     msg_queue_destroy(&ffp->msg_queue);
 
-    av_free(ffp);
+    ffp_freep_cacheline(&ffp);
 }
 
 void ffp_destroy_p(FFPlayer **pffp)
@@ -4476,7 +5606,9 @@ static int app_func_event(AVApplicationContext *h, int message ,void *data, size
         }
     } else if (message == AVAPP_EVENT_ASYNC_STATISTIC && sizeof(AVAppAsyncStatistic) == size) {
         AVAppAsyncStatistic *statistic =  (AVAppAsyncStatistic *) (intptr_t)data;
-        ffp->stat.buf_backwards = statistic->buf_backwards;
+        /* with a packet back buffer buf_backwards reports the played packets kept in memory */
+        if (ffp->back_buffer_duration_ms <= 0)
+            ffp->stat.buf_backwards = statistic->buf_backwards;
         ffp->stat.buf_forwards = statistic->buf_forwards;
         ffp->stat.buf_capacity = statistic->buf_capacity;
     }
@@ -4664,6 +5796,11 @@ int ffp_prepare_async_l(FFPlayer *ffp, const char *file_name)
         av_dict_set(&ffp->format_opts, "timeout", NULL, 0);
     }
 
+#ifdef FFP_TRACE
+    if (ffp->trace_file)
+        ff_trace_start();
+#endif
+
     static int once_flag = 1;
     
     if (once_flag) {
@@ -4761,6 +5898,7 @@ int ffp_stop_l(FFPlayer *ffp)
     VideoState *is = ffp->is;
     if (is) {
         is->abort_request = 1;
+        stream_wake_read_thread(is);
         toggle_pause(ffp, 1);
     }
 
@@ -4785,10 +5923,26 @@ int ffp_wait_stop_l(FFPlayer *ffp)
         ffp_stop_l(ffp);
         stream_close(ffp);
         ffp->is = NULL;
+#ifdef FFP_TRACE
+        if (ffp->trace_file) {
+            ff_trace_stop();
+            ff_trace_export_chrome(ffp->trace_file);
+        }
+#endif
     }
     return 0;
 }
 
+/* start of the item playing now on the timeline of is->ic, once items were chained */
+static int64_t ffp_get_item_start(VideoState *is)
+{
+    if (is->chain_started)
+        return is->chain_start;
+    if (is->prev_chain_start != AV_NOPTS_VALUE)
+        return is->prev_chain_start;
+    return is->ic->start_time != AV_NOPTS_VALUE ? is->ic->start_time : 0;
+}
+
 int ffp_seek_to_l(FFPlayer *ffp, long msec)
 {
     assert(ffp);
@@ -4807,6 +5961,8 @@ int ffp_seek_to_l(FFPlayer *ffp, long msec)
     }
 
     start_time = is->ic->start_time;
+    if (is->chain_ic)
+        start_time = ffp_get_item_start(is);
     if (start_time > 0 && start_time != AV_NOPTS_VALUE)
         seek_pos += start_time;
 
@@ -4823,6 +5979,60 @@ int ffp_seek_to_l(FFPlayer *ffp, long msec)
     return 0;
 }
 
+/* where the item starts on the master clock, in milliseconds */
+static int64_t ffp_get_position_start(FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+    int64_t start_time = is->ic->start_time;
+
+    if (is->chain_ic)
+        return fftime_to_milliseconds(ffp_get_item_start(is));
+    if (start_time > 0 && start_time != AV_NOPTS_VALUE)
+        return fftime_to_milliseconds(start_time);
+    return 0;
+}
+
+/* the refresh thread copies the master clock to position_clk on every pass */
+static void ffp_publish_position(FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+    Clock *master = get_master_clock_ref(is);
+    Clock *c = &ffp->position_clk;
+    // like ffp_get_current_position_l(), custom sources with no_time_adjust report the stream time
+    double start = ffp->no_time_adjust ? 0 : ffp_get_position_start(ffp) / 1000.0;
+    ClockState s;
+
+    clock_read(master, &s);
+    clock_write_begin(c);
+    if (isnan(s.pts) || __atomic_load_n(master->queue_serial, __ATOMIC_RELAXED) != s.serial) {
+        // stale after a seek, hold at the target until the master clock restarts
+        clock_store_l(c, is->seek_pos / (double)AV_TIME_BASE - start, c->serial, s.last_updated);
+        CLOCK_STORE(c, paused, 1);
+    } else {
+        CLOCK_STORE(c, pts, s.pts - start);
+        CLOCK_STORE(c, pts_drift, s.pts_drift - start);
+        CLOCK_STORE(c, last_updated, s.last_updated);
+        CLOCK_STORE(c, speed, s.speed);
+        CLOCK_STORE(c, paused, s.paused);
+    }
+    clock_write_end(c);
+}
+
+long ffp_get_current_position_nolock(FFPlayer *ffp)
+{
+    assert(ffp);
+    double pos_clock = get_clock(&ffp->position_clk);
+    int64_t pos;
+
+    // NAN until the refresh thread of an opened item published it
+    if (isnan(pos_clock))
+        return 0;
+    pos = pos_clock * 1000;
+    if (!ffp->no_time_adjust && pos < 0)
+        return 0;
+    return (long)pos;
+}
+
 long ffp_get_current_position_l(FFPlayer *ffp)
 {
     assert(ffp);
@@ -4830,11 +6040,7 @@ long ffp_get_current_position_l(FFPlayer *ffp)
     if (!is || !is->ic)
         return 0;
 
-    int64_t start_time = is->ic->start_time;
-    int64_t start_diff = 0;
-    if (start_time > 0 && start_time != AV_NOPTS_VALUE)
-        start_diff = fftime_to_milliseconds(start_time);
-
+    int64_t start_diff = ffp_get_position_start(ffp);
     int64_t pos = 0;
     double pos_clock = get_master_clock(is);
     if (isnan(pos_clock)) {
@@ -4866,6 +6072,8 @@ long ffp_get_duration_l(FFPlayer *ffp)
         return 0;
 
     int64_t duration = fftime_to_milliseconds(is->ic->duration);
+    if (is->chain_ic)
+        duration = fftime_to_milliseconds(is->chain_started ? is->chain_duration : is->prev_chain_duration);
     if (duration < 0)
         return 0;
 
@@ -4884,6 +6092,33 @@ long ffp_get_playable_duration_l(FFPlayer *ffp)
     return (long)ffp->playable_duration_ms;
 }
 
+int ffp_preload_next_l(FFPlayer *ffp, const char *url)
+{
+    assert(ffp);
+    VideoState *is = ffp->is;
+    FFPreloader *preloader = NULL;
+    FFPreloader *old;
+
+    if (!is)
+        return EIJK_NULL_IS_PTR;
+
+    if (url) {
+        AVIOInterruptCB interrupt_cb = { decode_interrupt_cb, is };
+
+        preloader = ff_preloader_create(url, is->format_opts, &interrupt_cb, ffp->probe_cache_dir, ffp->probe_cache_validator);
+        if (!preloader)
+            return EIJK_OUT_OF_MEMORY;
+    }
+
+    SDL_LockMutex(is->play_mutex);
+    old = is->preloader;
+    is->preloader = preloader;
+    SDL_UnlockMutex(is->play_mutex);
+
+    ff_preloader_destroyp(&old);
+    return 0;
+}
+
 void ffp_set_loop(FFPlayer *ffp, int loop)
 {
     assert(ffp);
@@ -4920,16 +6155,25 @@ double ffp_get_master_clock(VideoState *is)
     return get_master_clock(is);
 }
 
+int ffp_get_video_clock_serial(VideoState *is)
+{
+    return get_clock_serial(&is->vidclk);
+}
+
 void ffp_toggle_buffering_l(FFPlayer *ffp, int buffering_on)
 {
     if (!ffp->packet_buffering)
         return;
 
     VideoState *is = ffp->is;
+    /* trick play never has more than one keyframe queued */
+    if (buffering_on && is->trick_rate)
+        return;
     if (buffering_on && !is->buffering_on) {
         av_log(ffp, AV_LOG_DEBUG, "ffp_toggle_buffering_l: start\n");
         is->buffering_on = 1;
         stream_update_pause_l(ffp);
+        ff_player_group_set_buffering(ffp, 1);
         if (is->seek_req) {
             is->seek_buffering = 1;
             ffp_notify_msg2(ffp, FFP_MSG_BUFFERING_START, 1);
@@ -4940,6 +6184,7 @@ void ffp_toggle_buffering_l(FFPlayer *ffp, int buffering_on)
         av_log(ffp, AV_LOG_DEBUG, "ffp_toggle_buffering_l: end\n");
         is->buffering_on = 0;
         stream_update_pause_l(ffp);
+        ff_player_group_set_buffering(ffp, 0);
         
         if (is->seek_buffering) {
             is->seek_buffering = 0;
@@ -5103,6 +6348,22 @@ void ffp_set_subtitle_codec_info(FFPlayer *ffp, const char *module, const char *
     av_log(ffp, AV_LOG_INFO, "SubtitleCodec: %s\n", ffp->subtitle_codec_info);
 }
 
+int ffp_set_trick_play_rate(FFPlayer *ffp, int rate)
+{
+    VideoState *is = ffp->is;
+
+    if (!is || !is->video_st || (is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC) || is->chain_ic)
+        return EIJK_INVALID_STATE;
+    if (rate && (abs(rate) < TRICK_PLAY_MIN_RATE || abs(rate) > TRICK_PLAY_MAX_RATE))
+        return EIJK_FAILED;
+
+    av_log(ffp, AV_LOG_INFO, "Trick play rate: %d\n", rate);
+    is->trick_req_rate = rate;
+    is->trick_req = 1;
+    stream_wake_read_thread(is);
+    return 0;
+}
+
 void ffp_set_playback_rate(FFPlayer *ffp, float rate)
 {
     if (!ffp)
@@ -5257,6 +6518,9 @@ int ffp_set_stream_selected(FFPlayer *ffp, int stream, int selected)
         return -2;
     
     if (stream >= 0 && stream < ic->nb_streams) {
+        /* the streams of is->ic are fed by a chained item now */
+        if (is->chain_ic)
+            return -1;
         return ffp_set_internal_stream_selected(ffp, stream, selected);
     } else {
         int r = ff_sub_record_need_select_stream(is->ffSub, selected ? stream : -1);
@@ -5311,6 +6575,36 @@ void ffp_set_property_float(FFPlayer *ffp, int id, float value)
     }
 }
 
+static int64_t ffp_get_frame_hist_property(FFPlayer *ffp, int index)
+{
+    FFHistogram *hist = &ffp->stat.frame_hist[index / 4];
+
+    switch (index % 4) {
+        case 0:
+            return ff_histogram_percentile(hist, 50);
+        case 1:
+            return ff_histogram_percentile(hist, 95);
+        case 2:
+            return ff_histogram_percentile(hist, 99);
+        default:
+            return __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    }
+}
+
+int ffp_get_frame_histograms(FFPlayer *ffp, FFHistogramSnapshot *snapshots, int nb_snapshots, int reset)
+{
+    int nb = FFMIN(nb_snapshots, FFP_FRAME_HIST_NB);
+
+    if (!ffp || !snapshots)
+        return 0;
+    for (int i = 0; i < nb; i++) {
+        ff_histogram_snapshot(&ffp->stat.frame_hist[i], &snapshots[i]);
+        if (reset)
+            ff_histogram_reset(&ffp->stat.frame_hist[i]);
+    }
+    return nb;
+}
+
 int64_t ffp_get_property_int64(FFPlayer *ffp, int id, int64_t default_value)
 {
     switch (id) {
@@ -5407,9 +6701,21 @@ int64_t ffp_get_property_int64(FFPlayer *ffp, int id, int64_t default_value)
             if (!ffp)
                 return default_value;
             return ffp->stat.logical_file_size;
+        case FFP_PROP_INT64_STREAM_OPEN_DURATION:
+            return ffp ? ffp->stat.stream_open_duration : default_value;
+        case FFP_PROP_INT64_PROBE_CACHE_HIT:
+            return ffp ? ffp->stat.probe_cache_hit : default_value;
+        case FFP_PROP_INT64_LIVE_LATENCY:
+            return ffp ? ffp->stat.live_latency : default_value;
+        case FFP_PROP_INT64_TRICK_PLAY_RATE:
+            if (!ffp || !ffp->is)
+                return default_value;
+            return ffp->is->trick_req ? ffp->is->trick_req_rate : ffp->is->trick_rate;
         case FFP_PROP_FLOAT_DROP_FRAME_COUNT:
             return ffp ? ffp->stat.drop_frame_count : default_value;
         default:
+            if (ffp && id >= FFP_PROP_INT64_DECODE_TIME_P50 && id <= FFP_PROP_INT64_AV_SYNC_ERROR_MAX)
+                return ffp_get_frame_hist_property(ffp, id - FFP_PROP_INT64_DECODE_TIME_P50);
             return default_value;
     }
 }
@@ -5432,6 +6738,12 @@ void ffp_set_property_int64(FFPlayer *ffp, int id, int64_t value)
             if (ffp) {
                 ijkio_manager_immediate_reconnect(ffp->ijkio_manager_ctx);
             }
+            break;
+        case FFP_PROP_INT64_TRICK_PLAY_RATE:
+            if (ffp) {
+                ffp_set_trick_play_rate(ffp, (int)value);
+            }
+            break;
         default:
             break;
     }
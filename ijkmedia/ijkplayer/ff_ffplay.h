@@ -63,17 +63,23 @@ int       ffp_wait_stop_l(FFPlayer *ffp);
 /* all in milliseconds */
 int       ffp_seek_to_l(FFPlayer *ffp, long msec);
 long      ffp_get_current_position_l(FFPlayer *ffp);
+/* lock-free and safe from any thread, extrapolated from the master clock of the last refresh */
+long      ffp_get_current_position_nolock(FFPlayer *ffp);
 long      ffp_get_duration_l(FFPlayer *ffp);
 long      ffp_get_playable_duration_l(FFPlayer *ffp);
 void      ffp_set_loop(FFPlayer *ffp, int loop);
 int       ffp_get_loop(FFPlayer *ffp);
 
+/* open url in the background and play it gaplessly after the current item, NULL cancels */
+int       ffp_preload_next_l(FFPlayer *ffp, const char *url);
+
 /* for internal usage */
 int       ffp_packet_queue_get_or_buffering(FFPlayer *ffp, PacketQueue *q, AVPacket *pkt, int *serial, int *finished);
 int       ffp_queue_picture(FFPlayer *ffp, AVFrame *src_frame, double pts, double duration, int64_t pos, int serial);
 
 int       ffp_get_master_sync_type(VideoState *is);
 double    ffp_get_master_clock(VideoState *is);
+int       ffp_get_video_clock_serial(VideoState *is);
 
 void      ffp_toggle_buffering_l(FFPlayer *ffp, int start_buffering);
 void      ffp_toggle_buffering(FFPlayer *ffp, int start_buffering);
@@ -86,6 +92,11 @@ void      ffp_set_audio_codec_info(FFPlayer *ffp, const char *module, const char
 void      ffp_set_subtitle_codec_info(FFPlayer *ffp, const char *module, const char *codec);
 
 void      ffp_set_playback_rate(FFPlayer *ffp, float rate);
+/*
+ * keyframe-only playback at 4x..64x, negative rates scrub backwards, 0 resumes normal playback.
+ * paced on the playing time, reaching the start or end resumes on its own with FFP_MSG_TRICK_PLAY_END.
+ */
+int       ffp_set_trick_play_rate(FFPlayer *ffp, int rate);
 void      ffp_set_playback_volume(FFPlayer *ffp, float volume);
 int       ffp_get_video_rotate_degrees(FFPlayer *ffp);
 int       ffp_set_stream_selected(FFPlayer *ffp, int stream, int selected);
@@ -94,6 +105,8 @@ float     ffp_get_property_float(FFPlayer *ffp, int id, float default_value);
 void      ffp_set_property_float(FFPlayer *ffp, int id, float value);
 int64_t   ffp_get_property_int64(FFPlayer *ffp, int id, int64_t default_value);
 void      ffp_set_property_int64(FFPlayer *ffp, int id, int64_t value);
+/* per video frame timing distributions in FFP_FRAME_HIST_* order, reset starts a new window; returns the count filled */
+int       ffp_get_frame_histograms(FFPlayer *ffp, FFHistogramSnapshot *snapshots, int nb_snapshots, int reset);
 
 /* must be freed with free(); */
 struct IjkMediaMeta *ffp_get_meta_l(FFPlayer *ffp);
@@ -46,6 +46,10 @@
 // #define FFP_AMC_DISABLE_OUTPUT
 
 // #define FFP_AVFILTER_PLAYBACK_RATE
+
+// per-thread event rings, see ff_trace.h
+// #define FFP_TRACE
+
 //#define FFP_MONKEY_DEBUG
 #ifdef FFP_MONKEY_DEBUG
 #define monkey_log(fmt, ...) av_log(NULL, AV_LOG_INFO,fmt,__VA_ARGS__)
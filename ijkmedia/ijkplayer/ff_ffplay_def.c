@@ -8,8 +8,10 @@
 #include "ff_ffplay_def.h"
 #include "ff_packet_list.h"
 #include "ff_frame_queue.h"
+#include <stdlib.h>
 
-int decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue, SDL_cond *empty_queue_cond) 
+int decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue,
+                 void (*empty_queue_cb)(void *opaque), void *empty_queue_opaque)
 {
     memset(d, 0, sizeof(Decoder));
     d->pkt = av_packet_alloc();
@@ -17,7 +19,8 @@ int decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue, SDL_cond
         return AVERROR(ENOMEM);
     d->avctx = avctx;
     d->queue = queue;
-    d->empty_queue_cond = empty_queue_cond;
+    d->empty_queue_cb = empty_queue_cb;
+    d->empty_queue_opaque = empty_queue_opaque;
     d->start_pts = AV_NOPTS_VALUE;
     d->pkt_serial = 1;
     d->first_frame_decoded_time = SDL_GetTickHR();
@@ -43,6 +46,12 @@ int decoder_start(Decoder *d, int (*fn)(void *), void *arg, const char *name)
     return 0;
 }
 
+void decoder_signal_empty_queue(Decoder *d)
+{
+    if (d->queue->nb_packets == 0 && d->empty_queue_cb)
+        d->empty_queue_cb(d->empty_queue_opaque);
+}
+
 void decoder_destroy(Decoder *d)
 {
     av_packet_free(&d->pkt);
@@ -57,3 +66,22 @@ void decoder_abort(Decoder *d, FrameQueue *fq)
     d->decoder_tid = NULL;
     packet_queue_flush(d->queue);
 }
+
+void *ffp_mallocz_cacheline(size_t size)
+{
+    void *ptr = NULL;
+
+    // av_malloc only aligns for SIMD loads, 16 to 64 bytes depending on the build
+    if (posix_memalign(&ptr, FFP_CACHELINE_SIZE, size))
+        return NULL;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+void ffp_freep_cacheline(void *arg)
+{
+    void **ptr = arg;
+
+    free(*ptr);
+    *ptr = NULL;
+}
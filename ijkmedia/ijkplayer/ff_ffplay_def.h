@@ -63,6 +63,7 @@
 #include "ijkavformat/ijkioapplication.h"
 #include "ff_ffinc.h"
 #include "ff_ffmsg_queue.h"
+#include "ff_histogram.h"
 #include "ff_ffpipenode.h"
 #include "ijkmeta.h"
 #include "ijkavformat/ijklas.h"
@@ -123,6 +124,11 @@
 #define EXTERNAL_CLOCK_SPEED_MAX  1.010
 #define EXTERNAL_CLOCK_SPEED_STEP 0.001
 
+/* low-latency live: checks per second, catch-up speed per second of extra latency, speed granularity */
+#define LIVE_LATENCY_CHECK_INTERVAL 0.2
+#define LIVE_CATCHUP_GAIN           0.5
+#define LIVE_CATCHUP_STEP           0.05
+
 /* we use about AUDIO_DIFF_AVG_NB A-V differences to make the average */
 #define AUDIO_DIFF_AVG_NB   20
 
@@ -146,9 +152,18 @@ static unsigned sws_flags = SWS_BICUBIC;
 #define MAX_DEVIATION 200000   // 200ms
 #define IJK_EXCHANGE_DECODER_FLAG -1000
 
+/*
+ * state written at a high rate by one thread starts a line of its own, so the audio callback,
+ * the refresh thread, the decoders and read_thread don't steal each other's lines.
+ * 128 also covers the line pairs x86 prefetches together and the lines of apple silicon.
+ */
+#define FFP_CACHELINE_SIZE      128
+#define FFP_CACHELINE_ALIGNED   __attribute__((aligned(FFP_CACHELINE_SIZE)))
+
 typedef struct MyAVPacketList {
     AVPacket *pkt;
     int serial;
+    int64_t put_time;           // av_gettime_relative() when queued
 } MyAVPacketList;
 
 typedef struct PacketQueue {
@@ -163,6 +178,18 @@ typedef struct PacketQueue {
     MyAVPacketList *recycle_pkt;
     int recycle_count;
     int is_buffer_indicator;
+    AVFifo *back_list;          // played packets kept for backward seeks, NULL when disabled
+    int back_nb_packets;
+    int back_size;
+    int64_t back_duration;
+    int64_t back_max_duration;
+    int back_max_size;
+    int low_water_armed;        // one-shot, see packet_queue_arm_low_water()
+    int low_water_packets;
+    int low_water_size;         // queued bytes, the back list is not counted
+    void (*low_water_cb)(void *opaque);
+    void *low_water_opaque;
+    FFHistogram *wait_histogram;    // us each packet spent queued, NULL when not measured
 } PacketQueue;
 
 // #define VIDEO_PICTURE_QUEUE_SIZE 3
@@ -183,8 +210,14 @@ typedef struct AudioParams {
     int bytes_per_sec;
 } AudioParams;
 
+/*
+ * A seqlock guards pts to paused: writers make seq odd, store and make it even again,
+ * readers copy the fields until seq is even and unchanged around the copy. Readers
+ * never block, see clock_read() in ff_ffplay.c.
+ */
 typedef struct Clock {
     char name[10];
+    unsigned seq;
     double pts;           /* clock base */
     double pts_drift;     /* clock base minus time at which we updated the clock */
     double last_updated;
@@ -195,6 +228,16 @@ typedef struct Clock {
     float extra_delay;   /* user can set the delay*/
 } Clock;
 
+/* consistent copy of the seqlock guarded fields of a Clock */
+typedef struct ClockState {
+    double pts;
+    double pts_drift;
+    double last_updated;
+    double speed;
+    int serial;
+    int paused;
+} ClockState;
+
 /* Common struct for handling all types of decoded data and allocated render buffers. */
 typedef struct Frame {
     AVFrame *frame;
@@ -215,6 +258,7 @@ typedef struct Frame {
     int format;
     AVRational sar;
     int shown;
+    int64_t queued_time;  /* av_gettime_relative() when the decoded frame was queued */
 } Frame;
 
 typedef struct FrameQueue {
@@ -247,7 +291,8 @@ typedef struct Decoder {
     int bfsc_ret;
     uint8_t *bfsc_data;
 
-    SDL_cond *empty_queue_cond;
+    void (*empty_queue_cb)(void *opaque);   // wakes the reader when the queue runs dry
+    void *empty_queue_opaque;
     int64_t start_pts;
     AVRational start_pts_tb;
     int64_t next_pts;
@@ -262,55 +307,141 @@ typedef struct Decoder {
     Uint64 start_seek_time;
     
     int hw_failed_count;
+    int64_t decode_time;    // us spent in codec calls since the last frame came out
 } Decoder;
 
 typedef struct FFSubtitle FFSubtitle;
 typedef struct ijk_custom_avio_protocol ijk_custom_avio_protocol;
 
 typedef struct VideoState {
+    /* set up when the input and its streams open, read by every thread */
     SDL_Thread *read_tid;
     SDL_Thread _read_tid;
     const AVInputFormat *iformat;
-    int abort_request;
-    int force_refresh_sub_changed;//changed sub prefercence or close sub.
-    int force_refresh;
-    int paused;
-    int last_paused;
-    int queue_attachments_req;
-    int seek_req;
-    int seek_flags;
-    int64_t seek_pos;
-    int64_t seek_rel;
-    
 #ifdef FFP_MERGE
     int read_pause_return;
 #endif
     AVFormatContext *ic;
     int realtime;
+    char *filename;
+    int width, height, xleft, ytop;
 
-    Clock audclk;
-    Clock vidclk;
-    Clock extclk;
-
-    FrameQueue pictq;
-    FrameQueue sampq;
-
-    Decoder auddec;
-    Decoder viddec;
-    
     int audio_stream;
-
+    AVStream *audio_st;
+    int video_stream;
+    AVStream *video_st;
     int av_sync_type;
     void *handle;
-    double audio_clock;
-    int audio_clock_serial;
-    double audio_diff_cum; /* used for AV difference average computation */
     double audio_diff_avg_coef;
     double audio_diff_threshold;
-    int audio_diff_avg_count;
-    AVStream *audio_st;
-    PacketQueue audioq;
     int audio_hw_buf_size;
+    struct AudioParams audio_src;
+    struct AudioParams audio_tgt;
+    double max_frame_duration;      // maximum duration of a frame - above this, we consider the jump a timestamp discontinuity
+    int is_video_high_fps; // above 30fps
+    int is_video_high_res; // above 1080p
+    int dropping_frame;
+
+    SDL_cond *continue_read_thread;
+    SDL_mutex *continue_read_mutex;
+
+    /* extra fields */
+    SDL_mutex  *play_mutex; // only guard state, do not block any long operation
+    SDL_Thread *video_refresh_tid;
+    SDL_Thread _video_refresh_tid;
+    PacketQueue *buffer_indicator_queue;
+    SDL_mutex *accurate_seek_mutex;
+    SDL_cond  *video_accurate_seek_cond;
+    SDL_cond  *audio_accurate_seek_cond;
+    volatile int initialized_decoder;
+    FFSubtitle *ffSub;
+    ijk_custom_avio_protocol * ijk_io;
+    AVDictionary *format_opts;          // options ic was opened with, reused for the next item
+
+    /* composites the decoded pictures with the mosaic inputs, owned by the video decoder */
+    struct FFMosaic *mosaic;
+
+    /* requests of the API, written rarely and polled by the other threads */
+    int abort_request FFP_CACHELINE_ALIGNED;
+    int force_refresh_sub_changed;//changed sub prefercence or close sub.
+    int paused;
+    int pause_req;
+    int step;//for step mode
+    int step_on_seeking;//for seeking display a frame
+    int seek_req;
+    int seek_flags;
+    int64_t seek_pos;
+    int64_t seek_rel;
+    int audio_volume;
+    int muted;
+    enum ShowMode {
+        SHOW_MODE_NONE = -1, SHOW_MODE_VIDEO = 0, SHOW_MODE_WAVES, SHOW_MODE_RDFT, SHOW_MODE_NB
+    } show_mode;
+    int trick_req;
+    int trick_req_rate;
+    int buffering_on;
+
+    /* read_thread */
+    int eof FFP_CACHELINE_ALIGNED;
+    int last_paused;
+    int queue_attachments_req;
+    int continue_read_pending;          // guarded by continue_read_mutex
+    int low_water_size;                 // audioq and videoq bytes together that wake read_thread, -1 for none
+    int seek_buffering;
+    volatile int latest_video_seek_load_serial;
+    volatile int latest_audio_seek_load_serial;
+    volatile int64_t latest_seek_load_start_at;
+
+    /* gapless playlist, the next item is read after ic on ic's streams and timeline */
+    struct FFPreloader *preloader;      // guarded by play_mutex
+    AVFormatContext *chain_ic;          // item read after a transition, NULL while reading ic
+    struct FFPreloader *chain_preloader; // opened chain_ic, its interrupt callback, kept until chain_ic is closed
+    int chain_stream[AVMEDIA_TYPE_NB];  // streams of chain_ic feeding audio_stream and video_stream
+    int64_t chain_start;                // chain_ic's start on the ic timeline, AV_TIME_BASE
+    int64_t chain_duration;
+    int64_t prev_chain_start;           // same for the item playing until chain_start is reached
+    int64_t prev_chain_duration;
+    int chain_started;
+    AVFormatContext *prev_chain_ic;     // that item when it was chained too, open until chain_started
+    struct FFPreloader *prev_chain_preloader;
+    int prev_chain_stream[AVMEDIA_TYPE_NB];
+    AVFormatContext *chain_next_ic;     // chain_ic given back by a seek before chain_start, read again after
+    struct FFPreloader *chain_next_preloader;
+    int chain_next_stream[AVMEDIA_TYPE_NB];
+    int chain_extradata_req[AVMEDIA_TYPE_NB];   // next packet read carries its item's extradata
+    int64_t audio_read_end;             // end of the last queued packet on the ic timeline, AV_TIME_BASE
+    int64_t video_read_end;
+
+    /* keyframe-only trick play, stepped by read_thread */
+    int trick_rate;                     // playback speed, negative plays backwards, 0 is off
+    int64_t trick_origin_pos;           // AV_TIME_BASE
+    int64_t trick_origin_time;          // av_gettime_relative() at trick_origin_pos
+    int64_t trick_paused_time;          // av_gettime_relative() when paused in trick play, 0 otherwise
+    int64_t trick_last_key;             // AV_TIME_BASE
+    int64_t trick_next_step;
+    int trick_saved_sync_type;
+    enum AVDiscard trick_saved_skip_frame;
+
+    /* keyframes only while the player is in the background tier of its group */
+    int group_keyframes_only;
+    enum AVDiscard group_saved_skip_frame;
+
+    /* low-latency live, the live edge is the newest packet read on the master stream */
+    int64_t live_edge;                  // AV_TIME_BASE
+    int64_t live_edge_time;             // av_gettime_relative() when live_edge was read
+    double live_next_check;
+    float live_speed;                   // catch-up factor applied on top of pf_playback_rate
+
+    /* read by everyone, each written by its own thread */
+    Clock audclk FFP_CACHELINE_ALIGNED;
+    Clock vidclk FFP_CACHELINE_ALIGNED;
+    Clock extclk FFP_CACHELINE_ALIGNED;
+
+    /* audio callback */
+    double audio_clock FFP_CACHELINE_ALIGNED;
+    int audio_clock_serial;
+    double audio_diff_cum; /* used for AV difference average computation */
+    int audio_diff_avg_count;
     uint8_t *audio_buf;
     uint8_t *audio_buf1;
     short *audio_new_buf;  /* for soundtouch buf */
@@ -318,101 +449,66 @@ typedef struct VideoState {
     unsigned int audio_buf1_size;
     unsigned int audio_new_buf_size;
     int audio_buf_index; /* in bytes */
-    int audio_volume;
-    int muted;
-    struct AudioParams audio_src;
-#if CONFIG_AVFILTER
-    struct AudioParams audio_filter_src;
-#endif
-    struct AudioParams audio_tgt;
     struct SwrContext *swr_ctx;
-    int frame_drops_early;
-    int frame_drops_late;
-    int continuous_frame_drops_early;
-
-    enum ShowMode {
-        SHOW_MODE_NONE = -1, SHOW_MODE_VIDEO = 0, SHOW_MODE_WAVES, SHOW_MODE_RDFT, SHOW_MODE_NB
-    } show_mode;
-    int16_t sample_array[SAMPLE_ARRAY_SIZE];
     int sample_array_index;
     int last_i_start;
+    int16_t sample_array[SAMPLE_ARRAY_SIZE];
 #ifdef FFP_MERGE
     RDFTContext *rdft;
     int rdft_bits;
     FFTSample *rdft_data;
     int xpos;
 #endif
+
+    /* refresh thread */
+    double frame_timer FFP_CACHELINE_ALIGNED;
+    int frame_drops_late;
+    int force_refresh;
     double last_vis_time;
 #ifdef FFP_MERGE
     SDL_Texture *vis_texture;
     SDL_Texture *sub_texture;
 #endif
 
-    double frame_timer;
-    double frame_last_returned_time;
+    /* video decoder */
+    double frame_last_returned_time FFP_CACHELINE_ALIGNED;
     double frame_last_filter_delay;
-    int video_stream;
-    AVStream *video_st;
-    PacketQueue videoq;
-    double max_frame_duration;      // maximum duration of a frame - above this, we consider the jump a timestamp discontinuity
+    int frame_drops_early;
+    int continuous_frame_drops_early;
+    int drop_vframe_count;
+    int drop_vframe_serial;             //record the frame serial
+    volatile int64_t accurate_seek_vframe_pts;
+    int video_accurate_seek_req;
     struct SwsContext *img_convert_ctx;
 #ifdef FFP_SUB
     struct SwsContext *sub_convert_ctx;
 #endif
-    int eof;
-
-    char *filename;
-    int width, height, xleft, ytop;
-    int step;//for step mode
-    int step_on_seeking;//for seeking display a frame
 #if CONFIG_AVFILTER
     int vfilter_idx;
     AVFilterContext *in_video_filter;   // the first filter in the video chain
     AVFilterContext *out_video_filter;  // the last filter in the video chain
-    AVFilterContext *in_audio_filter;   // the first filter in the audio chain
-    AVFilterContext *out_audio_filter;  // the last filter in the audio chain
-    AVFilterGraph *agraph;              // audio filter graph
 #endif
 
-    SDL_cond *continue_read_thread;
-
-    /* extra fields */
-    SDL_mutex  *play_mutex; // only guard state, do not block any long operation
-    SDL_Thread *video_refresh_tid;
-    SDL_Thread _video_refresh_tid;
-
-    int buffering_on;
-    int pause_req;
-
-    int dropping_frame;
-    int is_video_high_fps; // above 30fps
-    int is_video_high_res; // above 1080p
-
-    PacketQueue *buffer_indicator_queue;
-
-    volatile int latest_video_seek_load_serial;
-    volatile int latest_audio_seek_load_serial;
-    volatile int64_t latest_seek_load_start_at;
-
-    int drop_aframe_count;
-    int drop_vframe_count;
-    
-    //record the frame serial
+    /* audio decoder */
+    int drop_aframe_count FFP_CACHELINE_ALIGNED;
     int drop_aframe_serial;
-    int drop_vframe_serial;
-    
-    int64_t accurate_seek_start_time;
-    volatile int64_t accurate_seek_vframe_pts;
     volatile int64_t accurate_seek_aframe_pts;
     int audio_accurate_seek_req;
-    int video_accurate_seek_req;
-    SDL_mutex *accurate_seek_mutex;
-    SDL_cond  *video_accurate_seek_cond;
-    SDL_cond  *audio_accurate_seek_cond;
-    volatile int initialized_decoder;
-    int seek_buffering;
-    FFSubtitle *ffSub;
-    ijk_custom_avio_protocol * ijk_io;
+    int64_t accurate_seek_start_time;
+#if CONFIG_AVFILTER
+    struct AudioParams audio_filter_src;
+    AVFilterContext *in_audio_filter;   // the first filter in the audio chain
+    AVFilterContext *out_audio_filter;  // the last filter in the audio chain
+    AVFilterGraph *agraph;              // audio filter graph
+#endif
+
+    /* queues between the threads, each with its own lock */
+    PacketQueue audioq FFP_CACHELINE_ALIGNED;
+    PacketQueue videoq FFP_CACHELINE_ALIGNED;
+    FrameQueue pictq FFP_CACHELINE_ALIGNED;
+    FrameQueue sampq FFP_CACHELINE_ALIGNED;
+    Decoder auddec FFP_CACHELINE_ALIGNED;
+    Decoder viddec FFP_CACHELINE_ALIGNED;
 } VideoState;
 
 /* options specified by the user */
@@ -484,6 +580,16 @@ typedef struct FFTrackCacheStatistic
     int64_t packets;
 } FFTrackCacheStatistic;
 
+/* per video frame distributions in FFStatistic, all in us */
+enum {
+    FFP_FRAME_HIST_DECODE_TIME = 0,     // in avcodec_send_packet/avcodec_receive_frame per frame
+    FFP_FRAME_HIST_QUEUE_WAIT,          // packet queued by read_thread until the decoder takes it
+    FFP_FRAME_HIST_DISPLAY_DELAY,       // decoded frame queued until it is displayed
+    FFP_FRAME_HIST_PRESENT_JITTER,      // display time off the frame's target time
+    FFP_FRAME_HIST_AV_SYNC_ERROR,       // displayed pts off the master clock
+    FFP_FRAME_HIST_NB
+};
+
 typedef struct FFStatistic
 {
     float vfps;
@@ -501,6 +607,9 @@ typedef struct FFStatistic
     int64_t buf_capacity;
     SDL_SpeedSampler2 tcp_read_sampler;
     int64_t latest_seek_load_duration;
+    int64_t stream_open_duration;   // ms from opening the input to stream info ready
+    int probe_cache_hit;
+    int64_t live_latency;           // ms behind the live edge, low-latency live mode only
     int64_t byte_count;
     int64_t cache_physical_pos;
     int64_t cache_file_forwards;
@@ -510,6 +619,7 @@ typedef struct FFStatistic
     int drop_frame_count;
     int decode_frame_count;
     float drop_frame_rate;
+    FFHistogram frame_hist[FFP_FRAME_HIST_NB];
 } FFStatistic;
 
 #define FFP_TCP_READ_SAMPLE_RANGE 2000
@@ -620,13 +730,13 @@ typedef struct FFPlayer {
 #ifdef FFP_MERGE
     int is_full_screen;
 #endif
-    int64_t audio_callback_time;
+    int64_t audio_callback_time FFP_CACHELINE_ALIGNED;  // audio callback
 #ifdef FFP_MERGE
     SDL_Surface *screen;
 #endif
 
     /* extra fields */
-    SDL_Aout *aout;
+    SDL_Aout *aout FFP_CACHELINE_ALIGNED;
     SDL_Vout *vout;
     struct SDL_GPU  *gpu;
     struct IJKFF_Pipeline *pipeline;
@@ -649,11 +759,14 @@ typedef struct FFPlayer {
     int first_audio_frame_rendered;
     int sync_av_start;
 
-    MessageQueue msg_queue;
+    MessageQueue msg_queue FFP_CACHELINE_ALIGNED;
 
-    int64_t playable_duration_ms;
+    int64_t playable_duration_ms FFP_CACHELINE_ALIGNED;  // read_thread
 
-    int packet_buffering;
+    /* master clock moved to the item's timeline, published by the refresh thread for lock-free position polling */
+    Clock position_clk FFP_CACHELINE_ALIGNED;
+
+    int packet_buffering FFP_CACHELINE_ALIGNED;
     int pictq_size;
     int max_fps;
     int startup_volume;
@@ -674,17 +787,25 @@ typedef struct FFPlayer {
     int soundtouch_enable;
 
     char *iformat_name;
+    char *probe_cache_dir;
+    char *probe_cache_validator;
+    char *trace_file;
+    char *mosaic_inputs;
+    int mosaic_columns;
+    int mosaic_width;
+    int mosaic_height;
+    int mosaic_benchmark;
 
     int no_time_adjust;
     double preset_5_1_center_mix_level;
 
     struct IjkMediaMeta *meta;
 
-    SDL_SpeedSampler vfps_sampler;
-    SDL_SpeedSampler vdps_sampler;
+    SDL_SpeedSampler vfps_sampler FFP_CACHELINE_ALIGNED;  // refresh thread
+    SDL_SpeedSampler vdps_sampler FFP_CACHELINE_ALIGNED;  // video decoder
 
     /* filters */
-    SDL_mutex  *vf_mutex;
+    SDL_mutex  *vf_mutex FFP_CACHELINE_ALIGNED;
     SDL_mutex  *af_mutex;
     int         vf_changed;
     int         af_changed;
@@ -695,14 +816,24 @@ typedef struct FFPlayer {
 
     void               *inject_opaque;
     void               *ijkio_inject_opaque;
-    FFStatistic         stat;
-    FFDemuxCacheControl dcc;
+    FFStatistic         stat FFP_CACHELINE_ALIGNED;
+    FFDemuxCacheControl dcc FFP_CACHELINE_ALIGNED;
 
     AVApplicationContext *app_ctx;
     IjkIOManagerContext *ijkio_manager_ctx;
+    /* set by ff_player_group.c under its link lock, read_thread holds a reference while it uses the group */
+    struct FFPlayerGroup *group;
+    void (*group_wake)(void *opaque);   // wakes read_thread of the open stream
+    void *group_wake_opaque;
 
     int enable_accurate_seek;
     int accurate_seek_timeout;
+    int enable_inbuffer_seek;
+    int back_buffer_duration_ms;
+    int back_buffer_max_bytes;
+    int live_target_latency_ms;
+    int live_max_latency_ms;
+    int live_max_catchup_rate;
     int mediacodec_sync;
     int skip_calc_frame_rate;
     int async_init_decoder;
@@ -804,6 +935,12 @@ inline static void ffp_reset_internal(FFPlayer *ffp)
     ffp->sync_av_start          = 1;
     ffp->enable_accurate_seek   = 0;
     ffp->accurate_seek_timeout  = MAX_ACCURATE_SEEK_TIMEOUT;
+    ffp->enable_inbuffer_seek   = 1;
+    ffp->back_buffer_duration_ms = 0;
+    ffp->back_buffer_max_bytes  = 0;
+    ffp->live_target_latency_ms = 0;
+    ffp->live_max_latency_ms    = 0;
+    ffp->live_max_catchup_rate  = 125;
 
     ffp->playable_duration_ms           = 0;
 
@@ -825,6 +962,14 @@ inline static void ffp_reset_internal(FFPlayer *ffp)
     ffp->soundtouch_enable              = 0; // option
 
     ffp->iformat_name                   = NULL; // option
+    ffp->probe_cache_dir                = NULL; // option
+    ffp->probe_cache_validator          = NULL; // option
+    ffp->trace_file                     = NULL; // option
+    ffp->mosaic_inputs                  = NULL; // option
+    ffp->mosaic_columns                 = 0; // option
+    ffp->mosaic_width                   = 0; // option
+    ffp->mosaic_height                  = 0; // option
+    ffp->mosaic_benchmark               = 0; // option
 
     ffp->no_time_adjust                 = 0; // option
     ffp->async_init_decoder             = 0; // option
@@ -899,9 +1044,15 @@ inline static const char *ffp_get_error_string(int error) {
 #define AVCODEC_MODULE_NAME    "avcodec"
 #define MEDIACODEC_MODULE_NAME "MediaCodec"
 
-int decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue, SDL_cond *empty_queue_cond);
+int decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue,
+                 void (*empty_queue_cb)(void *opaque), void *empty_queue_opaque);
+void decoder_signal_empty_queue(Decoder *d);
 int decoder_start(Decoder *d, int (*fn)(void *), void *arg, const char *name);
 void decoder_destroy(Decoder *d);
 void decoder_abort(Decoder *d, FrameQueue *fq);
 
+/* VideoState and FFPlayer start on a line, so their FFP_CACHELINE_ALIGNED blocks own whole lines */
+void *ffp_mallocz_cacheline(size_t size);
+void ffp_freep_cacheline(void *arg);
+
 #endif
@@ -160,6 +160,22 @@ static const AVOption ffp_context_options[] = {
         OPTION_OFFSET(sync_av_start),       OPTION_INT(1, 0, 1) },
     { "iformat",                            "force format",
         OPTION_OFFSET(iformat_name),        OPTION_STR(NULL) },
+    { "probe-cache-dir",                    "directory of cached stream info, skips find_stream_info when the input is unchanged",
+        OPTION_OFFSET(probe_cache_dir),     OPTION_STR(NULL) },
+    { "probe-cache-validator",              "application validator of the input for the probe cache, ETag or Last-Modified",
+        OPTION_OFFSET(probe_cache_validator), OPTION_STR(NULL) },
+    { "trace-file",                         "write a Chrome trace of the pipeline to this file on stop, needs FFP_TRACE",
+        OPTION_OFFSET(trace_file),          OPTION_STR(NULL) },
+    { "mosaic-inputs",                      "urls separated by '|' composited next to the video into one picture, needs the ffmpeg video decoder",
+        OPTION_OFFSET(mosaic_inputs),       OPTION_STR(NULL) },
+    { "mosaic-columns",                     "columns of the mosaic grid, 0 for a square grid",
+        OPTION_OFFSET(mosaic_columns),      OPTION_INT(0, 0, 64) },
+    { "mosaic-width",                       "width of the mosaic picture, 0 uses the video width",
+        OPTION_OFFSET(mosaic_width),        OPTION_INT(0, 0, 8192) },
+    { "mosaic-height",                      "height of the mosaic picture, 0 uses the video height",
+        OPTION_OFFSET(mosaic_height),       OPTION_INT(0, 0, 8192) },
+    { "mosaic-benchmark",                   "log decode and compose times of every mosaic tile",
+        OPTION_OFFSET(mosaic_benchmark),    OPTION_INT(0, 0, 1) },
     { "no-time-adjust",                     "return player's real time from the media stream instead of the adjusted time",
         OPTION_OFFSET(no_time_adjust),      OPTION_INT(0, 0, 1) },
     { "preset-5-1-center-mix-level",        "preset center-mix-level for 5.1 channel",
@@ -169,6 +185,18 @@ static const AVOption ffp_context_options[] = {
         OPTION_OFFSET(enable_accurate_seek),       OPTION_INT(0, 0, 1) },
     { "accurate-seek-timeout",                      "accurate seek timeout",
         OPTION_OFFSET(accurate_seek_timeout),       OPTION_INT(MAX_ACCURATE_SEEK_TIMEOUT, 0, MAX_ACCURATE_SEEK_TIMEOUT) },
+    { "enable-inbuffer-seek",                      "serve seeks that land inside the packet queues without seeking the demuxer",
+        OPTION_OFFSET(enable_inbuffer_seek),       OPTION_INT(1, 0, 1) },
+    { "back-buffer-duration-ms",                   "keep played packets of this duration for backward seeks, 0 disables",
+        OPTION_OFFSET(back_buffer_duration_ms),    OPTION_INT(0, 0, 600000) },
+    { "back-buffer-max-bytes",                     "byte limit of the back buffer on top of the max buffer size, 0 uses a quarter of it",
+        OPTION_OFFSET(back_buffer_max_bytes),      OPTION_INT(0, 0, INT_MAX) },
+    { "live-target-latency-ms",                    "low-latency live mode, catch up whenever a realtime stream is further behind its live edge, 0 disables",
+        OPTION_OFFSET(live_target_latency_ms),     OPTION_INT(0, 0, 60000) },
+    { "live-max-latency-ms",                       "skip to the newest keyframe beyond this latency, 0 uses 3x the target latency",
+        OPTION_OFFSET(live_max_latency_ms),        OPTION_INT(0, 0, 600000) },
+    { "live-max-catchup-rate",                     "highest catch-up playback rate in percent",
+        OPTION_OFFSET(live_max_catchup_rate),      OPTION_INT(125, 100, 200) },
     { "skip-calc-frame-rate",                      "don't calculate real frame rate",
         OPTION_OFFSET(skip_calc_frame_rate),       OPTION_INT(0, 0, 1) },
     { "async-init-decoder",                  "async create decoder",
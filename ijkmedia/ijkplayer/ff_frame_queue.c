@@ -153,6 +153,29 @@ Frame *frame_queue_peek_readable(FrameQueue *f)
     return &f->queue[(f->rindex + f->rindex_shown) % f->max_size];
 }
 
+Frame *frame_queue_peek_readable_timeout(FrameQueue *f, int timeout_ms)
+{
+    int64_t deadline = av_gettime_relative() + (int64_t)timeout_ms * 1000;
+    int64_t left;
+    int readable;
+
+    SDL_LockMutex(f->mutex);
+    while (f->size - f->rindex_shown <= 0 &&
+           !f->pktq->abort_request) {
+        left = deadline - av_gettime_relative();
+        if (left <= 0)
+            break;
+        SDL_CondWaitTimeout(f->cond, f->mutex, (uint32_t)((left + 999) / 1000));
+    }
+    readable = f->size - f->rindex_shown > 0;
+    SDL_UnlockMutex(f->mutex);
+
+    if (f->pktq->abort_request || !readable)
+        return NULL;
+
+    return &f->queue[(f->rindex + f->rindex_shown) % f->max_size];
+}
+
 Frame *frame_queue_peek_readable_noblock(FrameQueue *f)
 {
     SDL_LockMutex(f->mutex);
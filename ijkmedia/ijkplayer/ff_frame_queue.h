@@ -25,6 +25,8 @@ Frame *frame_queue_peek_writable_noblock(FrameQueue *f);
 Frame *frame_queue_peek_readable(FrameQueue *f);
 //return a readable frame or NULL, not wait
 Frame *frame_queue_peek_readable_noblock(FrameQueue *f);
+//wait at most timeout_ms for a readable frame, NULL on timeout or abort
+Frame *frame_queue_peek_readable_timeout(FrameQueue *f, int timeout_ms);
 int frame_queue_push(FrameQueue *f);
 int frame_queue_nb_remaining(FrameQueue *f);
 int frame_queue_is_full(FrameQueue *f);
@@ -0,0 +1,112 @@
+//
+//  ff_histogram.c
+//  IJKMediaPlayerKit
+//
+//  Log-bucketed histograms for per-frame timings.
+//
+
+#include "ff_histogram.h"
+#include <string.h>
+
+#define SUB_BUCKETS (1 << FF_HISTOGRAM_SUB_BITS)
+
+static int bucket_index(int64_t value)
+{
+    int shift;
+
+    if (value < SUB_BUCKETS)
+        return (int)value;
+    if (value >= (INT64_C(1) << (FF_HISTOGRAM_MAX_SHIFT + 1)))
+        return FF_HISTOGRAM_BUCKETS - 1;
+
+    shift = 63 - __builtin_clzll((uint64_t)value) - FF_HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << FF_HISTOGRAM_SUB_BITS) + (int)(value >> shift) - SUB_BUCKETS;
+}
+
+/* highest value that lands in bucket index */
+static int64_t bucket_value(int index)
+{
+    int shift = (index >> FF_HISTOGRAM_SUB_BITS) - 1;
+    int64_t sub = index & (SUB_BUCKETS - 1);
+
+    if (shift < 0)
+        return index;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void ff_histogram_record(FFHistogram *h, int64_t value)
+{
+    int64_t max;
+
+    if (value < 0)
+        value = 0;
+    __atomic_fetch_add(&h->counts[bucket_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, value, __ATOMIC_RELAXED);
+
+    max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (value > max &&
+           !__atomic_compare_exchange_n(&h->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void ff_histogram_reset(FFHistogram *h)
+{
+    for (int i = 0; i < FF_HISTOGRAM_BUCKETS; i++)
+        __atomic_store_n(&h->counts[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->max, 0, __ATOMIC_RELAXED);
+}
+
+/* walks the buckets once, out[i] receives percentiles[i], which must be ascending */
+static int64_t histogram_percentiles(const FFHistogram *h, const double *percentiles, int64_t *out, int nb)
+{
+    uint32_t counts[FF_HISTOGRAM_BUCKETS];
+    int64_t total = 0;
+    int64_t seen = 0;
+    int64_t max;
+    int i, k = 0;
+
+    for (i = 0; i < FF_HISTOGRAM_BUCKETS; i++) {
+        counts[i] = __atomic_load_n(&h->counts[i], __ATOMIC_RELAXED);
+        total += counts[i];
+    }
+    memset(out, 0, nb * sizeof(*out));
+    if (!total)
+        return 0;
+
+    /* the top bucket reaches past the largest value actually recorded */
+    max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    for (i = 0; i < FF_HISTOGRAM_BUCKETS && k < nb; i++) {
+        seen += counts[i];
+        while (k < nb && seen > 0 && seen >= percentiles[k] * total / 100.0) {
+            int64_t value = bucket_value(i);
+            out[k++] = value < max ? value : max;
+        }
+    }
+    return total;
+}
+
+int64_t ff_histogram_percentile(const FFHistogram *h, double percentile)
+{
+    int64_t value;
+
+    histogram_percentiles(h, &percentile, &value, 1);
+    return value;
+}
+
+void ff_histogram_snapshot(const FFHistogram *h, FFHistogramSnapshot *snapshot)
+{
+    static const double percentiles[3] = { 50, 95, 99 };
+    int64_t values[3];
+    int64_t count;
+
+    count = histogram_percentiles(h, percentiles, values, 3);
+    snapshot->count = count;
+    snapshot->p50   = values[0];
+    snapshot->p95   = values[1];
+    snapshot->p99   = values[2];
+    snapshot->max   = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    snapshot->mean  = count ? __atomic_load_n(&h->sum, __ATOMIC_RELAXED) / count : 0;
+}
@@ -0,0 +1,47 @@
+//
+//  ff_histogram.h
+//  IJKMediaPlayerKit
+//
+//  Log-bucketed histograms for per-frame timings.
+//
+
+#ifndef ff_histogram_h
+#define ff_histogram_h
+
+#include <stdint.h>
+
+/*
+ * values below 16 get a bucket each, above that every power of two is split into
+ * 16 buckets, so a percentile is off by at most 1/16 of its value.
+ * recording is a few relaxed atomic adds and never takes a lock, readers on other
+ * threads see a slightly stale but usable distribution.
+ */
+#define FF_HISTOGRAM_SUB_BITS   4
+#define FF_HISTOGRAM_MAX_SHIFT  30      // values are clamped to 2^31 - 1
+#define FF_HISTOGRAM_BUCKETS    ((FF_HISTOGRAM_MAX_SHIFT - FF_HISTOGRAM_SUB_BITS + 2) << FF_HISTOGRAM_SUB_BITS)
+
+typedef struct FFHistogram {
+    uint32_t counts[FF_HISTOGRAM_BUCKETS];
+    int64_t count;
+    int64_t sum;
+    int64_t max;
+} FFHistogram;
+
+typedef struct FFHistogramSnapshot {
+    int64_t count;
+    int64_t mean;
+    int64_t p50;
+    int64_t p95;
+    int64_t p99;
+    int64_t max;
+} FFHistogramSnapshot;
+
+/* negative values count as 0 */
+void    ff_histogram_record(FFHistogram *h, int64_t value);
+void    ff_histogram_reset(FFHistogram *h);
+/* percentile in 0~100, the highest value of the bucket it falls into, 0 when empty */
+int64_t ff_histogram_percentile(const FFHistogram *h, double percentile);
+/* p50, p95 and p99 from a single pass */
+void    ff_histogram_snapshot(const FFHistogram *h, FFHistogramSnapshot *snapshot);
+
+#endif /* ff_histogram_h */
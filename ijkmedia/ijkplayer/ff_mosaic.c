@@ -0,0 +1,560 @@
+//
+//  ff_mosaic.c
+//  IJKMediaPlayerKit
+//
+//  Extra inputs decoded on a pool of their own and composited into the pictures of one player.
+//
+
+#include "ff_mosaic.h"
+#include "ff_histogram.h"
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/avstring.h"
+#include "libavutil/hwcontext.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/time.h"
+#include "libswscale/swscale.h"
+#include "ijksdl/ijksdl_mutex.h"
+#include "ijksdl/ffmpeg/ijksdl_image_convert.h"
+#include "ijkavutil/ijkthreadpool.h"
+#include <inttypes.h>
+#include <math.h>
+
+#define MOSAIC_MAX_TILES            64
+#define MOSAIC_DEFAULT_WIDTH        1280
+#define MOSAIC_DEFAULT_HEIGHT       720
+// a seekable tile further off the mosaic time than this seeks instead of decoding there
+#define MOSAIC_RESYNC_THRESHOLD     2.0
+#define MOSAIC_BENCHMARK_INTERVAL   (5 * 1000000)
+
+enum {
+    TILE_OPENING,
+    TILE_READY,
+    TILE_FAILED,
+};
+
+typedef struct FFMosaicTile {
+    FFMosaic *m;
+    int index;
+    char *url;
+
+    /* input side, only touched by the decode task of the tile */
+    AVFormatContext *ic;
+    AVCodecContext *avctx;
+    int stream;
+    AVRational time_base;
+    int64_t start_pts;
+    AVPacket *pkt;
+    AVFrame *next;          // decoded but ahead of the target
+    int has_next;
+    double next_time;
+    double shown_time;
+    int started;
+    int eof;
+    int state;
+
+    /* compose side */
+    IjkThreadPoolFuture *decode_task;
+    IjkThreadPoolFuture *scale_task;
+    double target;          // mosaic time the decode task catches up to
+    AVFrame *src;
+    struct SwsContext *sws;
+    int x, y, width, height;
+
+    SDL_mutex *mutex;
+    AVFrame *shown;         // newest picture at or before the target, guarded by mutex
+
+    FFHistogram decode_hist;    // us to read and decode one picture
+    FFHistogram scale_hist;     // us to scale it into the mosaic
+} FFMosaicTile;
+
+struct FFMosaic {
+    FFMosaicTile *tiles;
+    int nb_tiles;
+    int width;
+    int height;
+    int benchmark;
+    volatile int abort_request;
+
+    // one worker per input, a tile decode blocks in its reads for as long as the tile lags
+    IjkThreadPoolContext *decode_pool;
+    AVBufferPool *pool;
+    AVFrame *canvas;        // picture being composed
+    double start_pts;       // pts of the player's video at mosaic time 0
+    double time;
+    int64_t last_report;
+    FFHistogram compose_hist;
+};
+
+static int tile_interrupt_cb(void *opaque)
+{
+    FFMosaic *m = opaque;
+    return m->abort_request;
+}
+
+static int tile_open(FFMosaicTile *t)
+{
+    FFMosaic *m = t->m;
+    const AVCodec *codec = NULL;
+    AVDictionary *opts = NULL;
+    AVStream *st;
+    int ret;
+
+    t->ic = avformat_alloc_context();
+    if (!t->ic)
+        return AVERROR(ENOMEM);
+    t->ic->interrupt_callback.callback = tile_interrupt_cb;
+    t->ic->interrupt_callback.opaque   = m;
+    if ((ret = avformat_open_input(&t->ic, t->url, NULL, NULL)) < 0)
+        return ret;
+    if ((ret = avformat_find_stream_info(t->ic, NULL)) < 0)
+        return ret;
+    if ((ret = av_find_best_stream(t->ic, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0)) < 0)
+        return ret;
+    t->stream = ret;
+    for (int i = 0; i < t->ic->nb_streams; i++) {
+        if (i != t->stream)
+            t->ic->streams[i]->discard = AVDISCARD_ALL;
+    }
+    st = t->ic->streams[t->stream];
+
+    t->avctx = avcodec_alloc_context3(codec);
+    if (!t->avctx)
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_parameters_to_context(t->avctx, st->codecpar)) < 0)
+        return ret;
+    t->avctx->pkt_timebase = st->time_base;
+    // a tile at half the size of its input or less needs no more than half the resolution
+    if (codec->max_lowres > 0 && t->width * 2 <= st->codecpar->width && t->height * 2 <= st->codecpar->height)
+        t->avctx->lowres = 1;
+    // the pool spreads the tiles over the cores, frame threads would only add latency
+    av_dict_set(&opts, "threads", "1", 0);
+    ret = avcodec_open2(t->avctx, codec, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    t->time_base = st->time_base;
+    if (st->start_time != AV_NOPTS_VALUE)
+        t->start_pts = st->start_time;
+    else if (t->ic->start_time != AV_NOPTS_VALUE)
+        t->start_pts = av_rescale_q(t->ic->start_time, AV_TIME_BASE_Q, st->time_base);
+    else
+        t->start_pts = AV_NOPTS_VALUE;
+
+    t->pkt  = av_packet_alloc();
+    t->next = av_frame_alloc();
+    if (!t->pkt || !t->next)
+        return AVERROR(ENOMEM);
+
+    av_log(NULL, AV_LOG_INFO, "mosaic: tile %d %s %dx%d%s\n", t->index, codec->name,
+           st->codecpar->width, st->codecpar->height, t->avctx->lowres ? " lowres" : "");
+    return 0;
+}
+
+static int tile_decode_frame(FFMosaicTile *t, AVFrame *frame)
+{
+    int ret;
+
+    for (;;) {
+        ret = avcodec_receive_frame(t->avctx, frame);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+
+        ret = av_read_frame(t->ic, t->pkt);
+        if (ret == AVERROR_EOF) {
+            ret = avcodec_send_packet(t->avctx, NULL);
+        } else if (ret >= 0) {
+            if (t->pkt->stream_index == t->stream)
+                ret = avcodec_send_packet(t->avctx, t->pkt);
+            av_packet_unref(t->pkt);
+        }
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static int tile_is_seekable(FFMosaicTile *t)
+{
+    return t->ic->pb && (t->ic->pb->seekable & AVIO_SEEKABLE_NORMAL) &&
+           t->ic->duration != AV_NOPTS_VALUE && t->start_pts != AV_NOPTS_VALUE;
+}
+
+static void tile_resync(FFMosaicTile *t, double target)
+{
+    int64_t ts = t->start_pts + (int64_t)(target / av_q2d(t->time_base));
+
+    // the keyframe before target, the frames up to it are decoded and dropped
+    if (avformat_seek_file(t->ic, t->stream, INT64_MIN, ts, ts, 0) < 0)
+        return;
+    avcodec_flush_buffers(t->avctx);
+    av_frame_unref(t->next);
+    t->has_next   = 0;
+    t->eof        = 0;
+    t->shown_time = target;
+}
+
+/* decode up to the picture following the target, shown is the one before */
+static void tile_decode_run(void *in, void *out)
+{
+    FFMosaicTile *t = in;
+    FFMosaic *m = t->m;
+    double target = t->target;
+    int ret;
+
+    if (t->state == TILE_OPENING) {
+        if ((ret = tile_open(t)) < 0) {
+            if (!m->abort_request)
+                av_log(NULL, AV_LOG_WARNING, "mosaic: tile %d %s could not be opened: %s\n", t->index, t->url, av_err2str(ret));
+            t->state = TILE_FAILED;
+            return;
+        }
+        t->state = TILE_READY;
+    }
+    if (t->state != TILE_READY)
+        return;
+
+    if (t->started && fabs(target - t->shown_time) > MOSAIC_RESYNC_THRESHOLD && tile_is_seekable(t))
+        tile_resync(t, target);
+
+    while (!m->abort_request) {
+        if (!t->has_next) {
+            int64_t start, ts;
+
+            if (t->eof)
+                break;
+            start = av_gettime_relative();
+            ret = tile_decode_frame(t, t->next);
+            if (ret < 0) {
+                if (ret != AVERROR_EOF && !m->abort_request)
+                    av_log(NULL, AV_LOG_WARNING, "mosaic: tile %d stopped: %s\n", t->index, av_err2str(ret));
+                t->eof = 1;
+                break;
+            }
+            ff_histogram_record(&t->decode_hist, av_gettime_relative() - start);
+
+            ts = t->next->best_effort_timestamp;
+            if (t->start_pts == AV_NOPTS_VALUE)
+                t->start_pts = ts;
+            if (ts != AV_NOPTS_VALUE && t->start_pts != AV_NOPTS_VALUE)
+                t->next_time = (ts - t->start_pts) * av_q2d(t->time_base);
+            else
+                t->next_time = t->shown_time;
+            t->has_next = 1;
+        }
+        // the first picture shows at once, so a tile ahead of the mosaic isn't black
+        if (t->started && t->next_time > target)
+            break;
+
+        SDL_LockMutex(t->mutex);
+        av_frame_unref(t->shown);
+        av_frame_move_ref(t->shown, t->next);
+        SDL_UnlockMutex(t->mutex);
+        t->shown_time = t->next_time;
+        t->has_next   = 0;
+        t->started    = 1;
+    }
+}
+
+static void tile_fill_black(uint8_t **dst, const int *dst_linesize, int width, int height)
+{
+    for (int y = 0; y < height; y++)
+        memset(dst[0] + y * dst_linesize[0], 16, width);
+    for (int y = 0; y < height / 2; y++) {
+        memset(dst[1] + y * dst_linesize[1], 128, width / 2);
+        memset(dst[2] + y * dst_linesize[2], 128, width / 2);
+    }
+}
+
+/* each tile owns a rectangle of the canvas, so tiles scale in parallel without locking */
+static void tile_scale_run(void *in, void *out)
+{
+    FFMosaicTile *t = in;
+    AVFrame *canvas = t->m->canvas;
+    AVFrame *src = t->src;
+    uint8_t *dst[4] = {
+        canvas->data[0] + t->y * canvas->linesize[0] + t->x,
+        canvas->data[1] + t->y / 2 * canvas->linesize[1] + t->x / 2,
+        canvas->data[2] + t->y / 2 * canvas->linesize[2] + t->x / 2,
+        NULL
+    };
+    int64_t start = av_gettime_relative();
+
+    if (!src->buf[0]) {
+        tile_fill_black(dst, canvas->linesize, t->width, t->height);
+        return;
+    }
+
+    // libyuv first, like SDL_VoutConvertFrame
+    if (ijk_image_scale(src->width, src->height, src->format, (const uint8_t **)src->data, src->linesize,
+                        t->width, t->height, dst, canvas->linesize)) {
+        t->sws = sws_getCachedContext(t->sws, src->width, src->height, src->format,
+                                      t->width, t->height, AV_PIX_FMT_YUV420P,
+                                      SWS_FAST_BILINEAR, NULL, NULL, NULL);
+        if (!t->sws) {
+            tile_fill_black(dst, canvas->linesize, t->width, t->height);
+            return;
+        }
+        sws_scale(t->sws, (const uint8_t * const *)src->data, src->linesize, 0, src->height,
+                  dst, canvas->linesize);
+    }
+    ff_histogram_record(&t->scale_hist, av_gettime_relative() - start);
+}
+
+static void mosaic_layout(FFMosaic *m, int columns)
+{
+    int rows;
+
+    if (columns <= 0)
+        columns = (int)ceil(sqrt(m->nb_tiles));
+    columns = FFMIN(columns, m->nb_tiles);
+    rows    = (m->nb_tiles + columns - 1) / columns;
+
+    for (int i = 0; i < m->nb_tiles; i++) {
+        FFMosaicTile *t = &m->tiles[i];
+        int c = i % columns;
+        int r = i / columns;
+        int x1 = ((c + 1) * m->width / columns) & ~1;
+        int y1 = ((r + 1) * m->height / rows) & ~1;
+
+        t->x      = (c * m->width / columns) & ~1;
+        t->y      = (r * m->height / rows) & ~1;
+        t->width  = x1 - t->x;
+        t->height = y1 - t->y;
+    }
+}
+
+static void mosaic_report(FFMosaic *m)
+{
+    FFHistogramSnapshot compose, decode, scale;
+
+    ff_histogram_snapshot(&m->compose_hist, &compose);
+    av_log(NULL, AV_LOG_INFO, "mosaic: %d tiles %dx%d, %"PRId64" pictures, compose mean %"PRId64"us p95 %"PRId64"us max %"PRId64"us\n",
+           m->nb_tiles, m->width, m->height, compose.count, compose.mean, compose.p95, compose.max);
+    for (int i = 0; i < m->nb_tiles; i++) {
+        FFMosaicTile *t = &m->tiles[i];
+
+        ff_histogram_snapshot(&t->decode_hist, &decode);
+        ff_histogram_snapshot(&t->scale_hist, &scale);
+        av_log(NULL, AV_LOG_INFO, "mosaic: tile %d %dx%d, decode mean %"PRId64"us p95 %"PRId64"us, scale mean %"PRId64"us p95 %"PRId64"us\n",
+               i, t->width, t->height, decode.mean, decode.p95, scale.mean, scale.p95);
+    }
+}
+
+FFMosaic *ff_mosaic_create(const char *inputs, int columns, int width, int height, int benchmark)
+{
+    FFMosaic *m;
+    char *urls, *url, *saveptr = NULL;
+    int nb_inputs = 0;
+
+    if (!inputs)
+        return NULL;
+    urls = av_strdup(inputs);
+    m = av_mallocz(sizeof(FFMosaic));
+    if (!urls || !m)
+        goto fail;
+
+    m->tiles = av_calloc(MOSAIC_MAX_TILES, sizeof(FFMosaicTile));
+    if (!m->tiles)
+        goto fail;
+    m->nb_tiles = 1;
+    for (url = av_strtok(urls, "|", &saveptr); url; url = av_strtok(NULL, "|", &saveptr)) {
+        if (m->nb_tiles == MOSAIC_MAX_TILES) {
+            av_log(NULL, AV_LOG_WARNING, "mosaic: more than %d tiles, ignoring %s\n", MOSAIC_MAX_TILES, url);
+            continue;
+        }
+        m->tiles[m->nb_tiles].url = av_strdup(url);
+        if (!m->tiles[m->nb_tiles].url)
+            goto fail;
+        m->nb_tiles++;
+        nb_inputs++;
+    }
+    av_freep(&urls);
+
+    for (int i = 0; i < m->nb_tiles; i++) {
+        FFMosaicTile *t = &m->tiles[i];
+
+        t->m         = m;
+        t->index     = i;
+        t->state     = t->url ? TILE_OPENING : TILE_READY;
+        t->start_pts = AV_NOPTS_VALUE;
+        t->mutex     = SDL_CreateMutex();
+        t->shown     = av_frame_alloc();
+        t->src       = av_frame_alloc();
+        if (!t->mutex || !t->shown || !t->src)
+            goto fail;
+    }
+
+    m->width     = (width  > 0 ? width  : MOSAIC_DEFAULT_WIDTH)  & ~1;
+    m->height    = (height > 0 ? height : MOSAIC_DEFAULT_HEIGHT) & ~1;
+    m->benchmark = benchmark;
+    m->start_pts = NAN;
+    m->pool      = av_buffer_pool_init(av_image_get_buffer_size(AV_PIX_FMT_YUV420P, m->width, m->height, 32), NULL);
+    if (!m->pool)
+        goto fail;
+    if (nb_inputs > 0 && !(m->decode_pool = ijk_threadpool_create(nb_inputs, 4, 0)))
+        goto fail;
+    mosaic_layout(m, columns);
+    m->last_report = av_gettime_relative();
+
+    av_log(NULL, AV_LOG_INFO, "mosaic: %d inputs next to the player's video, %dx%d\n", nb_inputs, m->width, m->height);
+    return m;
+fail:
+    av_free(urls);
+    ff_mosaic_destroyp(&m);
+    return NULL;
+}
+
+void ff_mosaic_destroyp(FFMosaic **pm)
+{
+    FFMosaic *m;
+
+    if (!pm || !*pm)
+        return;
+    m = *pm;
+
+    m->abort_request = 1;
+    if (m->tiles) {
+        for (int i = 0; i < m->nb_tiles; i++) {
+            FFMosaicTile *t = &m->tiles[i];
+
+            if (t->decode_task) {
+                ijk_threadpool_future_cancel(t->decode_task);
+                ijk_threadpool_future_wait(t->decode_task, -1);
+                ijk_threadpool_future_releasep(&t->decode_task);
+            }
+        }
+        if (m->decode_pool)
+            ijk_threadpool_destroy(m->decode_pool, IJK_IMMEDIATE_SHUTDOWN);
+        if (m->benchmark)
+            mosaic_report(m);
+
+        for (int i = 0; i < m->nb_tiles; i++) {
+            FFMosaicTile *t = &m->tiles[i];
+
+            avcodec_free_context(&t->avctx);
+            avformat_close_input(&t->ic);
+            av_packet_free(&t->pkt);
+            av_frame_free(&t->next);
+            av_frame_free(&t->shown);
+            av_frame_free(&t->src);
+            sws_freeContext(t->sws);
+            SDL_DestroyMutexP(&t->mutex);
+            av_freep(&t->url);
+        }
+        av_freep(&m->tiles);
+    }
+    av_buffer_pool_uninit(&m->pool);
+    av_freep(pm);
+}
+
+void ff_mosaic_get_size(FFMosaic *m, int *width, int *height)
+{
+    *width  = m->width;
+    *height = m->height;
+}
+
+/* keeps one decode task per tile in flight, chasing the newest mosaic time */
+static void mosaic_schedule_decode(FFMosaic *m, FFMosaicTile *t)
+{
+    if (t->decode_task) {
+        int state = ijk_threadpool_future_state(t->decode_task);
+        if (state != IJK_THREADPOOL_TASK_DONE && state != IJK_THREADPOOL_TASK_CANCELLED)
+            return;
+        ijk_threadpool_future_releasep(&t->decode_task);
+    }
+    if (t->state == TILE_FAILED)
+        return;
+
+    t->target = m->time;
+    // opens and reads block on the network, so decodes stay off the shared pool
+    ijk_threadpool_submit(m->decode_pool, tile_decode_run, t, NULL,
+                          IJK_THREADPOOL_PRIORITY_BACKGROUND, &t->decode_task);
+}
+
+static int mosaic_get_canvas(FFMosaic *m, AVFrame *frame, AVFrame *out)
+{
+    int ret;
+
+    if ((ret = av_frame_copy_props(out, frame)) < 0)
+        return ret;
+    out->buf[0] = av_buffer_pool_get(m->pool);
+    if (!out->buf[0])
+        return AVERROR(ENOMEM);
+    ret = av_image_fill_arrays(out->data, out->linesize, out->buf[0]->data,
+                               AV_PIX_FMT_YUV420P, m->width, m->height, 32);
+    if (ret < 0)
+        return ret;
+    out->extended_data       = out->data;
+    out->format              = AV_PIX_FMT_YUV420P;
+    out->width               = m->width;
+    out->height              = m->height;
+    out->sample_aspect_ratio = (AVRational){1, 1};
+    out->color_range         = AVCOL_RANGE_MPEG;
+    return 0;
+}
+
+int ff_mosaic_compose(FFMosaic *m, AVFrame *frame, double pts, AVFrame *out)
+{
+    IjkThreadPoolContext *pool = ijk_threadpool_shared();
+    FFMosaicTile *main_tile = &m->tiles[0];
+    int64_t start = av_gettime_relative();
+    int ret;
+
+    if (!isnan(pts)) {
+        if (isnan(m->start_pts))
+            m->start_pts = pts;
+        m->time = pts - m->start_pts;
+    }
+
+    if ((ret = mosaic_get_canvas(m, frame, out)) < 0) {
+        av_frame_unref(out);
+        return ret;
+    }
+    m->canvas = out;
+
+    if (frame->hw_frames_ctx)
+        ret = av_hwframe_transfer_data(main_tile->src, frame, 0);
+    else
+        ret = av_frame_ref(main_tile->src, frame);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_WARNING, "mosaic: player picture unusable: %s\n", av_err2str(ret));
+
+    for (int i = 1; i < m->nb_tiles; i++) {
+        FFMosaicTile *t = &m->tiles[i];
+
+        mosaic_schedule_decode(m, t);
+        SDL_LockMutex(t->mutex);
+        if (t->shown->buf[0])
+            av_frame_ref(t->src, t->shown);
+        SDL_UnlockMutex(t->mutex);
+
+        if (ijk_threadpool_submit(pool, tile_scale_run, t, NULL,
+                                  IJK_THREADPOOL_PRIORITY_CRITICAL, &t->scale_task))
+            tile_scale_run(t, NULL);
+    }
+    tile_scale_run(main_tile, NULL);
+
+    // a scale task no worker picked up yet runs here, workers blocked in reads can't stall compose
+    for (int i = 1; i < m->nb_tiles; i++) {
+        FFMosaicTile *t = &m->tiles[i];
+
+        if (!t->scale_task)
+            continue;
+        if (ijk_threadpool_future_cancel(t->scale_task) == IJK_THREADPOOL_TASK_CANCELLED)
+            tile_scale_run(t, NULL);
+        else
+            ijk_threadpool_future_wait(t->scale_task, -1);
+        ijk_threadpool_future_releasep(&t->scale_task);
+    }
+    for (int i = 0; i < m->nb_tiles; i++)
+        av_frame_unref(m->tiles[i].src);
+    m->canvas = NULL;
+
+    ff_histogram_record(&m->compose_hist, av_gettime_relative() - start);
+    if (m->benchmark && av_gettime_relative() - m->last_report >= MOSAIC_BENCHMARK_INTERVAL) {
+        m->last_report = av_gettime_relative();
+        mosaic_report(m);
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+//
+//  ff_mosaic.h
+//  IJKMediaPlayerKit
+//
+//  Extra inputs decoded on the shared thread pool and composited into the pictures of one player.
+//
+
+#ifndef ff_mosaic_h
+#define ff_mosaic_h
+
+typedef struct AVFrame AVFrame;
+typedef struct FFMosaic FFMosaic;
+
+/*
+ * inputs are the urls of the other tiles separated by '|', tile 0 is the player's own
+ * video. columns 0 lays the tiles out in a square grid of width x height. Inputs open
+ * on the shared thread pool, a tile stays black until it has a picture.
+ * benchmark logs the decode and compose times of every tile every few seconds.
+ */
+FFMosaic *ff_mosaic_create(const char *inputs, int columns, int width, int height, int benchmark);
+void ff_mosaic_destroyp(FFMosaic **pm);
+
+void ff_mosaic_get_size(FFMosaic *m, int *width, int *height);
+
+/*
+ * scales frame and the newest picture of every other tile at pts into out, a pooled
+ * yuv420p picture with the timing of frame. Compose never waits for a decode, a tile
+ * behind pts shows its last picture and catches up on the pool meanwhile.
+ */
+int ff_mosaic_compose(FFMosaic *m, AVFrame *frame, double pts, AVFrame *out);
+
+#endif /* ff_mosaic_h */
@@ -6,6 +6,7 @@
 //
 
 #include "ff_packet_list.h"
+#include "ff_trace.h"
 
 int packet_queue_put_private(PacketQueue *q, AVPacket *pkt)
 {
@@ -20,6 +21,7 @@ int packet_queue_put_private(PacketQueue *q, AVPacket *pkt)
     }
     pkt1.pkt = pkt;
     pkt1.serial = q->serial;
+    pkt1.put_time = av_gettime_relative();
     ret = av_fifo_write(q->pkt_list, &pkt1, 1);
     if (ret < 0)
         return ret;
@@ -44,9 +46,11 @@ int packet_queue_put(PacketQueue *q, AVPacket *pkt)
     }
     av_packet_move_ref(pkt1, pkt);
 
+    FFTRACE_BEGIN("packet_queue_put");
     SDL_LockMutex(q->mutex);
     ret = packet_queue_put_private(q, pkt1);
     SDL_UnlockMutex(q->mutex);
+    FFTRACE_END("packet_queue_put");
 
     if (ret < 0)
         av_packet_free(&pkt1);
@@ -60,6 +64,66 @@ int packet_queue_put_nullpacket(PacketQueue *q, AVPacket *pkt, int stream_index)
     return packet_queue_put(q, pkt);
 }
 
+/* caller holds q->mutex */
+static void back_list_trim_l(PacketQueue *q)
+{
+    MyAVPacketList pkt1;
+
+    while ((q->back_size > q->back_max_size || q->back_duration > q->back_max_duration) &&
+           av_fifo_read(q->back_list, &pkt1, 1) >= 0) {
+        q->back_nb_packets--;
+        q->back_size -= pkt1.pkt->size + sizeof(pkt1);
+        q->back_duration -= FFMAX(pkt1.pkt->duration, MIN_PKT_DURATION);
+        av_packet_free(&pkt1.pkt);
+    }
+}
+
+/* caller holds q->mutex, takes ownership of pkt1->pkt */
+static void back_list_put_l(PacketQueue *q, MyAVPacketList *pkt1)
+{
+    if (!q->back_list || !pkt1->pkt->data || av_fifo_write(q->back_list, pkt1, 1) < 0) {
+        av_packet_free(&pkt1->pkt);
+        return;
+    }
+    q->back_nb_packets++;
+    q->back_size += pkt1->pkt->size + sizeof(*pkt1);
+    q->back_duration += FFMAX(pkt1->pkt->duration, MIN_PKT_DURATION);
+}
+
+static void back_list_clear_l(PacketQueue *q)
+{
+    MyAVPacketList pkt1;
+
+    while (q->back_list && av_fifo_read(q->back_list, &pkt1, 1) >= 0)
+        av_packet_free(&pkt1.pkt);
+    q->back_nb_packets = 0;
+    q->back_size = 0;
+    q->back_duration = 0;
+}
+
+int packet_queue_set_back_buffer(PacketQueue *q, int64_t max_duration, int max_size)
+{
+    int ret = 0;
+
+    SDL_LockMutex(q->mutex);
+    if (max_duration > 0 && max_size > 0) {
+        if (!q->back_list)
+            q->back_list = av_fifo_alloc2(50, sizeof(MyAVPacketList), AV_FIFO_FLAG_AUTO_GROW);
+        if (q->back_list) {
+            q->back_max_duration = max_duration;
+            q->back_max_size     = max_size;
+            back_list_trim_l(q);
+        } else {
+            ret = AVERROR(ENOMEM);
+        }
+    } else if (q->back_list) {
+        back_list_clear_l(q);
+        av_fifo_freep2(&q->back_list);
+    }
+    SDL_UnlockMutex(q->mutex);
+    return ret;
+}
+
 /* packet queue handling */
 int packet_queue_init(PacketQueue *q)
 {
@@ -82,9 +146,38 @@ int packet_queue_init(PacketQueue *q)
     return 0;
 }
 
+/* caller holds q->mutex */
+static int low_water_reached_l(PacketQueue *q)
+{
+    return (q->low_water_packets >= 0 && q->nb_packets <= q->low_water_packets) ||
+           (q->low_water_size >= 0 && q->size <= q->low_water_size);
+}
+
+void packet_queue_set_low_water_cb(PacketQueue *q, void (*cb)(void *opaque), void *opaque)
+{
+    SDL_LockMutex(q->mutex);
+    q->low_water_cb     = cb;
+    q->low_water_opaque = opaque;
+    SDL_UnlockMutex(q->mutex);
+}
+
+int packet_queue_arm_low_water(PacketQueue *q, int nb_packets, int size)
+{
+    int reached;
+
+    SDL_LockMutex(q->mutex);
+    q->low_water_packets = nb_packets;
+    q->low_water_size    = size;
+    reached = low_water_reached_l(q);
+    q->low_water_armed   = !reached && q->low_water_cb;
+    SDL_UnlockMutex(q->mutex);
+    return reached;
+}
+
 void packet_queue_flush(PacketQueue *q)
 {
     MyAVPacketList pkt1;
+    int low_water;
 
     SDL_LockMutex(q->mutex);
     
@@ -95,13 +188,21 @@ void packet_queue_flush(PacketQueue *q)
     q->size = 0;
     q->duration = 0;
     q->serial++;
+    /* whatever is demuxed next does not continue the played packets */
+    back_list_clear_l(q);
+    low_water = q->low_water_armed;
+    q->low_water_armed = 0;
     SDL_UnlockMutex(q->mutex);
+
+    if (low_water)
+        q->low_water_cb(q->low_water_opaque);
 }
 
 void packet_queue_destroy(PacketQueue *q)
 {
     packet_queue_flush(q);
     av_fifo_freep2(&q->pkt_list);
+    av_fifo_freep2(&q->back_list);
     SDL_DestroyMutex(q->mutex);
     SDL_DestroyCond(q->cond);
 }
@@ -129,8 +230,10 @@ void packet_queue_start(PacketQueue *q)
 int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block, int *serial)
 {
     MyAVPacketList pkt1;
+    int low_water = 0;
     int ret;
 
+    FFTRACE_BEGIN("packet_queue_get");
     SDL_LockMutex(q->mutex);
 
     for (;;) {
@@ -143,10 +246,21 @@ int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block, int *serial)
             q->nb_packets--;
             q->size -= pkt1.pkt->size + sizeof(pkt1);
             q->duration -= FFMAX(pkt1.pkt->duration, MIN_PKT_DURATION);
-            av_packet_move_ref(pkt, pkt1.pkt);
             if (serial)
                 *serial = pkt1.serial;
-            av_packet_free(&pkt1.pkt);
+            if (q->wait_histogram && pkt1.pkt->data)
+                ff_histogram_record(q->wait_histogram, av_gettime_relative() - pkt1.put_time);
+            if (q->back_list && pkt1.pkt->data && av_packet_ref(pkt, pkt1.pkt) >= 0) {
+                back_list_put_l(q, &pkt1);
+                back_list_trim_l(q);
+            } else {
+                av_packet_move_ref(pkt, pkt1.pkt);
+                av_packet_free(&pkt1.pkt);
+            }
+            if (q->low_water_armed && low_water_reached_l(q)) {
+                q->low_water_armed = 0;
+                low_water = 1;
+            }
             ret = 1;
             break;
         } else if (!block) {
@@ -157,5 +271,135 @@ int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block, int *serial)
         }
     }
     SDL_UnlockMutex(q->mutex);
+    FFTRACE_END("packet_queue_get");
+
+    if (low_water)
+        q->low_water_cb(q->low_water_opaque);
     return ret;
 }
+
+static int64_t packet_time(const AVPacket *pkt, AVRational time_base)
+{
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    if (ts == AV_NOPTS_VALUE)
+        return AV_NOPTS_VALUE;
+    return av_rescale_q(ts, time_base, AV_TIME_BASE_Q);
+}
+
+/* caller holds q->mutex, index runs over the played packets first, then the queued ones */
+static int packet_queue_peek_l(PacketQueue *q, int index, MyAVPacketList *pkt1)
+{
+    int back_nb = q->back_list ? (int)av_fifo_can_read(q->back_list) : 0;
+
+    if (index < back_nb)
+        return av_fifo_peek(q->back_list, pkt1, 1, index);
+    return av_fifo_peek(q->pkt_list, pkt1, 1, index - back_nb);
+}
+
+/* caller holds q->mutex, target and *seek_time are in AV_TIME_BASE */
+int packet_queue_find_seek_point_l(PacketQueue *q, AVRational time_base, int64_t target, int key_only, int64_t *seek_time)
+{
+    MyAVPacketList pkt1;
+    int64_t max_time = AV_NOPTS_VALUE;
+    int back_nb = q->back_list ? (int)av_fifo_can_read(q->back_list) : 0;
+    int nb_entries = back_nb + (int)av_fifo_can_read(q->pkt_list);
+    int found = -1;
+
+    for (int i = 0; i < nb_entries; i++) {
+        int64_t t;
+
+        if (packet_queue_peek_l(q, i, &pkt1) < 0)
+            break;
+        if (!pkt1.pkt->data || (i >= back_nb && pkt1.serial != q->serial))
+            continue;
+        t = packet_time(pkt1.pkt, time_base);
+        if (t == AV_NOPTS_VALUE)
+            continue;
+        if (max_time == AV_NOPTS_VALUE || t > max_time)
+            max_time = t;
+
+        if (key_only) {
+            /* last keyframe at or before target, in decode order */
+            if ((pkt1.pkt->flags & AV_PKT_FLAG_KEY) && t <= target) {
+                found = i;
+                *seek_time = t;
+            }
+        } else if (found < 0) {
+            /* first packet still playing at target */
+            int64_t end = t + av_rescale_q(pkt1.pkt->duration, time_base, AV_TIME_BASE_Q);
+            if (end > target) {
+                found = i;
+                *seek_time = t;
+            }
+        }
+    }
+
+    /* the queue must reach the target, otherwise decoding would run dry right after the seek */
+    if (found < 0 || max_time == AV_NOPTS_VALUE || max_time < target)
+        return -1;
+    return found;
+}
+
+/*
+ * caller holds q->mutex, make the entry found by packet_queue_find_seek_point_l()
+ * the head of the queue and start a new serial: skipped packets become played
+ * ones, played packets from index on are queued again
+ */
+int packet_queue_restart_at_l(PacketQueue *q, int index)
+{
+    MyAVPacketList pkt1;
+    int back_nb = q->back_list ? (int)av_fifo_can_read(q->back_list) : 0;
+    int nb_entries = (int)av_fifo_can_read(q->pkt_list);
+    int64_t now = av_gettime_relative();
+
+    if (index < back_nb) {
+        AVFifo *pkt_list = av_fifo_alloc2(back_nb - index + nb_entries, sizeof(MyAVPacketList), AV_FIFO_FLAG_AUTO_GROW);
+        if (!pkt_list)
+            return AVERROR(ENOMEM);
+
+        q->serial++;
+        for (int i = 0; i < back_nb; i++) {
+            av_fifo_read(q->back_list, &pkt1, 1);
+            if (i < index) {
+                av_fifo_write(q->back_list, &pkt1, 1);
+                continue;
+            }
+            q->back_nb_packets--;
+            q->back_size -= pkt1.pkt->size + sizeof(pkt1);
+            q->back_duration -= FFMAX(pkt1.pkt->duration, MIN_PKT_DURATION);
+            q->nb_packets++;
+            q->size += pkt1.pkt->size + sizeof(pkt1);
+            q->duration += FFMAX(pkt1.pkt->duration, MIN_PKT_DURATION);
+            pkt1.serial = q->serial;
+            pkt1.put_time = now;
+            av_fifo_write(pkt_list, &pkt1, 1);
+        }
+        while (av_fifo_read(q->pkt_list, &pkt1, 1) >= 0) {
+            pkt1.serial = q->serial;
+            av_fifo_write(pkt_list, &pkt1, 1);
+        }
+        av_fifo_freep2(&q->pkt_list);
+        q->pkt_list = pkt_list;
+    } else {
+        int count = index - back_nb;
+
+        q->serial++;
+        for (int i = 0; i < nb_entries; i++) {
+            if (av_fifo_read(q->pkt_list, &pkt1, 1) < 0)
+                break;
+            if (i < count) {
+                q->nb_packets--;
+                q->size -= pkt1.pkt->size + sizeof(pkt1);
+                q->duration -= FFMAX(pkt1.pkt->duration, MIN_PKT_DURATION);
+                back_list_put_l(q, &pkt1);
+            } else {
+                pkt1.serial = q->serial;
+                av_fifo_write(q->pkt_list, &pkt1, 1);
+            }
+        }
+        if (q->back_list)
+            back_list_trim_l(q);
+    }
+    SDL_CondSignal(q->cond);
+    return 0;
+}
@@ -20,5 +20,16 @@ void packet_queue_destroy(PacketQueue *q);
 void packet_queue_abort(PacketQueue *q);
 void packet_queue_start(PacketQueue *q);
 int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block, int *serial);
+/* keep played packets for backward seeks, max_duration in stream time base, 0 disables */
+int packet_queue_set_back_buffer(PacketQueue *q, int64_t max_duration, int max_size);
+/* in-buffer seek, the caller holds q->mutex */
+int packet_queue_find_seek_point_l(PacketQueue *q, AVRational time_base, int64_t target, int key_only, int64_t *seek_time);
+int packet_queue_restart_at_l(PacketQueue *q, int index);
+/*
+ * wake the reader once a get leaves q at or below a low-water mark, or a flush empties it,
+ * marks < 0 are ignored, returns 1 without arming if q is already there
+ */
+void packet_queue_set_low_water_cb(PacketQueue *q, void (*cb)(void *opaque), void *opaque);
+int packet_queue_arm_low_water(PacketQueue *q, int nb_packets, int size);
 
 #endif /* ff_packet_list_h */
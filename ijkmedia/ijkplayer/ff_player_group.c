@@ -0,0 +1,396 @@
+//
+//  ff_player_group.c
+//  IJKMediaPlayerKit
+//
+//  Players of one screen sharing decoder threads, buffer memory and read bandwidth.
+//
+
+#include "ff_player_group.h"
+#include "ff_ffplay_def.h"
+#include "libavutil/cpu.h"
+#include "libavutil/time.h"
+#include <limits.h>
+#include <pthread.h>
+
+#define MIN_BUFFER_SIZE     (512 * 1024)
+// reads may run this far ahead of the rate before they wait
+#define IO_BURST_MS         250
+#define IO_MAX_DELAY_MS     100
+
+// shares by tier, in FFPlayerTier order
+static const int tier_weights[FFP_TIER_NB] = { 8, 3, 1 };
+
+/*
+ * guards FFPlayer.group and group_wake, taken before any group mutex. The hooks of
+ * read_thread take a reference under it, so a leave can't free the group under them.
+ */
+static pthread_mutex_t g_link_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct FFPlayerGroupMember {
+    FFPlayer *ffp;
+    void (*wake)(void *opaque);
+    void *wake_opaque;
+    FFPlayerTier tier;
+    int buffering;
+    int saved_max_buffer_size;
+    int decoder_threads;
+    int64_t io_rate;
+    int64_t io_tokens;
+    int64_t io_refill_time;
+} FFPlayerGroupMember;
+
+struct FFPlayerGroup {
+    SDL_mutex *mutex;
+    int ref_count;
+    int64_t memory_budget;
+    int64_t io_budget;
+    int decoder_threads;
+
+    FFPlayerGroupMember *members;
+    int nb_members;
+    int capacity;
+};
+
+static void group_unref(FFPlayerGroup *g)
+{
+    int ref_count;
+
+    SDL_LockMutex(g->mutex);
+    ref_count = --g->ref_count;
+    SDL_UnlockMutex(g->mutex);
+    if (ref_count > 0)
+        return;
+
+    SDL_DestroyMutexP(&g->mutex);
+    av_freep(&g->members);
+    av_free(g);
+}
+
+static FFPlayerGroupMember *group_find_l(FFPlayerGroup *g, FFPlayer *ffp)
+{
+    for (int i = 0; i < g->nb_members; i++) {
+        if (g->members[i].ffp == ffp)
+            return &g->members[i];
+    }
+    return NULL;
+}
+
+/* the group of ffp with a reference the caller drops with group_unref(), NULL outside a group */
+static FFPlayerGroup *group_acquire(FFPlayer *ffp)
+{
+    FFPlayerGroup *g;
+
+    if (!__atomic_load_n(&ffp->group, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    pthread_mutex_lock(&g_link_mutex);
+    g = ffp->group;
+    if (g) {
+        SDL_LockMutex(g->mutex);
+        g->ref_count++;
+        SDL_UnlockMutex(g->mutex);
+    }
+    pthread_mutex_unlock(&g_link_mutex);
+    return g;
+}
+
+static void member_wake_l(FFPlayerGroupMember *m)
+{
+    if (m->wake)
+        m->wake(m->wake_opaque);
+}
+
+/*
+ * reads of background members stop while a focused or visible one buffers,
+ * memory and decoder threads keep their split so nothing has to reopen
+ */
+static void group_rebalance_l(FFPlayerGroup *g)
+{
+    int weight_sum = 0, io_weight_sum = 0, starving = 0;
+
+    for (int i = 0; i < g->nb_members; i++) {
+        FFPlayerGroupMember *m = &g->members[i];
+        weight_sum += tier_weights[m->tier];
+        if (m->buffering && m->tier != FFP_TIER_BACKGROUND)
+            starving = 1;
+    }
+    for (int i = 0; i < g->nb_members; i++) {
+        if (!starving || g->members[i].tier != FFP_TIER_BACKGROUND)
+            io_weight_sum += tier_weights[g->members[i].tier];
+    }
+
+    for (int i = 0; i < g->nb_members; i++) {
+        FFPlayerGroupMember *m = &g->members[i];
+        int weight = tier_weights[m->tier];
+
+        if (g->memory_budget > 0) {
+            int max_buffer_size = (int)FFMIN(FFMAX(g->memory_budget * weight / weight_sum, MIN_BUFFER_SIZE), INT_MAX);
+            if (m->ffp->dcc.max_buffer_size != max_buffer_size) {
+                m->ffp->dcc.max_buffer_size = max_buffer_size;
+                // a read_thread sleeping on a full queue checks against the new size
+                member_wake_l(m);
+            }
+        }
+
+        m->decoder_threads = FFMAX(g->decoder_threads * weight / weight_sum, 1);
+
+        if (g->io_budget > 0) {
+            int io_weight = (starving && m->tier == FFP_TIER_BACKGROUND) ? 0 : weight;
+            m->io_rate = io_weight_sum ? g->io_budget * io_weight / io_weight_sum : 0;
+        }
+    }
+}
+
+FFPlayerGroup *ff_player_group_create(int64_t memory_budget, int64_t io_bytes_per_second, int decoder_threads)
+{
+    FFPlayerGroup *g = av_mallocz(sizeof(FFPlayerGroup));
+    if (!g)
+        return NULL;
+
+    g->mutex = SDL_CreateMutex();
+    if (!g->mutex) {
+        av_free(g);
+        return NULL;
+    }
+    g->ref_count       = 1;
+    g->memory_budget   = FFMAX(memory_budget, 0);
+    g->io_budget       = FFMAX(io_bytes_per_second, 0);
+    g->decoder_threads = decoder_threads > 0 ? decoder_threads : av_cpu_count();
+    return g;
+}
+
+void ff_player_group_destroyp(FFPlayerGroup **pg)
+{
+    if (!pg || !*pg)
+        return;
+    group_unref(*pg);
+    *pg = NULL;
+}
+
+int ff_player_group_join(FFPlayerGroup *g, FFPlayer *ffp, FFPlayerTier tier)
+{
+    FFPlayerGroupMember *m;
+
+    if (!g || !ffp || tier < 0 || tier >= FFP_TIER_NB)
+        return AVERROR(EINVAL);
+    if (__atomic_load_n(&ffp->group, __ATOMIC_ACQUIRE) == g)
+        return ff_player_group_set_tier(ffp, tier);
+    ff_player_group_leave(ffp);
+
+    pthread_mutex_lock(&g_link_mutex);
+    SDL_LockMutex(g->mutex);
+    if (g->nb_members == g->capacity) {
+        int capacity = FFMAX(g->capacity * 2, 4);
+        FFPlayerGroupMember *members = av_realloc_array(g->members, capacity, sizeof(FFPlayerGroupMember));
+        if (!members) {
+            SDL_UnlockMutex(g->mutex);
+            pthread_mutex_unlock(&g_link_mutex);
+            return AVERROR(ENOMEM);
+        }
+        g->members  = members;
+        g->capacity = capacity;
+    }
+    m = &g->members[g->nb_members++];
+    memset(m, 0, sizeof(*m));
+    m->ffp                   = ffp;
+    m->wake                  = ffp->group_wake;
+    m->wake_opaque           = ffp->group_wake_opaque;
+    m->tier                  = tier;
+    m->saved_max_buffer_size = ffp->dcc.max_buffer_size;
+    m->io_refill_time        = av_gettime_relative();
+    g->ref_count++;
+    __atomic_store_n(&ffp->group, g, __ATOMIC_RELEASE);
+    group_rebalance_l(g);
+    member_wake_l(m);
+    SDL_UnlockMutex(g->mutex);
+    pthread_mutex_unlock(&g_link_mutex);
+
+    av_log(ffp, AV_LOG_INFO, "player group: joined as tier %d of %d players\n", tier, g->nb_members);
+    return 0;
+}
+
+void ff_player_group_leave(FFPlayer *ffp)
+{
+    FFPlayerGroup *g;
+    FFPlayerGroupMember *m;
+
+    if (!ffp)
+        return;
+
+    pthread_mutex_lock(&g_link_mutex);
+    g = ffp->group;
+    if (!g) {
+        pthread_mutex_unlock(&g_link_mutex);
+        return;
+    }
+    SDL_LockMutex(g->mutex);
+    m = group_find_l(g, ffp);
+    if (m) {
+        ffp->dcc.max_buffer_size = m->saved_max_buffer_size;
+        member_wake_l(m);
+        *m = g->members[--g->nb_members];
+        group_rebalance_l(g);
+    }
+    __atomic_store_n(&ffp->group, NULL, __ATOMIC_RELEASE);
+    SDL_UnlockMutex(g->mutex);
+    pthread_mutex_unlock(&g_link_mutex);
+
+    // read_thread may still hold a reference, the last one frees the group
+    group_unref(g);
+}
+
+int ff_player_group_set_tier(FFPlayer *ffp, FFPlayerTier tier)
+{
+    FFPlayerGroup *g = ffp ? group_acquire(ffp) : NULL;
+    FFPlayerGroupMember *m;
+
+    if (!g)
+        return AVERROR(EINVAL);
+    if (tier < 0 || tier >= FFP_TIER_NB) {
+        group_unref(g);
+        return AVERROR(EINVAL);
+    }
+
+    SDL_LockMutex(g->mutex);
+    m = group_find_l(g, ffp);
+    if (m && m->tier != tier) {
+        m->tier = tier;
+        group_rebalance_l(g);
+        // read_thread picks up keyframes only on its next pass
+        member_wake_l(m);
+    }
+    SDL_UnlockMutex(g->mutex);
+
+    group_unref(g);
+    return 0;
+}
+
+void ff_player_group_set_wake(FFPlayer *ffp, void (*wake)(void *opaque), void *opaque)
+{
+    FFPlayerGroup *g;
+    FFPlayerGroupMember *m;
+
+    pthread_mutex_lock(&g_link_mutex);
+    ffp->group_wake        = wake;
+    ffp->group_wake_opaque = opaque;
+    g = ffp->group;
+    if (g) {
+        SDL_LockMutex(g->mutex);
+        m = group_find_l(g, ffp);
+        if (m) {
+            m->wake        = wake;
+            m->wake_opaque = opaque;
+        }
+        SDL_UnlockMutex(g->mutex);
+    }
+    pthread_mutex_unlock(&g_link_mutex);
+}
+
+FFPlayerTier ff_player_group_tier(FFPlayer *ffp)
+{
+    FFPlayerGroup *g = group_acquire(ffp);
+    FFPlayerGroupMember *m;
+    FFPlayerTier tier = FFP_TIER_FOCUSED;
+
+    if (!g)
+        return tier;
+
+    SDL_LockMutex(g->mutex);
+    m = group_find_l(g, ffp);
+    if (m)
+        tier = m->tier;
+    SDL_UnlockMutex(g->mutex);
+
+    group_unref(g);
+    return tier;
+}
+
+int ff_player_group_decoder_threads(FFPlayer *ffp)
+{
+    FFPlayerGroup *g = group_acquire(ffp);
+    FFPlayerGroupMember *m;
+    int threads = 0;
+
+    if (!g)
+        return 0;
+
+    SDL_LockMutex(g->mutex);
+    m = group_find_l(g, ffp);
+    if (m)
+        threads = m->decoder_threads;
+    SDL_UnlockMutex(g->mutex);
+
+    group_unref(g);
+    return threads;
+}
+
+int ff_player_group_io_delay(FFPlayer *ffp)
+{
+    FFPlayerGroup *g = group_acquire(ffp);
+    FFPlayerGroupMember *m;
+    int delay = 0;
+
+    if (!g)
+        return 0;
+    if (!g->io_budget) {
+        group_unref(g);
+        return 0;
+    }
+
+    SDL_LockMutex(g->mutex);
+    m = group_find_l(g, ffp);
+    if (m) {
+        int64_t now = av_gettime_relative();
+        if (!m->io_rate) {
+            m->io_tokens = 0;
+            delay = IO_MAX_DELAY_MS;
+        } else {
+            m->io_tokens = FFMIN(m->io_tokens + m->io_rate * (now - m->io_refill_time) / 1000000,
+                                 m->io_rate * IO_BURST_MS / 1000);
+            if (m->io_tokens < 0)
+                delay = (int)av_clip64(-m->io_tokens * 1000 / m->io_rate, 1, IO_MAX_DELAY_MS);
+        }
+        m->io_refill_time = now;
+    }
+    SDL_UnlockMutex(g->mutex);
+
+    group_unref(g);
+    return delay;
+}
+
+void ff_player_group_io_consume(FFPlayer *ffp, int bytes)
+{
+    FFPlayerGroup *g = bytes > 0 ? group_acquire(ffp) : NULL;
+    FFPlayerGroupMember *m;
+
+    if (!g)
+        return;
+
+    SDL_LockMutex(g->mutex);
+    m = g->io_budget ? group_find_l(g, ffp) : NULL;
+    if (m)
+        m->io_tokens -= bytes;
+    SDL_UnlockMutex(g->mutex);
+
+    group_unref(g);
+}
+
+void ff_player_group_set_buffering(FFPlayer *ffp, int buffering)
+{
+    FFPlayerGroup *g = group_acquire(ffp);
+    FFPlayerGroupMember *m;
+
+    if (!g)
+        return;
+
+    SDL_LockMutex(g->mutex);
+    m = group_find_l(g, ffp);
+    if (m && m->buffering != buffering) {
+        m->buffering = buffering;
+        if (m->tier != FFP_TIER_BACKGROUND)
+            group_rebalance_l(g);
+    }
+    SDL_UnlockMutex(g->mutex);
+
+    group_unref(g);
+}
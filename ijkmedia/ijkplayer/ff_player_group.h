@@ -0,0 +1,54 @@
+//
+//  ff_player_group.h
+//  IJKMediaPlayerKit
+//
+//  Players of one screen sharing decoder threads, buffer memory and read bandwidth.
+//
+
+#ifndef ff_player_group_h
+#define ff_player_group_h
+
+#include <stdint.h>
+
+typedef struct FFPlayer FFPlayer;
+typedef struct FFPlayerGroup FFPlayerGroup;
+
+typedef enum FFPlayerTier {
+    // the tile the user looks at, gets the largest share of everything
+    FFP_TIER_FOCUSED,
+    FFP_TIER_VISIBLE,
+    // decodes keyframes only, opens its decoder at lowres and stops reading while a higher tier buffers
+    FFP_TIER_BACKGROUND,
+    FFP_TIER_NB
+} FFPlayerTier;
+
+/*
+ * memory_budget is split into the dcc.max_buffer_size of the members, io_bytes_per_second
+ * into read rates and decoder_threads into the thread count of each video decoder, all
+ * by tier weight. 0 leaves that resource to each player, decoder_threads 0 uses the cpu count.
+ */
+FFPlayerGroup *ff_player_group_create(int64_t memory_budget, int64_t io_bytes_per_second, int decoder_threads);
+/* members keep the group alive until they leave */
+void ff_player_group_destroyp(FFPlayerGroup **pg);
+
+/*
+ * the group owns dcc.max_buffer_size of its members and gives the value set before
+ * back on leave. A decoder thread count or lowres only changes when the stream opens.
+ */
+int  ff_player_group_join(FFPlayerGroup *g, FFPlayer *ffp, FFPlayerTier tier);
+void ff_player_group_leave(FFPlayer *ffp);
+int  ff_player_group_set_tier(FFPlayer *ffp, FFPlayerTier tier);
+
+/* the open stream registers how to wake its read_thread when its limits change, NULL on close */
+void ff_player_group_set_wake(FFPlayer *ffp, void (*wake)(void *opaque), void *opaque);
+
+/* hooks of ff_ffplay, each a no-op for players outside a group */
+FFPlayerTier ff_player_group_tier(FFPlayer *ffp);
+/* 0 to let the decoder pick */
+int  ff_player_group_decoder_threads(FFPlayer *ffp);
+/* milliseconds read_thread waits before the next read, 0 to read now */
+int  ff_player_group_io_delay(FFPlayer *ffp);
+void ff_player_group_io_consume(FFPlayer *ffp, int bytes);
+void ff_player_group_set_buffering(FFPlayer *ffp, int buffering);
+
+#endif /* ff_player_group_h */
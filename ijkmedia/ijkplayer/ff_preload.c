@@ -0,0 +1,260 @@
+//
+//  ff_preload.c
+//  IJKMediaPlayerKit
+//
+//  Opens the next playlist item in the background.
+//
+
+#include "ff_preload.h"
+#include "ff_probe_cache.h"
+#include "libavformat/avformat.h"
+#include "libavutil/fifo.h"
+#include "ijksdl/ijksdl_mutex.h"
+#include "ijksdl/ijksdl_thread.h"
+
+#define PRELOAD_MAX_BYTES           (8 * 1024 * 1024)
+#define PRELOAD_AUDIO_ONLY_DURATION (2 * AV_TIME_BASE)
+
+struct FFPreloader {
+    char *url;
+    AVDictionary *format_opts;
+    AVIOInterruptCB interrupt_cb;   // the player's
+    char *probe_cache_dir;
+    char *probe_cache_validator;
+
+    SDL_Thread *tid;
+    SDL_Thread _tid;
+    SDL_mutex *mutex;
+    volatile int abort_request;
+    int state;
+
+    AVFormatContext *ic;
+    int st_index[AVMEDIA_TYPE_NB];
+    AVFifo *pkt_list;   // AVPacket *
+    int prebuffer_size;
+};
+
+static int preload_interrupt_cb(void *opaque)
+{
+    FFPreloader *p = opaque;
+    return p->abort_request ||
+           (p->interrupt_cb.callback && p->interrupt_cb.callback(p->interrupt_cb.opaque));
+}
+
+static int preload_find_stream_info(FFPreloader *p, AVFormatContext *ic, int *hit, char *validator, int validator_size)
+{
+    int cached_st_index[AVMEDIA_TYPE_NB];
+
+    *hit = 0;
+    if (p->probe_cache_dir &&
+        ff_probe_cache_validator(ic, p->url, p->probe_cache_validator, validator, validator_size) >= 0 &&
+        ff_probe_cache_load(p->probe_cache_dir, p->url, validator, ic, cached_st_index) >= 0) {
+        *hit = 1;
+        return 0;
+    }
+    return avformat_find_stream_info(ic, NULL);
+}
+
+/* read the chosen streams up to the end of the first GOP, or a little audio without video */
+static int preload_prebuffer(FFPreloader *p, AVFormatContext *ic)
+{
+    int video = p->st_index[AVMEDIA_TYPE_VIDEO];
+    int audio = p->st_index[AVMEDIA_TYPE_AUDIO];
+    int64_t audio_start = AV_NOPTS_VALUE;
+    int keyframes = 0;
+    AVPacket *pkt;
+    int ret = 0;
+
+    while (!p->abort_request && p->prebuffer_size < PRELOAD_MAX_BYTES) {
+        pkt = av_packet_alloc();
+        if (!pkt)
+            return AVERROR(ENOMEM);
+        ret = av_read_frame(ic, pkt);
+        if (ret < 0) {
+            av_packet_free(&pkt);
+            return ret == AVERROR_EOF ? 0 : ret;
+        }
+        if (pkt->stream_index != video && pkt->stream_index != audio) {
+            av_packet_free(&pkt);
+            continue;
+        }
+
+        /* the next keyframe closes the GOP, it is kept so no packet gets lost */
+        if (pkt->stream_index == video && (pkt->flags & AV_PKT_FLAG_KEY))
+            keyframes++;
+        if (video < 0 && pkt->pts != AV_NOPTS_VALUE) {
+            int64_t t = av_rescale_q(pkt->pts, ic->streams[audio]->time_base, AV_TIME_BASE_Q);
+            if (audio_start == AV_NOPTS_VALUE)
+                audio_start = t;
+            if (t - audio_start >= PRELOAD_AUDIO_ONLY_DURATION)
+                keyframes = 2;
+        }
+
+        p->prebuffer_size += pkt->size;
+        if ((ret = av_fifo_write(p->pkt_list, &pkt, 1)) < 0) {
+            av_packet_free(&pkt);
+            return ret;
+        }
+        if (keyframes >= 2)
+            break;
+    }
+    return 0;
+}
+
+static int preload_thread(void *arg)
+{
+    FFPreloader *p = arg;
+    AVFormatContext *ic = NULL;
+    AVDictionary *opts = NULL;
+    char validator[256] = {0};
+    int probe_cache_hit = 0;
+    int ret;
+
+    ic = avformat_alloc_context();
+    if (!ic) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ic->interrupt_callback.callback = preload_interrupt_cb;
+    ic->interrupt_callback.opaque   = p;
+
+    av_dict_copy(&opts, p->format_opts, 0);
+    ret = avformat_open_input(&ic, p->url, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+
+    if ((ret = preload_find_stream_info(p, ic, &probe_cache_hit, validator, sizeof(validator))) < 0)
+        goto end;
+
+    p->st_index[AVMEDIA_TYPE_VIDEO] = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    p->st_index[AVMEDIA_TYPE_AUDIO] = av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO, -1, p->st_index[AVMEDIA_TYPE_VIDEO], NULL, 0);
+    if (p->st_index[AVMEDIA_TYPE_VIDEO] >= 0 &&
+        (ic->streams[p->st_index[AVMEDIA_TYPE_VIDEO]]->disposition & AV_DISPOSITION_ATTACHED_PIC))
+        p->st_index[AVMEDIA_TYPE_VIDEO] = -1;
+    if (p->st_index[AVMEDIA_TYPE_VIDEO] < 0 && p->st_index[AVMEDIA_TYPE_AUDIO] < 0) {
+        ret = AVERROR_STREAM_NOT_FOUND;
+        goto end;
+    }
+    if (validator[0] && !probe_cache_hit)
+        ff_probe_cache_store(p->probe_cache_dir, p->url, validator, ic, p->st_index);
+
+    for (int i = 0; i < ic->nb_streams; i++) {
+        if (i != p->st_index[AVMEDIA_TYPE_VIDEO] && i != p->st_index[AVMEDIA_TYPE_AUDIO])
+            ic->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    ret = preload_prebuffer(p, ic);
+end:
+    if (p->abort_request)
+        ret = AVERROR_EXIT;
+    SDL_LockMutex(p->mutex);
+    if (ret < 0) {
+        avformat_close_input(&ic);
+        p->state = ret;
+        av_log(NULL, AV_LOG_WARNING, "preload %s failed: %s\n", p->url, av_err2str(ret));
+    } else {
+        p->ic = ic;
+        p->state = 1;
+        av_log(NULL, AV_LOG_INFO, "preload %s ready, %d bytes prebuffered%s\n",
+               p->url, p->prebuffer_size, probe_cache_hit ? ", probe cache hit" : "");
+    }
+    SDL_UnlockMutex(p->mutex);
+    return 0;
+}
+
+FFPreloader *ff_preloader_create(const char *url, AVDictionary *format_opts, const AVIOInterruptCB *interrupt_cb,
+                                 const char *probe_cache_dir, const char *probe_cache_validator)
+{
+    FFPreloader *p = av_mallocz(sizeof(FFPreloader));
+    if (!p)
+        return NULL;
+
+    memset(p->st_index, -1, sizeof(p->st_index));
+    p->url      = av_strdup(url);
+    p->mutex    = SDL_CreateMutex();
+    p->pkt_list = av_fifo_alloc2(64, sizeof(AVPacket *), AV_FIFO_FLAG_AUTO_GROW);
+    if (interrupt_cb)
+        p->interrupt_cb = *interrupt_cb;
+    if (probe_cache_dir)
+        p->probe_cache_dir = av_strdup(probe_cache_dir);
+    if (probe_cache_validator)
+        p->probe_cache_validator = av_strdup(probe_cache_validator);
+    if (!p->url || !p->mutex || !p->pkt_list ||
+        (probe_cache_dir && !p->probe_cache_dir) ||
+        (probe_cache_validator && !p->probe_cache_validator) ||
+        av_dict_copy(&p->format_opts, format_opts, 0) < 0)
+        goto fail;
+
+    p->tid = SDL_CreateThreadEx(&p->_tid, preload_thread, p, "ff_preload");
+    if (!p->tid)
+        goto fail;
+    return p;
+fail:
+    ff_preloader_destroyp(&p);
+    return NULL;
+}
+
+void ff_preloader_destroyp(FFPreloader **pp)
+{
+    FFPreloader *p;
+    AVPacket *pkt;
+
+    if (!pp || !*pp)
+        return;
+    p = *pp;
+
+    p->abort_request = 1;
+    if (p->tid)
+        SDL_WaitThread(p->tid, NULL);
+
+    if (p->pkt_list) {
+        while (av_fifo_read(p->pkt_list, &pkt, 1) >= 0)
+            av_packet_free(&pkt);
+        av_fifo_freep2(&p->pkt_list);
+    }
+    avformat_close_input(&p->ic);
+    if (p->mutex)
+        SDL_DestroyMutex(p->mutex);
+    av_dict_free(&p->format_opts);
+    av_freep(&p->probe_cache_validator);
+    av_freep(&p->probe_cache_dir);
+    av_freep(&p->url);
+    av_freep(pp);
+}
+
+int ff_preloader_poll(FFPreloader *p)
+{
+    int state;
+
+    SDL_LockMutex(p->mutex);
+    state = p->state;
+    SDL_UnlockMutex(p->mutex);
+    return state;
+}
+
+AVFormatContext *ff_preloader_take(FFPreloader *p, int st_index[AVMEDIA_TYPE_NB])
+{
+    AVFormatContext *ic;
+
+    SDL_LockMutex(p->mutex);
+    ic = p->ic;
+    p->ic = NULL;
+    SDL_UnlockMutex(p->mutex);
+
+    if (ic)
+        memcpy(st_index, p->st_index, sizeof(p->st_index));
+    return ic;
+}
+
+int ff_preloader_read_packet(FFPreloader *p, AVPacket *pkt)
+{
+    AVPacket *pkt1;
+
+    if (ff_preloader_poll(p) <= 0 || av_fifo_read(p->pkt_list, &pkt1, 1) < 0)
+        return AVERROR_EOF;
+
+    av_packet_move_ref(pkt, pkt1);
+    av_packet_free(&pkt1);
+    return 0;
+}
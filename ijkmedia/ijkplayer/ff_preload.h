@@ -0,0 +1,42 @@
+//
+//  ff_preload.h
+//  IJKMediaPlayerKit
+//
+//  Opens the next playlist item in the background.
+//
+
+#ifndef ff_preload_h
+#define ff_preload_h
+
+#include "libavutil/avutil.h"
+#include "libavutil/dict.h"
+#include "libavformat/avio.h"
+
+typedef struct AVFormatContext AVFormatContext;
+typedef struct AVPacket AVPacket;
+typedef struct FFPreloader FFPreloader;
+
+/*
+ * start opening url on a thread of its own: demuxer open, stream info (through the
+ * probe cache when probe_cache_dir is set) and the packets of the first GOP.
+ * interrupt_cb is the player's, I/O of the item stops when either it or the preloader aborts
+ */
+FFPreloader *ff_preloader_create(const char *url, AVDictionary *format_opts, const AVIOInterruptCB *interrupt_cb,
+                                 const char *probe_cache_dir, const char *probe_cache_validator);
+/* aborts a preload still running, an input taken from p must be closed before */
+void ff_preloader_destroyp(FFPreloader **pp);
+
+/* 0 while opening, 1 when ready, <0 if the item could not be opened */
+int ff_preloader_poll(FFPreloader *p);
+
+/*
+ * take over the opened input of a ready preloader, st_index receives the audio and
+ * video streams that were prebuffered, -1 where there is none. its interrupt callback
+ * still points at p, so p has to outlive it
+ */
+AVFormatContext *ff_preloader_take(FFPreloader *p, int st_index[AVMEDIA_TYPE_NB]);
+
+/* prebuffered packets in demux order, AVERROR_EOF once they are all taken */
+int ff_preloader_read_packet(FFPreloader *p, AVPacket *pkt);
+
+#endif /* ff_preload_h */
@@ -0,0 +1,370 @@
+//
+//  ff_probe_cache.c
+//  IJKMediaPlayerKit
+//
+//  Persistent cache of avformat_find_stream_info() results.
+//
+
+#include "ff_probe_cache.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "libavformat/avformat.h"
+#include "libavutil/avstring.h"
+#include "libavutil/md5.h"
+
+#define PROBE_CACHE_MAGIC       MKTAG('I', 'J', 'K', 'P')
+#define PROBE_CACHE_VERSION     1
+#define PROBE_CACHE_MAX_STREAMS 64
+#define PROBE_CACHE_MAX_EXTRADATA (1 << 20)
+
+/* written as is, the file is only ever read back on the device that wrote it */
+typedef struct ProbeCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t stream_size;
+    char     validator[256];
+    char     iformat[64];
+    int32_t  nb_streams;
+    int32_t  st_index[AVMEDIA_TYPE_NB];
+    int64_t  duration;
+    int64_t  start_time;
+    int64_t  bit_rate;
+} ProbeCacheHeader;
+
+typedef struct ProbeCacheStream {
+    int32_t    codec_type;
+    int32_t    codec_id;
+    uint32_t   codec_tag;
+    int32_t    format;
+    int64_t    bit_rate;
+    int32_t    bits_per_coded_sample;
+    int32_t    bits_per_raw_sample;
+    int32_t    profile;
+    int32_t    level;
+    int32_t    width;
+    int32_t    height;
+    AVRational sample_aspect_ratio;
+    int32_t    field_order;
+    int32_t    color_range;
+    int32_t    color_primaries;
+    int32_t    color_trc;
+    int32_t    color_space;
+    int32_t    chroma_location;
+    int32_t    video_delay;
+    int32_t    ch_order;
+    int32_t    nb_channels;
+    uint64_t   ch_mask;
+    int32_t    sample_rate;
+    int32_t    block_align;
+    int32_t    frame_size;
+    int32_t    initial_padding;
+    int32_t    trailing_padding;
+    int32_t    seek_preroll;
+    AVRational time_base;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+    int64_t    start_time;
+    int64_t    duration;
+    int64_t    nb_frames;
+    int32_t    extradata_size;
+} ProbeCacheStream;
+
+static int probe_cache_path(const char *dir, const char *url, char *path, int path_size)
+{
+    uint8_t md5[16];
+    char hex[33];
+
+    if (!dir || !*dir || !url)
+        return AVERROR(EINVAL);
+
+    av_md5_sum(md5, (const uint8_t *)url, strlen(url));
+    for (int i = 0; i < 16; i++)
+        snprintf(hex + i * 2, 3, "%02x", md5[i]);
+    if (snprintf(path, path_size, "%s/%s.probe", dir, hex) >= path_size)
+        return AVERROR(ENAMETOOLONG);
+    return 0;
+}
+
+int ff_probe_cache_validator(AVFormatContext *ic, const char *url, const char *app_validator, char *buf, int buf_size)
+{
+    int64_t size = ic->pb ? avio_size(ic->pb) : -1;
+    int64_t mtime = 0;
+    const char *path = url;
+    struct stat st;
+
+    if (app_validator && !*app_validator)
+        app_validator = NULL;
+
+    av_strstart(url, "file:", &path);
+    if (path && path[0] == '/' && stat(path, &st) == 0)
+        mtime = (int64_t)st.st_mtime;
+
+    /* live streams have no size, without an application validator there is nothing to compare */
+    if (size <= 0 && !app_validator)
+        return AVERROR(EINVAL);
+
+    if (snprintf(buf, buf_size, "size=%"PRId64";mtime=%"PRId64";app=%s", size, mtime, app_validator ? app_validator : "") >= buf_size)
+        return AVERROR(ENAMETOOLONG);
+    return 0;
+}
+
+static void probe_cache_save_stream(ProbeCacheStream *s, AVStream *st)
+{
+    AVCodecParameters *par = st->codecpar;
+
+    memset(s, 0, sizeof(*s));
+    s->codec_type            = par->codec_type;
+    s->codec_id              = par->codec_id;
+    s->codec_tag             = par->codec_tag;
+    s->format                = par->format;
+    s->bit_rate              = par->bit_rate;
+    s->bits_per_coded_sample = par->bits_per_coded_sample;
+    s->bits_per_raw_sample   = par->bits_per_raw_sample;
+    s->profile               = par->profile;
+    s->level                 = par->level;
+    s->width                 = par->width;
+    s->height                = par->height;
+    s->sample_aspect_ratio   = par->sample_aspect_ratio;
+    s->field_order           = par->field_order;
+    s->color_range           = par->color_range;
+    s->color_primaries       = par->color_primaries;
+    s->color_trc             = par->color_trc;
+    s->color_space           = par->color_space;
+    s->chroma_location       = par->chroma_location;
+    s->video_delay           = par->video_delay;
+    s->ch_order              = par->ch_layout.order;
+    s->nb_channels           = par->ch_layout.nb_channels;
+    s->ch_mask               = par->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? par->ch_layout.u.mask : 0;
+    s->sample_rate           = par->sample_rate;
+    s->block_align           = par->block_align;
+    s->frame_size            = par->frame_size;
+    s->initial_padding       = par->initial_padding;
+    s->trailing_padding      = par->trailing_padding;
+    s->seek_preroll          = par->seek_preroll;
+    s->time_base             = st->time_base;
+    s->avg_frame_rate        = st->avg_frame_rate;
+    s->r_frame_rate          = st->r_frame_rate;
+    s->start_time            = st->start_time;
+    s->duration              = st->duration;
+    s->nb_frames             = st->nb_frames;
+    s->extradata_size        = par->extradata_size <= PROBE_CACHE_MAX_EXTRADATA ? par->extradata_size : 0;
+}
+
+/* the demuxer must have produced the same streams, otherwise the cache is stale */
+static int probe_cache_match_stream(const ProbeCacheStream *s, AVStream *st)
+{
+    AVCodecParameters *par = st->codecpar;
+
+    if (par->codec_type != s->codec_type)
+        return 0;
+    if (par->codec_id != AV_CODEC_ID_NONE && par->codec_id != s->codec_id)
+        return 0;
+    if (av_cmp_q(st->time_base, s->time_base))
+        return 0;
+    return 1;
+}
+
+static int probe_cache_restore_stream(const ProbeCacheStream *s, const uint8_t *extradata, AVStream *st)
+{
+    AVCodecParameters *par = st->codecpar;
+
+    if (s->extradata_size > 0 && par->extradata_size <= 0) {
+        par->extradata = av_mallocz(s->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata)
+            return AVERROR(ENOMEM);
+        memcpy(par->extradata, extradata, s->extradata_size);
+        par->extradata_size = s->extradata_size;
+    }
+
+    av_channel_layout_uninit(&par->ch_layout);
+    if (s->ch_order == AV_CHANNEL_ORDER_NATIVE && s->ch_mask)
+        av_channel_layout_from_mask(&par->ch_layout, s->ch_mask);
+    else if (s->nb_channels > 0)
+        av_channel_layout_default(&par->ch_layout, s->nb_channels);
+
+    par->codec_id              = s->codec_id;
+    par->codec_tag             = s->codec_tag;
+    par->format                = s->format;
+    par->bit_rate              = s->bit_rate;
+    par->bits_per_coded_sample = s->bits_per_coded_sample;
+    par->bits_per_raw_sample   = s->bits_per_raw_sample;
+    par->profile               = s->profile;
+    par->level                 = s->level;
+    par->width                 = s->width;
+    par->height                = s->height;
+    par->sample_aspect_ratio   = s->sample_aspect_ratio;
+    par->field_order           = s->field_order;
+    par->color_range           = s->color_range;
+    par->color_primaries       = s->color_primaries;
+    par->color_trc             = s->color_trc;
+    par->color_space           = s->color_space;
+    par->chroma_location       = s->chroma_location;
+    par->video_delay           = s->video_delay;
+    par->sample_rate           = s->sample_rate;
+    par->block_align           = s->block_align;
+    par->frame_size            = s->frame_size;
+    par->initial_padding       = s->initial_padding;
+    par->trailing_padding      = s->trailing_padding;
+    par->seek_preroll          = s->seek_preroll;
+
+    st->avg_frame_rate = s->avg_frame_rate;
+    st->r_frame_rate   = s->r_frame_rate;
+    if (st->start_time == AV_NOPTS_VALUE)
+        st->start_time = s->start_time;
+    if (st->duration == AV_NOPTS_VALUE)
+        st->duration = s->duration;
+    if (!st->nb_frames)
+        st->nb_frames = s->nb_frames;
+    return 0;
+}
+
+int ff_probe_cache_load(const char *dir, const char *url, const char *validator, AVFormatContext *ic, int st_index[AVMEDIA_TYPE_NB])
+{
+    char path[1024];
+    ProbeCacheHeader header;
+    ProbeCacheStream *streams = NULL;
+    uint8_t **extradata = NULL;
+    FILE *fp = NULL;
+    int ret;
+
+    if ((ret = probe_cache_path(dir, url, path, sizeof(path))) < 0)
+        return ret;
+    if (!validator || !ic->iformat || !ic->nb_streams || ic->nb_streams > PROBE_CACHE_MAX_STREAMS)
+        return AVERROR(EINVAL);
+
+    fp = fopen(path, "rb");
+    if (!fp)
+        return AVERROR(ENOENT);
+
+    ret = AVERROR_INVALIDDATA;
+    if (fread(&header, sizeof(header), 1, fp) != 1)
+        goto end;
+    if (header.magic != PROBE_CACHE_MAGIC || header.version != PROBE_CACHE_VERSION ||
+        header.header_size != sizeof(header) || header.stream_size != sizeof(ProbeCacheStream))
+        goto end;
+    header.validator[sizeof(header.validator) - 1] = 0;
+    header.iformat[sizeof(header.iformat) - 1] = 0;
+    if (strcmp(header.validator, validator) || strcmp(header.iformat, ic->iformat->name) ||
+        header.nb_streams != (int)ic->nb_streams)
+        goto end;
+
+    streams   = av_calloc(header.nb_streams, sizeof(*streams));
+    extradata = av_calloc(header.nb_streams, sizeof(*extradata));
+    if (!streams || !extradata) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    /* read and check everything before touching ic, a miss must leave it as opened */
+    for (int i = 0; i < header.nb_streams; i++) {
+        ProbeCacheStream *s = &streams[i];
+
+        if (fread(s, sizeof(*s), 1, fp) != 1 ||
+            s->extradata_size < 0 || s->extradata_size > PROBE_CACHE_MAX_EXTRADATA)
+            goto end;
+        if (!probe_cache_match_stream(s, ic->streams[i]))
+            goto end;
+        if (s->extradata_size > 0) {
+            extradata[i] = av_malloc(s->extradata_size);
+            if (!extradata[i]) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            if (fread(extradata[i], s->extradata_size, 1, fp) != 1)
+                goto end;
+        }
+    }
+
+    for (int i = 0; i < header.nb_streams; i++) {
+        if ((ret = probe_cache_restore_stream(&streams[i], extradata[i], ic->streams[i])) < 0)
+            goto end;
+    }
+    if (ic->duration == AV_NOPTS_VALUE)
+        ic->duration = header.duration;
+    if (ic->start_time == AV_NOPTS_VALUE)
+        ic->start_time = header.start_time;
+    if (ic->bit_rate <= 0)
+        ic->bit_rate = header.bit_rate;
+    for (int i = 0; i < AVMEDIA_TYPE_NB; i++)
+        st_index[i] = header.st_index[i] < (int)ic->nb_streams ? header.st_index[i] : -1;
+    ret = 0;
+end:
+    if (extradata) {
+        for (int i = 0; i < header.nb_streams; i++)
+            av_free(extradata[i]);
+    }
+    av_free(extradata);
+    av_free(streams);
+    fclose(fp);
+    return ret;
+}
+
+int ff_probe_cache_store(const char *dir, const char *url, const char *validator, AVFormatContext *ic, const int st_index[AVMEDIA_TYPE_NB])
+{
+    char path[1024];
+    char tmp_path[1040];
+    ProbeCacheHeader header;
+    ProbeCacheStream s;
+    FILE *fp;
+    int ret;
+
+    if ((ret = probe_cache_path(dir, url, path, sizeof(path))) < 0)
+        return ret;
+    /* streams of headerless formats only show up while reading, they can't be matched on reopen */
+    if (!validator || !ic->iformat || (ic->ctx_flags & AVFMTCTX_NOHEADER) ||
+        !ic->nb_streams || ic->nb_streams > PROBE_CACHE_MAX_STREAMS ||
+        strlen(validator) >= sizeof(header.validator))
+        return AVERROR(EINVAL);
+
+    memset(&header, 0, sizeof(header));
+    header.magic       = PROBE_CACHE_MAGIC;
+    header.version     = PROBE_CACHE_VERSION;
+    header.header_size = sizeof(header);
+    header.stream_size = sizeof(ProbeCacheStream);
+    av_strlcpy(header.validator, validator, sizeof(header.validator));
+    av_strlcpy(header.iformat, ic->iformat->name, sizeof(header.iformat));
+    header.nb_streams  = ic->nb_streams;
+    header.duration    = ic->duration;
+    header.start_time  = ic->start_time;
+    header.bit_rate    = ic->bit_rate;
+    for (int i = 0; i < AVMEDIA_TYPE_NB; i++)
+        header.st_index[i] = st_index[i];
+
+    /* write aside and rename, a concurrent load sees either the old or the new file */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%p", path, (void *)ic);
+    fp = fopen(tmp_path, "wb");
+    if (!fp)
+        return AVERROR(errno);
+
+    ret = AVERROR(EIO);
+    if (fwrite(&header, sizeof(header), 1, fp) != 1)
+        goto fail;
+    for (int i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+
+        probe_cache_save_stream(&s, st);
+        if (fwrite(&s, sizeof(s), 1, fp) != 1)
+            goto fail;
+        if (s.extradata_size > 0 && fwrite(st->codecpar->extradata, s.extradata_size, 1, fp) != 1)
+            goto fail;
+    }
+    if (fclose(fp)) {
+        fp = NULL;
+        goto fail;
+    }
+    fp = NULL;
+    if (rename(tmp_path, path)) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    return 0;
+fail:
+    if (fp)
+        fclose(fp);
+    remove(tmp_path);
+    return ret;
+}
@@ -0,0 +1,32 @@
+//
+//  ff_probe_cache.h
+//  IJKMediaPlayerKit
+//
+//  Persistent cache of avformat_find_stream_info() results.
+//
+
+#ifndef ff_probe_cache_h
+#define ff_probe_cache_h
+
+#include "libavutil/avutil.h"
+
+typedef struct AVFormatContext AVFormatContext;
+
+/*
+ * describe the opened input so a cached probe is only reused for the same content:
+ * input size, mtime of local files and an optional validator from the application
+ * (ETag, Last-Modified...), returns <0 if the input can't be validated
+ */
+int ff_probe_cache_validator(AVFormatContext *ic, const char *url, const char *app_validator, char *buf, int buf_size);
+
+/*
+ * restore the stream parameters stored for url into ic, which must be freshly opened
+ * st_index receives the stream indices chosen last time, -1 where none was
+ * returns 0 on a hit, <0 if nothing usable is cached
+ */
+int ff_probe_cache_load(const char *dir, const char *url, const char *validator, AVFormatContext *ic, int st_index[AVMEDIA_TYPE_NB]);
+
+/* remember the stream parameters of ic, called once avformat_find_stream_info() succeeded */
+int ff_probe_cache_store(const char *dir, const char *url, const char *validator, AVFormatContext *ic, const int st_index[AVMEDIA_TYPE_NB]);
+
+#endif /* ff_probe_cache_h */
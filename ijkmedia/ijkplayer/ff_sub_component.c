@@ -609,7 +609,7 @@ int subComponent_open(FFSubComponent **cp, int stream_index, AVStream* stream, P
     com->pre_loading = -1;
     com->startTime = startTime;
     
-    int ret = decoder_init(&com->decoder, avctx, com->packetq, NULL);
+    int ret = decoder_init(&com->decoder, avctx, com->packetq, NULL, NULL);
     
     if (ret < 0) {
         av_log(NULL, AV_LOG_ERROR, "subtitle decoder init failed:%d", ret);
@@ -14,6 +14,7 @@
 #include "ijksdl_gpu.h"
 #include "ijksdl/ijksdl_gpu.h"
 #include "ff_subtitle_def_internal.h"
+#include "ijkavutil/ijkthreadpool.h"
 
 #define IJK_SUBTITLE_STREAM_UNDEF -2
 #define IJK_SUBTITLE_STREAM_NONE -1
@@ -54,7 +55,7 @@ typedef struct FFSubtitle {
     
     //当前使用的哪个备选字符
     int backup_charenc_idx;
-    SDL_Thread tmp_retry_thread;
+    IjkThreadPoolFuture *retry_task;
 }FFSubtitle;
 
 //---------------------------Public Common Functions--------------------------------------------------//
@@ -143,6 +144,8 @@ int ff_sub_destroy(FFSubtitle **subp)
     }
     
     SDL_LockMutex(sub->mutex);
+    //a retry still queued or running finds no stream to reopen
+    sub->last_stream = IJK_SUBTITLE_STREAM_UNDEF;
     if (sub->com) {
         subComponent_close(&sub->com);
     }
@@ -151,6 +154,13 @@ int ff_sub_destroy(FFSubtitle **subp)
     }
     SDL_UnlockMutex(sub->mutex);
     
+    IjkThreadPoolFuture *retry_task;
+    while ((retry_task = __atomic_exchange_n(&sub->retry_task, NULL, __ATOMIC_ACQ_REL))) {
+        ijk_threadpool_future_cancel(retry_task);
+        ijk_threadpool_future_wait(retry_task, -1);
+        ijk_threadpool_future_releasep(&retry_task);
+    }
+    
     packet_queue_destroy(&sub->packetq);
     packet_queue_destroy(&sub->packetq2);
     frame_queue_destory(&sub->frameq);
@@ -395,6 +405,11 @@ static const char * ext_file_path_for_idx(FFSubtitle *sub, int idx)
 
 static int do_retry_next_charenc(void *opaque);
 
+static void retry_task_run(void *in_arg, void *out_arg)
+{
+    do_retry_next_charenc(in_arg);
+}
+
 static void retry_callback(void *opaque)
 {
     FFSubtitle *sub = opaque;
@@ -404,7 +419,14 @@ static void retry_callback(void *opaque)
     //fix "Use of deallocated memory" crash
     //in other thread close this ex subtitle stream is necessory:because when destroy decoder,will join this thread,but join self won't join anything,then freed SDL_Thread struct,and func return value can't assign to retval! (thread->retval = thread->func(thread->data);)
     //if you want reproduce the crash,may need open "Address Sanitizer" option
-    SDL_CreateThreadEx(&sub->tmp_retry_thread, do_retry_next_charenc, opaque, "tmp_retry");
+    //the reopen runs on the shared pool, ff_sub_destroy waits for it instead of leaking a thread
+    IjkThreadPoolFuture *task = NULL;
+    if (ijk_threadpool_submit(ijk_threadpool_shared(), retry_task_run, opaque, NULL, IJK_THREADPOOL_PRIORITY_CRITICAL, &task)) {
+        av_log(NULL, AV_LOG_ERROR, "sub retry charenc submit failed\n");
+        return;
+    }
+    task = __atomic_exchange_n(&sub->retry_task, task, __ATOMIC_ACQ_REL);
+    ijk_threadpool_future_releasep(&task);
 }
 
 static void move_backup_to_normal(FFSubtitle *sub, int stream)
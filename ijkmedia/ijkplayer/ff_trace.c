@@ -0,0 +1,204 @@
+//
+//  ff_trace.c
+//  IJKMediaPlayerKit
+//
+//  Per-thread event rings for tracing the playback pipeline.
+//
+
+#include "ff_trace.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libavutil/log.h"
+#include "libavutil/time.h"
+
+#define FF_TRACE_RING_SIZE  8192    // power of two
+#define FF_TRACE_MAX_RINGS  64
+
+typedef struct FFTraceEvent {
+    int64_t ts;
+    int64_t value;
+    const char *name;
+    const char *step;
+    char phase;
+} FFTraceEvent;
+
+typedef struct FFTraceRing {
+    struct FFTraceRing *next;
+    int in_use;
+    int tid;
+    char thread_name[32];
+    // events ever written, only the ring's owner thread writes
+    uint32_t write_index;
+    FFTraceEvent events[FF_TRACE_RING_SIZE];
+} FFTraceRing;
+
+int ff_trace_enabled;
+
+// rings are pushed once and never freed, a thread that exits hands its ring to the next one
+static FFTraceRing *s_rings;
+static int s_ring_count;
+static int64_t s_trace_start;
+static pthread_key_t s_ring_key;
+static pthread_once_t s_ring_once = PTHREAD_ONCE_INIT;
+
+static void ring_release(void *opaque)
+{
+    FFTraceRing *ring = opaque;
+    __atomic_store_n(&ring->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void ring_key_init(void)
+{
+    pthread_key_create(&s_ring_key, ring_release);
+}
+
+static FFTraceRing *ring_get(void)
+{
+    FFTraceRing *ring;
+    int count;
+
+    pthread_once(&s_ring_once, ring_key_init);
+    ring = pthread_getspecific(s_ring_key);
+    if (ring)
+        return ring;
+
+    for (ring = __atomic_load_n(&s_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&ring->in_use, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            ring->thread_name[0] = '\0';
+            __atomic_store_n(&ring->write_index, 0, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+
+    if (!ring) {
+        count = __atomic_add_fetch(&s_ring_count, 1, __ATOMIC_RELAXED);
+        if (count > FF_TRACE_MAX_RINGS)
+            return NULL;
+        ring = calloc(1, sizeof(FFTraceRing));
+        if (!ring)
+            return NULL;
+        ring->in_use = 1;
+        ring->tid    = count;
+        ring->next   = __atomic_load_n(&s_rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&s_rings, &ring->next, ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+
+    pthread_setspecific(s_ring_key, ring);
+    return ring;
+}
+
+void ff_trace_start(void)
+{
+    __atomic_store_n(&s_trace_start, av_gettime_relative(), __ATOMIC_RELAXED);
+    __atomic_store_n(&ff_trace_enabled, 1, __ATOMIC_RELEASE);
+}
+
+void ff_trace_stop(void)
+{
+    __atomic_store_n(&ff_trace_enabled, 0, __ATOMIC_RELEASE);
+}
+
+void ff_trace_thread_name(const char *name)
+{
+    FFTraceRing *ring = ring_get();
+
+    if (ring && !ring->thread_name[0])
+        snprintf(ring->thread_name, sizeof(ring->thread_name), "%s", name);
+}
+
+void ff_trace_event(char phase, const char *name, const char *step, int64_t value)
+{
+    FFTraceRing *ring = ring_get();
+    FFTraceEvent *ev;
+    uint32_t index;
+
+    if (!ring)
+        return;
+
+    index = ring->write_index;
+    ev = &ring->events[index & (FF_TRACE_RING_SIZE - 1)];
+    ev->ts    = av_gettime_relative();
+    ev->value = value;
+    ev->name  = name;
+    ev->step  = step;
+    ev->phase = phase;
+    __atomic_store_n(&ring->write_index, index + 1, __ATOMIC_RELEASE);
+}
+
+static void export_event(FILE *fp, const FFTraceRing *ring, const FFTraceEvent *ev, int64_t start, int *first)
+{
+    fprintf(fp, "%s\n{\"ph\":\"%c\",\"name\":\"%s\",\"cat\":\"ijkplayer\",\"pid\":1,\"tid\":%d,\"ts\":%"PRId64,
+            *first ? "" : ",", ev->phase, ev->name, ring->tid, ev->ts - start);
+    *first = 0;
+
+    switch (ev->phase) {
+        case 'b':
+        case 'e':
+            fprintf(fp, ",\"id\":\"0x%"PRIx64"\"}", (uint64_t)ev->value);
+            break;
+        case 'n':
+            fprintf(fp, ",\"id\":\"0x%"PRIx64"\",\"args\":{\"step\":\"%s\"}}", (uint64_t)ev->value, ev->step);
+            break;
+        case 'i':
+            fprintf(fp, ",\"s\":\"t\",\"args\":{\"value\":%"PRId64"}}", ev->value);
+            break;
+        case 'C':
+            fprintf(fp, ",\"args\":{\"value\":%"PRId64"}}", ev->value);
+            break;
+        default:
+            fputc('}', fp);
+            break;
+    }
+}
+
+int ff_trace_export_chrome(const char *path)
+{
+    int64_t start = __atomic_load_n(&s_trace_start, __ATOMIC_RELAXED);
+    FFTraceRing *ring;
+    int first = 1;
+    int nb_events = 0;
+    FILE *fp;
+
+    fp = fopen(path, "w");
+    if (!fp) {
+        av_log(NULL, AV_LOG_ERROR, "trace: can't open %s\n", path);
+        return -1;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (ring = __atomic_load_n(&s_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        uint32_t end = __atomic_load_n(&ring->write_index, __ATOMIC_ACQUIRE);
+        uint32_t begin = end > FF_TRACE_RING_SIZE ? end - FF_TRACE_RING_SIZE : 0;
+
+        if (begin == end)
+            continue;
+        fprintf(fp, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",", ring->tid, ring->thread_name[0] ? ring->thread_name : "thread");
+        first = 0;
+
+        /* a thread still running may overwrite the oldest events meanwhile, they are skipped */
+        for (uint32_t i = begin; i != end; i++) {
+            FFTraceEvent ev = ring->events[i & (FF_TRACE_RING_SIZE - 1)];
+            uint32_t now = __atomic_load_n(&ring->write_index, __ATOMIC_ACQUIRE);
+            if (now - i >= FF_TRACE_RING_SIZE)
+                continue;
+            if (ev.ts < start || !ev.name)
+                continue;
+            export_event(fp, ring, &ev, start, &first);
+            nb_events++;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+
+    if (fclose(fp) != 0) {
+        av_log(NULL, AV_LOG_ERROR, "trace: write %s failed\n", path);
+        return -1;
+    }
+    av_log(NULL, AV_LOG_INFO, "trace: %d events written to %s\n", nb_events, path);
+    return 0;
+}
@@ -0,0 +1,59 @@
+//
+//  ff_trace.h
+//  IJKMediaPlayerKit
+//
+//  Per-thread event rings for tracing the playback pipeline.
+//
+
+#ifndef ff_trace_h
+#define ff_trace_h
+
+#include <math.h>
+#include <stdint.h>
+#include "ff_ffplay_debug.h"
+
+/*
+ * every thread records into a ring of its own without taking a lock, the ring keeps
+ * its latest FF_TRACE_RING_SIZE events. ff_trace_export_chrome writes what the rings
+ * hold as Chrome trace JSON, which chrome://tracing and ui.perfetto.dev both open.
+ * the FFTRACE_* macros compile to nothing unless FFP_TRACE is defined, their
+ * arguments are not evaluated then.
+ */
+
+/* events recorded from now on are kept, earlier ones are left out of the export */
+void ff_trace_start(void);
+void ff_trace_stop(void);
+/* <0 on error, the rings are not cleared so the same trace can be written twice */
+int  ff_trace_export_chrome(const char *path);
+
+/* name of the calling thread in the trace, only the first call of a thread counts */
+void ff_trace_thread_name(const char *name);
+/* phase is a Chrome trace phase: B E i C b n e, name and step must be string literals */
+void ff_trace_event(char phase, const char *name, const char *step, int64_t value);
+
+extern int ff_trace_enabled;
+
+/* async events of one frame are matched by its pts in ms, frames without pts share -1 */
+#define FFTRACE_ID(pts) (isnan(pts) ? -1 : (int64_t)llrint((pts) * 1000))
+
+#ifdef FFP_TRACE
+#define FFTRACE_EVENT(phase, name, step, value) \
+    do { \
+        if (__atomic_load_n(&ff_trace_enabled, __ATOMIC_RELAXED)) \
+            ff_trace_event(phase, name, step, value); \
+    } while (0)
+#define FFTRACE_THREAD(name)    ff_trace_thread_name(name)
+#else
+#define FFTRACE_EVENT(phase, name, step, value) ((void)0)
+#define FFTRACE_THREAD(name)    ((void)0)
+#endif
+
+#define FFTRACE_BEGIN(name)                 FFTRACE_EVENT('B', name, NULL, 0)
+#define FFTRACE_END(name)                   FFTRACE_EVENT('E', name, NULL, 0)
+#define FFTRACE_INSTANT(name, value)        FFTRACE_EVENT('i', name, NULL, value)
+#define FFTRACE_COUNTER(name, value)        FFTRACE_EVENT('C', name, NULL, value)
+#define FFTRACE_ASYNC_BEGIN(name, id)       FFTRACE_EVENT('b', name, NULL, id)
+#define FFTRACE_ASYNC_STEP(name, id, step)  FFTRACE_EVENT('n', name, step, id)
+#define FFTRACE_ASYNC_END(name, id)         FFTRACE_EVENT('e', name, NULL, id)
+
+#endif /* ff_trace_h */
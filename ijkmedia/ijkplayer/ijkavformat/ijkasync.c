@@ -31,30 +31,48 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/error.h"
-#include "libavutil/fifo.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavformat/url.h"
+#include <limits.h>
 #include <stdint.h>
 
 #include "libavformat/application.h"
-#include <pthread/pthread.h>
+#include <pthread.h>
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 
 #define SHORT_SEEK_THRESHOLD    (256 * 1024)
 
+#define FILL_SIZE_MIN           (4 * 1024)
+#define FILL_SIZE_MAX           (256 * 1024)
+
+/*
+ * owned here rather than in an AVFifoBuffer, the reader peeks in place behind the read
+ * position and the background thread reads the inner url straight into the free space.
+ */
 typedef struct RingBuffer
 {
-    AVFifoBuffer *fifo;
+    uint8_t      *buffer;
+    int           capacity;
     int           read_back_capacity;
 
+    // oldest byte kept, read back included
+    int           head;
+    // bytes from head, read back included
+    int           filled;
     int           read_pos;
 } RingBuffer;
 
+typedef struct RingSpan
+{
+    uint8_t      *data;
+    int           size;
+} RingSpan;
+
 typedef struct Context {
     AVClass        *class;
     URLContext     *inner;
@@ -81,9 +99,13 @@ typedef struct Context {
     int             abort_request;
     AVIOInterruptCB interrupt_callback;
 
+    int             fill_size;
+    int64_t         statistic_time;
+
     /* options */
     int64_t         forwards_capacity;
     int64_t         backwards_capacity;
+    int             statistic_interval;
     int64_t         app_ctx_intptr;
     AVApplicationContext *app_ctx;
 } Context;
@@ -91,55 +113,83 @@ typedef struct Context {
 static int ring_init(RingBuffer *ring, int64_t capacity, int64_t read_back_capacity)
 {
     memset(ring, 0, sizeof(RingBuffer));
-    ring->fifo = av_fifo_alloc((unsigned int)(capacity + read_back_capacity));
-    if (!ring->fifo)
+    if (capacity + read_back_capacity > INT_MAX)
+        return AVERROR(EINVAL);
+    ring->buffer = av_malloc(capacity + read_back_capacity);
+    if (!ring->buffer)
         return AVERROR(ENOMEM);
 
+    ring->capacity           = (int)(capacity + read_back_capacity);
     ring->read_back_capacity = (int)read_back_capacity;
     return 0;
 }
 
 static void ring_destroy(RingBuffer *ring)
 {
-    av_fifo_freep(&ring->fifo);
+    av_freep(&ring->buffer);
 }
 
 static void ring_reset(RingBuffer *ring)
 {
-    av_fifo_reset(ring->fifo);
+    ring->head     = 0;
+    ring->filled   = 0;
     ring->read_pos = 0;
 }
 
 static int ring_size(RingBuffer *ring)
 {
-    return av_fifo_size(ring->fifo) - ring->read_pos;
+    return ring->filled - ring->read_pos;
 }
 
 static int ring_space(RingBuffer *ring)
 {
-    return av_fifo_space(ring->fifo);
+    return ring->capacity - ring->filled;
 }
 
-static int ring_generic_read(RingBuffer *ring, void *dest, int buf_size, void (*func)(void*, void*, int))
+/* peek up to two contiguous spans of readable ring memory, starting at the read position */
+static int ring_peek_spans(RingBuffer *ring, int buf_size, RingSpan spans[2])
 {
-    int ret;
+    int start = (ring->head + ring->read_pos) % ring->capacity;
+    int len   = FFMIN(ring->capacity - start, buf_size);
+
+    av_assert2(buf_size <= ring_size(ring));
+    spans[0].data = ring->buffer + start;
+    spans[0].size = len;
+    spans[1].data = ring->buffer;
+    spans[1].size = buf_size - len;
+    return buf_size;
+}
 
+static void ring_skip(RingBuffer *ring, int buf_size)
+{
     av_assert2(buf_size <= ring_size(ring));
-    ret = av_fifo_generic_peek_at(ring->fifo, dest, ring->read_pos, buf_size, func);
     ring->read_pos += buf_size;
 
     if (ring->read_pos > ring->read_back_capacity) {
-        av_fifo_drain(ring->fifo, ring->read_pos - ring->read_back_capacity);
+        int drop = ring->read_pos - ring->read_back_capacity;
+        ring->head     = (ring->head + drop) % ring->capacity;
+        ring->filled  -= drop;
         ring->read_pos = ring->read_back_capacity;
     }
+}
 
-    return ret;
+/*
+ * single inner read straight into the contiguous free space behind the filled bytes.
+ * ring_skip moves head and filled together, so that space stays put without the mutex,
+ * the bytes only become readable once ring_commit publishes them under it.
+ */
+static int ring_fill(RingBuffer *ring, void *src, int size, int (*func)(void*, void*, int))
+{
+    int wpos = (ring->head + ring->filled) % ring->capacity;
+
+    av_assert2(size <= ring_space(ring));
+    return func(src, ring->buffer + wpos, FFMIN(ring->capacity - wpos, size));
 }
 
-static int ring_generic_write(RingBuffer *ring, void *src, int size, int (*func)(void*, void*, int))
+static void ring_commit(RingBuffer *ring, int size)
 {
     av_assert2(size <= ring_space(ring));
-    return av_fifo_generic_write(ring->fifo, src, size, func);
+    ring->filled += size;
 }
 
 static int ring_size_of_read_back(RingBuffer *ring)
@@ -150,7 +200,7 @@ static int ring_size_of_read_back(RingBuffer *ring)
 static int ring_drain(RingBuffer *ring, int offset)
 {
     av_assert2(offset >= -ring_size_of_read_back(ring));
-    av_assert2(offset <= -ring_size(ring));
+    av_assert2(offset <= ring_size(ring));
     ring->read_pos += offset;
     return 0;
 }
@@ -181,6 +231,18 @@ static int wrapped_url_read(void *src, void *dst, int size)
     return ret;
 }
 
+/* must be called with c->mutex held */
+static int async_statistic_due(Context *c)
+{
+    int64_t now = av_gettime_relative();
+
+    if (now - c->statistic_time < c->statistic_interval * 1000LL)
+        return 0;
+
+    c->statistic_time = now;
+    return 1;
+}
+
 static void call_inject_statistic(URLContext *h)
 {
     Context *c = h->priv_data;
@@ -222,7 +284,7 @@ static void *async_buffer_task(void *arg)
     int64_t       count_start_time_micro = av_gettime_relative();
 
     while (1) {
-        int fifo_space, to_copy;
+        int fifo_space, to_copy, statistic_due;
 
         pthread_mutex_lock(&c->mutex);
         if (async_check_interrupt(h)) {
@@ -248,6 +310,7 @@ static void *async_buffer_task(void *arg)
             c->seek_request   = 0;
 
             ring_reset(ring);
+            c->fill_size = FILL_SIZE_MIN;
 
             pthread_cond_signal(&c->cond_wakeup_main);
             pthread_mutex_unlock(&c->mutex);
@@ -266,9 +329,15 @@ static void *async_buffer_task(void *arg)
         }
         pthread_mutex_unlock(&c->mutex);
 
-        to_copy = FFMIN(4096, fifo_space);
-        ret = ring_generic_write(ring, (void *)h, to_copy, (void *)wrapped_url_read);
+        to_copy = FFMIN(c->fill_size, fifo_space);
+        ret = ring_fill(ring, (void *)h, to_copy, wrapped_url_read);
         if (ret > 0) {
+            /* grow while the source keeps up, shrink back on short reads */
+            if (ret >= to_copy)
+                c->fill_size = FFMIN(c->fill_size * 2, FILL_SIZE_MAX);
+            else if (ret < to_copy / 2)
+                c->fill_size = FFMAX(c->fill_size / 2, FILL_SIZE_MIN);
+
             count_bytes += ret;
             if (count_bytes > FFMIN((1 * 1024 * 1024), c->forwards_capacity)) {
                 int64_t now = av_gettime_relative();
@@ -280,16 +349,20 @@ static void *async_buffer_task(void *arg)
         }
 
         pthread_mutex_lock(&c->mutex);
-        if (ret <= 0) {
+        if (ret > 0) {
+            ring_commit(ring, ret);
+        } else {
             c->io_eof_reached = 1;
             if (c->inner_io_error < 0)
                 c->io_error = c->inner_io_error;
         }
 
+        statistic_due = async_statistic_due(c) || c->io_eof_reached;
         pthread_cond_signal(&c->cond_wakeup_main);
         pthread_mutex_unlock(&c->mutex);
 
-        call_inject_statistic(h);
+        if (statistic_due)
+            call_inject_statistic(h);
     }
 
     return NULL;
@@ -303,6 +376,8 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "async:", &arg);
 
+    c->fill_size = FILL_SIZE_MIN;
+
     ret = ring_init(&c->ring, c->forwards_capacity, c->backwards_capacity);
     if (ret < 0)
         goto fifo_fail;
@@ -392,6 +467,7 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
     RingBuffer   *ring    = &c->ring;
     int           to_read = size;
     int           ret     = 0;
+    int           statistic_due;
 
     pthread_mutex_lock(&c->mutex);
 
@@ -404,9 +480,23 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
         fifo_size = ring_size(ring);
         to_copy   = FFMIN(to_read, fifo_size);
         if (to_copy > 0) {
-            ring_generic_read(ring, dest, to_copy, func);
-            if (!func)
+            if (dest && !func) {
+                RingSpan spans[2];
+
+                /*
+                 * the background thread only ever writes into free space and
+                 * the ring is only reset or drained from this thread, so the
+                 * peeked spans stay valid without holding the mutex.
+                 */
+                ring_peek_spans(ring, to_copy, spans);
+                pthread_mutex_unlock(&c->mutex);
+                memcpy(dest, spans[0].data, spans[0].size);
+                if (spans[1].size > 0)
+                    memcpy((uint8_t *)dest + spans[0].size, spans[1].data, spans[1].size);
                 dest = (uint8_t *)dest + to_copy;
+                pthread_mutex_lock(&c->mutex);
+            }
+            ring_skip(ring, to_copy);
             c->logical_pos += to_copy;
             to_read        -= to_copy;
             ret             = size - to_read;
@@ -426,10 +516,12 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
         pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
     }
 
+    statistic_due = async_statistic_due(c);
     pthread_cond_signal(&c->cond_wakeup_background);
     pthread_mutex_unlock(&c->mutex);
 
-    call_inject_statistic(h);
+    if (statistic_due)
+        call_inject_statistic(h);
     return ret;
 }
 
@@ -535,6 +627,8 @@ static const AVOption options[] = {
         OFFSET(forwards_capacity),  AV_OPT_TYPE_INT64, {.i64 = 128 * 1024}, 128 * 1024, 128 * 1024 * 1024, D },
     { "async-backwards-capacity",   "max bytes that may be seek backward without seeking in inner protocol",
         OFFSET(backwards_capacity), AV_OPT_TYPE_INT64, {.i64 = 128 * 1024}, 128 * 1024, 128 * 1024 * 1024, D },
+    { "async-statistic-interval",   "min milliseconds between two buffer statistic callbacks",
+        OFFSET(statistic_interval), AV_OPT_TYPE_INT, {.i64 = 100}, 0, 10 * 1000, D },
     { "ijkapplication", "AVApplicationContext", OFFSET(app_ctx_intptr), AV_OPT_TYPE_INT64, { .i64 = 0 }, INT64_MIN, INT64_MAX, .flags = D },
     {NULL}
 };
@@ -24,6 +24,8 @@
 
 #include "ijkplayer/ijkavutil/ijkutils.h"
 #include "ijkplayer/ijkavutil/ijkthreadpool.h"
+#include "ijkioblockcache.h"
+#include "ijkiofilemap.h"
 
 #include <stdint.h>
 
@@ -38,11 +40,7 @@ typedef struct IjkIOAppCacheStatistic {
     int64_t logical_file_size;
 } IjkIOAppCacheStatistic;
 
-typedef struct IjkCacheEntry {
-    int64_t logical_pos;
-    int64_t physical_pos;
-    int64_t size;
-} IjkCacheEntry;
+typedef IjkRangeEntry IjkCacheEntry;
 
 typedef struct IjkIOApplicationContext IjkIOApplicationContext;
 struct IjkIOApplicationContext {
@@ -51,6 +49,8 @@ struct IjkIOApplicationContext {
     char cache_file_path[CACHE_FILE_PATH_MAX_LEN];
     int64_t last_physical_pos;
     void *cache_info_map;
+    IjkIOBlockCache *block_cache;
+    IjkIOFileMap *file_map;
     void *opaque;
     int64_t cache_count_bytes;
     int fd;
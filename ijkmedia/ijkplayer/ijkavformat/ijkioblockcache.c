@@ -0,0 +1,340 @@
+/*
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijkioblockcache.h"
+#include "ijkplayer/ijkavutil/ijkutils.h"
+#include "libavutil/log.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MIN_BLOCKS 4
+
+typedef struct IjkIOBlock {
+    int64_t block_no;   // -1 when unused
+    int     size;       // valid bytes, the tail block of the cache file may still grow
+    int     loading;    // a pread into the block runs without the mutex, it can't be evicted
+    int     load_limit; // bytes of that pread still valid after a discard
+    int     abandoned;  // dropped by an invalidate while loading
+    int     lru_prev;
+    int     lru_next;
+    int     hash_next;
+} IjkIOBlock;
+
+struct IjkIOBlockCache {
+    pthread_mutex_t mutex;
+    pthread_cond_t  loaded;     // a block finished loading
+    uint8_t    *data;
+    IjkIOBlock *blocks;
+    int         nb_blocks;
+    int        *buckets;
+    int         bucket_mask;
+    int         lru_head;   // most recently used
+    int         lru_tail;   // next victim
+
+    int64_t     hit_count;
+    int64_t     miss_count;
+};
+
+static int bucket_of(IjkIOBlockCache *cache, int64_t block_no)
+{
+    uint64_t h = (uint64_t)block_no * 0x9E3779B97F4A7C15ULL;
+    return (int)(h >> 32) & cache->bucket_mask;
+}
+
+static void lru_unlink(IjkIOBlockCache *cache, int i)
+{
+    IjkIOBlock *b = &cache->blocks[i];
+
+    if (b->lru_prev >= 0)
+        cache->blocks[b->lru_prev].lru_next = b->lru_next;
+    else
+        cache->lru_head = b->lru_next;
+
+    if (b->lru_next >= 0)
+        cache->blocks[b->lru_next].lru_prev = b->lru_prev;
+    else
+        cache->lru_tail = b->lru_prev;
+}
+
+static void lru_push_head(IjkIOBlockCache *cache, int i)
+{
+    IjkIOBlock *b = &cache->blocks[i];
+
+    b->lru_prev = -1;
+    b->lru_next = cache->lru_head;
+    if (cache->lru_head >= 0)
+        cache->blocks[cache->lru_head].lru_prev = i;
+    cache->lru_head = i;
+    if (cache->lru_tail < 0)
+        cache->lru_tail = i;
+}
+
+static void hash_remove(IjkIOBlockCache *cache, int i)
+{
+    int *link = &cache->buckets[bucket_of(cache, cache->blocks[i].block_no)];
+
+    while (*link >= 0) {
+        if (*link == i) {
+            *link = cache->blocks[i].hash_next;
+            break;
+        }
+        link = &cache->blocks[*link].hash_next;
+    }
+    cache->blocks[i].hash_next = -1;
+}
+
+static int hash_find(IjkIOBlockCache *cache, int64_t block_no)
+{
+    int i = cache->buckets[bucket_of(cache, block_no)];
+
+    while (i >= 0 && cache->blocks[i].block_no != block_no)
+        i = cache->blocks[i].hash_next;
+    return i;
+}
+
+static void block_cache_reset(IjkIOBlockCache *cache)
+{
+    for (int i = 0; i <= cache->bucket_mask; i++)
+        cache->buckets[i] = -1;
+
+    cache->lru_head = -1;
+    cache->lru_tail = -1;
+    for (int i = 0; i < cache->nb_blocks; i++) {
+        /* a block still loading stays out of use until its reader comes back for it */
+        if (cache->blocks[i].loading)
+            cache->blocks[i].abandoned = 1;
+        cache->blocks[i].block_no  = -1;
+        cache->blocks[i].size      = 0;
+        cache->blocks[i].hash_next = -1;
+        lru_push_head(cache, i);
+    }
+}
+
+/* least recently used block that is not loading, -1 if they all are */
+static int lru_victim(IjkIOBlockCache *cache)
+{
+    int i = cache->lru_tail;
+
+    while (i >= 0 && cache->blocks[i].loading)
+        i = cache->blocks[i].lru_prev;
+    return i;
+}
+
+IjkIOBlockCache *ijkio_block_cache_create(int64_t capacity)
+{
+    IjkIOBlockCache *cache = NULL;
+    int nb_buckets = 1;
+
+    if (capacity <= 0)
+        return NULL;
+
+    cache = calloc(1, sizeof(IjkIOBlockCache));
+    if (!cache)
+        return NULL;
+
+    cache->nb_blocks = (int)FFMAX(capacity / IJKIO_BLOCK_CACHE_BLOCK_SIZE, MIN_BLOCKS);
+    while (nb_buckets < cache->nb_blocks * 2)
+        nb_buckets <<= 1;
+    cache->bucket_mask = nb_buckets - 1;
+
+    cache->data    = malloc((size_t)cache->nb_blocks * IJKIO_BLOCK_CACHE_BLOCK_SIZE);
+    cache->blocks  = calloc(cache->nb_blocks, sizeof(IjkIOBlock));
+    cache->buckets = calloc(nb_buckets, sizeof(int));
+    if (!cache->data || !cache->blocks || !cache->buckets)
+        goto fail;
+
+    if (pthread_mutex_init(&cache->mutex, NULL))
+        goto fail;
+    if (pthread_cond_init(&cache->loaded, NULL)) {
+        pthread_mutex_destroy(&cache->mutex);
+        goto fail;
+    }
+
+    block_cache_reset(cache);
+    return cache;
+
+fail:
+    free(cache->buckets);
+    free(cache->blocks);
+    free(cache->data);
+    free(cache);
+    return NULL;
+}
+
+void ijkio_block_cache_destroyp(IjkIOBlockCache **pcache)
+{
+    IjkIOBlockCache *cache;
+
+    if (!pcache || !*pcache)
+        return;
+
+    cache = *pcache;
+    av_log(NULL, AV_LOG_INFO, "ijkio block cache: %"PRId64" hits, %"PRId64" misses\n",
+           cache->hit_count, cache->miss_count);
+    pthread_cond_destroy(&cache->loaded);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache->buckets);
+    free(cache->blocks);
+    free(cache->data);
+    free(cache);
+    *pcache = NULL;
+}
+
+void ijkio_block_cache_invalidate(IjkIOBlockCache *cache)
+{
+    if (!cache)
+        return;
+
+    pthread_mutex_lock(&cache->mutex);
+    block_cache_reset(cache);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void ijkio_block_cache_discard(IjkIOBlockCache *cache, int64_t physical_pos, int size)
+{
+    int64_t block_no;
+
+    if (!cache || size <= 0)
+        return;
+
+    pthread_mutex_lock(&cache->mutex);
+    for (block_no = physical_pos / IJKIO_BLOCK_CACHE_BLOCK_SIZE;
+         block_no * IJKIO_BLOCK_CACHE_BLOCK_SIZE < physical_pos + size; block_no++) {
+        int i      = hash_find(cache, block_no);
+        int offset = (int)FFMAX(physical_pos - block_no * IJKIO_BLOCK_CACHE_BLOCK_SIZE, 0);
+
+        /* keep what precedes the write, the rest is reloaded on the next read */
+        if (i >= 0 && cache->blocks[i].size > offset)
+            cache->blocks[i].size = offset;
+        if (i >= 0 && cache->blocks[i].loading && cache->blocks[i].load_limit > offset)
+            cache->blocks[i].load_limit = offset;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+/*
+ * make block_no resident with at least min_size valid bytes, return its slot or <0.
+ * called with the mutex held, it is dropped during the pread of a miss so readers of
+ * other blocks go on, readers of the same block wait for that pread instead of their own
+ */
+static int block_cache_load(IjkIOBlockCache *cache, int fd, int64_t block_no, int min_size)
+{
+    IjkIOBlock *b;
+    int waited = 0;
+    int err = 0;
+    ssize_t n;
+    int i;
+
+    for (;;) {
+        i = hash_find(cache, block_no);
+        if (i >= 0 && cache->blocks[i].loading) {
+            pthread_cond_wait(&cache->loaded, &cache->mutex);
+            waited = 1;
+            continue;
+        }
+        /* after waiting, a short block is as far as the cache file goes, no need to read it again */
+        if (i >= 0 && (cache->blocks[i].size >= min_size || waited)) {
+            cache->hit_count++;
+            lru_unlink(cache, i);
+            lru_push_head(cache, i);
+            return i;
+        }
+
+        if (i < 0) {
+            i = lru_victim(cache);
+            if (i < 0) {
+                pthread_cond_wait(&cache->loaded, &cache->mutex);
+                continue;
+            }
+            if (cache->blocks[i].block_no >= 0)
+                hash_remove(cache, i);
+            cache->blocks[i].block_no  = block_no;
+            cache->blocks[i].hash_next = cache->buckets[bucket_of(cache, block_no)];
+            cache->buckets[bucket_of(cache, block_no)] = i;
+        }
+        cache->miss_count++;
+        lru_unlink(cache, i);
+        lru_push_head(cache, i);
+
+        b = &cache->blocks[i];
+        b->size       = 0;
+        b->loading    = 1;
+        b->load_limit = IJKIO_BLOCK_CACHE_BLOCK_SIZE;
+        pthread_mutex_unlock(&cache->mutex);
+
+        n = pread(fd, cache->data + (size_t)i * IJKIO_BLOCK_CACHE_BLOCK_SIZE,
+                  IJKIO_BLOCK_CACHE_BLOCK_SIZE, block_no * IJKIO_BLOCK_CACHE_BLOCK_SIZE);
+        if (n < 0)
+            err = errno;
+
+        pthread_mutex_lock(&cache->mutex);
+        b->loading = 0;
+        pthread_cond_broadcast(&cache->loaded);
+        if (b->abandoned) {
+            /* the cache file was overwritten meanwhile, what was read may be stale */
+            b->abandoned = 0;
+            if (n >= 0)
+                continue;
+        } else if (n < 0) {
+            hash_remove(cache, i);
+            b->block_no = -1;
+        }
+        if (n < 0)
+            return IJKAVERROR(err);
+
+        b->size = (int)FFMIN(n, b->load_limit);
+        return i;
+    }
+}
+
+int ijkio_block_cache_read(IjkIOBlockCache *cache, int fd, int64_t physical_pos, void *buf, int size)
+{
+    uint8_t *dst = buf;
+    int total = 0;
+
+    if (!cache)
+        return (int)pread(fd, buf, size, physical_pos);
+
+    pthread_mutex_lock(&cache->mutex);
+    while (total < size) {
+        int64_t block_no = physical_pos / IJKIO_BLOCK_CACHE_BLOCK_SIZE;
+        int     offset   = (int)(physical_pos % IJKIO_BLOCK_CACHE_BLOCK_SIZE);
+        int     to_copy  = FFMIN(size - total, IJKIO_BLOCK_CACHE_BLOCK_SIZE - offset);
+        int     i        = block_cache_load(cache, fd, block_no, offset + to_copy);
+
+        if (i < 0) {
+            if (total == 0)
+                total = i;
+            break;
+        }
+
+        to_copy = FFMIN(to_copy, cache->blocks[i].size - offset);
+        if (to_copy <= 0)
+            break;
+
+        memcpy(dst + total, cache->data + (size_t)i * IJKIO_BLOCK_CACHE_BLOCK_SIZE + offset, to_copy);
+        total        += to_copy;
+        physical_pos += to_copy;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    return total;
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKAVFORMAT_IJKIOBLOCKCACHE_H
+#define IJKAVFORMAT_IJKIOBLOCKCACHE_H
+
+#include <stdint.h>
+
+#define IJKIO_BLOCK_CACHE_BLOCK_SIZE        (64 * 1024)
+#define DEFAULT_BLOCK_CACHE_CAPACITY        (4 * 1024 * 1024)
+
+/**
+ * Bounded LRU of fixed size blocks of the ijkio cache file, keyed by physical
+ * offset so every IjkURLContext sharing the cache file shares the blocks.
+ */
+typedef struct IjkIOBlockCache IjkIOBlockCache;
+
+IjkIOBlockCache *ijkio_block_cache_create(int64_t capacity);
+void ijkio_block_cache_destroyp(IjkIOBlockCache **pcache);
+
+/**
+ * Read size bytes at physical_pos of fd, from memory when the block is resident.
+ * Does not move the file offset of fd.
+ *
+ * @return number of bytes read, 0 at end of file, <0 on error
+ */
+int ijkio_block_cache_read(IjkIOBlockCache *cache, int fd, int64_t physical_pos, void *buf, int size);
+
+/**
+ * Forget the cached bytes of [physical_pos, physical_pos + size), must be
+ * called once a write to that range of the cache file has completed.
+ */
+void ijkio_block_cache_discard(IjkIOBlockCache *cache, int64_t physical_pos, int size);
+
+/**
+ * Drop every block, must be called whenever cache file data is overwritten.
+ */
+void ijkio_block_cache_invalidate(IjkIOBlockCache *cache);
+
+#endif /* IJKAVFORMAT_IJKIOBLOCKCACHE_H */
@@ -21,7 +21,8 @@
 #include "ijkiourl.h"
 #include "ijkioprotocol.h"
 #include "ijkioapplication.h"
-#include "ijkplayer/ijkavutil/ijktree.h"
+#include "ijkiouring.h"
+#include "ijkplayer/ijkavutil/ijkrangeindex.h"
 #include "ijkplayer/ijkavutil/ijkutils.h"
 #include "ijkplayer/ijkavutil/ijkthreadpool.h"
 #include "ijkplayer/ijkavutil/ijkstl.h"
@@ -43,6 +44,16 @@
 #       define O_BINARY 0
 #   endif
 #define FILE_RW_ERROR  (-100)
+#define CACHE_WRITE_DEPTH 16
+
+typedef struct IjkIOCacheWrite {
+    unsigned char buf[4096];
+    int64_t logical_pos;
+    int64_t physical_pos;
+    int64_t generation;
+    int size;
+    int busy;           // queued on write_ring, buf must not be touched
+} IjkIOCacheWrite;
 
 typedef struct IjkIOCacheContext {
     char *cache_file_path;
@@ -72,8 +83,14 @@ typedef struct IjkIOCacheContext {
 
     int cur_file_no;
     void *cache_info_map;
+    IjkIOBlockCache *block_cache;
+    IjkIOFileMap *file_map;
     int64_t *last_physical_pos;
     int64_t *cache_count_bytes;
+    int64_t file_generation;    // bumped whenever cache file data is recycled, readers recheck it after unlocked reads
+    int file_error_pending;     // reported by the reader, handled by the writer task
+    IjkIOUring *write_ring;
+    IjkIOCacheWrite *pending_writes;
 
     pthread_cond_t     cond_wakeup_main;
     pthread_cond_t     cond_wakeup_file_background;
@@ -83,6 +100,7 @@ typedef struct IjkIOCacheContext {
     int                abort_request;
     IjkAVIOInterruptCB *ijkio_interrupt_callback;
     int task_is_running;
+    IjkThreadPoolFuture *task_future;
 
     IjkURLContext *inner;
     IjkThreadPoolContext *threadpool_ctx;
@@ -94,11 +112,6 @@ typedef struct IjkIOCacheContext {
     int only_read_file;
 } IjkIOCacheContext;
 
-static int cmp(const void *key, const void *node)
-{
-    return FFDIFFSIGN(*(const int64_t *)key, ((const IjkCacheEntry *) node)->logical_pos);
-}
-
 static void call_inject_statistic(IjkURLContext *h)
 {
     IjkIOCacheContext *c = h->priv_data;
@@ -134,17 +147,18 @@ static int ijkio_cache_check_interrupt(IjkURLContext *h)
     return c->abort_request;
 }
 
-static int enu_free(void *opaque, void *elem)
+/* cache file content is about to be recycled or truncated */
+static void ijkio_cache_drop_file_views(IjkIOCacheContext *c)
 {
-    free(elem);
-    return 0;
+    c->file_generation++;
+    ijkio_file_map_invalidate(c->file_map);
+    ijkio_block_cache_invalidate(c->block_cache);
 }
 
 static int tree_destroy(void *parm, int64_t key, void *elem)
 {
     IjkCacheTreeInfo *info = elem;
-    ijk_av_tree_enumerate(info->root, NULL, NULL, enu_free);
-    ijk_av_tree_destroy(info->root);
+    ijk_range_index_clear(&info->ranges);
     free(info);
     return 0;
 }
@@ -160,6 +174,7 @@ static int ijkio_cache_file_error(IjkURLContext *h) {
             ijk_map_traversal_handle(c->cache_info_map, NULL, tree_destroy);
             ijk_map_clear(c->cache_info_map);
             c->tree_info = NULL;
+            ijkio_cache_drop_file_views(c);
             *c->last_physical_pos    = 0;
             c->cache_physical_pos    = 0;
             c->file_inner_pos        = 0;
@@ -210,16 +225,15 @@ static int64_t ijkio_cache_file_overrang(IjkURLContext *h, int64_t *cur_pos, int
         ijk_map_remove(c->cache_info_map, (int64_t)c->cur_file_no);
         ijk_map_traversal_handle(c->cache_info_map, NULL, tree_destroy);
         ijk_map_clear(c->cache_info_map);
+        ijk_range_index_clear(&c->tree_info->ranges);
         memset(c->tree_info, 0, sizeof(IjkCacheTreeInfo));
         ijk_map_put(c->cache_info_map, (int64_t)c->cur_file_no, c->tree_info);
+        ijkio_cache_drop_file_views(c);
         *c->last_physical_pos    = 0;
         c->cache_physical_pos    = 0;
         c->io_eof_reached        = 0;
         c->file_logical_pos      = c->read_logical_pos;
-        *cur_pos = lseek(c->fd, 0, SEEK_SET);
-        if (*cur_pos < 0) {
-            goto fail;
-        }
+        *cur_pos = 0;
     } else {
         goto fail;
     }
@@ -232,95 +246,184 @@ fail:
     return FILE_RW_ERROR;
 }
 
-static int64_t add_entry(IjkURLContext *h, const unsigned char *buf, int size)
+/* under file_mutex, claim size bytes of the cache file, return 0 if the file was recycled instead */
+static int ijkio_cache_reserve(IjkURLContext *h, int size, int64_t *pos)
 {
-    IjkIOCacheContext *c= h->priv_data;
-    int64_t pos = -1;
-    int64_t ret = 0;
-    IjkCacheEntry *entry = NULL, *next[2] = {NULL, NULL};
-    IjkCacheEntry *entry_ret = NULL;
-    struct IjkAVTreeNode *node = NULL;
+    IjkIOCacheContext *c = h->priv_data;
     int64_t free_space = 0;
 
-    //FIXME avoid lseek
-    pos = lseek(c->fd, *c->last_physical_pos, SEEK_SET);
-
-    if (pos < 0) {
-        c->file_handle_retry_count++;
-        return ijkio_cache_file_error(h);
-    } else {
-        c->cache_physical_pos = pos;
-        *c->last_physical_pos = pos;
-    }
-
-    if (pos + size >= c->cache_max_capacity) {
-        free_space = ijkio_cache_file_overrang(h, &pos, size);
+    *pos = *c->last_physical_pos;
+    if (*pos + size >= c->cache_max_capacity) {
+        free_space = ijkio_cache_file_overrang(h, pos, size);
         if (free_space < size) {
             c->cache_file_close = 1;
             return FILE_RW_ERROR;
         }
-        if (pos < 0) {
-            c->file_handle_retry_count++;
-            return ijkio_cache_file_error(h);
-        }
-        if (free_space == c->cache_max_capacity)
-            return 0;
+        return 0;
     }
 
-    ret = write(c->fd, buf, size);
-    if (ret < 0) {
+    c->cache_physical_pos = *pos + size;
+    *c->last_physical_pos = *pos + size;
+    return 1;
+}
+
+/* under file_mutex, publish a finished write so readers can find it */
+static int64_t ijkio_cache_commit(IjkURLContext *h, int64_t logical_pos, int64_t physical_pos,
+                                  int64_t written, int64_t generation)
+{
+    IjkIOCacheContext *c = h->priv_data;
+
+    if (generation != c->file_generation || !c->tree_info)
+        return 0;
+
+    if (written < 0) {
         c->file_handle_retry_count++;
         return ijkio_cache_file_error(h);
-    } else {
-        c->file_handle_retry_count = 0;
     }
+    c->file_handle_retry_count = 0;
+    c->tree_info->physical_size += written;
+    ijkio_block_cache_discard(c->block_cache, physical_pos, (int)written);
 
-    c->cache_physical_pos       += ret;
-    *c->last_physical_pos       += ret;
-    c->tree_info->physical_size += ret;
+    if (ijk_range_index_add(&c->tree_info->ranges, logical_pos, physical_pos, written) < 0) {
+        //we could truncate the file to pos here if pos >=0 but ftruncate isn't available in VS so
+        //for simplicty we just leave the file a bit larger
+        av_log(NULL, AV_LOG_ERROR, "ijk_range_index_add failed\n");
+        return -1;
+    }
+
+    return written;
+}
+
+/* called with file_mutex held, the write itself runs unlocked */
+static int64_t add_entry(IjkURLContext *h, const unsigned char *buf, int size)
+{
+    IjkIOCacheContext *c = h->priv_data;
+    int64_t logical_pos  = c->file_logical_pos;
+    int64_t generation   = c->file_generation;
+    int64_t pos          = -1;
+    int64_t ret          = 0;
+    int fd               = c->fd;
 
-    entry = ijk_av_tree_find(c->tree_info->root, &c->file_logical_pos, cmp, (void**)next);
+    ret = ijkio_cache_reserve(h, size, &pos);
+    if (ret <= 0)
+        return ret;
+
+    pthread_mutex_unlock(&c->file_mutex);
+    ret = pwrite(fd, buf, size, pos);
+    pthread_mutex_lock(&c->file_mutex);
+
+    return ijkio_cache_commit(h, logical_pos, pos, ret, generation);
+}
+
+/* called with file_mutex held, w->buf is written by write_ring, published by ijkio_cache_reap_writes */
+static int64_t queue_entry(IjkURLContext *h, IjkIOCacheWrite *w, int size)
+{
+    IjkIOCacheContext *c = h->priv_data;
+    int64_t ret          = 0;
+
+    ret = ijkio_cache_reserve(h, size, &w->physical_pos);
+    if (ret <= 0)
+        return ret;
+
+    w->logical_pos = c->file_logical_pos;
+    w->generation  = c->file_generation;
+    w->size        = size;
+    w->busy        = 1;
+    if (ijkio_uring_queue_write(c->write_ring, c->fd, w->buf, size, w->physical_pos, w - c->pending_writes) < 0) {
+        int fd = c->fd;
+
+        w->busy = 0;
+        pthread_mutex_unlock(&c->file_mutex);
+        ret = pwrite(fd, w->buf, size, w->physical_pos);
+        pthread_mutex_lock(&c->file_mutex);
+        return ijkio_cache_commit(h, w->logical_pos, w->physical_pos, ret, w->generation);
+    }
+
+    return size;
+}
+
+/* submit queued writes and publish the finished ones, waits for at least min_complete */
+static int ijkio_cache_reap_writes(IjkURLContext *h, int min_complete)
+{
+    IjkIOCacheContext *c = h->priv_data;
+    IjkIOUringCompletion cqes[CACHE_WRITE_DEPTH];
+    int nb_cqes = 0;
+
+    if (!c->write_ring)
+        return 0;
+
+    nb_cqes = ijkio_uring_reap(c->write_ring, cqes, CACHE_WRITE_DEPTH, min_complete);
+    if (nb_cqes <= 0)
+        return nb_cqes;
+
+    pthread_mutex_lock(&c->file_mutex);
+    for (int i = 0; i < nb_cqes; i++) {
+        IjkIOCacheWrite *w = &c->pending_writes[cqes[i].user_data];
 
-    if (!entry)
-        entry = next[0];
+        w->busy = 0;
+        if (w->generation != c->file_generation)
+            continue;
 
-    if (!entry ||
-        entry->logical_pos  + entry->size != c->file_logical_pos ||
-        entry->physical_pos + entry->size != pos) {
-        entry = malloc(sizeof(*entry));
-        node = ijk_av_tree_node_alloc();
-        if (!entry || !node) {
-            ret = IJKAVERROR(ENOMEM);
-            goto fail;
+        if (cqes[i].res > 0)
+            ijkio_cache_commit(h, w->logical_pos, w->physical_pos, cqes[i].res, w->generation);
+
+        if (cqes[i].res < w->size) {
+            int64_t missing = w->logical_pos + FFMAX(cqes[i].res, 0);
+
+            /* download the lost part again unless a seek already moved away from it */
+            if (missing >= c->read_logical_pos && missing < c->file_logical_pos)
+                c->file_logical_pos = missing;
+            if (cqes[i].res < 0) {
+                c->file_handle_retry_count++;
+                c->file_error_pending = 1;
+            }
         }
-        entry->logical_pos = c->file_logical_pos;
-        entry->physical_pos = pos;
-        entry->size = ret;
-
-        entry_ret = ijk_av_tree_insert(&c->tree_info->root, entry, cmp, &node);
-        if (entry_ret && entry_ret != entry) {
-            ret = -1;
-            av_log(NULL, AV_LOG_ERROR, "av_tree_insert failed\n");
-            goto fail;
+    }
+    pthread_cond_signal(&c->cond_wakeup_main);
+    pthread_mutex_unlock(&c->file_mutex);
+
+    return nb_cqes;
+}
+
+static void ijkio_cache_drain_writes(IjkURLContext *h)
+{
+    IjkIOCacheContext *c = h->priv_data;
+
+    while (ijkio_uring_inflight(c->write_ring) > 0) {
+        if (ijkio_cache_reap_writes(h, ijkio_uring_inflight(c->write_ring)) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "ijkio cache: io_uring completion failed\n");
+            break;
         }
-    } else
-        entry->size += ret;
+    }
+}
 
-    return ret;
-fail:
-    //we could truncate the file to pos here if pos >=0 but ftruncate isn't available in VS so
-    //for simplicty we just leave the file a bit larger
-    free(entry);
-    free(node);
-    return ret;
+/* a buffer whose write is not in flight, completions arrive in any order */
+static IjkIOCacheWrite *ijkio_cache_get_write_slot(IjkURLContext *h)
+{
+    IjkIOCacheContext *c = h->priv_data;
+
+    if (!c->write_ring)
+        return NULL;
+
+    while (1) {
+        for (int i = 0; i < CACHE_WRITE_DEPTH; i++) {
+            if (!c->pending_writes[i].busy)
+                return &c->pending_writes[i];
+        }
+        if (ijkio_cache_reap_writes(h, 1) < 0)
+            return NULL;
+    }
 }
 
-static int wrapped_file_read(IjkURLContext *h, void *dst, int size)
+/* positional read from the mapping or the shared block cache, leaves the file offset untouched */
+static int wrapped_file_read(IjkURLContext *h, int fd, void *dst, int64_t physical_pos, int size)
 {
     IjkIOCacheContext *c   = h->priv_data;
     int ret;
 
-    ret = (int)read(c->fd, dst, size);
+    ret = c->file_map ? ijkio_file_map_read(c->file_map, fd, physical_pos, dst, size) : -1;
+    if (ret < 0)
+        ret = ijkio_block_cache_read(c->block_cache, fd, physical_pos, dst, size);
     c->read_file_inner_error = ret < 0 ? ret : 0;
     return ret;
 }
@@ -376,19 +479,22 @@ static int ijkio_cache_io_open(IjkURLContext *h, const char *url, int flags, Ijk
 static int64_t ijkio_cache_write_file(IjkURLContext *h) {
     IjkIOCacheContext *c= h->priv_data;
     int64_t r;
-    unsigned char buf[4096] = {0};
+    unsigned char stack_buf[4096] = {0};
+    unsigned char *buf = stack_buf;
     int to_read = 4096;
     int64_t to_copy = (int64_t)to_read;
 
-    IjkCacheEntry *root = NULL ,*l_entry = NULL, *r_entry = NULL, *next[2] = {NULL, NULL};
+    IjkCacheEntry *l_entry = NULL, *r_entry = NULL;
+    IjkIOCacheWrite *w = NULL;
 
     if (!c || !c->inner || !c->inner->prot)
         return IJKAVERROR(ENOSYS);
 
-    root = ijk_av_tree_find(c->tree_info->root, &c->file_logical_pos, cmp, (void**)next);
+    w = ijkio_cache_get_write_slot(h);
+    if (w)
+        buf = w->buf;
 
-    if (!root)
-        l_entry = next[0];
+    l_entry = ijk_range_index_find(&c->tree_info->ranges, c->file_logical_pos, &r_entry);
 
     if (l_entry) {
         int64_t in_block_pos = c->file_logical_pos - l_entry->logical_pos;
@@ -396,16 +502,8 @@ static int64_t ijkio_cache_write_file(IjkURLContext *h) {
         if (in_block_pos < l_entry->size) {
             c->file_logical_pos = l_entry->logical_pos + l_entry->size;
         }
-    } else if (root) {
-        int64_t in_block_pos = c->file_logical_pos - root->logical_pos;
-        assert(root->logical_pos <= c->file_logical_pos);
-        if (in_block_pos < root->size) {
-            c->file_logical_pos = root->logical_pos + root->size;
-        }
     }
 
-    r_entry = next[1];
-
     if (r_entry) {
         to_copy = r_entry->logical_pos - c->file_logical_pos;
         to_copy = FFMIN(to_copy, to_read);
@@ -467,8 +565,15 @@ static int64_t ijkio_cache_write_file(IjkURLContext *h) {
     *c->cache_count_bytes += r;
     c->file_inner_pos += r;
 
+    /* writes in flight must land before the cache file is recycled */
+    if (*c->last_physical_pos + r >= c->cache_max_capacity)
+        ijkio_cache_drain_writes(h);
+
     pthread_mutex_lock(&c->file_mutex);
-    r = add_entry(h, buf, (int)r);
+    if (w)
+        r = queue_entry(h, w, (int)r);
+    else
+        r = add_entry(h, buf, (int)r);
 
     if (r > 0) {
         c->file_logical_pos += r;
@@ -476,6 +581,9 @@ static int64_t ijkio_cache_write_file(IjkURLContext *h) {
     }
     pthread_mutex_unlock(&c->file_mutex);
 
+    if (w)
+        ijkio_cache_reap_writes(h, 0);
+
     return r;
 }
 
@@ -494,6 +602,16 @@ static void ijkio_cache_task(void *h, void *r) {
             break;
         }
 
+        if (c->file_error_pending) {
+            ijkio_cache_drain_writes(h);
+            pthread_mutex_lock(&c->file_mutex);
+            c->file_error_pending = 0;
+            ijkio_cache_file_error(h);
+            pthread_cond_signal(&c->cond_wakeup_main);
+            pthread_mutex_unlock(&c->file_mutex);
+            continue;
+        }
+
         if (c->seek_request) {
             pthread_mutex_lock(&c->file_mutex);
             c->io_eof_reached    = 0;
@@ -509,6 +627,7 @@ static void ijkio_cache_task(void *h, void *r) {
 
         if (((c->file_logical_pos - c->read_logical_pos > c->cache_file_forwards_capacity)
             || c->io_eof_reached)) {
+            ijkio_cache_drain_writes(h);
             pthread_mutex_lock(&c->file_mutex);
             pthread_cond_signal(&c->cond_wakeup_main);
             pthread_cond_wait(&c->cond_wakeup_file_background, &c->file_mutex);
@@ -526,6 +645,7 @@ static void ijkio_cache_task(void *h, void *r) {
 
         call_inject_statistic(h);
     }
+    ijkio_cache_drain_writes(h);
     pthread_mutex_lock(&c->file_mutex);
     c->task_is_running = 0;
     pthread_cond_signal(&c->cond_wakeup_main);
@@ -590,6 +710,8 @@ static int ijkio_cache_open(IjkURLContext *h, const char *url, int flags, IjkAVD
 
     c->threadpool_ctx       = c->ijkio_app_ctx->threadpool_ctx;
     c->cache_info_map       = c->ijkio_app_ctx->cache_info_map;
+    c->block_cache          = c->ijkio_app_ctx->block_cache;
+    c->file_map             = c->ijkio_app_ctx->file_map;
     c->last_physical_pos    = &c->ijkio_app_ctx->last_physical_pos;
     c->cache_count_bytes    = &c->ijkio_app_ctx->cache_count_bytes;
     if (!c->last_physical_pos || !c->threadpool_ctx || !c->cache_info_map) {
@@ -610,10 +732,12 @@ static int ijkio_cache_open(IjkURLContext *h, const char *url, int flags, IjkAVD
                         av_log(NULL, AV_LOG_WARNING, "ijkio cache exist is error, will delete last_physical_pos = %lld, cur_exist_file_size = %lld\n", *c->last_physical_pos, cur_exist_file_size);
                         ijk_map_traversal_handle(c->cache_info_map, NULL, tree_destroy);
                         ijk_map_clear(c->cache_info_map);
+                        ijkio_cache_drop_file_views(c);
                         *c->last_physical_pos    = 0;
                         c->cache_physical_pos    = 0;
                     }
                 } else {
+                    ijkio_cache_drop_file_views(c);
                     c->fd = open(c->cache_file_path, O_RDWR | O_BINARY | O_CREAT | O_TRUNC, 0600);
                 }
                 c->ijkio_app_ctx->fd = c->fd;
@@ -626,6 +750,7 @@ static int ijkio_cache_open(IjkURLContext *h, const char *url, int flags, IjkAVD
             int64_t seek_ret = lseek(c->fd, *c->last_physical_pos, SEEK_SET);
             if (seek_ret < 0) {
                 c->cache_file_close = 1;
+                ijkio_cache_drop_file_views(c);
                 close(c->fd);
                 c->fd = -1;
                 c->ijkio_app_ctx->fd = -1;
@@ -692,8 +817,19 @@ static int ijkio_cache_open(IjkURLContext *h, const char *url, int flags, IjkAVD
     }
 
     if (!c->cache_file_close && c->cache_file_forwards_capacity) {
+        t = ijk_av_dict_get(*options, "cache_file_io_uring", NULL, IJK_AV_DICT_MATCH_CASE);
+        if (t && strtol(t->value, NULL, 10)) {
+            c->write_ring = ijkio_uring_create(CACHE_WRITE_DEPTH);
+            if (c->write_ring) {
+                c->pending_writes = calloc(CACHE_WRITE_DEPTH, sizeof(IjkIOCacheWrite));
+                if (!c->pending_writes)
+                    ijkio_uring_destroyp(&c->write_ring);
+            }
+        }
+
         c->task_is_running = 1;
-        ret = ijk_threadpool_add(c->threadpool_ctx, ijkio_cache_task, h, NULL, 0);
+        ret = ijk_threadpool_submit(c->threadpool_ctx, ijkio_cache_task, h, NULL,
+                                    IJK_THREADPOOL_PRIORITY_BACKGROUND, &c->task_future);
         if (ret) {
             c->task_is_running = 0;
             pthread_cond_signal(&c->cond_wakeup_exit);
@@ -704,6 +840,9 @@ static int ijkio_cache_open(IjkURLContext *h, const char *url, int flags, IjkAVD
     return 0;
 
 thread_fail:
+    ijkio_uring_destroyp(&c->write_ring);
+    free(c->pending_writes);
+    c->pending_writes = NULL;
     pthread_cond_destroy(&c->cond_wakeup_exit);
 cond_wakeup_exit_fail:
     pthread_cond_destroy(&c->cond_wakeup_file_background);
@@ -731,46 +870,48 @@ url_fail:
     return ret;
 }
 
+/* called with file_mutex held, the read itself runs unlocked */
 static int ijkio_file_read(IjkURLContext *h, void *dest, int to_read)
 {
     IjkIOCacheContext *c   = h->priv_data;
     IjkCacheEntry *entry   = NULL;
-    IjkCacheEntry *next[2] = {NULL, NULL};
     int64_t ret            = 0;
     int to_copy            = 0;
 
-    if (!c->tree_info)
-        return 0;
+    while (c->tree_info) {
+        int64_t generation = c->file_generation;
+        int64_t in_block_pos;
+        int64_t physical_target;
+        int fd;
 
-    entry = ijk_av_tree_find(c->tree_info->root, &c->read_logical_pos, cmp, (void**)next);
-    if (!entry)
-        entry = next[0];
+        entry = ijk_range_index_find(&c->tree_info->ranges, c->read_logical_pos, NULL);
+        if (!entry)
+            break;
 
-    if (entry) {
-        int64_t in_block_pos = c->read_logical_pos - entry->logical_pos;
-        if (in_block_pos < entry->size && entry->logical_pos <= c->read_logical_pos) {
-            int64_t physical_target = entry->physical_pos + in_block_pos;
-            if (c->cache_physical_pos != physical_target) {
-                ret = lseek(c->fd, physical_target, SEEK_SET);
-                if (ret < 0) {
-                    c->file_handle_retry_count++;
-                    ijkio_cache_file_error(h);
-                }
-            } else {
-                ret = c->cache_physical_pos;
-            }
+        in_block_pos = c->read_logical_pos - entry->logical_pos;
+        if (in_block_pos >= entry->size || entry->logical_pos > c->read_logical_pos)
+            break;
 
-            if (ret >= 0) {
-                to_copy = (int)FFMIN(to_read, entry->size - in_block_pos);
-                ret = wrapped_file_read(h, dest, to_copy);
-                if (ret < 0) {
-                    if(c->read_file_inner_error) {
-                        c->file_handle_retry_count++;
-                        ijkio_cache_file_error(h);
-                    }
-                }
-            }
+        physical_target = entry->physical_pos + in_block_pos;
+        to_copy         = (int)FFMIN(to_read, entry->size - in_block_pos);
+        fd              = c->fd;
+
+        pthread_mutex_unlock(&c->file_mutex);
+        ret = wrapped_file_read(h, fd, dest, physical_target, to_copy);
+        pthread_mutex_lock(&c->file_mutex);
+
+        if (generation != c->file_generation) {
+            /* the range was recycled while reading, look it up again */
+            ret = 0;
+            continue;
         }
+
+        if (ret < 0 && c->read_file_inner_error) {
+            /* the writer task may have a write in flight, let it recreate the file */
+            c->file_handle_retry_count++;
+            c->file_error_pending = 1;
+        }
+        break;
     }
     return (int)ret;
 }
@@ -780,75 +921,29 @@ static int64_t sync_add_entry(IjkURLContext *h, const unsigned char *buf, int si
     IjkIOCacheContext *c= h->priv_data;
     int64_t pos = -1;
     int64_t ret = 0;
-    IjkCacheEntry *entry = NULL, *next[2] = {NULL, NULL};
-    IjkCacheEntry *entry_ret = NULL;
-    struct IjkAVTreeNode *node = NULL;
-    int64_t free_space = 0;
 
-    if (*c->last_physical_pos != c->cache_physical_pos) {
-        pos = lseek(c->fd, *c->last_physical_pos, SEEK_SET);
-        if (pos < 0) {
-            return FILE_RW_ERROR;
-        } else {
-            c->cache_physical_pos = pos;
-            *c->last_physical_pos = pos;
-        }
-    } else {
-        pos = *c->last_physical_pos;
-    }
-
-    if (*c->last_physical_pos + size >= c->cache_max_capacity) {
-        free_space = ijkio_cache_file_overrang(h, &pos, size);
-        if (free_space < size || pos < 0) {
-            return FILE_RW_ERROR;
-        }
-        c->cache_physical_pos = pos;
-        *c->last_physical_pos = pos;
+    ret = ijkio_cache_reserve(h, size, &pos);
+    if (ret == 0)
+        ret = ijkio_cache_reserve(h, size, &pos);
+    if (ret <= 0) {
+        return FILE_RW_ERROR;
     }
 
-    ret = write(c->fd, buf, size);
+    ret = pwrite(c->fd, buf, size, pos);
     if (ret < 0) {
         return FILE_RW_ERROR;
     }
 
-    c->cache_physical_pos       += ret;
-    *c->last_physical_pos       += ret;
     c->tree_info->physical_size += ret;
+    ijkio_block_cache_discard(c->block_cache, pos, (int)ret);
 
-    entry = ijk_av_tree_find(c->tree_info->root, &c->read_logical_pos, cmp, (void**)next);
-
-    if (!entry)
-        entry = next[0];
-
-    if (!entry ||
-        entry->logical_pos  + entry->size != c->read_logical_pos ||
-        entry->physical_pos + entry->size != pos) {
-        entry = malloc(sizeof(*entry));
-        node = ijk_av_tree_node_alloc();
-        if (!entry || !node) {
-            ret = IJKAVERROR(ENOMEM);
-            goto fail;
-        }
-        entry->logical_pos = c->read_logical_pos;
-        entry->physical_pos = pos;
-        entry->size = ret;
-
-        entry_ret = ijk_av_tree_insert(&c->tree_info->root, entry, cmp, &node);
-        if (entry_ret && entry_ret != entry) {
-            ret = -1;
-            av_log(NULL, AV_LOG_ERROR, "sync_add_entry av_tree_insert failed\n");
-            goto fail;
-        }
-    } else {
-        entry->size += ret;
+    if (ijk_range_index_add(&c->tree_info->ranges, c->read_logical_pos, pos, ret) < 0) {
+        //we could truncate the file to pos here if pos >=0 but ftruncate isn't available in VS so
+        //for simplicty we just leave the file a bit larger
+        av_log(NULL, AV_LOG_ERROR, "sync_add_entry ijk_range_index_add failed\n");
+        return -1;
     }
 
-    return ret;
-fail:
-    //we could truncate the file to pos here if pos >=0 but ftruncate isn't available in VS so
-    //for simplicty we just leave the file a bit larger
-    free(entry);
-    free(node);
     return ret;
 }
 
@@ -857,7 +952,7 @@ static int ijkio_cache_sync_read(IjkURLContext *h, unsigned char *buf, int size)
     int64_t ret = 0;
     int to_read = size;
     int to_copy = 0;
-    IjkCacheEntry *entry = NULL, *next_entry = NULL, *next[2] = {NULL, NULL};
+    IjkCacheEntry *entry = NULL, *next_entry = NULL;
 
     if (!c || !c->inner || !c->inner->prot)
         return IJKAVERROR(ENOSYS);
@@ -867,36 +962,26 @@ static int ijkio_cache_sync_read(IjkURLContext *h, unsigned char *buf, int size)
     }
 
     if (c->tree_info) {
-        entry = ijk_av_tree_find(c->tree_info->root, &c->read_logical_pos, cmp, (void**)next);
+        entry = ijk_range_index_find(&c->tree_info->ranges, c->read_logical_pos, &next_entry);
     }
 
-    if (!entry)
-        entry = next[0];
-
     if (entry) {
         int64_t in_block_pos = c->read_logical_pos - entry->logical_pos;
         if (in_block_pos < entry->size && entry->logical_pos <= c->read_logical_pos) {
             int64_t physical_target = entry->physical_pos + in_block_pos;
-            if (c->cache_physical_pos != physical_target) {
-                ret = lseek(c->fd, physical_target, SEEK_SET);
-            } else {
-                ret = c->cache_physical_pos;
-            }
 
+            to_copy = (int)FFMIN(to_read, entry->size - in_block_pos);
+            ret = wrapped_file_read(h, c->fd, buf, physical_target, to_copy);
             if (ret >= 0) {
-                c->cache_physical_pos = ret;
-                to_copy = (int)FFMIN(to_read, entry->size - in_block_pos);
-                ret = wrapped_file_read(h, buf, to_copy);
-                if (ret >= 0) {
-                    c->cache_physical_pos += ret;
-                    return (int)ret;
-                }
+                return (int)ret;
             }
 
             av_log(NULL, AV_LOG_ERROR, "%s cache file is bad, will try recreate\n", __func__);
             ijk_map_traversal_handle(c->cache_info_map, NULL, tree_destroy);
             ijk_map_clear(c->cache_info_map);
             c->tree_info             = NULL;
+            next_entry               = NULL;
+            ijkio_cache_drop_file_views(c);
             *c->last_physical_pos    = 0;
             c->cache_physical_pos    = 0;
             c->io_eof_reached        = 0;
@@ -933,7 +1018,6 @@ static int ijkio_cache_sync_read(IjkURLContext *h, unsigned char *buf, int size)
         c->read_inner_pos = ret;
     }
 
-    next_entry = next[1];
     if (next_entry && next_entry->logical_pos > c->read_logical_pos) {
         to_copy = (int)FFMIN(to_read, next_entry->logical_pos - c->read_logical_pos);
     } else {
@@ -1087,14 +1171,22 @@ static int ijkio_cache_close(IjkURLContext *h) {
         pthread_mutex_lock(&c->file_mutex);
         c->abort_request = 1;
         pthread_cond_signal(&c->cond_wakeup_file_background);
+        // still queued behind the tasks of other streams, it never has to run
+        if (ijk_threadpool_future_cancel(c->task_future) == IJK_THREADPOOL_TASK_CANCELLED)
+            c->task_is_running = 0;
         while (c->task_is_running) {
             pthread_cond_wait(&c->cond_wakeup_exit, &c->file_mutex);
         }
         pthread_mutex_unlock(&c->file_mutex);
+        ijk_threadpool_future_releasep(&c->task_future);
     } else {
         c->abort_request = 1;
     }
 
+    ijkio_uring_destroyp(&c->write_ring);
+    free(c->pending_writes);
+    c->pending_writes = NULL;
+
     pthread_cond_destroy(&c->cond_wakeup_file_background);
     pthread_cond_destroy(&c->cond_wakeup_main);
     pthread_cond_destroy(&c->cond_wakeup_exit);
@@ -1127,10 +1219,14 @@ static int ijkio_cache_pause(IjkURLContext *h) {
         pthread_mutex_lock(&c->file_mutex);
         c->abort_request = 1;
         pthread_cond_signal(&c->cond_wakeup_file_background);
+        // still queued behind the tasks of other streams, it never has to run
+        if (ijk_threadpool_future_cancel(c->task_future) == IJK_THREADPOOL_TASK_CANCELLED)
+            c->task_is_running = 0;
         while (c->task_is_running) {
             pthread_cond_wait(&c->cond_wakeup_exit, &c->file_mutex);
         }
         pthread_mutex_unlock(&c->file_mutex);
+        ijk_threadpool_future_releasep(&c->task_future);
     }
 
     return ret;
@@ -1149,6 +1245,7 @@ static int ijkio_cache_resume(IjkURLContext *h) {
             int64_t seek_ret = lseek(c->fd, *c->last_physical_pos, SEEK_SET);
             if (seek_ret < 0) {
                 c->cache_file_close = 1;
+                ijkio_cache_drop_file_views(c);
                 close(c->fd);
                 c->fd = -1;
                 c->ijkio_app_ctx->fd = -1;
@@ -1169,7 +1266,8 @@ static int ijkio_cache_resume(IjkURLContext *h) {
 
     if (!c->cache_file_close && c->cache_file_forwards_capacity) {
         c->task_is_running = 1;
-        ret = ijk_threadpool_add(c->threadpool_ctx, ijkio_cache_task, h, NULL, 0);
+        ret = ijk_threadpool_submit(c->threadpool_ctx, ijkio_cache_task, h, NULL,
+                                    IJK_THREADPOOL_PRIORITY_BACKGROUND, &c->task_future);
         if (ret) {
             c->task_is_running = 0;
             pthread_cond_signal(&c->cond_wakeup_exit);
@@ -0,0 +1,144 @@
+/*
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijkiofilemap.h"
+#include "ijkplayer/ijkavutil/ijkutils.h"
+#include "libavutil/log.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FILE_MAP_GROW_STEP      (64 * 1024 * 1024)
+#define FILE_MAP_MAX_SIZE_32BIT (256 * 1024 * 1024)
+
+struct IjkIOFileMap {
+    pthread_mutex_t mutex;
+    int      fd;
+    uint8_t *data;
+    int64_t  size;
+    int64_t  file_size;     // bytes known to be backed by the file, never read past it
+    int64_t  max_size;
+};
+
+IjkIOFileMap *ijkio_file_map_create(void)
+{
+    IjkIOFileMap *map = calloc(1, sizeof(IjkIOFileMap));
+    if (!map)
+        return NULL;
+
+    if (pthread_mutex_init(&map->mutex, NULL)) {
+        free(map);
+        return NULL;
+    }
+
+    map->fd       = -1;
+    map->max_size = sizeof(void *) >= 8 ? INT64_MAX : FILE_MAP_MAX_SIZE_32BIT;
+    return map;
+}
+
+static void file_map_unmap(IjkIOFileMap *map)
+{
+    if (map->data)
+        munmap(map->data, (size_t)map->size);
+    map->data      = NULL;
+    map->size      = 0;
+    map->file_size = 0;
+    map->fd        = -1;
+}
+
+void ijkio_file_map_destroyp(IjkIOFileMap **pmap)
+{
+    if (!pmap || !*pmap)
+        return;
+
+    file_map_unmap(*pmap);
+    pthread_mutex_destroy(&(*pmap)->mutex);
+    free(*pmap);
+    *pmap = NULL;
+}
+
+void ijkio_file_map_invalidate(IjkIOFileMap *map)
+{
+    if (!map)
+        return;
+
+    pthread_mutex_lock(&map->mutex);
+    file_map_unmap(map);
+    pthread_mutex_unlock(&map->mutex);
+}
+
+/* map at least [0, end) of fd, only pages backed by the file are ever touched */
+static int file_map_ensure(IjkIOFileMap *map, int fd, int64_t end)
+{
+    struct stat st;
+    int64_t new_size;
+    void *data;
+
+    if (map->data && map->fd == fd && end <= map->file_size)
+        return 0;
+
+    if (end > map->max_size)
+        return IJKAVERROR(ENOMEM);
+
+    if (fstat(fd, &st) < 0)
+        return IJKAVERROR(errno);
+    if (end > st.st_size)
+        return IJKAVERROR(EINVAL);
+
+    if (map->data && map->fd == fd && end <= map->size) {
+        map->file_size = FFMIN(st.st_size, map->size);
+        return 0;
+    }
+
+    new_size = (end + FILE_MAP_GROW_STEP - 1) / FILE_MAP_GROW_STEP * FILE_MAP_GROW_STEP;
+    new_size = FFMIN(new_size, map->max_size);
+
+    file_map_unmap(map);
+    data = mmap(NULL, (size_t)new_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        av_log(NULL, AV_LOG_WARNING, "ijkio file map: mmap %"PRId64" failed: %d\n", new_size, errno);
+        return IJKAVERROR(errno);
+    }
+
+    map->data      = data;
+    map->size      = new_size;
+    map->file_size = FFMIN(st.st_size, new_size);
+    map->fd        = fd;
+    return 0;
+}
+
+int ijkio_file_map_read(IjkIOFileMap *map, int fd, int64_t physical_pos, void *buf, int size)
+{
+    int ret;
+
+    if (!map || fd < 0 || physical_pos < 0 || size <= 0)
+        return IJKAVERROR(EINVAL);
+
+    pthread_mutex_lock(&map->mutex);
+    ret = file_map_ensure(map, fd, physical_pos + size);
+    if (ret >= 0) {
+        memcpy(buf, map->data + physical_pos, size);
+        ret = size;
+    }
+    pthread_mutex_unlock(&map->mutex);
+
+    return ret;
+}
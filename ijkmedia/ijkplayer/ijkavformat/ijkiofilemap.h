@@ -0,0 +1,49 @@
+/*
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKAVFORMAT_IJKIOFILEMAP_H
+#define IJKAVFORMAT_IJKIOFILEMAP_H
+
+#include <stdint.h>
+
+/**
+ * Read-only shared mapping of the ijkio cache file.
+ *
+ * The mapping follows the file as it grows, it is remapped in large steps
+ * when a read goes past its end. On 32-bit address spaces the mapping is
+ * capped and reads beyond the cap are refused so the caller falls back to read().
+ */
+typedef struct IjkIOFileMap IjkIOFileMap;
+
+IjkIOFileMap *ijkio_file_map_create(void);
+void ijkio_file_map_destroyp(IjkIOFileMap **pmap);
+
+/**
+ * Copy size bytes at physical_pos of fd out of the mapping.
+ *
+ * @return number of bytes copied, <0 if the range can not be served from
+ *         the mapping and must be read with read()/pread() instead
+ */
+int ijkio_file_map_read(IjkIOFileMap *map, int fd, int64_t physical_pos, void *buf, int size);
+
+/**
+ * Drop the mapping, must be called before the cache file is truncated or reopened.
+ */
+void ijkio_file_map_invalidate(IjkIOFileMap *map);
+
+#endif /* IJKAVFORMAT_IJKIOFILEMAP_H */
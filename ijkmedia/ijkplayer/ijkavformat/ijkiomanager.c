@@ -22,7 +22,7 @@
 #include "ijkiomanager.h"
 #include "ijkioprotocol.h"
 #include "ijkplayer/ijkavutil/ijkutils.h"
-#include "ijkplayer/ijkavutil/ijktree.h"
+#include "ijkplayer/ijkavutil/ijkrangeindex.h"
 #include "ijkplayer/ijkavutil/ijkstl.h"
 #include "libavutil/log.h"
 
@@ -47,6 +47,7 @@ static int ijkio_manager_alloc(IjkIOManagerContext **ph, void *opaque)
     ijkio_application_open(&h->ijkio_app_ctx, opaque);
 
     pthread_mutex_init(&h->ijkio_app_ctx->mutex, NULL);
+    // cache tasks hold a worker for the life of their stream, keep them off the shared pool
     h->ijkio_app_ctx->threadpool_ctx = ijk_threadpool_create(5, 5, 0);
     h->ijkio_app_ctx->cache_info_map = ijk_map_create();
     h->ijkio_app_ctx->fd             = -1;
@@ -59,24 +60,16 @@ int ijkio_manager_create(IjkIOManagerContext **ph, void *opaque)
     return ijkio_manager_alloc(ph, opaque);
 }
 
-static int enu_free(void *opaque, void *elem)
-{
-    free(elem);
-    return 0;
-}
-
 static int tree_destroy(void *parm, int64_t key, void *elem)
 {
     IjkCacheTreeInfo *info = elem;
-    ijk_av_tree_enumerate(info->root, NULL, NULL, enu_free);
-    ijk_av_tree_destroy(info->root);
+    ijk_range_index_clear(&info->ranges);
     free(info);
     return 0;
 }
 
-static int enu_save(void *opaque, void *elem) {
+static int enu_save(void *opaque, IjkCacheEntry *entry) {
     FILE *fp = opaque;
-    IjkCacheEntry *entry = elem;
     char string[CONFIG_MAX_LINE] = {0};
 
     if (entry && fp) {
@@ -125,7 +118,7 @@ static int ijkio_manager_save_tree_to_file(void *parm, int64_t key, void *elem)
         snprintf(string, CONFIG_MAX_LINE, "tree-info-flush\n");
         fwrite(string, strlen(string), 1, fp);
 
-        ijk_av_tree_enumerate(info->root, parm, NULL, enu_save);
+        ijk_range_index_enumerate(&info->ranges, parm, enu_save);
     }
     return 0;
 }
@@ -146,6 +139,8 @@ void ijkio_manager_destroy(IjkIOManagerContext *h)
         ijk_map_traversal_handle(h->ijkio_app_ctx->cache_info_map, NULL, tree_destroy);
         ijk_map_destroy(h->ijkio_app_ctx->cache_info_map);
         h->ijkio_app_ctx->cache_info_map = NULL;
+        ijkio_block_cache_destroyp(&h->ijkio_app_ctx->block_cache);
+        ijkio_file_map_destroyp(&h->ijkio_app_ctx->file_map);
 
         if (h->ijkio_app_ctx->threadpool_ctx) {
             ijk_threadpool_destroy(h->ijkio_app_ctx->threadpool_ctx, IJK_IMMEDIATE_SHUTDOWN);
@@ -202,11 +197,6 @@ static void ijkio_manager_set_all_ctx_pause(IjkIOManagerContext *h) {
     }
 }
 
-static int cmp(const void *key, const void *node)
-{
-    return FFDIFFSIGN(*(const int64_t *)key, ((const IjkCacheEntry *) node)->logical_pos);
-}
-
 static void ijkio_manager_parse_cache_info(IjkIOApplicationContext *app_ctx, char *file_path) {
     char string_line[CONFIG_MAX_LINE] = {0};
     char **ptr = (char **)&string_line;
@@ -220,9 +210,6 @@ static void ijkio_manager_parse_cache_info(IjkIOApplicationContext *app_ctx, cha
     int64_t entry_size              = 0;
     void *cache_info_map            = app_ctx->cache_info_map;
     IjkCacheTreeInfo *cur_tree_info = NULL;
-    IjkCacheEntry *cur_entry        = NULL;
-    IjkCacheEntry *entry_ret        = NULL;
-    struct IjkAVTreeNode *cur_node  = NULL;
 
     FILE *fp = fopen(file_path, "r");
     if (!fp) {
@@ -315,26 +302,7 @@ static void ijkio_manager_parse_cache_info(IjkIOApplicationContext *app_ctx, cha
             entry_size = strtoll(*ptr, NULL, 10);
         } else if (ijk_av_strstart(string_line, "entry-info-flush", (const char **)ptr)) {
             if (cur_tree_info) {
-                cur_entry = calloc(1, sizeof(IjkCacheEntry));
-                cur_node  = ijk_av_tree_node_alloc();
-                if (!cur_entry || !cur_node) {
-                    if (cur_node) {
-                        ijk_av_tree_destroy(cur_node);
-                        cur_node = NULL;
-                    }
-                    if (cur_entry) {
-                        free(cur_entry);
-                        cur_entry= NULL;
-                    }
-                    break;
-                }
-
-                cur_entry->logical_pos  = entry_logical_pos;
-                cur_entry->physical_pos = entry_physical_pos;
-                cur_entry->size         = entry_size;
-
-                entry_ret = ijk_av_tree_insert(&cur_tree_info->root, cur_entry, cmp, &cur_node);
-                if (entry_ret && entry_ret != cur_entry) {
+                if (ijk_range_index_add(&cur_tree_info->ranges, entry_logical_pos, entry_physical_pos, entry_size) < 0) {
                     break;
                 }
             }
@@ -419,6 +387,23 @@ int ijkio_manager_io_open(IjkIOManagerContext *h, const char *url, int flags, Ij
         }
     }
 
+    if (!h->ijkio_app_ctx->block_cache && 0 != strlen(h->ijkio_app_ctx->cache_file_path)) {
+        int64_t block_cache_capacity = DEFAULT_BLOCK_CACHE_CAPACITY;
+
+        t = ijk_av_dict_get(*options, "cache_memory_capacity", NULL, IJK_AV_DICT_MATCH_CASE);
+        if (t) {
+            block_cache_capacity = strtoll(t->value, NULL, 10);
+        }
+        h->ijkio_app_ctx->block_cache = ijkio_block_cache_create(block_cache_capacity);
+    }
+
+    if (!h->ijkio_app_ctx->file_map && 0 != strlen(h->ijkio_app_ctx->cache_file_path)) {
+        t = ijk_av_dict_get(*options, "cache_file_mmap", NULL, IJK_AV_DICT_MATCH_CASE);
+        if (t && strtol(t->value, NULL, 10)) {
+            h->ijkio_app_ctx->file_map = ijkio_file_map_create();
+        }
+    }
+
     h->ijkio_app_ctx->ijkio_interrupt_callback = h->ijkio_interrupt_callback;
 
     IjkURLContext *inner = NULL;
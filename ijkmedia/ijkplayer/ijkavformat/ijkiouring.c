@@ -0,0 +1,316 @@
+/*
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijkiouring.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && defined(__has_include)
+#   if __has_include(<linux/io_uring.h>)
+#       include <linux/io_uring.h>
+#   endif
+#endif
+
+/* IORING_OP_READ/IORING_OP_WRITE came with the same uapi revision as IORING_FEAT_RW_CUR_POS */
+#if defined(IORING_FEAT_RW_CUR_POS)
+#define IJKIO_HAVE_IO_URING 1
+#endif
+
+#if IJKIO_HAVE_IO_URING
+
+#include "libavutil/log.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+struct IjkIOUring {
+    int       fd;
+    unsigned  entries;
+    unsigned  queued;       // in the submission queue, not handed to the kernel yet
+    int       inflight;     // queued or submitted, completion not reaped yet
+
+    void     *sq_ring;
+    size_t    sq_ring_size;
+    void     *cq_ring;
+    size_t    cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t    sqes_size;
+
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+void ijkio_uring_destroyp(IjkIOUring **pring)
+{
+    IjkIOUring *ring;
+
+    if (!pring || !*pring)
+        return;
+
+    ring = *pring;
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    free(ring);
+    *pring = NULL;
+}
+
+IjkIOUring *ijkio_uring_create(unsigned entries)
+{
+    struct io_uring_params p;
+    IjkIOUring *ring = calloc(1, sizeof(IjkIOUring));
+    uint8_t *sq, *cq;
+
+    if (!ring)
+        return NULL;
+
+    memset(&p, 0, sizeof(p));
+    ring->fd = sys_io_uring_setup(entries, &p);
+    if (ring->fd < 0) {
+        av_log(NULL, AV_LOG_INFO, "ijkio uring: io_uring_setup failed: %d, using pwrite\n", errno);
+        goto fail;
+    }
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        av_log(NULL, AV_LOG_INFO, "ijkio uring: kernel lacks IORING_OP_READ/WRITE, using pwrite\n");
+        goto fail;
+    }
+    ring->entries = p.sq_entries;
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        goto fail;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            goto fail;
+        }
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        goto fail;
+    }
+
+    sq = ring->sq_ring;
+    cq = ring->cq_ring;
+    ring->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return ring;
+
+fail:
+    ijkio_uring_destroyp(&ring);
+    return NULL;
+}
+
+static int uring_enter(IjkIOUring *ring, unsigned min_complete, unsigned flags)
+{
+    int ret;
+
+    do {
+        ret = sys_io_uring_enter(ring->fd, ring->queued, min_complete, flags);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        return -errno;
+
+    ring->queued -= ret < (int)ring->queued ? ret : (int)ring->queued;
+    return 0;
+}
+
+static int uring_queue(IjkIOUring *ring, int opcode, int fd, const void *buf, int size, int64_t pos, uint64_t user_data)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned index;
+    struct io_uring_sqe *sqe;
+
+    if (ring->inflight >= (int)ring->entries)
+        return -EBUSY;
+
+    index = tail & *ring->sq_mask;
+    sqe   = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = (uint8_t)opcode;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t)(uintptr_t)buf;
+    sqe->len       = (unsigned)size;
+    sqe->off       = (uint64_t)pos;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    ring->queued++;
+    ring->inflight++;
+    return 0;
+}
+
+int ijkio_uring_queue_write(IjkIOUring *ring, int fd, const void *buf, int size, int64_t pos, uint64_t user_data)
+{
+    if (!ring || fd < 0 || size <= 0 || pos < 0)
+        return -EINVAL;
+    return uring_queue(ring, IORING_OP_WRITE, fd, buf, size, pos, user_data);
+}
+
+int ijkio_uring_queue_read(IjkIOUring *ring, int fd, void *buf, int size, int64_t pos, uint64_t user_data)
+{
+    if (!ring || fd < 0 || size <= 0 || pos < 0)
+        return -EINVAL;
+    return uring_queue(ring, IORING_OP_READ, fd, buf, size, pos, user_data);
+}
+
+int ijkio_uring_submit(IjkIOUring *ring)
+{
+    if (!ring)
+        return -EINVAL;
+    return ring->queued ? uring_enter(ring, 0, 0) : 0;
+}
+
+int ijkio_uring_reap(IjkIOUring *ring, IjkIOUringCompletion *cqes, int max, int min_complete)
+{
+    unsigned head, tail;
+    int count = 0;
+    int ret;
+
+    if (!ring || !cqes || max <= 0)
+        return -EINVAL;
+
+    min_complete = min_complete < ring->inflight ? min_complete : ring->inflight;
+    min_complete = min_complete < max ? min_complete : max;
+
+    while (1) {
+        head = *ring->cq_head;
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail && count < max) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            cqes[count].user_data = cqe->user_data;
+            cqes[count].res       = cqe->res;
+            count++;
+            head++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        if (count >= min_complete && !ring->queued)
+            break;
+
+        /* hand over everything queued and wait for the missing completions in one syscall */
+        ret = uring_enter(ring, count < min_complete ? min_complete - count : 0,
+                          count < min_complete ? IORING_ENTER_GETEVENTS : 0);
+        if (ret < 0) {
+            ring->inflight -= count;
+            return count > 0 ? count : ret;
+        }
+        if (count >= min_complete)
+            break;
+    }
+
+    ring->inflight -= count;
+    return count;
+}
+
+int ijkio_uring_inflight(IjkIOUring *ring)
+{
+    return ring ? ring->inflight : 0;
+}
+
+#else
+
+IjkIOUring *ijkio_uring_create(unsigned entries)
+{
+    return NULL;
+}
+
+void ijkio_uring_destroyp(IjkIOUring **pring)
+{
+}
+
+int ijkio_uring_queue_write(IjkIOUring *ring, int fd, const void *buf, int size, int64_t pos, uint64_t user_data)
+{
+    return -ENOSYS;
+}
+
+int ijkio_uring_queue_read(IjkIOUring *ring, int fd, void *buf, int size, int64_t pos, uint64_t user_data)
+{
+    return -ENOSYS;
+}
+
+int ijkio_uring_submit(IjkIOUring *ring)
+{
+    return -ENOSYS;
+}
+
+int ijkio_uring_reap(IjkIOUring *ring, IjkIOUringCompletion *cqes, int max, int min_complete)
+{
+    return -ENOSYS;
+}
+
+int ijkio_uring_inflight(IjkIOUring *ring)
+{
+    return 0;
+}
+
+#endif /* IJKIO_HAVE_IO_URING */
@@ -0,0 +1,70 @@
+/*
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKAVFORMAT_IJKIOURING_H
+#define IJKAVFORMAT_IJKIOURING_H
+
+#include <stdint.h>
+
+/**
+ * Minimal io_uring submission/completion ring for positional file I/O.
+ *
+ * Only available on Linux kernels with io_uring, ijkio_uring_create() returns
+ * NULL everywhere else (or when a seccomp policy denies io_uring_setup) and
+ * the caller keeps using pread()/pwrite().
+ * A ring is not thread safe, it must be driven by a single thread.
+ */
+typedef struct IjkIOUring IjkIOUring;
+
+typedef struct IjkIOUringCompletion {
+    uint64_t user_data;
+    int      res;       // bytes transferred or negative errno
+} IjkIOUringCompletion;
+
+IjkIOUring *ijkio_uring_create(unsigned entries);
+void ijkio_uring_destroyp(IjkIOUring **pring);
+
+/**
+ * Queue a write of size bytes of buf at pos of fd, buf must stay valid until
+ * the matching completion has been reaped. Queued requests reach the kernel
+ * with the next ijkio_uring_submit() or ijkio_uring_reap().
+ *
+ * @return 0 on success, <0 if the ring is full
+ */
+int ijkio_uring_queue_write(IjkIOUring *ring, int fd, const void *buf, int size, int64_t pos, uint64_t user_data);
+int ijkio_uring_queue_read(IjkIOUring *ring, int fd, void *buf, int size, int64_t pos, uint64_t user_data);
+
+/**
+ * Hand every queued request to the kernel without waiting.
+ */
+int ijkio_uring_submit(IjkIOUring *ring);
+
+/**
+ * Submit what is queued and collect up to max completions, blocking until
+ * at least min_complete are available.
+ *
+ * @return number of completions stored in cqes, <0 on error
+ */
+int ijkio_uring_reap(IjkIOUring *ring, IjkIOUringCompletion *cqes, int max, int min_complete);
+
+/**
+ * @return number of queued or submitted requests whose completion was not reaped yet
+ */
+int ijkio_uring_inflight(IjkIOUring *ring);
+
+#endif /* IJKAVFORMAT_IJKIOURING_H */
@@ -0,0 +1,141 @@
+/*
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijkrangeindex.h"
+#include "ijkutils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RANGE_INDEX_MIN_CAPACITY 16
+
+void ijk_range_index_clear(IjkRangeIndex *index)
+{
+    if (!index)
+        return;
+
+    free(index->entries);
+    index->entries    = NULL;
+    index->nb_entries = 0;
+    index->capacity   = 0;
+}
+
+/* index of the first entry with logical_pos > pos */
+static int upper_bound(const IjkRangeIndex *index, int64_t pos)
+{
+    int lo = 0;
+    int hi = index->nb_entries;
+
+    while (lo < hi) {
+        int mid = lo + ((hi - lo) >> 1);
+        if (index->entries[mid].logical_pos <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+IjkRangeEntry *ijk_range_index_find(const IjkRangeIndex *index, int64_t pos, IjkRangeEntry **next)
+{
+    int i;
+
+    if (!index || index->nb_entries <= 0) {
+        if (next)
+            *next = NULL;
+        return NULL;
+    }
+
+    i = upper_bound(index, pos);
+    if (next)
+        *next = i < index->nb_entries ? &index->entries[i] : NULL;
+    return i > 0 ? &index->entries[i - 1] : NULL;
+}
+
+static int range_index_grow(IjkRangeIndex *index)
+{
+    int capacity = FFMAX(index->capacity * 2, RANGE_INDEX_MIN_CAPACITY);
+    IjkRangeEntry *entries = realloc(index->entries, capacity * sizeof(IjkRangeEntry));
+    if (!entries)
+        return IJKAVERROR(ENOMEM);
+
+    index->entries  = entries;
+    index->capacity = capacity;
+    return 0;
+}
+
+static int is_adjacent(const IjkRangeEntry *l, const IjkRangeEntry *r)
+{
+    return l->logical_pos  + l->size == r->logical_pos &&
+           l->physical_pos + l->size == r->physical_pos;
+}
+
+int ijk_range_index_add(IjkRangeIndex *index, int64_t logical_pos, int64_t physical_pos, int64_t size)
+{
+    IjkRangeEntry entry = { logical_pos, physical_pos, size };
+    int i;
+
+    if (!index || size <= 0)
+        return IJKAVERROR(EINVAL);
+
+    i = upper_bound(index, logical_pos);
+    if (i > 0 && index->entries[i - 1].logical_pos == logical_pos)
+        return -1;
+
+    if (i > 0 && is_adjacent(&index->entries[i - 1], &entry)) {
+        IjkRangeEntry *prev = &index->entries[i - 1];
+        prev->size += size;
+        if (i < index->nb_entries && is_adjacent(prev, &index->entries[i])) {
+            prev->size += index->entries[i].size;
+            memmove(&index->entries[i], &index->entries[i + 1],
+                    (index->nb_entries - i - 1) * sizeof(IjkRangeEntry));
+            index->nb_entries--;
+        }
+        return 0;
+    }
+
+    if (i < index->nb_entries && is_adjacent(&entry, &index->entries[i])) {
+        index->entries[i].logical_pos  = logical_pos;
+        index->entries[i].physical_pos = physical_pos;
+        index->entries[i].size        += size;
+        return 0;
+    }
+
+    if (index->nb_entries >= index->capacity) {
+        int ret = range_index_grow(index);
+        if (ret < 0)
+            return ret;
+    }
+
+    memmove(&index->entries[i + 1], &index->entries[i],
+            (index->nb_entries - i) * sizeof(IjkRangeEntry));
+    index->entries[i] = entry;
+    index->nb_entries++;
+    return 0;
+}
+
+void ijk_range_index_enumerate(const IjkRangeIndex *index, void *opaque,
+                               int (*enu)(void *opaque, IjkRangeEntry *entry))
+{
+    if (!index || !enu)
+        return;
+
+    for (int i = 0; i < index->nb_entries; i++) {
+        if (enu(opaque, &index->entries[i]))
+            break;
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKAVUTIL_IJKRANGEINDEX_H
+#define IJKAVUTIL_IJKRANGEINDEX_H
+
+#include <stdint.h>
+
+/**
+ * @file
+ * sorted extent vector mapping logical file ranges to cache file offsets
+ *
+ * Entries are kept in one contiguous array ordered by logical_pos, so a lookup
+ * is a binary search over adjacent memory. A range that continues an existing
+ * entry both logically and physically is merged into it instead of creating a
+ * new entry, which keeps sequentially downloaded files at a handful of entries.
+ */
+
+typedef struct IjkRangeEntry {
+    int64_t logical_pos;
+    int64_t physical_pos;
+    int64_t size;
+} IjkRangeEntry;
+
+typedef struct IjkRangeIndex {
+    IjkRangeEntry *entries;
+    int nb_entries;
+    int capacity;
+} IjkRangeIndex;
+
+/**
+ * Release the entries of an index and reset it to the empty state.
+ */
+void ijk_range_index_clear(IjkRangeIndex *index);
+
+/**
+ * Find the entry with the greatest logical_pos <= pos.
+ *
+ * @param next if not NULL, set to the entry with the smallest logical_pos > pos,
+ *             or NULL if there is none
+ * @return the entry, or NULL if every entry starts after pos
+ *
+ * The returned pointers are invalidated by the next call to ijk_range_index_add().
+ */
+IjkRangeEntry *ijk_range_index_find(const IjkRangeIndex *index, int64_t pos, IjkRangeEntry **next);
+
+/**
+ * Record that [logical_pos, logical_pos + size) is stored at physical_pos.
+ * Merges with the neighbours when both logical and physical ranges are adjacent.
+ *
+ * @return 0 on success, <0 if an entry already starts at logical_pos or on ENOMEM
+ */
+int ijk_range_index_add(IjkRangeIndex *index, int64_t logical_pos, int64_t physical_pos, int64_t size);
+
+/**
+ * Call enu for every entry in logical order, stop when it returns non-zero.
+ */
+void ijk_range_index_enumerate(const IjkRangeIndex *index, void *opaque,
+                               int (*enu)(void *opaque, IjkRangeEntry *entry));
+
+#endif /* IJKAVUTIL_IJKRANGEINDEX_H */
@@ -17,11 +17,15 @@
  * License along with ijkPlayer; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
-#include <map>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 using namespace std;
 
-typedef map<int64_t, void *> IjkMap;
+/* a handful of keys per manager, so a sorted vector beats a node based map */
+typedef pair<int64_t, void *> IjkMapItem;
+typedef vector<IjkMapItem> IjkMap;
 
 extern "C" void* ijk_map_create();
 extern "C" void ijk_map_put(void *data, int64_t key, void *value);
@@ -35,6 +39,14 @@ extern "C" void ijk_map_clear(void *data);
 extern "C" void ijk_map_destroy(void *data);
 extern "C" void ijk_map_traversal_handle(void *data, void *parm, int (*enu)(void *parm, int64_t key, void *elem));
 
+static bool item_key_less(const IjkMapItem &item, int64_t key) {
+    return item.first < key;
+}
+
+static IjkMap::iterator map_lower_bound(IjkMap *map_data, int64_t key) {
+    return lower_bound(map_data->begin(), map_data->end(), key, item_key_less);
+}
+
 void* ijk_map_create() {
     IjkMap *data = new IjkMap();
     return data;
@@ -44,7 +56,13 @@ void ijk_map_put(void *data, int64_t key, void *value) {
     IjkMap *map_data = reinterpret_cast<IjkMap *>(data);
     if (!map_data)
         return;
-    (*map_data)[key] = value;
+
+    IjkMap::iterator it = map_lower_bound(map_data, key);
+    if (it != map_data->end() && it->first == key) {
+        it->second = value;
+    } else {
+        map_data->insert(it, IjkMapItem(key, value));
+    }
 }
 
 void* ijk_map_get(void *data, int64_t key) {
@@ -52,8 +70,8 @@ void* ijk_map_get(void *data, int64_t key) {
     if (!map_data)
         return NULL;
 
-    IjkMap::iterator it = map_data->find(key);
-    if (it != map_data->end()) {
+    IjkMap::iterator it = map_lower_bound(map_data, key);
+    if (it != map_data->end() && it->first == key) {
         return it->second;
     }
     return NULL;
@@ -63,7 +81,11 @@ int ijk_map_remove(void *data, int64_t key) {
     IjkMap *map_data = reinterpret_cast<IjkMap *>(data);
     if (!map_data)
         return -1;
-    map_data->erase(key);
+
+    IjkMap::iterator it = map_lower_bound(map_data, key);
+    if (it != map_data->end() && it->first == key) {
+        map_data->erase(it);
+    }
     return 0;
 }
 
@@ -80,25 +102,15 @@ int ijk_map_max_size(void *data) {
     if (!map_data)
         return 0;
 
-    return (int)map_data->max_size();
+    return (int)min(map_data->max_size(), (size_t)INT32_MAX);
 }
 
 void* ijk_map_index_get(void *data, int index) {
     IjkMap *map_data = reinterpret_cast<IjkMap *>(data);
-    if (!map_data || map_data->empty())
+    if (!map_data || index < 0 || index >= (int)map_data->size())
         return NULL;
 
-    IjkMap::iterator it;
-    it = map_data->begin();
-
-    for (int i = 0; i < index; i++) {
-        it = it++;
-        if (it == map_data->end()) {
-            return NULL;
-        }
-    }
-
-    return it->second;
+    return (*map_data)[index].second;
 }
 
 void ijk_map_traversal_handle(void *data, void *parm, int (*enu)(void *parm, int64_t key, void *elem)) {
@@ -106,10 +118,8 @@ void ijk_map_traversal_handle(void *data, void *parm, int (*enu)(void *parm, int
     if (!map_data || map_data->empty())
         return;
 
-    IjkMap::iterator it;
-
-    for (it = map_data->begin(); it != map_data->end(); it++) {
-        enu(parm, it->first, it->second);
+    for (size_t i = 0; i < map_data->size(); i++) {
+        enu(parm, (*map_data)[i].first, (*map_data)[i].second);
     }
 }
 
@@ -118,15 +128,7 @@ int64_t ijk_map_get_min_key(void *data) {
     if (!map_data || map_data->empty())
         return -1;
 
-    IjkMap::iterator it = map_data->begin();
-
-    int64_t min_key = it->first;
-
-    for (; it != map_data->end(); it++) {
-        min_key = min_key < it->first ? min_key : it->first;
-    }
-
-    return min_key;
+    return map_data->front().first;
 }
 
 void ijk_map_clear(void *data) {
@@ -20,231 +20,626 @@
  */
 
 #include "ijkthreadpool.h"
+#include "libavutil/cpu.h"
 #include "libavutil/log.h"
 
+#include <errno.h>
+#include <sched.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
 #include <unistd.h>
 
+// threads of the shared pool beyond the cpu count, for tasks that block on io for a while
+#define SHARED_EXTRA_THREADS 4
+#define SHARED_QUEUE_SIZE    64
+// how long a worker waiting on a future sleeps when there is nothing to help with
+#define HELP_WAIT_US         1000
+
+struct IjkThreadPoolFuture {
+    Runable function;
+    void *in_arg;
+    void *out_arg;
+    IjkThreadPoolContext *ctx;
+    int state;
+    int ref_count;
+};
+
+/**
+ * @struct IjkTaskDeque
+ * @brief growable ring of tasks, the owner uses bottom and thieves use top
+ *
+ * count mirrors bottom - top so a thief can skip an empty deque without the lock.
+ */
+typedef struct IjkTaskDeque {
+    pthread_mutex_t lock;
+    IjkThreadPoolFuture **tasks;
+    unsigned int mask;
+    unsigned int top;
+    unsigned int bottom;
+    int count;
+} IjkTaskDeque;
+
+typedef struct IjkThreadPoolWorker {
+    IjkThreadPoolContext *ctx;
+    pthread_t thread;
+    int index;
+    int started;
+    unsigned int steal_seed;
+    IjkTaskDeque deques[IJK_THREADPOOL_PRIORITY_COUNT];
+} IjkThreadPoolWorker;
+
+/**
+ * pending_count, sleeping_count, waiting_count and submitting_count are only
+ * touched with atomics. A worker goes to sleep on notify after raising
+ * sleeping_count and finding pending_count at 0 under lock, a submitter raises
+ * pending_count before it reads sleeping_count, so one of them sees the other.
+ * Futures do the same with waiting_count and their state on done_lock.
+ */
+struct IjkThreadPoolContext {
+    pthread_mutex_t lock;
+    pthread_cond_t notify;
+    pthread_mutex_t done_lock;
+    pthread_cond_t done_notify;
+    IjkThreadPoolWorker *workers;
+    int thread_count;
+    int shutdown;
+    int shared;
+    int pending_count;
+    int sleeping_count;
+    int waiting_count;
+    int submitting_count;
+    unsigned int next_worker;
+};
+
+static pthread_once_t g_worker_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_worker_key;
+
+static pthread_once_t g_shared_once = PTHREAD_ONCE_INIT;
+static IjkThreadPoolContext *g_shared_ctx;
+
+static void ijk_threadpool_make_worker_key(void)
+{
+    pthread_key_create(&g_worker_key, NULL);
+}
+
+static IjkThreadPoolWorker *ijk_threadpool_current_worker(IjkThreadPoolContext *ctx)
+{
+    IjkThreadPoolWorker *self = pthread_getspecific(g_worker_key);
+    return (self && self->ctx == ctx) ? self : NULL;
+}
+
+static int ijk_threadpool_deque_init(IjkTaskDeque *dq, int capacity)
+{
+    unsigned int size = 16;
+
+    while (size < (unsigned int)capacity)
+        size <<= 1;
+
+    if (pthread_mutex_init(&dq->lock, NULL) != 0)
+        return -1;
+    dq->tasks = (IjkThreadPoolFuture **)calloc(size, sizeof(IjkThreadPoolFuture *));
+    if (!dq->tasks) {
+        pthread_mutex_destroy(&dq->lock);
+        return -1;
+    }
+    dq->mask = size - 1;
+    return 0;
+}
+
+static void ijk_threadpool_deque_uninit(IjkTaskDeque *dq)
+{
+    if (!dq->tasks)
+        return;
+    free(dq->tasks);
+    dq->tasks = NULL;
+    pthread_mutex_destroy(&dq->lock);
+}
+
+static int ijk_threadpool_deque_push(IjkTaskDeque *dq, IjkThreadPoolFuture *task)
+{
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom - dq->top > dq->mask) {
+        unsigned int new_mask = dq->mask * 2 + 1;
+        unsigned int i;
+        IjkThreadPoolFuture **tasks = (IjkThreadPoolFuture **)malloc(sizeof(IjkThreadPoolFuture *) * (new_mask + 1));
+        if (!tasks) {
+            pthread_mutex_unlock(&dq->lock);
+            return -1;
+        }
+        // indices keep counting up, only the ring they wrap around in changes
+        for (i = dq->top; i != dq->bottom; i++)
+            tasks[i & new_mask] = dq->tasks[i & dq->mask];
+        free(dq->tasks);
+        dq->tasks = tasks;
+        dq->mask  = new_mask;
+    }
+    dq->tasks[dq->bottom & dq->mask] = task;
+    dq->bottom++;
+    __atomic_store_n(&dq->count, (int)(dq->bottom - dq->top), __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&dq->lock);
+    return 0;
+}
+
+static IjkThreadPoolFuture *ijk_threadpool_deque_pop(IjkTaskDeque *dq)
+{
+    IjkThreadPoolFuture *task = NULL;
+
+    if (__atomic_load_n(&dq->count, __ATOMIC_ACQUIRE) == 0)
+        return NULL;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom != dq->top) {
+        dq->bottom--;
+        task = dq->tasks[dq->bottom & dq->mask];
+        __atomic_store_n(&dq->count, (int)(dq->bottom - dq->top), __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return task;
+}
+
+static IjkThreadPoolFuture *ijk_threadpool_deque_steal(IjkTaskDeque *dq)
+{
+    IjkThreadPoolFuture *task = NULL;
+
+    if (__atomic_load_n(&dq->count, __ATOMIC_ACQUIRE) == 0)
+        return NULL;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom != dq->top) {
+        task = dq->tasks[dq->top & dq->mask];
+        dq->top++;
+        __atomic_store_n(&dq->count, (int)(dq->bottom - dq->top), __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return task;
+}
+
+static void ijk_threadpool_future_unref(IjkThreadPoolFuture *task)
+{
+    if (__atomic_sub_fetch(&task->ref_count, 1, __ATOMIC_ACQ_REL) == 0)
+        free(task);
+}
+
+static int ijk_threadpool_state_is_final(int state)
+{
+    return state == IJK_THREADPOOL_TASK_DONE || state == IJK_THREADPOOL_TASK_CANCELLED;
+}
+
+static void ijk_threadpool_finish(IjkThreadPoolFuture *task, int state)
+{
+    IjkThreadPoolContext *ctx = task->ctx;
+
+    __atomic_store_n(&task->state, state, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ctx->waiting_count, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&ctx->done_lock);
+        pthread_cond_broadcast(&ctx->done_notify);
+        pthread_mutex_unlock(&ctx->done_lock);
+    }
+}
+
+/**
+ * Own deque first, then the others starting from a random victim, all
+ * critical deques before any background one.
+ */
+static IjkThreadPoolFuture *ijk_threadpool_take(IjkThreadPoolContext *ctx, IjkThreadPoolWorker *self)
+{
+    IjkThreadPoolFuture *task = NULL;
+    unsigned int start = 0;
+    int p, i;
+
+    if (self) {
+        self->steal_seed ^= self->steal_seed << 13;
+        self->steal_seed ^= self->steal_seed >> 17;
+        self->steal_seed ^= self->steal_seed << 5;
+        start = self->steal_seed;
+    }
+
+    for (p = 0; p < IJK_THREADPOOL_PRIORITY_COUNT; p++) {
+        if (self && (task = ijk_threadpool_deque_pop(&self->deques[p])))
+            goto found;
+        for (i = 0; i < ctx->thread_count; i++) {
+            IjkThreadPoolWorker *victim = &ctx->workers[(start + i) % ctx->thread_count];
+            if (victim == self)
+                continue;
+            if ((task = ijk_threadpool_deque_steal(&victim->deques[p])))
+                goto found;
+        }
+    }
+    return NULL;
+
+found:
+    __atomic_sub_fetch(&ctx->pending_count, 1, __ATOMIC_SEQ_CST);
+    return task;
+}
+
+static void ijk_threadpool_run(IjkThreadPoolFuture *task)
+{
+    int expected = IJK_THREADPOOL_TASK_PENDING;
+
+    // a cancelled task stays in its deque until someone pops it
+    if (__atomic_compare_exchange_n(&task->state, &expected, IJK_THREADPOOL_TASK_RUNNING,
+                                    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        (*(task->function))(task->in_arg, task->out_arg);
+        ijk_threadpool_finish(task, IJK_THREADPOOL_TASK_DONE);
+    }
+    ijk_threadpool_future_unref(task);
+}
+
 /**
  * @function void *threadpool_thread(void *threadpool)
  * @brief the worker thread
- * @param pool_ctx the pool which own the thread
+ * @param worker the worker which owns the thread
  */
-static void *ijk_threadpool_thread(void *pool_ctx)
+static void *ijk_threadpool_thread(void *worker)
 {
-    IjkThreadPoolContext *ctx = (IjkThreadPoolContext *)pool_ctx;
-    IjkThreadPoolTask task;
+    IjkThreadPoolWorker *self = (IjkThreadPoolWorker *)worker;
+    IjkThreadPoolContext *ctx = self->ctx;
+    IjkThreadPoolFuture *task;
+    int shutdown, pending;
+
+    pthread_setspecific(g_worker_key, self);
 
     for(;;) {
-        pthread_mutex_lock(&(ctx->lock));
+        if (__atomic_load_n(&ctx->shutdown, __ATOMIC_ACQUIRE) == IJK_IMMEDIATE_SHUTDOWN)
+            break;
+
+        task = ijk_threadpool_take(ctx, self);
+        if (task) {
+            ijk_threadpool_run(task);
+            continue;
+        }
 
-        while((ctx->pending_count == 0) && (!ctx->shutdown)) {
+        pthread_mutex_lock(&(ctx->lock));
+        __atomic_add_fetch(&ctx->sleeping_count, 1, __ATOMIC_SEQ_CST);
+        while (!ctx->shutdown && __atomic_load_n(&ctx->pending_count, __ATOMIC_SEQ_CST) == 0) {
             pthread_cond_wait(&(ctx->notify), &(ctx->lock));
         }
+        __atomic_sub_fetch(&ctx->sleeping_count, 1, __ATOMIC_SEQ_CST);
+        shutdown = ctx->shutdown;
+        pending  = __atomic_load_n(&ctx->pending_count, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&(ctx->lock));
 
-        if((ctx->shutdown == IJK_IMMEDIATE_SHUTDOWN) ||
-           ((ctx->shutdown == IJK_LEISURELY_SHUTDOWN) &&
-            (ctx->pending_count == 0))) {
-               break;
-           }
+        if (shutdown == IJK_LEISURELY_SHUTDOWN && pending == 0)
+            break;
+    }
 
-        /* Grab our task */
-        task.function = ctx->queue[ctx->queue_head].function;
-        task.in_arg   = ctx->queue[ctx->queue_head].in_arg;
-        task.out_arg  = ctx->queue[ctx->queue_head].out_arg;
-        ctx->queue_head = (ctx->queue_head + 1) % ctx->queue_size;
-        ctx->pending_count -= 1;
+    pthread_setspecific(g_worker_key, NULL);
+    return NULL;
+}
 
-        pthread_mutex_unlock(&(ctx->lock));
+static void ijk_threadpool_free(IjkThreadPoolContext *ctx)
+{
+    int i, p;
 
-        (*(task.function))(task.in_arg, task.out_arg);
+    if (ctx->workers) {
+        for (i = 0; i < ctx->thread_count; i++) {
+            for (p = 0; p < IJK_THREADPOOL_PRIORITY_COUNT; p++)
+                ijk_threadpool_deque_uninit(&ctx->workers[i].deques[p]);
+        }
+        free(ctx->workers);
     }
+    pthread_mutex_destroy(&(ctx->lock));
+    pthread_cond_destroy(&(ctx->notify));
+    pthread_mutex_destroy(&(ctx->done_lock));
+    pthread_cond_destroy(&(ctx->done_notify));
+    free(ctx);
+}
 
-    ctx->started_count--;
+static int ijk_threadpool_shutdown(IjkThreadPoolContext *ctx, int flags)
+{
+    IjkThreadPoolFuture *task;
+    int i, p, err = 0;
 
+    pthread_mutex_lock(&(ctx->lock));
+    if (ctx->shutdown) {
+        pthread_mutex_unlock(&(ctx->lock));
+        return IJK_THREADPOOL_SHUTDOWN;
+    }
+    __atomic_store_n(&ctx->shutdown, flags, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&(ctx->notify));
     pthread_mutex_unlock(&(ctx->lock));
-    pthread_exit(NULL);
-    return(NULL);
-}
 
-int ijk_threadpool_free(IjkThreadPoolContext *ctx)
-{
-    if(ctx == NULL || ctx->started_count > 0) {
-        return -1;
+    // a submit that saw shutdown at 0 finishes its push before the deques are drained
+    while (__atomic_load_n(&ctx->submitting_count, __ATOMIC_SEQ_CST) > 0)
+        sched_yield();
+
+    for (i = 0; i < ctx->thread_count; i++) {
+        if (ctx->workers[i].started && pthread_join(ctx->workers[i].thread, NULL) != 0)
+            err = IJK_THREADPOOL_THREAD_FAILURE;
     }
 
-    /* Did we manage to allocate ? */
-    if(ctx->threads) {
-        free(ctx->threads);
-        free(ctx->queue);
+    for (i = 0; i < ctx->thread_count; i++) {
+        for (p = 0; p < IJK_THREADPOOL_PRIORITY_COUNT; p++) {
+            if (!ctx->workers[i].deques[p].tasks)
+                continue;
+            while ((task = ijk_threadpool_deque_pop(&ctx->workers[i].deques[p]))) {
+                int expected = IJK_THREADPOOL_TASK_PENDING;
+                if (__atomic_compare_exchange_n(&task->state, &expected, IJK_THREADPOOL_TASK_CANCELLED,
+                                                0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                    ijk_threadpool_finish(task, IJK_THREADPOOL_TASK_CANCELLED);
+                ijk_threadpool_future_unref(task);
+            }
+        }
+    }
 
-        /* Because we allocate pool->threads after initializing the
-         mutex and condition variable, we're sure they're
-         initialized. Let's lock the mutex just in case. */
-        pthread_mutex_lock(&(ctx->lock));
-        pthread_mutex_destroy(&(ctx->lock));
-        pthread_cond_destroy(&(ctx->notify));
+    // every future of the pool is final now, let the threads in future_wait leave done_lock
+    while (__atomic_load_n(&ctx->waiting_count, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&ctx->done_lock);
+        pthread_cond_broadcast(&ctx->done_notify);
+        pthread_mutex_unlock(&ctx->done_lock);
+        sched_yield();
     }
-    free(ctx);
-    return 0;
+    return err;
 }
 
 IjkThreadPoolContext *ijk_threadpool_create(int thread_count, int queue_size, int flags)
 {
     IjkThreadPoolContext *ctx;
-    int i;
+    int i, p;
 
-    if(thread_count <= 0 || thread_count > MAX_THREADS || queue_size <= 0 || queue_size > MAX_QUEUE) {
+    if(thread_count <= 0 || thread_count > MAX_THREADS || queue_size <= 0) {
         return NULL;
     }
+    if (queue_size > MAX_QUEUE)
+        queue_size = MAX_QUEUE;
+
+    pthread_once(&g_worker_key_once, ijk_threadpool_make_worker_key);
 
     if((ctx = (IjkThreadPoolContext *)calloc(1, sizeof(IjkThreadPoolContext))) == NULL) {
-        goto err;
+        return NULL;
     }
 
-    ctx->queue_size = queue_size;
-
-    /* Allocate thread and task queue */
-    ctx->threads = (pthread_t *)calloc(1, sizeof(pthread_t) * thread_count);
-    ctx->queue = (IjkThreadPoolTask *)calloc
-        (queue_size, sizeof(IjkThreadPoolTask));
+    pthread_mutex_init(&(ctx->lock), NULL);
+    pthread_cond_init(&(ctx->notify), NULL);
+    pthread_mutex_init(&(ctx->done_lock), NULL);
+    pthread_cond_init(&(ctx->done_notify), NULL);
 
-    /* Initialize mutex and conditional variable first */
-    if((pthread_mutex_init(&(ctx->lock), NULL) != 0) ||
-       (pthread_cond_init(&(ctx->notify), NULL) != 0) ||
-       (ctx->threads == NULL) ||
-       (ctx->queue == NULL)) {
+    ctx->workers = (IjkThreadPoolWorker *)calloc(thread_count, sizeof(IjkThreadPoolWorker));
+    if (!ctx->workers)
         goto err;
+    ctx->thread_count = thread_count;
+
+    for (i = 0; i < thread_count; i++) {
+        ctx->workers[i].ctx        = ctx;
+        ctx->workers[i].index      = i;
+        ctx->workers[i].steal_seed = 0x9E3779B9u * (i + 1);
+        for (p = 0; p < IJK_THREADPOOL_PRIORITY_COUNT; p++) {
+            if (ijk_threadpool_deque_init(&ctx->workers[i].deques[p], queue_size) < 0)
+                goto err;
+        }
     }
 
     /* Start worker threads */
     for(i = 0; i < thread_count; i++) {
-        if(pthread_create(&(ctx->threads[i]), NULL,
-                          ijk_threadpool_thread, (void*)ctx) != 0) {
-            ijk_threadpool_destroy(ctx, 0);
-            return NULL;
+        if(pthread_create(&(ctx->workers[i].thread), NULL,
+                          ijk_threadpool_thread, (void*)&ctx->workers[i]) != 0) {
+            av_log(NULL, AV_LOG_ERROR, "ijk_threadpool_create: only %d of %d threads started\n", i, thread_count);
+            ijk_threadpool_shutdown(ctx, IJK_IMMEDIATE_SHUTDOWN);
+            goto err;
         }
-        ctx->thread_count++;
-        ctx->started_count++;
+        ctx->workers[i].started = 1;
     }
 
     return ctx;
 
  err:
-    if(ctx) {
-        ijk_threadpool_free(ctx);
-    }
+    ijk_threadpool_free(ctx);
     return NULL;
 }
 
-int ijk_threadpool_add(IjkThreadPoolContext *ctx, Runable function,
-                   void *in_arg, void *out_arg, int flags)
+static void ijk_threadpool_shared_init(void)
 {
-    int err = 0;
-    int next;
+    int thread_count = av_cpu_count() + SHARED_EXTRA_THREADS;
 
-    if(ctx == NULL || function == NULL) {
-        return IJK_THREADPOOL_INVALID;
-    }
+    if (thread_count > MAX_THREADS)
+        thread_count = MAX_THREADS;
+    g_shared_ctx = ijk_threadpool_create(thread_count, SHARED_QUEUE_SIZE, 0);
+    if (g_shared_ctx)
+        g_shared_ctx->shared = 1;
+}
 
-    if(pthread_mutex_lock(&(ctx->lock)) != 0) {
-        return IJK_THREADPOOL_LOCK_FAILURE;
-    }
+IjkThreadPoolContext *ijk_threadpool_shared(void)
+{
+    pthread_once(&g_shared_once, ijk_threadpool_shared_init);
+    return g_shared_ctx;
+}
 
-    if (ctx->pending_count == MAX_QUEUE || ctx->pending_count == ctx->queue_size) {
-        pthread_mutex_unlock(&ctx->lock);
-        return IJK_THREADPOOL_QUEUE_FULL;
-    }
+int ijk_threadpool_submit(IjkThreadPoolContext *ctx, Runable function,
+                          void *in_arg, void *out_arg, int priority,
+                          IjkThreadPoolFuture **future)
+{
+    IjkThreadPoolWorker *target;
+    IjkThreadPoolFuture *task;
+    int err = 0;
 
-    if(ctx->pending_count == ctx->queue_size - 1) {
-        int new_pueue_size = (ctx->queue_size * 2) > MAX_QUEUE ? MAX_QUEUE : (ctx->queue_size * 2);
-        IjkThreadPoolTask *new_queue = (IjkThreadPoolTask *)realloc(ctx->queue, sizeof(IjkThreadPoolTask) * new_pueue_size);
-        if (new_queue) {
-            ctx->queue = new_queue;
-            ctx->queue_size = new_pueue_size;
-        }
+    if (future)
+        *future = NULL;
+    if (ctx == NULL || function == NULL ||
+        priority < 0 || priority >= IJK_THREADPOOL_PRIORITY_COUNT) {
+        return IJK_THREADPOOL_INVALID;
     }
 
-    next = (ctx->queue_tail + 1) % ctx->queue_size;
+    task = (IjkThreadPoolFuture *)calloc(1, sizeof(IjkThreadPoolFuture));
+    if (!task)
+        return IJK_THREADPOOL_QUEUE_FULL;
+    task->function  = function;
+    task->in_arg    = in_arg;
+    task->out_arg   = out_arg;
+    task->ctx       = ctx;
+    task->state     = IJK_THREADPOOL_TASK_PENDING;
+    task->ref_count = future ? 2 : 1;
+
+    __atomic_add_fetch(&ctx->submitting_count, 1, __ATOMIC_SEQ_CST);
     do {
-        /* Are we shutting down ? */
-        if(ctx->shutdown) {
+        if (__atomic_load_n(&ctx->shutdown, __ATOMIC_SEQ_CST)) {
             err = IJK_THREADPOOL_SHUTDOWN;
             break;
         }
 
-        /* Add task to queue */
-        ctx->queue[ctx->queue_tail].function = function;
-        ctx->queue[ctx->queue_tail].in_arg   = in_arg;
-        ctx->queue[ctx->queue_tail].out_arg  = out_arg;
-        ctx->queue_tail = next;
-        ctx->pending_count += 1;
+        target = ijk_threadpool_current_worker(ctx);
+        if (!target) {
+            unsigned int next = __atomic_fetch_add(&ctx->next_worker, 1, __ATOMIC_RELAXED);
+            target = &ctx->workers[next % ctx->thread_count];
+        }
 
-        /* pthread_cond_broadcast */
-        if(pthread_cond_signal(&(ctx->notify)) != 0) {
-            err = IJK_THREADPOOL_LOCK_FAILURE;
+        __atomic_add_fetch(&ctx->pending_count, 1, __ATOMIC_SEQ_CST);
+        if (ijk_threadpool_deque_push(&target->deques[priority], task) < 0) {
+            __atomic_sub_fetch(&ctx->pending_count, 1, __ATOMIC_SEQ_CST);
+            err = IJK_THREADPOOL_QUEUE_FULL;
             break;
         }
+
+        if (__atomic_load_n(&ctx->sleeping_count, __ATOMIC_SEQ_CST) > 0) {
+            pthread_mutex_lock(&(ctx->lock));
+            pthread_cond_signal(&(ctx->notify));
+            pthread_mutex_unlock(&(ctx->lock));
+        }
     } while(0);
+    __atomic_sub_fetch(&ctx->submitting_count, 1, __ATOMIC_SEQ_CST);
 
-    if(pthread_mutex_unlock(&ctx->lock) != 0) {
-        err = IJK_THREADPOOL_LOCK_FAILURE;
+    if (err) {
+        free(task);
+        return err;
     }
+    if (future)
+        *future = task;
+    return 0;
+}
 
-    return err;
+int ijk_threadpool_add(IjkThreadPoolContext *ctx, Runable function,
+                   void *in_arg, void *out_arg, int flags)
+{
+    return ijk_threadpool_submit(ctx, function, in_arg, out_arg, flags, NULL);
 }
 
-static int ijk_threadpool_freep(IjkThreadPoolContext **ctx)
+static void ijk_threadpool_deadline(struct timespec *ts, int64_t after_us)
 {
-    int ret = 0;
+    struct timeval now;
+    int64_t usec;
 
-    if (!ctx || !*ctx)
-        return -1;
+    gettimeofday(&now, NULL);
+    usec = (int64_t)now.tv_usec + after_us;
+    ts->tv_sec  = now.tv_sec + usec / 1000000;
+    ts->tv_nsec = (usec % 1000000) * 1000;
+}
 
-    ret = ijk_threadpool_free(*ctx);
-    *ctx = NULL;
-    return ret;
+static int ijk_threadpool_deadline_passed(const struct timespec *ts)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return now.tv_sec > ts->tv_sec ||
+           (now.tv_sec == ts->tv_sec && (int64_t)now.tv_usec * 1000 >= ts->tv_nsec);
 }
 
-int ijk_threadpool_destroy(IjkThreadPoolContext *ctx, int flags)
+/* sleep on done_notify until state is final or until ts, returns the state read last */
+static int ijk_threadpool_wait_done(IjkThreadPoolFuture *future, const struct timespec *ts)
+{
+    IjkThreadPoolContext *ctx = future->ctx;
+    int state;
+
+    pthread_mutex_lock(&ctx->done_lock);
+    __atomic_add_fetch(&ctx->waiting_count, 1, __ATOMIC_SEQ_CST);
+    while (!ijk_threadpool_state_is_final(state = __atomic_load_n(&future->state, __ATOMIC_SEQ_CST))) {
+        if (!ts) {
+            pthread_cond_wait(&ctx->done_notify, &ctx->done_lock);
+        } else if (pthread_cond_timedwait(&ctx->done_notify, &ctx->done_lock, ts) == ETIMEDOUT) {
+            state = __atomic_load_n(&future->state, __ATOMIC_SEQ_CST);
+            break;
+        }
+    }
+    __atomic_sub_fetch(&ctx->waiting_count, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&ctx->done_lock);
+    return state;
+}
+
+int ijk_threadpool_future_wait(IjkThreadPoolFuture *future, int timeout_ms)
 {
-    int i, err = 0;
+    IjkThreadPoolWorker *self;
+    struct timespec deadline;
+    int state;
 
-    if(ctx == NULL) {
+    if (!future)
         return IJK_THREADPOOL_INVALID;
-    }
 
-    if(pthread_mutex_lock(&(ctx->lock)) != 0) {
-        return IJK_THREADPOOL_LOCK_FAILURE;
+    // a final future may outlive its pool, do not touch ctx then
+    state = __atomic_load_n(&future->state, __ATOMIC_ACQUIRE);
+    if (ijk_threadpool_state_is_final(state))
+        return state;
+
+    if (timeout_ms >= 0)
+        ijk_threadpool_deadline(&deadline, (int64_t)timeout_ms * 1000);
+
+    self = ijk_threadpool_current_worker(future->ctx);
+    if (!self) {
+        state = ijk_threadpool_wait_done(future, timeout_ms >= 0 ? &deadline : NULL);
+        return ijk_threadpool_state_is_final(state) ? state : IJK_THREADPOOL_TIMEOUT;
     }
 
-    do {
-        /* Already shutting down */
-        if(ctx->shutdown) {
-            err = IJK_THREADPOOL_SHUTDOWN;
-            break;
+    // blocking a worker on another task could leave nobody to run it
+    while (!ijk_threadpool_state_is_final(state = __atomic_load_n(&future->state, __ATOMIC_ACQUIRE))) {
+        IjkThreadPoolFuture *task = ijk_threadpool_take(future->ctx, self);
+        struct timespec nap;
+
+        if (task) {
+            ijk_threadpool_run(task);
+            continue;
         }
+        if (timeout_ms >= 0 && ijk_threadpool_deadline_passed(&deadline))
+            return IJK_THREADPOOL_TIMEOUT;
+        ijk_threadpool_deadline(&nap, HELP_WAIT_US);
+        if (timeout_ms >= 0 && (nap.tv_sec > deadline.tv_sec ||
+                                (nap.tv_sec == deadline.tv_sec && nap.tv_nsec > deadline.tv_nsec)))
+            nap = deadline;
+        ijk_threadpool_wait_done(future, &nap);
+    }
+    return state;
+}
 
-        ctx->shutdown = flags;
+int ijk_threadpool_future_cancel(IjkThreadPoolFuture *future)
+{
+    int expected = IJK_THREADPOOL_TASK_PENDING;
 
-        /* Wake up all worker threads */
-        if((pthread_cond_broadcast(&(ctx->notify)) != 0) ||
-           (pthread_mutex_unlock(&(ctx->lock)) != 0)) {
-            err = IJK_THREADPOOL_LOCK_FAILURE;
-            break;
-        }
+    if (!future)
+        return IJK_THREADPOOL_INVALID;
 
-        /* Join all worker thread */
-        for(i = 0; i < ctx->thread_count; i++) {
-            if(pthread_join(ctx->threads[i], NULL) != 0) {
-                err = IJK_THREADPOOL_THREAD_FAILURE;
-            }
-        }
-    } while(0);
+    if (__atomic_compare_exchange_n(&future->state, &expected, IJK_THREADPOOL_TASK_CANCELLED,
+                                    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        ijk_threadpool_finish(future, IJK_THREADPOOL_TASK_CANCELLED);
+        return IJK_THREADPOOL_TASK_CANCELLED;
+    }
+    return expected;
+}
+
+int ijk_threadpool_future_state(IjkThreadPoolFuture *future)
+{
+    if (!future)
+        return IJK_THREADPOOL_INVALID;
+    return __atomic_load_n(&future->state, __ATOMIC_ACQUIRE);
+}
+
+void ijk_threadpool_future_releasep(IjkThreadPoolFuture **future)
+{
+    if (!future || !*future)
+        return;
+    ijk_threadpool_future_unref(*future);
+    *future = NULL;
+}
+
+int ijk_threadpool_destroy(IjkThreadPoolContext *ctx, int flags)
+{
+    int err;
+
+    if(ctx == NULL || ctx->shared || ijk_threadpool_current_worker(ctx)) {
+        return IJK_THREADPOOL_INVALID;
+    }
+
+    err = ijk_threadpool_shutdown(ctx, flags == IJK_LEISURELY_SHUTDOWN ? IJK_LEISURELY_SHUTDOWN : IJK_IMMEDIATE_SHUTDOWN);
 
     /* Only if everything went well do we deallocate the pool */
-    if(!err) {
-        return ijk_threadpool_freep(&ctx);
+    if (!err) {
+        ijk_threadpool_free(ctx);
     }
     return err;
 }
@@ -22,6 +22,7 @@
 #include <pthread.h>
 
 #define MAX_THREADS 100
+// initial capacity of each worker deque, the deques grow past it
 #define MAX_QUEUE 1024
 
 typedef enum {
@@ -29,7 +30,8 @@ typedef enum {
     IJK_THREADPOOL_LOCK_FAILURE   = -2,
     IJK_THREADPOOL_QUEUE_FULL     = -3,
     IJK_THREADPOOL_SHUTDOWN       = -4,
-    IJK_THREADPOOL_THREAD_FAILURE = -5
+    IJK_THREADPOOL_THREAD_FAILURE = -5,
+    IJK_THREADPOOL_TIMEOUT        = -6
 } IjkThreadPoolErrorType;
 
 typedef enum {
@@ -37,56 +39,105 @@ typedef enum {
     IJK_LEISURELY_SHUTDOWN = 2
 } IjkThreadPoolShutdownType;
 
+/**
+ * Workers take every critical task they can find, in their own deque or by
+ * stealing, before they look at background tasks.
+ */
+typedef enum {
+    IJK_THREADPOOL_PRIORITY_CRITICAL   = 0,
+    IJK_THREADPOOL_PRIORITY_BACKGROUND = 1
+} IjkThreadPoolPriority;
+
+#define IJK_THREADPOOL_PRIORITY_COUNT 2
+
+typedef enum {
+    IJK_THREADPOOL_TASK_PENDING   = 0,
+    IJK_THREADPOOL_TASK_RUNNING   = 1,
+    IJK_THREADPOOL_TASK_DONE      = 2,
+    IJK_THREADPOOL_TASK_CANCELLED = 3
+} IjkThreadPoolTaskState;
+
 typedef void (*Runable)(void *, void *);
+
 /**
- *  @struct ThreadPoolTask
- *  @brief the work struct
+ *  @struct IjkThreadPoolFuture
+ *  @brief completion handle of a submitted task
  *
- *  @var function Pointer to the function that will perform the task.
- *  @var in_arg Argument to be passed to the function.
- *  @var out_arg Argument to be passed to the call function.
+ *  Reference counted, the pool keeps one reference until the task ran or
+ *  was cancelled and the submitter owns the one it got back.
  */
-
-typedef struct IjkThreadPoolTask {
-    Runable function;
-    void *in_arg;
-    void *out_arg;
-} IjkThreadPoolTask;
+typedef struct IjkThreadPoolFuture IjkThreadPoolFuture;
 
 /**
- *  @struct ThreadPoolContext
- *  @brief The threadpool context struct
+ *  @struct IjkThreadPoolContext
+ *  @brief work stealing pool
  *
- *  @var notify        Condition variable to notify worker threads.
- *  @var threads       Array containing worker threads ID.
- *  @var thread_count  Number of threads
- *  @var queue         Array containing the task queue.
- *  @var queue_size    Size of the task queue.
- *  @var queue_head    Index of the first element.
- *  @var queue_tail    Index of the next element.
- *  @var pending_count Number of pending tasks
- *  @var shutdown      Flag indicating if the pool is shutting down
- *  @var started       Number of started threads
+ *  Every worker owns one deque per priority. A task submitted from a worker
+ *  goes to the bottom of that worker's deque and the owner pops from the
+ *  bottom, tasks from other threads are spread over the workers round robin.
+ *  An idle worker steals from the top of the other deques, so there is no
+ *  lock shared by all submitters and the deques grow instead of rejecting
+ *  bursts with IJK_THREADPOOL_QUEUE_FULL.
  */
-typedef struct IjkThreadPoolContext {
-    pthread_mutex_t lock;
-    pthread_cond_t notify;
-    pthread_t *threads;
-    IjkThreadPoolTask *queue;
-    int thread_count;
-    int queue_size;
-    int queue_head;
-    int queue_tail;
-    int pending_count;
-    int shutdown;
-    int started_count;
-} IjkThreadPoolContext;
+typedef struct IjkThreadPoolContext IjkThreadPoolContext;
 
+/**
+ * queue_size is the initial capacity of each worker deque, flags is unused.
+ */
 IjkThreadPoolContext *ijk_threadpool_create(int thread_count, int queue_size, int flags);
 
+/**
+ * The process wide pool shared by subtitles, mosaic scaling and the other
+ * players of the process. Created on first use and never destroyed,
+ * ijk_threadpool_destroy() refuses it. Only for tasks that return soon,
+ * a task that loops for the life of a stream starves everyone else.
+ */
+IjkThreadPoolContext *ijk_threadpool_shared(void);
+
+/**
+ * Queue function(in_arg, out_arg) without a completion handle.
+ *
+ * @param flags the IjkThreadPoolPriority of the task
+ */
 int ijk_threadpool_add(IjkThreadPoolContext *ctx, Runable function,
                    void *in_arg, void *out_arg, int flags);
 
+/**
+ * Queue function(in_arg, out_arg) at priority.
+ *
+ * @param future if not NULL, receives a handle to wait for or cancel the task,
+ *               release it with ijk_threadpool_future_releasep()
+ * @return 0 on success, IJK_THREADPOOL_SHUTDOWN once the pool is being destroyed
+ */
+int ijk_threadpool_submit(IjkThreadPoolContext *ctx, Runable function,
+                          void *in_arg, void *out_arg, int priority,
+                          IjkThreadPoolFuture **future);
+
+/**
+ * Wait until the task finished or was cancelled. Called from a worker of the
+ * same pool, the worker runs other tasks meanwhile instead of blocking.
+ *
+ * @param timeout_ms < 0 waits forever
+ * @return IJK_THREADPOOL_TASK_DONE, IJK_THREADPOOL_TASK_CANCELLED or IJK_THREADPOOL_TIMEOUT
+ */
+int ijk_threadpool_future_wait(IjkThreadPoolFuture *future, int timeout_ms);
+
+/**
+ * Cancel the task if it did not start yet, a running task is not interrupted.
+ *
+ * @return the IjkThreadPoolTaskState after the call, IJK_THREADPOOL_TASK_CANCELLED
+ *         means function will never be called
+ */
+int ijk_threadpool_future_cancel(IjkThreadPoolFuture *future);
+
+int ijk_threadpool_future_state(IjkThreadPoolFuture *future);
+
+void ijk_threadpool_future_releasep(IjkThreadPoolFuture **future);
+
+/**
+ * IJK_IMMEDIATE_SHUTDOWN cancels the tasks that did not start,
+ * IJK_LEISURELY_SHUTDOWN runs them first. Returns after all workers exited.
+ */
 int ijk_threadpool_destroy(IjkThreadPoolContext *ctx, int flags);
 
 #endif /* _IJK_THREADPOOL_H_ */
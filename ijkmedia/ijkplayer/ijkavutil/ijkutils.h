@@ -23,6 +23,7 @@
 #define IJKAVUTIL_IJKUTILS_H
 
 #include "ijktree.h"
+#include "ijkrangeindex.h"
 
 #include <errno.h>
 #include <stddef.h>
@@ -34,7 +35,7 @@ typedef struct IjkAVIOInterruptCB {
 } IjkAVIOInterruptCB;
 
 typedef struct IjkCacheTreeInfo {
-    struct IjkAVTreeNode *root;
+    IjkRangeIndex ranges;
     int64_t physical_init_pos;
     int64_t physical_size;
     int64_t file_size;
@@ -258,6 +258,16 @@ int64_t ijkmp_get_property_int64(IjkMediaPlayer *mp, int id, int64_t default_val
     return ret;
 }
 
+int ijkmp_get_frame_histograms(IjkMediaPlayer *mp, FFHistogramSnapshot *snapshots, int nb_snapshots, int reset)
+{
+    assert(mp);
+
+    pthread_mutex_lock(&mp->mutex);
+    int ret = ffp_get_frame_histograms(mp->ffplayer, snapshots, nb_snapshots, reset);
+    pthread_mutex_unlock(&mp->mutex);
+    return ret;
+}
+
 void ijkmp_set_property_int64(IjkMediaPlayer *mp, int id, int64_t value)
 {
     assert(mp);
@@ -359,6 +369,47 @@ int ijkmp_set_data_source(IjkMediaPlayer *mp, const char *url)
     return retval;
 }
 
+int ijkmp_preload_next(IjkMediaPlayer *mp, const char *url)
+{
+    assert(mp);
+    MPTRACE("ijkmp_preload_next(url=\"%s\")\n", url ? url : "");
+    pthread_mutex_lock(&mp->mutex);
+    int retval = ffp_preload_next_l(mp->ffplayer, url);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("ijkmp_preload_next()=%d\n", retval);
+    return retval;
+}
+
+int ijkmp_join_group(IjkMediaPlayer *mp, FFPlayerGroup *group, FFPlayerTier tier)
+{
+    assert(mp);
+    MPTRACE("ijkmp_join_group(tier=%d)\n", tier);
+    pthread_mutex_lock(&mp->mutex);
+    int retval = ff_player_group_join(group, mp->ffplayer, tier);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("ijkmp_join_group()=%d\n", retval);
+    return retval;
+}
+
+void ijkmp_leave_group(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    MPTRACE("ijkmp_leave_group()\n");
+    pthread_mutex_lock(&mp->mutex);
+    ff_player_group_leave(mp->ffplayer);
+    pthread_mutex_unlock(&mp->mutex);
+}
+
+int ijkmp_set_group_tier(IjkMediaPlayer *mp, FFPlayerTier tier)
+{
+    assert(mp);
+    MPTRACE("ijkmp_set_group_tier(tier=%d)\n", tier);
+    pthread_mutex_lock(&mp->mutex);
+    int retval = ff_player_group_set_tier(mp->ffplayer, tier);
+    pthread_mutex_unlock(&mp->mutex);
+    return retval;
+}
+
 static int ijkmp_msg_loop(void *arg)
 {
     IjkMediaPlayer *mp = arg;
@@ -563,8 +614,9 @@ static int ijkmp_seek_to_l(IjkMediaPlayer *mp, long msec)
 
     MP_RET_IF_FAILED(ikjmp_chkst_seek_l(mp->mp_state));
 
-    mp->seek_req = 1;
-    mp->seek_msec = msec;
+    // seek_msec before seek_req, for ijkmp_get_current_position_nolock()
+    __atomic_store_n(&mp->seek_msec, msec, __ATOMIC_RELAXED);
+    __atomic_store_n(&mp->seek_req, 1, __ATOMIC_RELEASE);
     ffp_remove_msg(mp->ffplayer, FFP_REQ_SEEK);
     ffp_notify_msg2(mp->ffplayer, FFP_REQ_SEEK, (int)msec);
     // TODO: 9 64-bit long?
@@ -605,6 +657,14 @@ long ijkmp_get_current_position(IjkMediaPlayer *mp)
     return retval;
 }
 
+long ijkmp_get_current_position_nolock(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    if (__atomic_load_n(&mp->seek_req, __ATOMIC_ACQUIRE))
+        return __atomic_load_n(&mp->seek_msec, __ATOMIC_RELAXED);
+    return ffp_get_current_position_nolock(mp->ffplayer);
+}
+
 static long ijkmp_get_duration_l(IjkMediaPlayer *mp)
 {
     return ffp_get_duration_l(mp->ffplayer);
@@ -704,8 +764,8 @@ int ijkmp_get_msg(IjkMediaPlayer *mp, AVMessage *msg, int block)
             MPTRACE("ijkmp_get_msg: FFP_MSG_SEEK_COMPLETE\n");
             long seek_msec2 = 0;
             pthread_mutex_lock(&mp->mutex);
-            mp->seek_req = 0;
-            mp->seek_msec = 0;
+            // seek_msec stays, a lock-free reader may still pair it with the old seek_req
+            __atomic_store_n(&mp->seek_req, 0, __ATOMIC_RELAXED);
             if (mp->seek_req2) {
                 seek_msec2 = mp->seek_msec2;
                 mp->seek_msec2 = 0;
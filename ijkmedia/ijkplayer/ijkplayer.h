@@ -26,6 +26,8 @@
 
 #include <stdbool.h>
 #include "ff_ffmsg_queue.h"
+#include "ff_histogram.h"
+#include "ff_player_group.h"
 
 #include "ijkmeta.h"
 
@@ -178,6 +180,8 @@ float           ijkmp_get_property_float(IjkMediaPlayer *mp, int id, float defau
 void            ijkmp_set_property_float(IjkMediaPlayer *mp, int id, float value);
 int64_t         ijkmp_get_property_int64(IjkMediaPlayer *mp, int id, int64_t default_value);
 void            ijkmp_set_property_int64(IjkMediaPlayer *mp, int id, int64_t value);
+/* per video frame timing distributions in FFP_FRAME_HIST_* order, see ffp_get_frame_histograms */
+int             ijkmp_get_frame_histograms(IjkMediaPlayer *mp, FFHistogramSnapshot *snapshots, int nb_snapshots, int reset);
 
 // must be freed with free();
 IjkMediaMeta   *ijkmp_get_meta_l(IjkMediaPlayer *mp);
@@ -195,6 +199,12 @@ void            ijkmp_dec_ref_p(IjkMediaPlayer **pmp);
 
 int             ijkmp_set_data_source(IjkMediaPlayer *mp, const char *url);
 int             ijkmp_prepare_async(IjkMediaPlayer *mp);
+/* play url right after the current item without a gap, NULL cancels; see FFP_MSG_NEXT_ITEM_* */
+int             ijkmp_preload_next(IjkMediaPlayer *mp, const char *url);
+/* share decoder threads, buffer memory and read bandwidth with the other players of group */
+int             ijkmp_join_group(IjkMediaPlayer *mp, FFPlayerGroup *group, FFPlayerTier tier);
+void            ijkmp_leave_group(IjkMediaPlayer *mp);
+int             ijkmp_set_group_tier(IjkMediaPlayer *mp, FFPlayerTier tier);
 int             ijkmp_start(IjkMediaPlayer *mp);
 int             ijkmp_pause(IjkMediaPlayer *mp);
 int             ijkmp_stop(IjkMediaPlayer *mp);
@@ -202,6 +212,8 @@ int             ijkmp_seek_to(IjkMediaPlayer *mp, long msec);
 int             ijkmp_get_state(IjkMediaPlayer *mp);
 bool            ijkmp_is_playing(IjkMediaPlayer *mp);
 long            ijkmp_get_current_position(IjkMediaPlayer *mp);
+/* never blocks, for polling the position at ui rate from any thread */
+long            ijkmp_get_current_position_nolock(IjkMediaPlayer *mp);
 long            ijkmp_get_duration(IjkMediaPlayer *mp);
 long            ijkmp_get_playable_duration(IjkMediaPlayer *mp);
 void            ijkmp_set_loop(IjkMediaPlayer *mp, int loop);
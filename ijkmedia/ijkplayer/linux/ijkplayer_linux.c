@@ -0,0 +1,67 @@
+//
+//  ijkplayer_linux.c
+//  IJKMediaPlayerKit
+//
+//  Player without a gpu or sound card, pictures come out as rgba through the soft vout.
+//
+
+#include "ijkplayer_linux.h"
+#include <assert.h>
+#include "ijkplayer/ff_fferror.h"
+#include "ijkplayer/ff_ffplay.h"
+#include "ijkplayer/ijkplayer_internal.h"
+#include "pipeline/ffpipeline_linux.h"
+
+IjkMediaPlayer *ijkmp_linux_create(int (*msg_loop)(void*))
+{
+    IjkMediaPlayer *mp = ijkmp_create(msg_loop);
+    if (!mp)
+        goto fail;
+
+    mp->ffplayer->vout = SDL_VoutSoft_Create();
+    if (!mp->ffplayer->vout)
+        goto fail;
+
+    mp->ffplayer->pipeline = ffpipeline_create_from_linux(mp->ffplayer);
+    if (!mp->ffplayer->pipeline)
+        goto fail;
+
+    return mp;
+
+fail:
+    ijkmp_dec_ref_p(&mp);
+    return NULL;
+}
+
+void ijkmp_linux_set_pixel_callback(IjkMediaPlayer *mp, SDL_VoutSoft_PixelCallback callback, void *opaque)
+{
+    assert(mp);
+    MPTRACE("%s(%p)\n", __func__, opaque);
+    pthread_mutex_lock(&mp->mutex);
+    SDL_VoutSoft_SetPixelCallback(mp->ffplayer->vout, callback, opaque);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+int ijkmp_linux_set_shared_framebuffer(IjkMediaPlayer *mp, const char *name, int max_width, int max_height)
+{
+    assert(mp);
+    MPTRACE("%s(%s, %dx%d)\n", __func__, name ? name : "null", max_width, max_height);
+    pthread_mutex_lock(&mp->mutex);
+    int ret = SDL_VoutSoft_SetSharedFramebuffer(mp->ffplayer->vout, name, max_width, max_height);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=%d\n", __func__, ret);
+    return ret;
+}
+
+void ijkmp_linux_set_pcm_callback(IjkMediaPlayer *mp, SDL_AoutSoft_PCMCallback callback, void *opaque)
+{
+    assert(mp);
+    MPTRACE("%s(%p)\n", __func__, opaque);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_linux_set_pcm_callback(mp->ffplayer->pipeline, callback, opaque);
+    if (mp->ffplayer->aout)
+        SDL_AoutSoft_SetPCMCallback(mp->ffplayer->aout, callback, opaque);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
@@ -0,0 +1,24 @@
+//
+//  ijkplayer_linux.h
+//  IJKMediaPlayerKit
+//
+//  Player without a gpu or sound card, pictures come out as rgba through the soft vout.
+//
+
+#ifndef ijkplayer_linux_h
+#define ijkplayer_linux_h
+
+#include "ijkplayer/ijkplayer.h"
+#include "ijksdl/soft/ijksdl_vout_soft.h"
+#include "ijksdl/soft/ijksdl_aout_soft.h"
+
+// ref_count is 1 after open
+IjkMediaPlayer *ijkmp_linux_create(int (*msg_loop)(void*));
+
+void ijkmp_linux_set_pixel_callback(IjkMediaPlayer *mp, SDL_VoutSoft_PixelCallback callback, void *opaque);
+/* see SDL_VoutSoft_SetSharedFramebuffer */
+int  ijkmp_linux_set_shared_framebuffer(IjkMediaPlayer *mp, const char *name, int max_width, int max_height);
+/* also reaches an audio output that is already open */
+void ijkmp_linux_set_pcm_callback(IjkMediaPlayer *mp, SDL_AoutSoft_PCMCallback callback, void *opaque);
+
+#endif /* ijkplayer_linux_h */
@@ -0,0 +1,64 @@
+//
+//  ffpipeline_linux.c
+//  IJKMediaPlayerKit
+//
+//  Software decoding and the device-less soft audio output.
+//
+
+#include "ffpipeline_linux.h"
+#include "ijkplayer/ff_ffplay.h"
+#include "ijkplayer/pipeline/ffpipenode_ffplay_vdec.h"
+#include "ijksdl/soft/ijksdl_aout_soft.h"
+
+struct IJKFF_Pipeline_Opaque {
+    FFPlayer *ffp;
+
+    SDL_AoutSoft_PCMCallback pcm_callback;
+    void *pcm_callback_opaque;
+};
+
+static void func_destroy(IJKFF_Pipeline *pipeline)
+{
+    // do nothing
+}
+
+static IJKFF_Pipenode *func_open_video_decoder(IJKFF_Pipeline *pipeline, FFPlayer *ffp)
+{
+    return ffpipenode_create_video_decoder_from_ffplay(ffp);
+}
+
+static SDL_Aout *func_open_audio_output(IJKFF_Pipeline *pipeline, FFPlayer *ffp)
+{
+    SDL_Aout *aout = SDL_AoutSoft_Create();
+    if (aout && pipeline->opaque->pcm_callback)
+        SDL_AoutSoft_SetPCMCallback(aout, pipeline->opaque->pcm_callback, pipeline->opaque->pcm_callback_opaque);
+    return aout;
+}
+
+static SDL_Class g_pipeline_class = {
+    .name = "ffpipeline_linux",
+};
+
+IJKFF_Pipeline *ffpipeline_create_from_linux(FFPlayer *ffp)
+{
+    IJKFF_Pipeline *pipeline = ffpipeline_alloc(&g_pipeline_class, sizeof(IJKFF_Pipeline_Opaque));
+    if (!pipeline)
+        return pipeline;
+
+    IJKFF_Pipeline_Opaque *opaque     = pipeline->opaque;
+    opaque->ffp                       = ffp;
+    pipeline->func_destroy            = func_destroy;
+    pipeline->func_open_video_decoder = func_open_video_decoder;
+    pipeline->func_open_audio_output  = func_open_audio_output;
+
+    return pipeline;
+}
+
+void ffpipeline_linux_set_pcm_callback(IJKFF_Pipeline *pipeline, SDL_AoutSoft_PCMCallback callback, void *opaque)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    pipeline->opaque->pcm_callback        = callback;
+    pipeline->opaque->pcm_callback_opaque = opaque;
+}
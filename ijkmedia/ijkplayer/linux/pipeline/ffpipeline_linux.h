@@ -0,0 +1,21 @@
+//
+//  ffpipeline_linux.h
+//  IJKMediaPlayerKit
+//
+//  Software decoding and the device-less soft audio output.
+//
+
+#ifndef ffpipeline_linux_h
+#define ffpipeline_linux_h
+
+#include "ijkplayer/ff_ffpipeline.h"
+#include "ijksdl/soft/ijksdl_aout_soft.h"
+
+struct FFPlayer;
+
+IJKFF_Pipeline *ffpipeline_create_from_linux(struct FFPlayer *ffp);
+
+/* handed to the soft aout when the audio output is opened */
+void ffpipeline_linux_set_pcm_callback(IJKFF_Pipeline *pipeline, SDL_AoutSoft_PCMCallback callback, void *opaque);
+
+#endif /* ffpipeline_linux_h */
@@ -55,6 +55,7 @@ LOCAL_SRC_FILES += dummy/ijksdl_vout_dummy.c
 
 LOCAL_SRC_FILES += ffmpeg/ijksdl_vout_overlay_ffmpeg.c
 LOCAL_SRC_FILES += ffmpeg/abi_all/image_convert.c
+LOCAL_SRC_FILES += ffmpeg/ijksdl_tonemap.c
 
 LOCAL_SRC_FILES += android/android_audiotrack.c
 LOCAL_SRC_FILES += android/android_nativewindow.c
@@ -24,6 +24,7 @@
 #include "../ijksdl_image_convert.h"
 #if defined(__ANDROID__)
 #include "libyuv/convert_from.h"
+#include "libyuv/scale.h"
 #endif
 
 int ijk_image_convert(int width, int height,
@@ -60,3 +61,28 @@ int ijk_image_convert(int width, int height,
     return -1;
 }
 
+
+int ijk_image_scale(int src_width, int src_height,
+    enum AVPixelFormat src_format, const uint8_t **src_data, const int *src_linesize,
+    int dst_width, int dst_height, uint8_t **dst_data, const int *dst_linesize)
+{
+#if defined(__ANDROID__)
+    switch (src_format) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+            return I420Scale(
+                src_data[0], src_linesize[0],
+                src_data[1], src_linesize[1],
+                src_data[2], src_linesize[2],
+                src_width, src_height,
+                dst_data[0], dst_linesize[0],
+                dst_data[1], dst_linesize[1],
+                dst_data[2], dst_linesize[2],
+                dst_width, dst_height,
+                kFilterBilinear);
+        default:
+            break;
+    }
+#endif
+    return -1;
+}
@@ -32,4 +32,9 @@ int ijk_image_convert(int width, int height,
     enum AVPixelFormat dst_format, uint8_t **dst_data, int *dst_linesize,
     enum AVPixelFormat src_format, const uint8_t **src_data, const int *src_linesize);
 
+/* resize a yuv420p picture into yuv420p planes, -1 where libyuv can't do it */
+int ijk_image_scale(int src_width, int src_height,
+    enum AVPixelFormat src_format, const uint8_t **src_data, const int *src_linesize,
+    int dst_width, int dst_height, uint8_t **dst_data, const int *dst_linesize);
+
 #endif
@@ -0,0 +1,599 @@
+//
+//  ijksdl_tonemap.c
+//  IJKMediaPlayerKit
+//
+//  HDR10 and HLG to SDR BT.709 on the cpu, for outputs without the gpu shaders.
+//
+
+#include "ijksdl_tonemap.h"
+#include <math.h>
+#include <string.h>
+#include "libavutil/cpu.h"
+#include "libavutil/mastering_display_metadata.h"
+#include "../ijksdl_mutex.h"
+#include "../ijksdl_thread.h"
+#include "../ijksdl_log.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#define TONEMAP_LUT_SIZE        4096
+#define TONEMAP_LUT_MAX         (TONEMAP_LUT_SIZE - 1)
+#define TONEMAP_MAX_THREADS     4
+//BT.2408 HDR reference white, it becomes SDR white
+#define TONEMAP_REF_WHITE       203.0
+#define TONEMAP_DEFAULT_PEAK    1000.0
+//nominal HLG display and its system gamma
+#define TONEMAP_HLG_PEAK        1000.0
+#define TONEMAP_HLG_GAMMA       1.2
+
+/*
+ * the lanes are four 2x2 blocks, their chroma is one vector and every step is one 4 lane op.
+ * only the table lookups are scalar.
+ */
+#if defined(__SSE2__)
+typedef __m128 v4f;
+static inline v4f v4f_set1(float x)             { return _mm_set1_ps(x); }
+static inline v4f v4f_setr(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+static inline v4f v4f_load(const float *p)      { return _mm_loadu_ps(p); }
+static inline void v4f_store(float *p, v4f a)   { _mm_storeu_ps(p, a); }
+static inline v4f v4f_add(v4f a, v4f b)         { return _mm_add_ps(a, b); }
+static inline v4f v4f_sub(v4f a, v4f b)         { return _mm_sub_ps(a, b); }
+static inline v4f v4f_mul(v4f a, v4f b)         { return _mm_mul_ps(a, b); }
+static inline v4f v4f_min(v4f a, v4f b)         { return _mm_min_ps(a, b); }
+static inline v4f v4f_max(v4f a, v4f b)         { return _mm_max_ps(a, b); }
+static inline v4f v4f_sqrt(v4f a)               { return _mm_sqrt_ps(a); }
+//truncates, the callers add 0.5 to non negative values
+static inline void v4f_store_int(int32_t *p, v4f a) { _mm_storeu_si128((__m128i *)p, _mm_cvttps_epi32(a)); }
+#elif defined(__aarch64__)
+typedef float32x4_t v4f;
+static inline v4f v4f_set1(float x)             { return vdupq_n_f32(x); }
+static inline v4f v4f_setr(float a, float b, float c, float d) { float32x4_t r = vdupq_n_f32(a); r = vsetq_lane_f32(b, r, 1); r = vsetq_lane_f32(c, r, 2); return vsetq_lane_f32(d, r, 3); }
+static inline v4f v4f_load(const float *p)      { return vld1q_f32(p); }
+static inline void v4f_store(float *p, v4f a)   { vst1q_f32(p, a); }
+static inline v4f v4f_add(v4f a, v4f b)         { return vaddq_f32(a, b); }
+static inline v4f v4f_sub(v4f a, v4f b)         { return vsubq_f32(a, b); }
+static inline v4f v4f_mul(v4f a, v4f b)         { return vmulq_f32(a, b); }
+static inline v4f v4f_min(v4f a, v4f b)         { return vminq_f32(a, b); }
+static inline v4f v4f_max(v4f a, v4f b)         { return vmaxq_f32(a, b); }
+static inline v4f v4f_sqrt(v4f a)               { return vsqrtq_f32(a); }
+static inline void v4f_store_int(int32_t *p, v4f a) { vst1q_s32(p, vcvtq_s32_f32(a)); }
+#else
+typedef struct v4f { float v[4]; } v4f;
+#define V4F_OP(name, expr) \
+static inline v4f name(v4f a, v4f b) { v4f r; for (int i = 0; i < 4; i++) { float x = a.v[i], y = b.v[i]; r.v[i] = (expr); } return r; }
+V4F_OP(v4f_add, x + y)
+V4F_OP(v4f_sub, x - y)
+V4F_OP(v4f_mul, x * y)
+V4F_OP(v4f_min, x < y ? x : y)
+V4F_OP(v4f_max, x > y ? x : y)
+#undef V4F_OP
+static inline v4f v4f_set1(float x)             { v4f r = {{ x, x, x, x }}; return r; }
+static inline v4f v4f_setr(float a, float b, float c, float d) { v4f r = {{ a, b, c, d }}; return r; }
+static inline v4f v4f_load(const float *p)      { v4f r; memcpy(r.v, p, sizeof(r.v)); return r; }
+static inline void v4f_store(float *p, v4f a)   { memcpy(p, a.v, sizeof(a.v)); }
+static inline v4f v4f_sqrt(v4f a)               { for (int i = 0; i < 4; i++) a.v[i] = sqrtf(a.v[i]); return a; }
+static inline void v4f_store_int(int32_t *p, v4f a) { for (int i = 0; i < 4; i++) p[i] = (int32_t)a.v[i]; }
+#endif
+
+typedef struct ToneMapParams {
+    //P010 keeps its samples in the high bits
+    int shift;
+    float y_off, y_scale, c_off, c_scale;
+    //10 bit Y'CbCr to R'G'B', Y' has a factor of 1
+    float cr_r, cb_g, cr_g, cb_b;
+    //luminance of the source primaries, drives the HLG OOTF
+    float kr, kg, kb;
+    int hlg;
+    float inv_peak;
+    int gamut;
+    float gamut_m[9];
+    //BT.709 R'G'B' to 8 bit Y'CbCr
+    float out_y_range, out_y_base, out_c_range;
+    int nv12;
+} ToneMapParams;
+
+typedef struct IJKToneMapWorker {
+    IJKToneMap *tm;
+    int slice;
+    SDL_Thread *tid;
+    SDL_Thread _tid;
+} IJKToneMapWorker;
+
+struct IJKToneMap {
+    IJKToneMapOperator op;
+
+    //what the tables were built for
+    enum AVColorTransferCharacteristic lut_trc;
+    int lut_peak;
+    //last peak read from side data, frames without it keep using it
+    double metadata_peak;
+    //code value to light relative to reference white
+    float lin_lut[TONEMAP_LUT_SIZE];
+    //HLG OOTF gain, indexed by the square root of scene luminance
+    float ootf_lut[TONEMAP_LUT_SIZE];
+    //tone curve over signal, indexed by the square root of signal / peak
+    float ratio_lut[TONEMAP_LUT_SIZE];
+    //BT.1886 inverse EOTF, indexed by the square root of light
+    float oetf_lut[TONEMAP_LUT_SIZE];
+
+    ToneMapParams params;
+    const AVFrame *src;
+    uint8_t *dst_data[4];
+    int dst_linesize[4];
+
+    int nb_threads;
+    IJKToneMapWorker *workers;
+    SDL_mutex *mutex;
+    SDL_cond *start_cond;
+    SDL_cond *done_cond;
+    int generation;
+    int pending;
+    int abort_request;
+};
+
+static const double pq_m1 = 2610.0 / 16384;
+static const double pq_m2 = 2523.0 / 4096 * 128;
+static const double pq_c1 = 3424.0 / 4096;
+static const double pq_c2 = 2413.0 / 4096 * 32;
+static const double pq_c3 = 2392.0 / 4096 * 32;
+
+static double pq_eotf(double e)
+{
+    double p = pow(FFMAX(e, 0.0), 1.0 / pq_m2);
+    return 10000.0 * pow(FFMAX(p - pq_c1, 0.0) / (pq_c2 - pq_c3 * p), 1.0 / pq_m1);
+}
+
+static double pq_inverse_eotf(double nits)
+{
+    double y = pow(FFMAX(nits, 0.0) / 10000.0, pq_m1);
+    return pow((pq_c1 + pq_c2 * y) / (1.0 + pq_c3 * y), pq_m2);
+}
+
+static double hlg_inverse_oetf(double e)
+{
+    const double a = 0.17883277, b = 1.0 - 4.0 * a, c = 0.5 - a * log(4.0 * a);
+    return e <= 0.5 ? e * e / 3.0 : (exp((e - c) / a) + b) / 12.0;
+}
+
+static double hable(double x)
+{
+    const double a = 0.15, b = 0.50, c = 0.10, d = 0.20, e = 0.02, f = 0.30;
+    return (x * (x * a + b * c) + d * e) / (x * (x * a + b) + d * f) - e / f;
+}
+
+//sig and peak relative to reference white, the result tops out at 1
+static double tonemap_curve(IJKToneMapOperator op, double sig, double peak)
+{
+    if (peak <= 1.0)
+        return FFMIN(sig, 1.0);
+
+    switch (op) {
+        case IJK_TONEMAP_HABLE:
+            return hable(sig) / hable(peak);
+        case IJK_TONEMAP_BT2390:
+        default: {
+            //hermite spline in the PQ domain above the knee ks, source black taken as 0
+            const double src_max = pq_inverse_eotf(peak * TONEMAP_REF_WHITE);
+            const double max_lum = pq_inverse_eotf(TONEMAP_REF_WHITE) / src_max;
+            const double ks = 1.5 * max_lum - 0.5;
+            double e = pq_inverse_eotf(sig * TONEMAP_REF_WHITE) / src_max;
+            if (e > ks) {
+                double t = (e - ks) / (1.0 - ks), t2 = t * t, t3 = t2 * t;
+                e = (2 * t3 - 3 * t2 + 1) * ks + (t3 - 2 * t2 + t) * (1.0 - ks) + (-2 * t3 + 3 * t2) * max_lum;
+            }
+            return pq_eotf(e * src_max) / TONEMAP_REF_WHITE;
+        }
+    }
+}
+
+static void tonemap_build_luts(IJKToneMap *tm, enum AVColorTransferCharacteristic trc, int peak_nits)
+{
+    const double peak = peak_nits / TONEMAP_REF_WHITE;
+
+    for (int i = 0; i < TONEMAP_LUT_SIZE; i++) {
+        double e = (double)i / TONEMAP_LUT_MAX;
+        if (trc == AVCOL_TRC_ARIB_STD_B67) {
+            double ys = e * e;
+            tm->lin_lut[i]  = hlg_inverse_oetf(e);
+            tm->ootf_lut[i] = TONEMAP_HLG_PEAK / TONEMAP_REF_WHITE * pow(ys, TONEMAP_HLG_GAMMA - 1.0);
+        } else {
+            tm->lin_lut[i]  = pq_eotf(e) / TONEMAP_REF_WHITE;
+        }
+    }
+
+    //entry 0 is the slope at black, taken from its neighbour
+    for (int i = 1; i < TONEMAP_LUT_SIZE; i++) {
+        double s = (double)i / TONEMAP_LUT_MAX;
+        double sig = s * s * peak;
+        tm->ratio_lut[i] = tonemap_curve(tm->op, sig, peak) / sig;
+    }
+    tm->ratio_lut[0] = tm->ratio_lut[1];
+
+    tm->lut_trc  = trc;
+    tm->lut_peak = peak_nits;
+}
+
+static double tonemap_peak_nits(IJKToneMap *tm, const AVFrame *frame)
+{
+    AVFrameSideData *sd;
+    double peak = 0;
+
+    if (frame->color_trc == AVCOL_TRC_ARIB_STD_B67)
+        return TONEMAP_HLG_PEAK;
+
+    sd = av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+    if (sd) {
+        const AVContentLightMetadata *clm = (const AVContentLightMetadata *)sd->data;
+        peak = clm->MaxCLL;
+    }
+    if (peak <= 0 && (sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA))) {
+        const AVMasteringDisplayMetadata *mdm = (const AVMasteringDisplayMetadata *)sd->data;
+        if (mdm->has_luminance && mdm->max_luminance.den)
+            peak = av_q2d(mdm->max_luminance);
+    }
+    if (peak > 0)
+        tm->metadata_peak = peak;
+    else if (tm->metadata_peak > 0)
+        peak = tm->metadata_peak;
+    else
+        peak = TONEMAP_DEFAULT_PEAK;
+    return av_clipd(peak, TONEMAP_REF_WHITE, 10000.0);
+}
+
+static void tonemap_set_params(IJKToneMap *tm, const AVFrame *src, enum AVPixelFormat dst_format, double peak_nits)
+{
+    static const double bt2020_to_bt709[9] = {
+         1.660491, -0.587641, -0.072850,
+        -0.124550,  1.132900, -0.008349,
+        -0.018151, -0.100579,  1.118730,
+    };
+    ToneMapParams *p = &tm->params;
+    const int full_range = src->color_range == AVCOL_RANGE_JPEG;
+    //BT.2020 non constant luminance unless the stream says BT.709
+    const double kr = src->colorspace == AVCOL_SPC_BT709 ? 0.2126 : 0.2627;
+    const double kb = src->colorspace == AVCOL_SPC_BT709 ? 0.0722 : 0.0593;
+    const double kg = 1.0 - kr - kb;
+
+    memset(p, 0, sizeof(*p));
+    p->shift   = src->format == AV_PIX_FMT_P010LE ? 6 : 0;
+    p->y_off   = full_range ? 0 : 64;
+    p->y_scale = full_range ? 1.0 / 1023 : 1.0 / 876;
+    p->c_off   = 512;
+    p->c_scale = full_range ? 1.0 / 1023 : 1.0 / 896;
+    p->cr_r    = 2 * (1 - kr);
+    p->cb_b    = 2 * (1 - kb);
+    p->cb_g    = -2 * (1 - kb) * kb / kg;
+    p->cr_g    = -2 * (1 - kr) * kr / kg;
+    p->kr      = kr;
+    p->kg      = kg;
+    p->kb      = kb;
+    p->hlg     = src->color_trc == AVCOL_TRC_ARIB_STD_B67;
+    p->inv_peak = TONEMAP_REF_WHITE / peak_nits;
+    p->gamut   = src->color_primaries != AVCOL_PRI_BT709;
+    for (int i = 0; i < 9; i++)
+        p->gamut_m[i] = bt2020_to_bt709[i];
+
+    if (dst_format == AV_PIX_FMT_YUVJ420P) {
+        p->out_y_range = 255;
+        p->out_y_base  = 0;
+        p->out_c_range = 255;
+    } else {
+        p->out_y_range = 219;
+        p->out_y_base  = 16;
+        p->out_c_range = 224;
+    }
+    p->nv12 = dst_format == AV_PIX_FMT_NV12;
+}
+
+static inline uint8_t clip_uint8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline v4f clamp01(v4f a)
+{
+    return v4f_min(v4f_max(a, v4f_set1(0.0f)), v4f_set1(1.0f));
+}
+
+//a is in [0, 1]
+static inline v4f lut_lookup(const float *lut, v4f a)
+{
+    int32_t idx[4];
+
+    v4f_store_int(idx, v4f_add(v4f_mul(a, v4f_set1(TONEMAP_LUT_MAX)), v4f_set1(0.5f)));
+    //built from registers, a vector load of four scalar stores would stall on store forwarding
+    return v4f_setr(lut[idx[0]], lut[idx[1]], lut[idx[2]], lut[idx[3]]);
+}
+
+/*
+ * four 2x2 blocks side by side, lane i of every vector belongs to block i and yq[0..3] are
+ * the top left, top right, bottom left and bottom right luma of the blocks.
+ * each step runs over the four pixel positions before the next one starts, so the four
+ * independent lookup chains overlap instead of waiting on each other.
+ * out is gamma encoded BT.709 R'G'B'.
+ */
+static void tonemap_blocks(const IJKToneMap *tm, const ToneMapParams *p, const v4f yq[4], v4f cb, v4f cr,
+                           v4f r[4], v4f g[4], v4f b[4])
+{
+    const v4f u = v4f_mul(v4f_sub(cb, v4f_set1(p->c_off)), v4f_set1(p->c_scale));
+    const v4f v = v4f_mul(v4f_sub(cr, v4f_set1(p->c_off)), v4f_set1(p->c_scale));
+    const v4f dr = v4f_mul(v, v4f_set1(p->cr_r));
+    const v4f dg = v4f_add(v4f_mul(u, v4f_set1(p->cb_g)), v4f_mul(v, v4f_set1(p->cr_g)));
+    const v4f db = v4f_mul(u, v4f_set1(p->cb_b));
+    int k;
+
+    for (k = 0; k < 4; k++) {
+        v4f y = v4f_mul(v4f_sub(yq[k], v4f_set1(p->y_off)), v4f_set1(p->y_scale));
+        r[k] = lut_lookup(tm->lin_lut, clamp01(v4f_add(y, dr)));
+        g[k] = lut_lookup(tm->lin_lut, clamp01(v4f_add(y, dg)));
+        b[k] = lut_lookup(tm->lin_lut, clamp01(v4f_add(y, db)));
+    }
+
+    if (p->hlg) {
+        for (k = 0; k < 4; k++) {
+            v4f ys = v4f_add(v4f_add(v4f_mul(r[k], v4f_set1(p->kr)), v4f_mul(g[k], v4f_set1(p->kg))),
+                             v4f_mul(b[k], v4f_set1(p->kb)));
+            v4f gain = lut_lookup(tm->ootf_lut, v4f_sqrt(clamp01(ys)));
+            r[k] = v4f_mul(r[k], gain);
+            g[k] = v4f_mul(g[k], gain);
+            b[k] = v4f_mul(b[k], gain);
+        }
+    }
+
+    //scaling all channels by the curve of the largest keeps the hue
+    for (k = 0; k < 4; k++) {
+        v4f sig = v4f_max(r[k], v4f_max(g[k], b[k]));
+        v4f ratio = lut_lookup(tm->ratio_lut, v4f_sqrt(clamp01(v4f_mul(sig, v4f_set1(p->inv_peak)))));
+        r[k] = v4f_mul(r[k], ratio);
+        g[k] = v4f_mul(g[k], ratio);
+        b[k] = v4f_mul(b[k], ratio);
+    }
+
+    if (p->gamut) {
+        const float *m = p->gamut_m;
+        for (k = 0; k < 4; k++) {
+            v4f r2 = v4f_add(v4f_add(v4f_mul(r[k], v4f_set1(m[0])), v4f_mul(g[k], v4f_set1(m[1]))), v4f_mul(b[k], v4f_set1(m[2])));
+            v4f g2 = v4f_add(v4f_add(v4f_mul(r[k], v4f_set1(m[3])), v4f_mul(g[k], v4f_set1(m[4]))), v4f_mul(b[k], v4f_set1(m[5])));
+            v4f b2 = v4f_add(v4f_add(v4f_mul(r[k], v4f_set1(m[6])), v4f_mul(g[k], v4f_set1(m[7]))), v4f_mul(b[k], v4f_set1(m[8])));
+            r[k] = r2;
+            g[k] = g2;
+            b[k] = b2;
+        }
+    }
+
+    for (k = 0; k < 4; k++) {
+        r[k] = lut_lookup(tm->oetf_lut, v4f_sqrt(clamp01(r[k])));
+        g[k] = lut_lookup(tm->oetf_lut, v4f_sqrt(clamp01(g[k])));
+        b[k] = lut_lookup(tm->oetf_lut, v4f_sqrt(clamp01(b[k])));
+    }
+}
+
+static void tonemap_slice(IJKToneMap *tm, int slice, int nb_slices)
+{
+    //a local copy, the byte stores into dst could alias tm and reload every field per block
+    const ToneMapParams params = tm->params;
+    const ToneMapParams *p = &params;
+    const AVFrame *src = tm->src;
+    const int w = src->width;
+    const int h = src->height;
+    const int rows = (h + 1) / 2;
+    const int begin = rows * slice / nb_slices;
+    const int end = rows * (slice + 1) / nb_slices;
+    const int shift = p->shift;
+    const int cstep = src->format == AV_PIX_FMT_P010LE ? 2 : 1;
+    const int dstep = p->nv12 ? 2 : 1;
+    const v4f kr = v4f_set1(0.2126f), kg = v4f_set1(0.7152f), kb = v4f_set1(0.0722f);
+    const v4f y_range = v4f_set1(p->out_y_range), y_base = v4f_set1(p->out_y_base + 0.5f);
+    const v4f cb_scale = v4f_set1(p->out_c_range / 1.8556f), cr_scale = v4f_set1(p->out_c_range / 1.5748f);
+    const v4f c_base = v4f_set1(128.5f), quarter = v4f_set1(0.25f);
+
+    for (int cy = begin; cy < end; cy++) {
+        const int y0 = cy * 2;
+        const int y1 = FFMIN(y0 + 1, h - 1);
+        const uint16_t *l0 = (const uint16_t *)(src->data[0] + y0 * src->linesize[0]);
+        const uint16_t *l1 = (const uint16_t *)(src->data[0] + y1 * src->linesize[0]);
+        const uint16_t *su = (const uint16_t *)(src->data[1] + cy * src->linesize[1]);
+        const uint16_t *sv = cstep == 2 ? su + 1 : (const uint16_t *)(src->data[2] + cy * src->linesize[2]);
+        uint8_t *d0 = tm->dst_data[0] + y0 * tm->dst_linesize[0];
+        uint8_t *d1 = tm->dst_data[0] + y1 * tm->dst_linesize[0];
+        uint8_t *du = tm->dst_data[1] + cy * tm->dst_linesize[1];
+        uint8_t *dv = p->nv12 ? du + 1 : tm->dst_data[2] + cy * tm->dst_linesize[2];
+
+        for (int x = 0; x < w; x += 8) {
+            float yf[4][4], cbf[4], crf[4];
+            int32_t yc[4][4], cbc[4], crc[4];
+            v4f yq[4], r[4], g[4], b[4], ra, ga, ba, ya;
+
+            //the right edge repeats its last column into the blocks past it
+            for (int i = 0; i < 4; i++) {
+                const int xa = FFMIN(x + 2 * i, w - 1);
+                const int xb = FFMIN(x + 2 * i + 1, w - 1);
+                const int cx = xa >> 1;
+                yf[0][i] = (l0[xa] >> shift) & 0x3ff;
+                yf[1][i] = (l0[xb] >> shift) & 0x3ff;
+                yf[2][i] = (l1[xa] >> shift) & 0x3ff;
+                yf[3][i] = (l1[xb] >> shift) & 0x3ff;
+                cbf[i]   = (su[cx * cstep] >> shift) & 0x3ff;
+                crf[i]   = (sv[cx * cstep] >> shift) & 0x3ff;
+            }
+            for (int k = 0; k < 4; k++)
+                yq[k] = v4f_load(yf[k]);
+
+            tonemap_blocks(tm, p, yq, v4f_load(cbf), v4f_load(crf), r, g, b);
+
+            for (int k = 0; k < 4; k++) {
+                v4f y = v4f_add(v4f_add(v4f_mul(r[k], kr), v4f_mul(g[k], kg)), v4f_mul(b[k], kb));
+                v4f_store_int(yc[k], v4f_add(v4f_mul(y, y_range), y_base));
+            }
+            //chroma of the block average, in the gamma domain like every 4:2:0 encoder.
+            //|Cb| and |Cr| stay within 0.5, so the sums are positive and truncation rounds
+            ra = v4f_mul(v4f_add(v4f_add(r[0], r[1]), v4f_add(r[2], r[3])), quarter);
+            ga = v4f_mul(v4f_add(v4f_add(g[0], g[1]), v4f_add(g[2], g[3])), quarter);
+            ba = v4f_mul(v4f_add(v4f_add(b[0], b[1]), v4f_add(b[2], b[3])), quarter);
+            ya = v4f_add(v4f_add(v4f_mul(ra, kr), v4f_mul(ga, kg)), v4f_mul(ba, kb));
+            v4f_store_int(cbc, v4f_add(v4f_mul(v4f_sub(ba, ya), cb_scale), c_base));
+            v4f_store_int(crc, v4f_add(v4f_mul(v4f_sub(ra, ya), cr_scale), c_base));
+
+            for (int i = 0; i < 4 && x + 2 * i < w; i++) {
+                const int xa = x + 2 * i;
+                const int xb = FFMIN(xa + 1, w - 1);
+                const int cx = xa >> 1;
+                d0[xa] = clip_uint8(yc[0][i]);
+                d0[xb] = clip_uint8(yc[1][i]);
+                d1[xa] = clip_uint8(yc[2][i]);
+                d1[xb] = clip_uint8(yc[3][i]);
+                du[cx * dstep] = clip_uint8(cbc[i]);
+                dv[cx * dstep] = clip_uint8(crc[i]);
+            }
+        }
+    }
+}
+
+static int tonemap_worker_thread(void *arg)
+{
+    IJKToneMapWorker *w = arg;
+    IJKToneMap *tm = w->tm;
+    int generation = 0;
+
+    SDL_LockMutex(tm->mutex);
+    for (;;) {
+        while (!tm->abort_request && tm->generation == generation)
+            SDL_CondWait(tm->start_cond, tm->mutex);
+        if (tm->abort_request)
+            break;
+        generation = tm->generation;
+        SDL_UnlockMutex(tm->mutex);
+
+        tonemap_slice(tm, w->slice, tm->nb_threads);
+
+        SDL_LockMutex(tm->mutex);
+        if (--tm->pending == 0)
+            SDL_CondSignal(tm->done_cond);
+    }
+    SDL_UnlockMutex(tm->mutex);
+    return 0;
+}
+
+IJKToneMap *ijk_tonemap_create(IJKToneMapOperator op, int threads)
+{
+    IJKToneMap *tm = av_mallocz(sizeof(IJKToneMap));
+    if (!tm)
+        return NULL;
+
+    tm->op = op;
+    tm->lut_trc = AVCOL_TRC_UNSPECIFIED;
+    for (int i = 0; i < TONEMAP_LUT_SIZE; i++) {
+        double s = (double)i / TONEMAP_LUT_MAX;
+        tm->oetf_lut[i] = pow(s * s, 1.0 / 2.4);
+    }
+
+    tm->nb_threads = threads > 0 ? threads : FFMIN(av_cpu_count(), TONEMAP_MAX_THREADS);
+    if (tm->nb_threads > 1) {
+        tm->mutex      = SDL_CreateMutex();
+        tm->start_cond = SDL_CreateCond();
+        tm->done_cond  = SDL_CreateCond();
+        tm->workers    = av_calloc(tm->nb_threads, sizeof(IJKToneMapWorker));
+        if (!tm->mutex || !tm->start_cond || !tm->done_cond || !tm->workers) {
+            ijk_tonemap_freep(&tm);
+            return NULL;
+        }
+        //slice 0 runs on the caller
+        for (int i = 1; i < tm->nb_threads; i++) {
+            IJKToneMapWorker *w = &tm->workers[i];
+            w->tm    = tm;
+            w->slice = i;
+            w->tid   = SDL_CreateThreadEx(&w->_tid, tonemap_worker_thread, w, "ijk_tonemap");
+            if (!w->tid) {
+                ALOGE("ijk_tonemap: only %d of %d threads\n", i, tm->nb_threads);
+                tm->nb_threads = i;
+                break;
+            }
+        }
+    }
+    if (tm->nb_threads < 1)
+        tm->nb_threads = 1;
+    return tm;
+}
+
+void ijk_tonemap_freep(IJKToneMap **ptm)
+{
+    IJKToneMap *tm;
+
+    if (!ptm || !*ptm)
+        return;
+    tm = *ptm;
+
+    if (tm->workers) {
+        SDL_LockMutex(tm->mutex);
+        tm->abort_request = 1;
+        SDL_CondBroadcast(tm->start_cond);
+        SDL_UnlockMutex(tm->mutex);
+        for (int i = 1; i < tm->nb_threads; i++) {
+            if (tm->workers[i].tid)
+                SDL_WaitThread(tm->workers[i].tid, NULL);
+        }
+        av_freep(&tm->workers);
+    }
+    SDL_DestroyCondP(&tm->done_cond);
+    SDL_DestroyCondP(&tm->start_cond);
+    SDL_DestroyMutexP(&tm->mutex);
+    av_freep(ptm);
+}
+
+int ijk_tonemap_is_hdr(const AVFrame *frame)
+{
+    if (!frame)
+        return 0;
+    if (frame->format != AV_PIX_FMT_YUV420P10LE && frame->format != AV_PIX_FMT_P010LE)
+        return 0;
+    return frame->color_trc == AVCOL_TRC_SMPTE2084 || frame->color_trc == AVCOL_TRC_ARIB_STD_B67;
+}
+
+int ijk_tonemap_supports_format(enum AVPixelFormat dst_format)
+{
+    return dst_format == AV_PIX_FMT_YUV420P || dst_format == AV_PIX_FMT_YUVJ420P || dst_format == AV_PIX_FMT_NV12;
+}
+
+int ijk_tonemap_convert(IJKToneMap *tm, const AVFrame *src,
+                        enum AVPixelFormat dst_format, uint8_t **dst_data, const int *dst_linesize)
+{
+    double peak_nits;
+
+    if (!tm || !ijk_tonemap_is_hdr(src) || src->width <= 0 || src->height <= 0)
+        return -1;
+    if (!ijk_tonemap_supports_format(dst_format))
+        return -1;
+
+    peak_nits = tonemap_peak_nits(tm, src);
+    if (tm->lut_trc != src->color_trc || tm->lut_peak != (int)peak_nits)
+        tonemap_build_luts(tm, src->color_trc, (int)peak_nits);
+    tonemap_set_params(tm, src, dst_format, (int)peak_nits);
+
+    tm->src = src;
+    for (int i = 0; i < 4; i++) {
+        tm->dst_data[i]     = dst_data[i];
+        tm->dst_linesize[i] = dst_linesize[i];
+    }
+
+    if (tm->nb_threads > 1) {
+        SDL_LockMutex(tm->mutex);
+        tm->pending = tm->nb_threads - 1;
+        tm->generation++;
+        SDL_CondBroadcast(tm->start_cond);
+        SDL_UnlockMutex(tm->mutex);
+
+        tonemap_slice(tm, 0, tm->nb_threads);
+
+        SDL_LockMutex(tm->mutex);
+        while (tm->pending > 0)
+            SDL_CondWait(tm->done_cond, tm->mutex);
+        SDL_UnlockMutex(tm->mutex);
+    } else {
+        tonemap_slice(tm, 0, 1);
+    }
+    tm->src = NULL;
+    return 0;
+}
@@ -0,0 +1,42 @@
+//
+//  ijksdl_tonemap.h
+//  IJKMediaPlayerKit
+//
+//  HDR10 and HLG to SDR BT.709 on the cpu, for outputs without the gpu shaders.
+//
+
+#ifndef ijksdl_tonemap_h
+#define ijksdl_tonemap_h
+
+#include <stdint.h>
+#include "ijksdl_inc_ffmpeg.h"
+
+typedef enum IJKToneMapOperator {
+    //ITU-R BT.2390 EETF, keeps everything below the knee untouched
+    IJK_TONEMAP_BT2390,
+    //filmic curve from Uncharted 2, darker but softer highlights
+    IJK_TONEMAP_HABLE,
+} IJKToneMapOperator;
+
+typedef struct IJKToneMap IJKToneMap;
+
+/* threads <= 0 picks from the cpu count, 1 converts on the calling thread only */
+IJKToneMap *ijk_tonemap_create(IJKToneMapOperator op, int threads);
+void ijk_tonemap_freep(IJKToneMap **tm);
+
+/* 1 when frame is PQ or HLG 10 bit 4:2:0, planar or P010 */
+int ijk_tonemap_is_hdr(const AVFrame *frame);
+
+/* 1 when ijk_tonemap_convert() can write dst_format */
+int ijk_tonemap_supports_format(enum AVPixelFormat dst_format);
+
+/*
+ * tone map src into dst_data of the same size, dst_format is AV_PIX_FMT_YUV420P, YUVJ420P or NV12.
+ * the output is BT.709 primaries, matrix and transfer, full range only for YUVJ420P.
+ * the peak comes from the content light level or mastering display side data, 1000 nits without.
+ * returns 0 on success, <0 when the formats are not supported.
+ */
+int ijk_tonemap_convert(IJKToneMap *tm, const AVFrame *src,
+                        enum AVPixelFormat dst_format, uint8_t **dst_data, const int *dst_linesize);
+
+#endif /* ijksdl_tonemap_h */
@@ -33,6 +33,7 @@
 #include "../ijksdl_video.h"
 #include "ijksdl_inc_ffmpeg.h"
 #include "ijksdl_image_convert.h"
+#include "ijksdl_tonemap.h"
 
 struct SDL_VoutOverlay_Opaque {
     SDL_mutex *mutex;
@@ -50,6 +51,9 @@ struct SDL_VoutOverlay_Opaque {
 
     struct SwsContext *img_convert_ctx;
     int sws_flags;
+
+    //overlays are per picture, so it converts on the calling thread only
+    IJKToneMap *tonemap;
 };
 
 /* Always assume a linesize alignment of 1 here */
@@ -117,6 +121,7 @@ static void func_free_l(SDL_VoutOverlay *overlay)
         return;
 
     sws_freeContext(opaque->img_convert_ctx);
+    ijk_tonemap_freep(&opaque->tonemap);
 
     if (opaque->managed_frame)
         av_frame_free(&opaque->managed_frame);
@@ -243,6 +248,10 @@ static int func_fill_frame(SDL_VoutOverlay *overlay, const AVFrame *frame)
      */
     if (use_linked_frame) {
         // do nothing
+    } else if (ijk_tonemap_is_hdr(frame) &&
+               (opaque->tonemap || (opaque->tonemap = ijk_tonemap_create(IJK_TONEMAP_BT2390, 1))) &&
+               !ijk_tonemap_convert(opaque->tonemap, frame, dst_format, swscale_dst_pic.data, swscale_dst_pic.linesize)) {
+        // HDR10 / HLG mapped to BT.709 SDR
     } else if (ijk_image_convert(frame->width, frame->height,
                                  dst_format, swscale_dst_pic.data, swscale_dst_pic.linesize,
                                  frame->format, (const uint8_t**) frame->data, frame->linesize)) {
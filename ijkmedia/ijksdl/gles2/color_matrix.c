@@ -19,14 +19,14 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
-#include "internal.h"
+#include <stddef.h>
 #include "color_matrix.h"
 
 //Full Range YUV to RGB reference
-const GLfloat *IJK_GLES2_getColorMatrix_bt2020(void)
+const float *IJK_GLES2_getColorMatrix_bt2020(void)
 {
     // BT.2020, which is the standard for HDR.
-    static const GLfloat g_bt2020[] = {
+    static const float g_bt2020[] = {
         1.164384, 1.164384 , 1.164384,
         0.0     , -0.187326, 2.14177,
         1.67867 , -0.65042 , 0.0
@@ -34,10 +34,10 @@ const GLfloat *IJK_GLES2_getColorMatrix_bt2020(void)
     return g_bt2020;
 }
 
-const GLfloat *IJK_GLES2_getColorMatrix_bt709(void)
+const float *IJK_GLES2_getColorMatrix_bt709(void)
 {
     // BT.709, which is the standard for HDTV.
-    static const GLfloat g_bt709[] = {
+    static const float g_bt709[] = {
         1.164,  1.164,  1.164,
         0.0,   -0.213,  2.112,
         1.793, -0.533,  0.0,
@@ -46,10 +46,10 @@ const GLfloat *IJK_GLES2_getColorMatrix_bt709(void)
 }
 
 //https://developer.apple.com/library/archive/samplecode/AVBasicVideoOutput/Listings/AVBasicVideoOutput_APLEAGLView_m.html
-const GLfloat *IJK_GLES2_getColorMatrix_bt601(void)
+const float *IJK_GLES2_getColorMatrix_bt601(void)
 {
     // BT.601, which is the standard for HDTV.
-    static const GLfloat g_bt601[] = {
+    static const float g_bt601[] = {
         1.164,  1.164, 1.164,
         0.0,   -0.392, 2.017,
         1.596, -0.813, 0.0,
@@ -57,7 +57,7 @@ const GLfloat *IJK_GLES2_getColorMatrix_bt601(void)
     return g_bt601;
 }
 
-const GLfloat *IJK_GLES2_getColorMatrix(YUV_2_RGB_Color_Matrix type)
+const float *IJK_GLES2_getColorMatrix(YUV_2_RGB_Color_Matrix type)
 {
     switch (type) {
         case YUV_2_RGB_Color_Matrix_None:
@@ -69,4 +69,5 @@ const GLfloat *IJK_GLES2_getColorMatrix(YUV_2_RGB_Color_Matrix type)
         case YUV_2_RGB_Color_Matrix_BT2020:
             return IJK_GLES2_getColorMatrix_bt2020();
     }
+    return NULL;
 }
@@ -23,22 +23,23 @@
 
 #ifndef _COLOR_MATRIX_HEADER_
 #define _COLOR_MATRIX_HEADER_
-typedef enum : int {
+typedef enum {
     YUV_2_RGB_Color_Matrix_None,
     YUV_2_RGB_Color_Matrix_BT601,
     YUV_2_RGB_Color_Matrix_BT709,
     YUV_2_RGB_Color_Matrix_BT2020
 } YUV_2_RGB_Color_Matrix;
 
-typedef enum : int {
+typedef enum {
     IJK_Color_Transfer_Function_LINEAR,
     IJK_Color_Transfer_Function_PQ,
     IJK_Color_Transfer_Function_HLG,
 } IJK_Color_Transfer_Function;
 
 //Full Range YUV to RGB reference
-const GLfloat *IJK_GLES2_getColorMatrix_bt2020(void);
-const GLfloat *IJK_GLES2_getColorMatrix_bt709(void);
-const GLfloat *IJK_GLES2_getColorMatrix_bt601(void);
-const GLfloat *IJK_GLES2_getColorMatrix(YUV_2_RGB_Color_Matrix type);
+//column major 3x3, plain float (GLfloat) so the software vout can share them without GL headers
+const float *IJK_GLES2_getColorMatrix_bt2020(void);
+const float *IJK_GLES2_getColorMatrix_bt709(void);
+const float *IJK_GLES2_getColorMatrix_bt601(void);
+const float *IJK_GLES2_getColorMatrix(YUV_2_RGB_Color_Matrix type);
 #endif
@@ -22,13 +22,23 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+// pthread_setname_np and gettid are gnu extensions on glibc
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <errno.h>
 #include <assert.h>
+#include <stdio.h>
 #include <unistd.h>
 #include "ijksdl_inc_internal.h"
 #include "ijksdl_thread.h"
 #ifdef __ANDROID__
 #include "ijksdl/android/ijksdl_android_jni.h"
+#elif defined(__linux__)
+// glibc only declares gettid from 2.30
+#include <sys/syscall.h>
+#define gettid() ((pid_t)syscall(SYS_gettid))
 #endif
 
 #if !defined(__APPLE__)
@@ -49,7 +59,8 @@ SDL_Thread *SDL_CreateThreadEx(SDL_Thread *thread, int (*fn)(void *), void *data
 {
     thread->func = fn;
     thread->data = data;
-    strlcpy(thread->name, name, sizeof(thread->name) - 1);
+    // glibc has no strlcpy before 2.38
+    snprintf(thread->name, sizeof(thread->name), "%s", name);
     int retval = pthread_create(&thread->id, NULL, SDL_RunThread, thread);
     if (retval)
         return NULL;
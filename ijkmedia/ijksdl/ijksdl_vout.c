@@ -30,10 +30,13 @@
 #include <android/native_window_jni.h>
 #endif
 #include "ijksdl_image_convert.h"
+#include "ffmpeg/ijksdl_tonemap.h"
 
 typedef struct _SDL_Image_Converter
 {
     struct SwsContext *sws_ctx;
+    //HDR to SDR when the gpu shaders can't, created on the first PQ or HLG frame
+    IJKToneMap *tonemap;
     AVFrame *frame;
     AVBufferRef *frame_buffer;
     int frame_buffer_size;
@@ -49,6 +52,7 @@ void SDL_VoutFree(SDL_Vout *vout)
         if (convert->sws_ctx) {
             sws_freeContext(convert->sws_ctx);
         }
+        ijk_tonemap_freep(&convert->tonemap);
         if (convert->frame) {
             av_frame_free(&convert->frame);
             av_buffer_unref(&convert->frame_buffer);
@@ -136,10 +140,23 @@ int SDL_VoutConvertFrame(SDL_Vout *vout, int dst_format, const AVFrame *inFrame,
         convert->frame_buffer_size = frame_bytes;
     }
     
+    int r = -1;
+    int tonemapped = 0;
+    //HDR10 and HLG look washed out when only the pixel format changes, map them to SDR first
+    if (ijk_tonemap_is_hdr(inFrame) && ijk_tonemap_supports_format(dst_format)) {
+        if (!convert->tonemap) {
+            convert->tonemap = ijk_tonemap_create(IJK_TONEMAP_BT2390, 0);
+        }
+        r = ijk_tonemap_convert(convert->tonemap, inFrame, dst_format, convert->frame->data, convert->frame->linesize);
+        tonemapped = r == 0;
+    }
+    
     //优先使用libyuv转换
-    int r = ijk_image_convert(inFrame->width, inFrame->height,
-                             dst_format, convert->frame->data, convert->frame->linesize,
-                             inFrame->format, (const uint8_t**) inFrame->data, inFrame->linesize);
+    if (r) {
+        r = ijk_image_convert(inFrame->width, inFrame->height,
+                              dst_format, convert->frame->data, convert->frame->linesize,
+                              inFrame->format, (const uint8_t**) inFrame->data, inFrame->linesize);
+    }
     
     //libyuv转换失败？
     if (r) {
@@ -160,6 +177,17 @@ int SDL_VoutConvertFrame(SDL_Vout *vout, int dst_format, const AVFrame *inFrame,
     if (r == 0 && outFrame) {
         convert->frame->width  = inFrame->width;
         convert->frame->height = inFrame->height;
+        if (tonemapped) {
+            convert->frame->color_primaries = AVCOL_PRI_BT709;
+            convert->frame->color_trc       = AVCOL_TRC_BT709;
+            convert->frame->colorspace      = AVCOL_SPC_BT709;
+            convert->frame->color_range     = dst_format == AV_PIX_FMT_YUVJ420P ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+        } else {
+            convert->frame->color_primaries = inFrame->color_primaries;
+            convert->frame->color_trc       = inFrame->color_trc;
+            convert->frame->colorspace      = inFrame->colorspace;
+            convert->frame->color_range     = inFrame->color_range;
+        }
         *outFrame = convert->frame;
     }
     
@@ -0,0 +1,201 @@
+//
+//  ijksdl_aout_soft.c
+//  IJKMediaPlayerKit
+//
+//  Audio output without a device, pulls the player at real-time pace.
+//
+
+#include "ijksdl_aout_soft.h"
+#include <stdbool.h>
+#include "../ijksdl_inc_internal.h"
+#include "../ijksdl_aout_internal.h"
+#include "../ijksdl_thread.h"
+#include "../ijksdl_log.h"
+#include "libavutil/time.h"
+
+static SDL_Class g_soft_aout_class = {
+    .name = "SoftAout",
+};
+
+typedef struct SDL_Aout_Opaque {
+    SDL_cond *wakeup_cond;
+    SDL_mutex *wakeup_mutex;
+
+    SDL_AudioSpec spec;
+    Uint8 *buffer;
+    int bytes_per_sec;
+
+    SDL_AoutSoft_PCMCallback callback;
+    void *callback_opaque;
+
+    volatile bool pause_on;
+    volatile bool abort_request;
+
+    SDL_Thread *audio_tid;
+    SDL_Thread _audio_tid;
+} SDL_Aout_Opaque;
+
+static int aout_thread(void *arg)
+{
+    SDL_Aout *aout = arg;
+    SDL_Aout_Opaque *opaque = aout->opaque;
+    SDL_AudioCallback audio_cblk = opaque->spec.callback;
+    void *userdata = opaque->spec.userdata;
+    // when the next buffer is due, restarted after a pause so it is not played back in a burst
+    int64_t due = 0;
+
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+
+    while (!opaque->abort_request) {
+        SDL_LockMutex(opaque->wakeup_mutex);
+        if (!opaque->abort_request && opaque->pause_on) {
+            while (!opaque->abort_request && opaque->pause_on)
+                SDL_CondWaitTimeout(opaque->wakeup_cond, opaque->wakeup_mutex, 1000);
+            due = 0;
+        }
+        SDL_UnlockMutex(opaque->wakeup_mutex);
+        if (opaque->abort_request)
+            break;
+
+        int64_t now = av_gettime_relative();
+        if (!due)
+            due = now;
+        else if (due > now)
+            av_usleep((unsigned)(due - now));
+
+        audio_cblk(userdata, opaque->buffer, opaque->spec.size);
+
+        SDL_LockMutex(opaque->wakeup_mutex);
+        if (opaque->callback)
+            opaque->callback(opaque->callback_opaque, opaque->buffer, opaque->spec.size, &opaque->spec);
+        SDL_UnlockMutex(opaque->wakeup_mutex);
+
+        due += (int64_t)opaque->spec.size * 1000000 / opaque->bytes_per_sec;
+    }
+
+    return 0;
+}
+
+static int aout_open_audio(SDL_Aout *aout, const SDL_AudioSpec *desired, SDL_AudioSpec *obtained)
+{
+    SDL_Aout_Opaque *opaque = aout->opaque;
+
+    // the player only asks for AUDIO_S16SYS, take whatever it wants
+    opaque->spec = *desired;
+    SDL_CalculateAudioSpec(&opaque->spec);
+    opaque->bytes_per_sec = opaque->spec.freq * opaque->spec.channels * SDL_AUDIO_BITSIZE(opaque->spec.format) / 8;
+    if (opaque->spec.size == 0 || opaque->bytes_per_sec <= 0) {
+        ALOGE("aout_open_audio: invalid spec %d Hz, %d channels\n", desired->freq, desired->channels);
+        return -1;
+    }
+
+    opaque->buffer = malloc(opaque->spec.size);
+    if (!opaque->buffer) {
+        ALOGE("aout_open_audio: failed to allocate buffer\n");
+        return -1;
+    }
+
+    if (obtained)
+        *obtained = opaque->spec;
+
+    opaque->pause_on = 1;
+    opaque->abort_request = 0;
+    opaque->audio_tid = SDL_CreateThreadEx(&opaque->_audio_tid, aout_thread, aout, "ff_aout_soft");
+    if (!opaque->audio_tid) {
+        ALOGE("aout_open_audio: failed to create audio thread\n");
+        free(opaque->buffer);
+        opaque->buffer = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void aout_pause_audio(SDL_Aout *aout, int pause_on)
+{
+    SDL_Aout_Opaque *opaque = aout->opaque;
+
+    SDL_LockMutex(opaque->wakeup_mutex);
+    opaque->pause_on = pause_on;
+    if (!pause_on)
+        SDL_CondSignal(opaque->wakeup_cond);
+    SDL_UnlockMutex(opaque->wakeup_mutex);
+}
+
+static void aout_flush_audio(SDL_Aout *aout)
+{
+    // nothing is queued past the buffer being pulled
+}
+
+static void aout_set_volume(SDL_Aout *aout, float left_volume, float right_volume)
+{
+    // samples are not played, the pcm callback can scale them itself
+}
+
+static void aout_close_audio(SDL_Aout *aout)
+{
+    SDL_Aout_Opaque *opaque = aout->opaque;
+
+    SDL_LockMutex(opaque->wakeup_mutex);
+    opaque->abort_request = true;
+    SDL_CondSignal(opaque->wakeup_cond);
+    SDL_UnlockMutex(opaque->wakeup_mutex);
+
+    SDL_WaitThread(opaque->audio_tid, NULL);
+
+    opaque->audio_tid = NULL;
+}
+
+static void aout_free_l(SDL_Aout *aout)
+{
+    if (!aout)
+        return;
+
+    aout_close_audio(aout);
+
+    SDL_Aout_Opaque *opaque = aout->opaque;
+    if (opaque) {
+        free(opaque->buffer);
+        opaque->buffer = NULL;
+
+        SDL_DestroyCond(opaque->wakeup_cond);
+        SDL_DestroyMutex(opaque->wakeup_mutex);
+    }
+
+    SDL_Aout_FreeInternal(aout);
+}
+
+SDL_Aout *SDL_AoutSoft_Create(void)
+{
+    SDL_Aout *aout = SDL_Aout_CreateInternal(sizeof(SDL_Aout_Opaque));
+    if (!aout)
+        return NULL;
+
+    SDL_Aout_Opaque *opaque = aout->opaque;
+    opaque->wakeup_cond  = SDL_CreateCond();
+    opaque->wakeup_mutex = SDL_CreateMutex();
+
+    aout->opaque_class = &g_soft_aout_class;
+    aout->free_l       = aout_free_l;
+    aout->open_audio   = aout_open_audio;
+    aout->pause_audio  = aout_pause_audio;
+    aout->flush_audio  = aout_flush_audio;
+    aout->set_volume   = aout_set_volume;
+    aout->close_audio  = aout_close_audio;
+
+    return aout;
+}
+
+void SDL_AoutSoft_SetPCMCallback(SDL_Aout *aout, SDL_AoutSoft_PCMCallback callback, void *opaque)
+{
+    if (!aout || !aout->opaque || aout->opaque_class != &g_soft_aout_class) {
+        ALOGE("%s: not a soft aout\n", __func__);
+        return;
+    }
+
+    SDL_Aout_Opaque *aout_opaque = aout->opaque;
+    SDL_LockMutex(aout_opaque->wakeup_mutex);
+    aout_opaque->callback        = callback;
+    aout_opaque->callback_opaque = opaque;
+    SDL_UnlockMutex(aout_opaque->wakeup_mutex);
+}
@@ -0,0 +1,25 @@
+//
+//  ijksdl_aout_soft.h
+//  IJKMediaPlayerKit
+//
+//  Audio output without a device, pulls the player at real-time pace.
+//
+
+#ifndef ijksdl_aout_soft_h
+#define ijksdl_aout_soft_h
+
+#include "../ijksdl_aout.h"
+
+/* pcm is only valid during the call, which runs on the audio thread */
+typedef void (*SDL_AoutSoft_PCMCallback)(void *opaque, const Uint8 *pcm, int size, const SDL_AudioSpec *spec);
+
+/*
+ * keeps the audio clock moving as a device would, so players without a sound card
+ * (headless, the soft vout) still sync video to audio. samples are dropped unless
+ * a pcm callback is set.
+ */
+SDL_Aout *SDL_AoutSoft_Create(void);
+
+void SDL_AoutSoft_SetPCMCallback(SDL_Aout *aout, SDL_AoutSoft_PCMCallback callback, void *opaque);
+
+#endif /* ijksdl_aout_soft_h */
@@ -0,0 +1,437 @@
+//
+//  ijksdl_vout_soft.c
+//  IJKMediaPlayerKit
+//
+//  Video output without a gpu, overlays become rgba in memory.
+//
+
+#include "ijksdl_vout_soft.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../ijksdl_vout_internal.h"
+#include "../ijksdl_log.h"
+#include "ijksdl_yuv2rgba.h"
+#include "libavutil/time.h"
+
+struct SDL_VoutOverlay_Opaque {
+    SDL_mutex *mutex;
+    Uint16 pitches[AV_NUM_DATA_POINTERS];
+    AVFrame *frame;
+};
+
+struct SDL_Vout_Opaque {
+    SDL_VoutSoft_PixelCallback callback;
+    void *callback_opaque;
+
+    char *shm_name;
+    SDL_VoutSoftFramebuffer *shm;
+    size_t shm_size;
+
+    // pictures that do not fit the shared framebuffer
+    Uint8 *pixels;
+    size_t pixels_size;
+
+    IJK_YUV2RGBA conv;
+    // what conv was built for, matrix is YUV_2_RGB_Color_Matrix_None until the first picture
+    YUV_2_RGB_Color_Matrix conv_matrix;
+    int conv_full_range;
+    int conv_dirty;
+    float brightness;
+    float saturation;
+    float contrast;
+    int use_simd;
+
+    int64_t render_us;
+    int64_t render_count;
+};
+
+static SDL_Class g_vout_overlay_soft_class = {
+    .name = "SoftVoutOverlay",
+};
+
+static SDL_Class g_vout_soft_class = {
+    .name = "SoftVout",
+};
+
+static void overlay_free_l(SDL_VoutOverlay *overlay)
+{
+    if (!overlay)
+        return;
+
+    SDL_VoutOverlay_Opaque *opaque = overlay->opaque;
+    if (opaque) {
+        av_frame_free(&opaque->frame);
+        if (opaque->mutex)
+            SDL_DestroyMutex(opaque->mutex);
+    }
+
+    SDL_VoutOverlay_FreeInternal(overlay);
+}
+
+static int overlay_lock(SDL_VoutOverlay *overlay)
+{
+    SDL_VoutOverlay_Opaque *opaque = overlay->opaque;
+    return SDL_LockMutex(opaque->mutex);
+}
+
+static int overlay_unlock(SDL_VoutOverlay *overlay)
+{
+    SDL_VoutOverlay_Opaque *opaque = overlay->opaque;
+    return SDL_UnlockMutex(opaque->mutex);
+}
+
+static void overlay_unref(SDL_VoutOverlay *overlay)
+{
+    SDL_VoutOverlay_Opaque *opaque = overlay->opaque;
+    av_frame_unref(opaque->frame);
+    overlay->pixels = NULL;
+    overlay->planes = 0;
+}
+
+static int overlay_fill_frame(SDL_VoutOverlay *overlay, const AVFrame *frame)
+{
+    SDL_VoutOverlay_Opaque *opaque = overlay->opaque;
+
+    if (frame->format != AV_PIX_FMT_YUV420P &&
+        frame->format != AV_PIX_FMT_YUVJ420P &&
+        frame->format != AV_PIX_FMT_NV12) {
+        const AVPixFmtDescriptor *pd = av_pix_fmt_desc_get(frame->format);
+        ALOGE("SoftVoutOverlay: unsupported pixel format:%s\n", pd ? pd->name : "none");
+        return -1;
+    }
+
+    // keep a reference instead of copying, the decoder's buffer is converted at display time
+    av_frame_unref(opaque->frame);
+    int ret = av_frame_ref(opaque->frame, frame);
+    if (ret < 0)
+        return ret;
+
+    overlay->planes = frame->format == AV_PIX_FMT_NV12 ? 2 : 3;
+    overlay->pixels = opaque->frame->data;
+    for (int i = 0; i < overlay->planes; i++)
+        opaque->pitches[i] = opaque->frame->linesize[i];
+    return 0;
+}
+
+static SDL_VoutOverlay *vout_create_overlay_l(int width, int height, int src_format, SDL_Vout *vout)
+{
+    SDL_VoutOverlay *overlay = SDL_VoutOverlay_CreateInternal(sizeof(SDL_VoutOverlay_Opaque));
+    if (!overlay) {
+        ALOGE("SoftVout: overlay allocation failed\n");
+        return NULL;
+    }
+
+    SDL_VoutOverlay_Opaque *opaque = overlay->opaque;
+    opaque->mutex = SDL_CreateMutex();
+    opaque->frame = av_frame_alloc();
+    if (!opaque->mutex || !opaque->frame) {
+        overlay_free_l(overlay);
+        return NULL;
+    }
+
+    switch (src_format) {
+        case AV_PIX_FMT_NV12:
+            overlay->format = SDL_FCC_NV12;
+            break;
+        case AV_PIX_FMT_YUVJ420P:
+            overlay->format = SDL_FCC_J420;
+            break;
+        default:
+            overlay->format = SDL_FCC_I420;
+            break;
+    }
+
+    overlay->opaque_class   = &g_vout_overlay_soft_class;
+    overlay->is_private     = 1;
+    overlay->pitches        = opaque->pitches;
+    overlay->w              = width;
+    overlay->h              = height;
+    overlay->free_l         = overlay_free_l;
+    overlay->lock           = overlay_lock;
+    overlay->unlock         = overlay_unlock;
+    overlay->unref          = overlay_unref;
+    overlay->func_fill_frame = overlay_fill_frame;
+    return overlay;
+}
+
+static SDL_VoutOverlay *vout_create_overlay(int width, int height, int src_format, SDL_Vout *vout)
+{
+    SDL_LockMutex(vout->mutex);
+    SDL_VoutOverlay *overlay = vout_create_overlay_l(width, height, src_format, vout);
+    SDL_UnlockMutex(vout->mutex);
+    return overlay;
+}
+
+static void unmap_framebuffer_l(SDL_Vout_Opaque *opaque)
+{
+    if (opaque->shm) {
+        munmap(opaque->shm, opaque->shm_size);
+        opaque->shm = NULL;
+        opaque->shm_size = 0;
+    }
+    if (opaque->shm_name) {
+        shm_unlink(opaque->shm_name);
+        av_freep(&opaque->shm_name);
+    }
+}
+
+static void vout_free_l(SDL_Vout *vout)
+{
+    if (!vout)
+        return;
+
+    SDL_Vout_Opaque *opaque = vout->opaque;
+    if (opaque) {
+        unmap_framebuffer_l(opaque);
+        av_freep(&opaque->pixels);
+    }
+
+    SDL_Vout_FreeInternal(vout);
+}
+
+static YUV_2_RGB_Color_Matrix color_matrix_of_frame(const AVFrame *frame)
+{
+    // same choice as the renderers, anything unknown is treated as BT.709
+    switch (frame->colorspace) {
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+            return YUV_2_RGB_Color_Matrix_BT601;
+        case AVCOL_SPC_BT2020_NCL:
+        case AVCOL_SPC_BT2020_CL:
+            return YUV_2_RGB_Color_Matrix_BT2020;
+        default:
+            return YUV_2_RGB_Color_Matrix_BT709;
+    }
+}
+
+static void convert_frame_l(SDL_Vout_Opaque *opaque, const AVFrame *frame, Uint8 *dst, int dst_stride)
+{
+    YUV_2_RGB_Color_Matrix matrix = color_matrix_of_frame(frame);
+    int full_range = frame->format == AV_PIX_FMT_YUVJ420P || frame->color_range == AVCOL_RANGE_JPEG;
+
+    if (opaque->conv_dirty || opaque->conv_matrix != matrix || opaque->conv_full_range != full_range) {
+        IJK_YUV2RGBA_init(&opaque->conv, matrix, full_range,
+                          opaque->brightness, opaque->saturation, opaque->contrast);
+        opaque->conv_matrix = matrix;
+        opaque->conv_full_range = full_range;
+        opaque->conv_dirty = 0;
+    }
+    opaque->conv.use_simd = opaque->use_simd;
+
+    int64_t begin = av_gettime_relative();
+    if (frame->format == AV_PIX_FMT_NV12) {
+        const uint8_t *const src[2] = { frame->data[0], frame->data[1] };
+        const int linesize[2] = { frame->linesize[0], frame->linesize[1] };
+        IJK_YUV2RGBA_convertNV12(&opaque->conv, src, linesize, dst, dst_stride, frame->width, frame->height);
+    } else {
+        const uint8_t *const src[3] = { frame->data[0], frame->data[1], frame->data[2] };
+        const int linesize[3] = { frame->linesize[0], frame->linesize[1], frame->linesize[2] };
+        IJK_YUV2RGBA_convertI420(&opaque->conv, src, linesize, dst, dst_stride, frame->width, frame->height);
+    }
+    opaque->render_us += av_gettime_relative() - begin;
+    opaque->render_count++;
+}
+
+static int vout_display_overlay_l(SDL_Vout *vout, SDL_VoutOverlay *overlay, SDL_TextureOverlay *sub_overlay)
+{
+    SDL_Vout_Opaque *opaque = vout->opaque;
+
+    // stop sends a NULL overlay to clear subtitles, there is nothing to draw them on here
+    if (!overlay)
+        return 0;
+
+    if (overlay->opaque_class != &g_vout_overlay_soft_class) {
+        ALOGE("SoftVout: foreign overlay %s\n", overlay->opaque_class ? overlay->opaque_class->name : "null");
+        return -4;
+    }
+
+    const AVFrame *frame = overlay->opaque->frame;
+    if (!frame->data[0] || frame->width <= 0 || frame->height <= 0) {
+        ALOGE("SoftVout: no video picture\n");
+        return -5;
+    }
+
+    const int width  = frame->width;
+    const int height = frame->height;
+    const int stride = FFALIGN(width * 4, 64);
+    const size_t size = (size_t)stride * height;
+
+    if (!opaque->callback && !opaque->shm)
+        return 0;
+
+    if (opaque->shm && size <= opaque->shm->capacity) {
+        SDL_VoutSoftFramebuffer *fb = opaque->shm;
+        Uint8 *pixels = (Uint8 *)(fb + 1);
+        Uint32 seq = fb->sequence;
+
+        __atomic_store_n(&fb->sequence, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        fb->width  = width;
+        fb->height = height;
+        fb->stride = stride;
+        convert_frame_l(opaque, frame, pixels, stride);
+        __atomic_store_n(&fb->sequence, seq + 2, __ATOMIC_RELEASE);
+
+        if (opaque->callback)
+            opaque->callback(opaque->callback_opaque, pixels, width, height, stride);
+        return 0;
+    }
+
+    if (!opaque->callback)
+        return 0;
+
+    if (opaque->pixels_size < size) {
+        av_freep(&opaque->pixels);
+        opaque->pixels_size = 0;
+        opaque->pixels = av_malloc(size);
+        if (!opaque->pixels)
+            return -6;
+        opaque->pixels_size = size;
+    }
+    convert_frame_l(opaque, frame, opaque->pixels, stride);
+    opaque->callback(opaque->callback_opaque, opaque->pixels, width, height, stride);
+    return 0;
+}
+
+static int vout_display_overlay(SDL_Vout *vout, SDL_VoutOverlay *overlay, SDL_TextureOverlay *sub_overlay)
+{
+    SDL_LockMutex(vout->mutex);
+    int retval = vout_display_overlay_l(vout, overlay, sub_overlay);
+    SDL_UnlockMutex(vout->mutex);
+    return retval;
+}
+
+SDL_Vout *SDL_VoutSoft_Create(void)
+{
+    SDL_Vout *vout = SDL_Vout_CreateInternal(sizeof(SDL_Vout_Opaque));
+    if (!vout)
+        return NULL;
+
+    SDL_Vout_Opaque *opaque = vout->opaque;
+    opaque->conv_matrix = YUV_2_RGB_Color_Matrix_None;
+    opaque->brightness  = 1.0f;
+    opaque->saturation  = 1.0f;
+    opaque->contrast    = 1.0f;
+    opaque->use_simd    = 1;
+
+    vout->opaque_class    = &g_vout_soft_class;
+    vout->overlay_format  = SDL_FCC__GLES2;
+    vout->create_overlay  = vout_create_overlay;
+    vout->free_l          = vout_free_l;
+    vout->display_overlay = vout_display_overlay;
+    return vout;
+}
+
+static int check_vout(SDL_Vout *vout, const char *func_name)
+{
+    if (!vout || !vout->opaque || vout->opaque_class != &g_vout_soft_class) {
+        ALOGE("%s: not a soft vout\n", func_name);
+        return 0;
+    }
+    return 1;
+}
+
+void SDL_VoutSoft_SetPixelCallback(SDL_Vout *vout, SDL_VoutSoft_PixelCallback callback, void *opaque)
+{
+    if (!check_vout(vout, __func__))
+        return;
+
+    SDL_LockMutex(vout->mutex);
+    vout->opaque->callback = callback;
+    vout->opaque->callback_opaque = opaque;
+    SDL_UnlockMutex(vout->mutex);
+}
+
+static int map_framebuffer_l(SDL_Vout_Opaque *opaque, const char *name, int max_width, int max_height)
+{
+    const size_t capacity = (size_t)FFALIGN(max_width * 4, 64) * max_height;
+    const size_t size = sizeof(SDL_VoutSoftFramebuffer) + capacity;
+
+    if (capacity > UINT32_MAX)
+        return -1;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        ALOGE("SoftVout: shm_open %s failed\n", name);
+        return -1;
+    }
+    if (ftruncate(fd, size) < 0) {
+        ALOGE("SoftVout: ftruncate %s to %zu failed\n", name, size);
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        ALOGE("SoftVout: mmap %s failed\n", name);
+        shm_unlink(name);
+        return -1;
+    }
+
+    SDL_VoutSoftFramebuffer *fb = addr;
+    fb->magic    = SDL_VOUT_SOFT_FB_MAGIC;
+    fb->version  = SDL_VOUT_SOFT_FB_VERSION;
+    fb->capacity = (Uint32)capacity;
+    fb->width    = 0;
+    fb->height   = 0;
+    fb->stride   = 0;
+    __atomic_store_n(&fb->sequence, 0, __ATOMIC_RELEASE);
+
+    opaque->shm      = fb;
+    opaque->shm_size = size;
+    opaque->shm_name = av_strdup(name);
+    return 0;
+}
+
+int SDL_VoutSoft_SetSharedFramebuffer(SDL_Vout *vout, const char *name, int max_width, int max_height)
+{
+    if (!check_vout(vout, __func__))
+        return -1;
+    if (name && (max_width <= 0 || max_height <= 0))
+        return -1;
+
+    SDL_LockMutex(vout->mutex);
+    unmap_framebuffer_l(vout->opaque);
+    int ret = name ? map_framebuffer_l(vout->opaque, name, max_width, max_height) : 0;
+    SDL_UnlockMutex(vout->mutex);
+    return ret;
+}
+
+void SDL_VoutSoft_UpdateColorConversion(SDL_Vout *vout, float brightness, float saturation, float contrast)
+{
+    if (!check_vout(vout, __func__))
+        return;
+
+    SDL_LockMutex(vout->mutex);
+    vout->opaque->brightness = brightness;
+    vout->opaque->saturation = saturation;
+    vout->opaque->contrast   = contrast;
+    vout->opaque->conv_dirty = 1;
+    SDL_UnlockMutex(vout->mutex);
+}
+
+void SDL_VoutSoft_SetUseSIMD(SDL_Vout *vout, int use_simd)
+{
+    if (!check_vout(vout, __func__))
+        return;
+
+    SDL_LockMutex(vout->mutex);
+    vout->opaque->use_simd = use_simd;
+    SDL_UnlockMutex(vout->mutex);
+}
+
+void SDL_VoutSoft_GetRenderCost(SDL_Vout *vout, int64_t *total_us, int64_t *count)
+{
+    if (!check_vout(vout, __func__))
+        return;
+
+    SDL_LockMutex(vout->mutex);
+    if (total_us)
+        *total_us = vout->opaque->render_us;
+    if (count)
+        *count = vout->opaque->render_count;
+    SDL_UnlockMutex(vout->mutex);
+}
@@ -0,0 +1,53 @@
+//
+//  ijksdl_vout_soft.h
+//  IJKMediaPlayerKit
+//
+//  Video output without a gpu, overlays become rgba in memory.
+//
+
+#ifndef ijksdl_vout_soft_h
+#define ijksdl_vout_soft_h
+
+#include "../ijksdl_stdinc.h"
+#include "../ijksdl_vout.h"
+
+#define SDL_VOUT_SOFT_FB_MAGIC      SDL_FOURCC('I', 'J', 'K', 'F')
+#define SDL_VOUT_SOFT_FB_VERSION    1
+
+/*
+ * head of the shared memory framebuffer, rgba pixels follow it.
+ * sequence is odd while a picture is written and even once it is complete, a reader
+ * copies the pixels and keeps the copy only if sequence was the same even value before
+ * and after.
+ */
+typedef struct SDL_VoutSoftFramebuffer {
+    Uint32 magic;
+    Uint32 version;
+    // bytes available for pixels
+    Uint32 capacity;
+    Uint32 sequence;
+    Uint32 width;
+    Uint32 height;
+    Uint32 stride;
+    Uint32 reserved;
+} SDL_VoutSoftFramebuffer;
+
+/* rgba is only valid during the call, which runs on the video refresh thread */
+typedef void (*SDL_VoutSoft_PixelCallback)(void *opaque, const Uint8 *rgba, int width, int height, int stride);
+
+SDL_Vout *SDL_VoutSoft_Create(void);
+
+void SDL_VoutSoft_SetPixelCallback(SDL_Vout *vout, SDL_VoutSoft_PixelCallback callback, void *opaque);
+/*
+ * publish pictures to the POSIX shared memory object name, sized for max_width x max_height,
+ * larger pictures only reach the pixel callback. NULL name unmaps and unlinks it.
+ */
+int  SDL_VoutSoft_SetSharedFramebuffer(SDL_Vout *vout, const char *name, int max_width, int max_height);
+/* same meaning as IJK_GLES2_Renderer_updateColorConversion, 1.0 each by default */
+void SDL_VoutSoft_UpdateColorConversion(SDL_Vout *vout, float brightness, float saturation, float contrast);
+/* 0 makes the conversion use the c kernel only, for checking the simd kernels against it */
+void SDL_VoutSoft_SetUseSIMD(SDL_Vout *vout, int use_simd);
+/* total microseconds spent converting pictures and their count, a render cost without a gpu */
+void SDL_VoutSoft_GetRenderCost(SDL_Vout *vout, int64_t *total_us, int64_t *count);
+
+#endif /* ijksdl_vout_soft_h */
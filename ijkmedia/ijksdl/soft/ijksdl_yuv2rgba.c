@@ -0,0 +1,299 @@
+//
+//  ijksdl_yuv2rgba.c
+//  IJKMediaPlayerKit
+//
+//  YUV to RGBA on the cpu with the renderers' color matrices and adjustment.
+//
+
+#include "ijksdl_yuv2rgba.h"
+#include <math.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define YUV2RGBA_MAX_SHIFT 13
+
+static uint8_t clip_uint8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+void IJK_YUV2RGBA_init(IJK_YUV2RGBA *c, YUV_2_RGB_Color_Matrix matrix, int full_range,
+                       float brightness, float saturation, float contrast)
+{
+    static const double luma[3] = { 0.299, 0.587, 0.114 };
+    const float *m = IJK_GLES2_getColorMatrix(matrix);
+    double a[3][3], t[3], b, max = 0;
+
+    if (!m)
+        m = IJK_GLES2_getColorMatrix_bt709();
+
+    /*
+     * same steps as the fragment shaders on normalized yuv:
+     * yuv += offset; rgb = um3_ColorConversion * yuv; rgb = rgb_adjust(rgb, um3_rgbAdjustment)
+     * rgb_adjust keeps the shaders' own ordering, contrast, brightness, then saturation.
+     */
+    t[0] = full_range ? 0.0 : -16.0 / 255.0;
+    // the shaders take 0.5 off, which is 127.5 in 8 bit, chroma is centered on 128
+    t[1] = -128.0 / 255.0;
+    t[2] = -128.0 / 255.0;
+    b = 0.5 - 0.5 * contrast + (0.75 * brightness - 0.5) / 2.5 - 0.1;
+
+    for (int k = 0; k < 3; k++) {
+        double cm[3], intensity = 0;
+        // the matrices expand video range, 219 luma and 224 chroma steps, to 0~1.
+        // full range pictures use all 255 steps, scale them back instead of clipping.
+        const double range = full_range ? (k == 0 ? 219.0 : 224.0) / 255.0 : 1.0;
+        // um3_ColorConversion is column major, column k multiplies component k
+        for (int i = 0; i < 3; i++) {
+            cm[i] = m[k * 3 + i] * range * contrast;
+            intensity += luma[i] * cm[i];
+        }
+        // saturation mixes every channel with the weighted intensity of all three
+        for (int i = 0; i < 3; i++)
+            a[i][k] = saturation * cm[i] + (1.0 - saturation) * intensity;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        for (int k = 0; k < 3; k++) {
+            if (fabs(a[i][k]) > max)
+                max = fabs(a[i][k]);
+        }
+    }
+    c->shift = YUV2RGBA_MAX_SHIFT;
+    while (c->shift > 0 && max * (1 << c->shift) > INT16_MAX)
+        c->shift--;
+
+    for (int i = 0; i < 3; i++) {
+        // the constant term in 8 bit units, the intensity of b * (1,1,1) is b again
+        double offset = b;
+        for (int k = 0; k < 3; k++) {
+            c->coef[i][k] = (int16_t)lrint(a[i][k] * (1 << c->shift));
+            offset += a[i][k] * t[k];
+        }
+        c->offset[i] = (int32_t)lrint(offset * 255.0 * (1 << c->shift));
+        if (c->shift > 0)
+            c->offset[i] += 1 << (c->shift - 1);
+    }
+    c->use_simd = 1;
+}
+
+static void row_c(const IJK_YUV2RGBA *c, const uint8_t *y, const uint8_t *u, const uint8_t *v, int uv_step,
+                  uint8_t *dst, int x, int width)
+{
+    for (; x < width; x++) {
+        int Y = y[x];
+        int U = u[(x >> 1) * uv_step];
+        int V = v[(x >> 1) * uv_step];
+        uint8_t *p = dst + 4 * x;
+
+        for (int i = 0; i < 3; i++)
+            p[i] = clip_uint8((c->coef[i][0] * Y + c->coef[i][1] * U + c->coef[i][2] * V + c->offset[i]) >> c->shift);
+        p[3] = 0xff;
+    }
+}
+
+#if defined(__SSE2__)
+typedef struct YUV2RGBA_SSE2 {
+    // (y, u) and (v, 0) coefficient pairs for _mm_madd_epi16
+    __m128i yu[3];
+    __m128i v[3];
+    __m128i offset[3];
+    __m128i shift;
+} YUV2RGBA_SSE2;
+
+static void sse2_setup(const IJK_YUV2RGBA *c, YUV2RGBA_SSE2 *s)
+{
+    for (int i = 0; i < 3; i++) {
+        s->yu[i]     = _mm_set1_epi32((int)((uint16_t)c->coef[i][0] | ((uint32_t)(uint16_t)c->coef[i][1] << 16)));
+        s->v[i]      = _mm_set1_epi32((uint16_t)c->coef[i][2]);
+        s->offset[i] = _mm_set1_epi32(c->offset[i]);
+    }
+    s->shift = _mm_cvtsi32_si128(c->shift);
+}
+
+// 8 pixels of one channel, saturated to 0~255 in the low 8 bytes
+static __m128i sse2_channel(const YUV2RGBA_SSE2 *s, int i, __m128i y, __m128i u, __m128i v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, u), s->yu[i]),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(v, zero), s->v[i]));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, u), s->yu[i]),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(v, zero), s->v[i]));
+
+    lo = _mm_sra_epi32(_mm_add_epi32(lo, s->offset[i]), s->shift);
+    hi = _mm_sra_epi32(_mm_add_epi32(hi, s->offset[i]), s->shift);
+    return _mm_packus_epi16(_mm_packs_epi32(lo, hi), zero);
+}
+
+// y, u and v hold 8 16 bit samples each, chroma already doubled
+static void sse2_store(const YUV2RGBA_SSE2 *s, __m128i y, __m128i u, __m128i v, uint8_t *dst)
+{
+    __m128i r  = sse2_channel(s, 0, y, u, v);
+    __m128i g  = sse2_channel(s, 1, y, u, v);
+    __m128i b  = sse2_channel(s, 2, y, u, v);
+    __m128i rg = _mm_unpacklo_epi8(r, g);
+    __m128i ba = _mm_unpacklo_epi8(b, _mm_set1_epi8((char)0xff));
+
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+static __m128i sse2_load32(const uint8_t *p)
+{
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return _mm_cvtsi32_si128(v);
+}
+
+static int row_i420_simd(const IJK_YUV2RGBA *c, const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    YUV2RGBA_SSE2 s;
+    int x = 0;
+
+    sse2_setup(c, &s);
+    for (; x + 8 <= width; x += 8) {
+        __m128i y16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y + x)), zero);
+        __m128i u16 = _mm_unpacklo_epi8(sse2_load32(u + x / 2), zero);
+        __m128i v16 = _mm_unpacklo_epi8(sse2_load32(v + x / 2), zero);
+
+        sse2_store(&s, y16, _mm_unpacklo_epi16(u16, u16), _mm_unpacklo_epi16(v16, v16), dst + 4 * x);
+    }
+    return x;
+}
+
+static int row_nv12_simd(const IJK_YUV2RGBA *c, const uint8_t *y, const uint8_t *uv, uint8_t *dst, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i low  = _mm_set1_epi32(0xffff);
+    YUV2RGBA_SSE2 s;
+    int x = 0;
+
+    sse2_setup(c, &s);
+    for (; x + 8 <= width; x += 8) {
+        __m128i y16  = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y + x)), zero);
+        __m128i uv16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(uv + x)), zero);
+        __m128i u16  = _mm_and_si128(uv16, low);
+        __m128i v16  = _mm_srli_epi32(uv16, 16);
+
+        sse2_store(&s, y16, _mm_or_si128(u16, _mm_slli_epi32(u16, 16)), _mm_or_si128(v16, _mm_slli_epi32(v16, 16)), dst + 4 * x);
+    }
+    return x;
+}
+
+const char *IJK_YUV2RGBA_simdName(void)
+{
+    return "sse2";
+}
+#elif defined(__ARM_NEON)
+// 8 pixels of one channel, the same saturation steps as sse2: to int16 first, then to uint8
+static uint8x8_t neon_channel(const IJK_YUV2RGBA *c, int i, int16x8_t y, int16x8_t u, int16x8_t v, int32x4_t shift)
+{
+    int32x4_t offset = vdupq_n_s32(c->offset[i]);
+    int32x4_t lo = vmlal_n_s16(vmlal_n_s16(vmlal_n_s16(offset, vget_low_s16(y), c->coef[i][0]),
+                                           vget_low_s16(u), c->coef[i][1]),
+                               vget_low_s16(v), c->coef[i][2]);
+    int32x4_t hi = vmlal_n_s16(vmlal_n_s16(vmlal_n_s16(offset, vget_high_s16(y), c->coef[i][0]),
+                                           vget_high_s16(u), c->coef[i][1]),
+                               vget_high_s16(v), c->coef[i][2]);
+
+    lo = vshlq_s32(lo, shift);
+    hi = vshlq_s32(hi, shift);
+    return vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+}
+
+static void neon_store(const IJK_YUV2RGBA *c, uint8x8_t y, uint8x8_t u, uint8x8_t v, uint8_t *dst)
+{
+    int32x4_t shift = vdupq_n_s32(-c->shift);
+    int16x8_t y16 = vreinterpretq_s16_u16(vmovl_u8(y));
+    int16x8_t u16 = vreinterpretq_s16_u16(vmovl_u8(u));
+    int16x8_t v16 = vreinterpretq_s16_u16(vmovl_u8(v));
+    uint8x8x4_t rgba;
+
+    rgba.val[0] = neon_channel(c, 0, y16, u16, v16, shift);
+    rgba.val[1] = neon_channel(c, 1, y16, u16, v16, shift);
+    rgba.val[2] = neon_channel(c, 2, y16, u16, v16, shift);
+    rgba.val[3] = vdup_n_u8(0xff);
+    vst4_u8(dst, rgba);
+}
+
+static int row_i420_simd(const IJK_YUV2RGBA *c, const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        uint8x8x2_t u2 = vzip_u8(vld1_u8(u + x / 2), vld1_u8(u + x / 2));
+        uint8x8x2_t v2 = vzip_u8(vld1_u8(v + x / 2), vld1_u8(v + x / 2));
+
+        neon_store(c, vld1_u8(y + x), u2.val[0], v2.val[0], dst + 4 * x);
+        neon_store(c, vld1_u8(y + x + 8), u2.val[1], v2.val[1], dst + 4 * x + 32);
+    }
+    return x;
+}
+
+static int row_nv12_simd(const IJK_YUV2RGBA *c, const uint8_t *y, const uint8_t *uv, uint8_t *dst, int width)
+{
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        uint8x8x2_t uv2 = vld2_u8(uv + x);
+        uint8x8x2_t u2  = vzip_u8(uv2.val[0], uv2.val[0]);
+        uint8x8x2_t v2  = vzip_u8(uv2.val[1], uv2.val[1]);
+
+        neon_store(c, vld1_u8(y + x), u2.val[0], v2.val[0], dst + 4 * x);
+        neon_store(c, vld1_u8(y + x + 8), u2.val[1], v2.val[1], dst + 4 * x + 32);
+    }
+    return x;
+}
+
+const char *IJK_YUV2RGBA_simdName(void)
+{
+    return "neon";
+}
+#else
+static int row_i420_simd(const IJK_YUV2RGBA *c, const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    return 0;
+}
+
+static int row_nv12_simd(const IJK_YUV2RGBA *c, const uint8_t *y, const uint8_t *uv, uint8_t *dst, int width)
+{
+    return 0;
+}
+
+const char *IJK_YUV2RGBA_simdName(void)
+{
+    return "c";
+}
+#endif
+
+void IJK_YUV2RGBA_convertI420(const IJK_YUV2RGBA *c, const uint8_t *const src[3], const int src_linesize[3],
+                              uint8_t *dst, int dst_stride, int width, int height)
+{
+    for (int j = 0; j < height; j++) {
+        const uint8_t *y = src[0] + j * src_linesize[0];
+        const uint8_t *u = src[1] + (j >> 1) * src_linesize[1];
+        const uint8_t *v = src[2] + (j >> 1) * src_linesize[2];
+        uint8_t *row = dst + j * dst_stride;
+        int x = c->use_simd ? row_i420_simd(c, y, u, v, row, width) : 0;
+
+        row_c(c, y, u, v, 1, row, x, width);
+    }
+}
+
+void IJK_YUV2RGBA_convertNV12(const IJK_YUV2RGBA *c, const uint8_t *const src[2], const int src_linesize[2],
+                              uint8_t *dst, int dst_stride, int width, int height)
+{
+    for (int j = 0; j < height; j++) {
+        const uint8_t *y  = src[0] + j * src_linesize[0];
+        const uint8_t *uv = src[1] + (j >> 1) * src_linesize[1];
+        uint8_t *row = dst + j * dst_stride;
+        int x = c->use_simd ? row_nv12_simd(c, y, uv, row, width) : 0;
+
+        row_c(c, y, uv, uv + 1, 2, row, x, width);
+    }
+}
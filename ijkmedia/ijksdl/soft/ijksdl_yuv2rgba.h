@@ -0,0 +1,49 @@
+//
+//  ijksdl_yuv2rgba.h
+//  IJKMediaPlayerKit
+//
+//  YUV to RGBA on the cpu with the renderers' color matrices and adjustment.
+//
+
+#ifndef ijksdl_yuv2rgba_h
+#define ijksdl_yuv2rgba_h
+
+#include <stdint.h>
+#include "../gles2/color_matrix.h"
+
+/*
+ * the shaders apply the color matrix and then rgb_adjust, both are affine, so the whole
+ * conversion folds into one fixed point 3x3 matrix plus offset per picture.
+ * the sse2 and neon kernels compute exactly what the c kernel does, so their output is
+ * pixel exact with each other on every platform.
+ */
+typedef struct IJK_YUV2RGBA {
+    // R, G and B rows of Y, U and V coefficients
+    int16_t coef[3][3];
+    // includes the rounding half
+    int32_t offset[3];
+    int     shift;
+    // 0 forces the c kernel
+    int     use_simd;
+} IJK_YUV2RGBA;
+
+/*
+ * matrix as the renderers pick it, YUV_2_RGB_Color_Matrix_None falls back to BT.709.
+ * unlike the shaders, chroma is centered on 128 and full_range rescales the video range matrix
+ * so 0 and 255 map to black and white.
+ * brightness, saturation and contrast mean what they mean to
+ * IJK_GLES2_Renderer_updateColorConversion, all 1.0 leave the picture untouched.
+ */
+void IJK_YUV2RGBA_init(IJK_YUV2RGBA *c, YUV_2_RGB_Color_Matrix matrix, int full_range,
+                       float brightness, float saturation, float contrast);
+
+/* 4:2:0 sources to rgba rows of dst_stride bytes, alpha is opaque */
+void IJK_YUV2RGBA_convertI420(const IJK_YUV2RGBA *c, const uint8_t *const src[3], const int src_linesize[3],
+                              uint8_t *dst, int dst_stride, int width, int height);
+void IJK_YUV2RGBA_convertNV12(const IJK_YUV2RGBA *c, const uint8_t *const src[2], const int src_linesize[2],
+                              uint8_t *dst, int dst_stride, int width, int height);
+
+/* "sse2", "neon" or "c" */
+const char *IJK_YUV2RGBA_simdName(void);
+
+#endif /* ijksdl_yuv2rgba_h */
@@ -0,0 +1,238 @@
+//
+//  yuv2rgba_test.c
+//  IJKMediaPlayerKit
+//
+//  Pixel exact regression test of the soft vout conversion.
+//
+
+#include "ijksdl/soft/ijksdl_yuv2rgba.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// chroma values swept per picture, 0, 4, ... 252 and 255, so 128 is one of them
+#define CHROMA_STEP 4
+#define CHROMA_COUNT (255 / CHROMA_STEP + 2)
+
+// every luma value along a row, a chroma pair per 2x2 block
+#define WIDTH  256
+#define HEIGHT (2 * CHROMA_COUNT * CHROMA_COUNT)
+
+typedef struct TestCase {
+    const char *name;
+    YUV_2_RGB_Color_Matrix matrix;
+    int full_range;
+    double kr, kb;
+    // fnv-1a of the whole rgba picture, update only for an intended change of the output
+    uint64_t golden;
+} TestCase;
+
+static const TestCase g_cases[] = {
+    { "bt601 limited", YUV_2_RGB_Color_Matrix_BT601, 0, 0.299,  0.114,  0xa3adfac30fd7d161ULL },
+    { "bt601 full",    YUV_2_RGB_Color_Matrix_BT601, 1, 0.299,  0.114,  0x4e66022177094355ULL },
+    { "bt709 limited", YUV_2_RGB_Color_Matrix_BT709, 0, 0.2126, 0.0722, 0xbd36eb7b6e0dc181ULL },
+    { "bt709 full",    YUV_2_RGB_Color_Matrix_BT709, 1, 0.2126, 0.0722, 0x8a51db41e4948919ULL },
+};
+
+static uint64_t fnv1a(const uint8_t *p, size_t size)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int chroma_value(int i)
+{
+    return i * CHROMA_STEP > 255 ? 255 : i * CHROMA_STEP;
+}
+
+static double clip01(double v)
+{
+    return v < 0 ? 0 : (v > 1 ? 1 : v);
+}
+
+// straight from the BT.601 and BT.709 equations, nothing shared with the code under test
+static void reference(const TestCase *t, int Y, int U, int V, double rgb[3])
+{
+    double y, pb, pr;
+
+    if (t->full_range) {
+        y  = Y / 255.0;
+        pb = (U - 128) / 255.0;
+        pr = (V - 128) / 255.0;
+    } else {
+        y  = (Y - 16) / 219.0;
+        pb = (U - 128) / 224.0;
+        pr = (V - 128) / 224.0;
+    }
+
+    double r = y + 2 * (1 - t->kr) * pr;
+    double b = y + 2 * (1 - t->kb) * pb;
+    double g = (y - t->kr * r - t->kb * b) / (1 - t->kr - t->kb);
+
+    rgb[0] = clip01(r) * 255;
+    rgb[1] = clip01(g) * 255;
+    rgb[2] = clip01(b) * 255;
+}
+
+static void fill_picture(uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *uv)
+{
+    for (int row = 0; row < HEIGHT; row++) {
+        for (int x = 0; x < WIDTH; x++)
+            y[row * WIDTH + x] = x;
+    }
+    for (int row = 0; row < HEIGHT / 2; row++) {
+        int U = chroma_value(row / CHROMA_COUNT);
+        int V = chroma_value(row % CHROMA_COUNT);
+        for (int x = 0; x < WIDTH / 2; x++) {
+            u[row * WIDTH / 2 + x] = uv[row * WIDTH + 2 * x]     = U;
+            v[row * WIDTH / 2 + x] = uv[row * WIDTH + 2 * x + 1] = V;
+        }
+    }
+}
+
+static int check_pixel(const TestCase *t, const uint8_t *rgba, int Y, int U, int V, double tolerance)
+{
+    double ref[3];
+
+    reference(t, Y, U, V, ref);
+    for (int i = 0; i < 3; i++) {
+        if (fabs(rgba[i] - ref[i]) > tolerance) {
+            printf("%s: yuv %d %d %d gives %d %d %d, expected %.2f %.2f %.2f\n", t->name, Y, U, V,
+                   rgba[0], rgba[1], rgba[2], ref[0], ref[1], ref[2]);
+            return 1;
+        }
+    }
+    if (rgba[3] != 0xff) {
+        printf("%s: yuv %d %d %d alpha %d\n", t->name, Y, U, V, rgba[3]);
+        return 1;
+    }
+    return 0;
+}
+
+static int run_case(const TestCase *t, const uint8_t *const i420[3], const uint8_t *const nv12[2],
+                    uint8_t *out, uint8_t *c_out)
+{
+    const int i420_linesize[3] = { WIDTH, WIDTH / 2, WIDTH / 2 };
+    const int nv12_linesize[2] = { WIDTH, WIDTH };
+    const size_t size = (size_t)WIDTH * HEIGHT * 4;
+    IJK_YUV2RGBA c;
+    int failed = 0;
+
+    IJK_YUV2RGBA_init(&c, t->matrix, t->full_range, 1.0f, 1.0f, 1.0f);
+
+    c.use_simd = 0;
+    IJK_YUV2RGBA_convertI420(&c, i420, i420_linesize, c_out, WIDTH * 4, WIDTH, HEIGHT);
+
+    uint64_t hash = fnv1a(c_out, size);
+    if (hash != t->golden) {
+        printf("%s: output hash 0x%016llx, golden 0x%016llx\n", t->name,
+               (unsigned long long)hash, (unsigned long long)t->golden);
+        failed = 1;
+    }
+
+    c.use_simd = 1;
+    IJK_YUV2RGBA_convertI420(&c, i420, i420_linesize, out, WIDTH * 4, WIDTH, HEIGHT);
+    if (memcmp(out, c_out, size)) {
+        printf("%s: i420 %s differs from c\n", t->name, IJK_YUV2RGBA_simdName());
+        failed = 1;
+    }
+    IJK_YUV2RGBA_convertNV12(&c, nv12, nv12_linesize, out, WIDTH * 4, WIDTH, HEIGHT);
+    if (memcmp(out, c_out, size)) {
+        printf("%s: nv12 %s differs from i420 c\n", t->name, IJK_YUV2RGBA_simdName());
+        failed = 1;
+    }
+
+    // the matrices carry three decimals and the kernels round once, one step either way
+    for (int row = 0; row < HEIGHT && !failed; row += 2) {
+        int U = chroma_value(row / 2 / CHROMA_COUNT);
+        int V = chroma_value(row / 2 % CHROMA_COUNT);
+        for (int Y = 0; Y < WIDTH && !failed; Y++)
+            failed = check_pixel(t, c_out + ((size_t)row * WIDTH + Y) * 4, Y, U, V, 1.0);
+    }
+
+    // black and white land exactly on the ends of the range
+    const int black = t->full_range ? 0 : 16;
+    const int white = t->full_range ? 255 : 235;
+    const uint8_t *gray_row = c_out + (size_t)2 * (128 / CHROMA_STEP * CHROMA_COUNT + 128 / CHROMA_STEP) * WIDTH * 4;
+    if (!failed) {
+        failed = check_pixel(t, gray_row + black * 4, black, 128, 128, 0.0) ||
+                 check_pixel(t, gray_row + white * 4, white, 128, 128, 0.0);
+    }
+
+    printf("%s: %s\n", t->name, failed ? "FAIL" : "ok");
+    return failed;
+}
+
+// odd sizes reach the tails the simd kernels leave to c
+static int run_odd_sizes(void)
+{
+    enum { W = 37, H = 9, CW = (W + 1) / 2, CH = (H + 1) / 2 };
+    uint8_t y[W * H], u[CW * CH], v[CW * CH], uv[CW * CH * 2];
+    uint8_t out[W * H * 4], c_out[W * H * 4];
+    const uint8_t *i420[3] = { y, u, v };
+    const uint8_t *nv12[2] = { y, uv };
+    const int i420_linesize[3] = { W, CW, CW };
+    const int nv12_linesize[2] = { W, CW * 2 };
+    uint32_t seed = 1;
+    int failed = 0;
+
+    for (int i = 0; i < W * H; i++)
+        y[i] = (seed = seed * 1664525 + 1013904223) >> 24;
+    for (int i = 0; i < CW * CH; i++) {
+        u[i] = uv[2 * i]     = (seed = seed * 1664525 + 1013904223) >> 24;
+        v[i] = uv[2 * i + 1] = (seed = seed * 1664525 + 1013904223) >> 24;
+    }
+
+    for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); i++) {
+        IJK_YUV2RGBA c;
+        IJK_YUV2RGBA_init(&c, g_cases[i].matrix, g_cases[i].full_range, 1.0f, 1.0f, 1.0f);
+        c.use_simd = 0;
+        IJK_YUV2RGBA_convertI420(&c, i420, i420_linesize, c_out, W * 4, W, H);
+        c.use_simd = 1;
+        IJK_YUV2RGBA_convertI420(&c, i420, i420_linesize, out, W * 4, W, H);
+        failed |= memcmp(out, c_out, sizeof(out)) != 0;
+        IJK_YUV2RGBA_convertNV12(&c, nv12, nv12_linesize, out, W * 4, W, H);
+        failed |= memcmp(out, c_out, sizeof(out)) != 0;
+    }
+
+    printf("%dx%d %s against c: %s\n", W, H, IJK_YUV2RGBA_simdName(), failed ? "FAIL" : "ok");
+    return failed;
+}
+
+int main(void)
+{
+    const size_t luma = (size_t)WIDTH * HEIGHT;
+    uint8_t *y  = malloc(luma);
+    uint8_t *u  = malloc(luma / 4);
+    uint8_t *v  = malloc(luma / 4);
+    uint8_t *uv = malloc(luma / 2);
+    uint8_t *out   = malloc(luma * 4);
+    uint8_t *c_out = malloc(luma * 4);
+    const uint8_t *i420[3] = { y, u, v };
+    const uint8_t *nv12[2] = { y, uv };
+    int failed = 0;
+
+    if (!y || !u || !v || !uv || !out || !c_out) {
+        printf("out of memory\n");
+        return 1;
+    }
+
+    fill_picture(y, u, v, uv);
+    for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); i++)
+        failed |= run_case(&g_cases[i], i420, nv12, out, c_out);
+    failed |= run_odd_sizes();
+
+    free(y);
+    free(u);
+    free(v);
+    free(uv);
+    free(out);
+    free(c_out);
+    return failed;
+}
@@ -0,0 +1,894 @@
+//
+//  mr_audio_overview.c
+//
+// ijkplayer not use the file, but the file will be used by other module in app.
+//
+//  Waveform peaks and EBU R128 loudness of a whole audio stream, kept in a sidecar file.
+//
+
+#include "mr_audio_overview.h"
+#include "ijksdl/ijksdl_thread.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/avstring.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/cpu.h>
+#include <libavutil/time.h>
+#include <libswresample/swresample.h>
+
+#define MR_OVERVIEW_DEFAULT_SAMPLES 256
+#define MR_OVERVIEW_MAX_THREADS     8
+//seconds, shorter segments are not worth a demuxer of their own
+#define MR_OVERVIEW_MIN_SEGMENT     30
+#define MR_OVERVIEW_MAGIC           MKTAG('M', 'R', 'A', 'O')
+#define MR_OVERVIEW_VERSION         1
+//BS.1770 gating blocks are 400ms long and start every 100ms
+#define MR_LOUDNESS_STEPS_PER_SEC   10
+#define MR_LOUDNESS_BLOCK_STEPS     4
+#define MR_LOUDNESS_ABSOLUTE_GATE   -70.0
+#define MR_LOUDNESS_RELATIVE_GATE   -10.0
+
+//sidecar layout: header, nb_levels level entries, then the peaks of every level
+typedef struct MRAudioOverviewHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sample_rate;
+    uint32_t channels;
+    int64_t  nb_samples;
+    uint32_t samples_per_peak;
+    uint32_t nb_levels;
+    double   loudness;
+    double   sample_peak;
+    uint8_t  reserved[16];
+} MRAudioOverviewHeader;
+
+typedef struct MRAudioOverviewLevel {
+    //bytes from the start of the file
+    uint64_t offset;
+    uint64_t count;
+} MRAudioOverviewLevel;
+
+struct MRAudioOverview {
+    void *map;
+    size_t size;
+    const MRAudioOverviewHeader *header;
+    const MRAudioOverviewLevel *levels;
+};
+
+//a level 0 peak while samples are still added to it
+typedef struct MRPeakAcc {
+    float min;
+    float max;
+    float sum_sq;
+    int n;
+} MRPeakAcc;
+
+typedef struct MRLoudnessStep {
+    //sum over the 100ms of the channel weighted squares of the K-weighted samples
+    double energy;
+    int n;
+} MRLoudnessStep;
+
+typedef struct MRBiquad {
+    double b0, b1, b2;
+    double a1, a2;
+} MRBiquad;
+
+typedef struct MROverviewContext {
+    const char *url;
+    int stream_index;
+    int nb_streams;
+    AVCodecParameters *par;
+    AVRational time_base;
+    int64_t start_time;
+    int64_t duration;
+
+    //decoded audio is converted to planar float in this format before it is measured
+    int sample_rate;
+    AVChannelLayout ch_layout;
+    int samples_per_peak;
+    int step_samples;
+    //K-weighting is a high shelf followed by a high pass
+    MRBiquad kweight[2];
+    double *weights;
+} MROverviewContext;
+
+typedef struct MROverviewWorker {
+    MROverviewContext *ctx;
+    //samples [first, last) belong to this worker, the last one runs to the end of the stream
+    int64_t first;
+    int64_t last;
+
+    AVFormatContext *ic;
+    AVCodecContext *avctx;
+    SwrContext *swr;
+    AVPacket *pkt;
+    AVFrame *frame;
+    AVFrame *planar;
+
+    //index of the next decoded sample, <0 until a frame with a timestamp placed the segment
+    int64_t next_sample;
+    //two biquads of two states per channel
+    double *filter_state;
+
+    //partial peaks and steps at both segment edges are merged with the neighbours afterwards
+    MRPeakAcc *peaks;
+    int64_t peak_base;
+    int peaks_allocated;
+    MRLoudnessStep *steps;
+    int64_t step_base;
+    int steps_allocated;
+    int64_t end;
+    float sample_peak;
+
+    SDL_Thread *tid;
+    SDL_Thread _tid;
+    int ret;
+} MROverviewWorker;
+
+//BS.1770-4 filters derived for any sample rate, at 48kHz they match the coefficients of the recommendation
+static void overview_kweight_init(MRBiquad kw[2], int sample_rate)
+{
+    double f0 = 1681.974450955533;
+    double G  = 3.999843853973347;
+    double Q  = 0.7071752369554196;
+    double K  = tan(M_PI * f0 / sample_rate);
+    double Vh = pow(10.0, G / 20.0);
+    double Vb = pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+
+    kw[0].b0 = (Vh + Vb * K / Q + K * K) / a0;
+    kw[0].b1 = 2.0 * (K * K - Vh) / a0;
+    kw[0].b2 = (Vh - Vb * K / Q + K * K) / a0;
+    kw[0].a1 = 2.0 * (K * K - 1.0) / a0;
+    kw[0].a2 = (1.0 - K / Q + K * K) / a0;
+
+    f0 = 38.13547087602444;
+    Q  = 0.5003270373238773;
+    K  = tan(M_PI * f0 / sample_rate);
+    a0 = 1.0 + K / Q + K * K;
+    kw[1].b0 = 1.0;
+    kw[1].b1 = -2.0;
+    kw[1].b2 = 1.0;
+    kw[1].a1 = 2.0 * (K * K - 1.0) / a0;
+    kw[1].a2 = (1.0 - K / Q + K * K) / a0;
+}
+
+//surround channels count 1.41 times, LFE is left out
+static double overview_channel_weight(const AVChannelLayout *layout, int index)
+{
+    switch (av_channel_layout_channel_from_index(layout, index)) {
+        case AV_CHAN_LOW_FREQUENCY:
+        case AV_CHAN_LOW_FREQUENCY_2:
+            return 0.0;
+        case AV_CHAN_SIDE_LEFT:
+        case AV_CHAN_SIDE_RIGHT:
+        case AV_CHAN_BACK_LEFT:
+        case AV_CHAN_BACK_RIGHT:
+        case AV_CHAN_SURROUND_DIRECT_LEFT:
+        case AV_CHAN_SURROUND_DIRECT_RIGHT:
+            return 1.41;
+        default:
+            return 1.0;
+    }
+}
+
+static int overview_open_input(MROverviewContext *ctx, AVFormatContext **icp)
+{
+    AVFormatContext *ic = NULL;
+    int ret = avformat_open_input(&ic, ctx->url, NULL, NULL);
+    if (ret < 0)
+        return ret;
+
+    //the decoder parameters come from the first demuxer, the others skip probing when the container has a header
+    if (!ctx->par || (ic->ctx_flags & AVFMTCTX_NOHEADER) || ic->nb_streams != ctx->nb_streams) {
+        ret = avformat_find_stream_info(ic, NULL);
+        if (ret < 0) {
+            avformat_close_input(&ic);
+            return ret;
+        }
+    }
+    *icp = ic;
+    return 0;
+}
+
+static int overview_prepare(MROverviewContext *ctx, int stream_index, AVFormatContext **icp)
+{
+    AVFormatContext *ic = NULL;
+    AVStream *st;
+    int ret;
+
+    ret = overview_open_input(ctx, &ic);
+    if (ret < 0)
+        return ret;
+
+    ret = av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO, stream_index, -1, NULL, 0);
+    if (ret < 0)
+        goto fail;
+    st = ic->streams[ret];
+    if (st->codecpar->sample_rate <= 0 || st->codecpar->ch_layout.nb_channels <= 0) {
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+
+    ctx->par = avcodec_parameters_alloc();
+    if (!ctx->par) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = avcodec_parameters_copy(ctx->par, st->codecpar)) < 0)
+        goto fail;
+    if ((ret = av_channel_layout_copy(&ctx->ch_layout, &st->codecpar->ch_layout)) < 0)
+        goto fail;
+
+    ctx->stream_index = st->index;
+    ctx->nb_streams   = ic->nb_streams;
+    ctx->time_base    = st->time_base;
+    ctx->start_time   = ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0;
+    ctx->duration     = ic->duration > 0 ? ic->duration : 0;
+    ctx->sample_rate  = st->codecpar->sample_rate;
+    ctx->step_samples = FFMAX(1, ctx->sample_rate / MR_LOUDNESS_STEPS_PER_SEC);
+    overview_kweight_init(ctx->kweight, ctx->sample_rate);
+
+    ctx->weights = av_calloc(ctx->ch_layout.nb_channels, sizeof(double));
+    if (!ctx->weights) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int c = 0; c < ctx->ch_layout.nb_channels; c++)
+        ctx->weights[c] = overview_channel_weight(&ctx->ch_layout, c);
+
+    *icp = ic;
+    return 0;
+fail:
+    avformat_close_input(&ic);
+    return ret;
+}
+
+static int overview_worker_open(MROverviewWorker *w)
+{
+    MROverviewContext *ctx = w->ctx;
+    const AVCodec *codec;
+    int ret;
+
+    if (!w->ic && (ret = overview_open_input(ctx, &w->ic)) < 0)
+        return ret;
+    if (ctx->stream_index >= w->ic->nb_streams ||
+        w->ic->streams[ctx->stream_index]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+        return AVERROR_STREAM_NOT_FOUND;
+    for (int i = 0; i < w->ic->nb_streams; i++)
+        w->ic->streams[i]->discard = i == ctx->stream_index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    codec = avcodec_find_decoder(ctx->par->codec_id);
+    if (!codec)
+        return AVERROR_DECODER_NOT_FOUND;
+    w->avctx = avcodec_alloc_context3(codec);
+    if (!w->avctx)
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_parameters_to_context(w->avctx, ctx->par)) < 0)
+        return ret;
+    w->avctx->pkt_timebase = ctx->time_base;
+    //the parallelism is across demuxers, one decoding thread each
+    w->avctx->thread_count = 1;
+    if ((ret = avcodec_open2(w->avctx, codec, NULL)) < 0)
+        return ret;
+
+    w->swr          = swr_alloc();
+    w->pkt          = av_packet_alloc();
+    w->frame        = av_frame_alloc();
+    w->planar       = av_frame_alloc();
+    w->filter_state = av_calloc(ctx->ch_layout.nb_channels * 4, sizeof(double));
+    if (!w->swr || !w->pkt || !w->frame || !w->planar || !w->filter_state)
+        return AVERROR(ENOMEM);
+
+    w->next_sample = -1;
+    w->peak_base   = w->first / ctx->samples_per_peak;
+    w->step_base   = w->first / ctx->step_samples;
+    return 0;
+}
+
+static void overview_worker_close(MROverviewWorker *w)
+{
+    av_freep(&w->peaks);
+    av_freep(&w->steps);
+    av_freep(&w->filter_state);
+    av_frame_free(&w->planar);
+    av_frame_free(&w->frame);
+    av_packet_free(&w->pkt);
+    swr_free(&w->swr);
+    avcodec_free_context(&w->avctx);
+    avformat_close_input(&w->ic);
+}
+
+//grow a zeroed accumulator array so index fits, doubling keeps the last worker's unknown length cheap
+static int overview_grow(void **array, int *allocated, size_t elem_size, int64_t index)
+{
+    int64_t size = FFMAX(*allocated, 1024);
+    void *grown;
+
+    if (index < *allocated)
+        return 0;
+    while (size <= index)
+        size *= 2;
+    if (size > INT_MAX)
+        return AVERROR(ENOMEM);
+    grown = av_realloc_array(*array, size, elem_size);
+    if (!grown)
+        return AVERROR(ENOMEM);
+    memset((uint8_t *)grown + *allocated * elem_size, 0, (size - *allocated) * elem_size);
+    *array = grown;
+    *allocated = (int)size;
+    return 0;
+}
+
+static int overview_accumulate(MROverviewWorker *w, const float * const *planes, int nb_samples)
+{
+    MROverviewContext *ctx = w->ctx;
+    const MRBiquad *shelf = &ctx->kweight[0];
+    const MRBiquad *hpf = &ctx->kweight[1];
+    int channels = ctx->ch_layout.nb_channels;
+    float sample_peak = w->sample_peak;
+    int ret;
+
+    for (int i = 0; i < nb_samples; i++) {
+        int64_t index = w->next_sample + i;
+        int64_t peak_index, step_index;
+        double energy = 0;
+        float mono = 0;
+        MRPeakAcc *peak;
+        MRLoudnessStep *step;
+
+        if (index >= w->last)
+            break;
+
+        //samples before the segment still run through the filters so they are settled at its start
+        for (int c = 0; c < channels; c++) {
+            double *s = &w->filter_state[4 * c];
+            float x = planes[c][i];
+            double y, z;
+
+            y    = shelf->b0 * x + s[0];
+            s[0] = shelf->b1 * x - shelf->a1 * y + s[1];
+            s[1] = shelf->b2 * x - shelf->a2 * y;
+            z    = hpf->b0 * y + s[2];
+            s[2] = hpf->b1 * y - hpf->a1 * z + s[3];
+            s[3] = hpf->b2 * y - hpf->a2 * z;
+
+            energy += ctx->weights[c] * z * z;
+            mono   += x;
+            if (fabsf(x) > sample_peak)
+                sample_peak = fabsf(x);
+        }
+        if (index < w->first)
+            continue;
+        mono /= channels;
+
+        peak_index = index / ctx->samples_per_peak - w->peak_base;
+        step_index = index / ctx->step_samples - w->step_base;
+        if ((ret = overview_grow((void **)&w->peaks, &w->peaks_allocated, sizeof(MRPeakAcc), peak_index)) < 0 ||
+            (ret = overview_grow((void **)&w->steps, &w->steps_allocated, sizeof(MRLoudnessStep), step_index)) < 0)
+            return ret;
+
+        peak = &w->peaks[peak_index];
+        if (!peak->n) {
+            peak->min = mono;
+            peak->max = mono;
+        } else if (mono < peak->min) {
+            peak->min = mono;
+        } else if (mono > peak->max) {
+            peak->max = mono;
+        }
+        peak->sum_sq += mono * mono;
+        peak->n++;
+
+        step = &w->steps[step_index];
+        step->energy += energy;
+        step->n++;
+        w->end = index + 1;
+    }
+    w->sample_peak = sample_peak;
+    return 0;
+}
+
+static int overview_convert(MROverviewWorker *w, AVFrame *frame)
+{
+    MROverviewContext *ctx = w->ctx;
+    int ret;
+
+    for (int retry = 0; retry < 2; retry++) {
+        av_frame_unref(w->planar);
+        w->planar->format      = AV_SAMPLE_FMT_FLTP;
+        w->planar->sample_rate = ctx->sample_rate;
+        if ((ret = av_channel_layout_copy(&w->planar->ch_layout, &ctx->ch_layout)) < 0)
+            return ret;
+        ret = swr_convert_frame(w->swr, w->planar, frame);
+        if (ret != AVERROR_INPUT_CHANGED)
+            return ret;
+        //the stream changed its format midway, reconfigure once from the new frame
+        swr_close(w->swr);
+    }
+    return ret;
+}
+
+static int overview_frame(MROverviewWorker *w)
+{
+    MROverviewContext *ctx = w->ctx;
+    AVFrame *frame = w->frame;
+    int64_t pts = frame->best_effort_timestamp;
+    const float * const *planes;
+    int nb_samples;
+    int ret;
+
+    //the first timestamp places the segment, after that samples are counted so rounding opens no gaps
+    if (w->next_sample < 0) {
+        if (pts != AV_NOPTS_VALUE)
+            w->next_sample = FFMAX(0, av_rescale_q(pts, ctx->time_base, (AVRational){1, ctx->sample_rate}) -
+                                      av_rescale(ctx->start_time, ctx->sample_rate, AV_TIME_BASE));
+        else if (w->first == 0)
+            w->next_sample = 0;
+        else
+            return 0;
+    }
+
+    if (frame->format == AV_SAMPLE_FMT_FLTP && frame->sample_rate == ctx->sample_rate &&
+        !av_channel_layout_compare(&frame->ch_layout, &ctx->ch_layout)) {
+        planes     = (const float * const *)frame->extended_data;
+        nb_samples = frame->nb_samples;
+    } else {
+        if ((ret = overview_convert(w, frame)) < 0)
+            return ret;
+        planes     = (const float * const *)w->planar->extended_data;
+        nb_samples = w->planar->nb_samples;
+    }
+
+    ret = overview_accumulate(w, planes, nb_samples);
+    w->next_sample += nb_samples;
+    return ret;
+}
+
+static int overview_decode_segment(MROverviewWorker *w)
+{
+    MROverviewContext *ctx = w->ctx;
+    int ret;
+
+    if (w->first > 0) {
+        int64_t ts = ctx->start_time + av_rescale(w->first, AV_TIME_BASE, ctx->sample_rate);
+        //landing before the segment is fine, the samples up to it only warm up the filters
+        ret = avformat_seek_file(w->ic, -1, INT64_MIN, ts, ts, 0);
+        if (ret < 0)
+            av_log(NULL, AV_LOG_WARNING, "audio overview seek to %.3fs failed:%s, decoding from the start\n",
+                   ts / (double)AV_TIME_BASE, av_err2str(ret));
+    }
+
+    for (;;) {
+        ret = avcodec_receive_frame(w->avctx, w->frame);
+        if (ret >= 0) {
+            ret = overview_frame(w);
+            av_frame_unref(w->frame);
+            if (ret < 0)
+                return ret;
+            if (w->next_sample >= w->last)
+                return 0;
+            continue;
+        }
+        if (ret == AVERROR_EOF)
+            return 0;
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+
+        ret = av_read_frame(w->ic, w->pkt);
+        if (ret < 0) {
+            //a broken tail ends the segment like the end of the file does
+            if (ret != AVERROR_EOF)
+                av_log(NULL, AV_LOG_WARNING, "audio overview read failed:%s\n", av_err2str(ret));
+            if ((ret = avcodec_send_packet(w->avctx, NULL)) < 0)
+                return ret;
+            continue;
+        }
+        if (w->pkt->stream_index == ctx->stream_index) {
+            ret = avcodec_send_packet(w->avctx, w->pkt);
+            if (ret < 0)
+                av_log(w->avctx, AV_LOG_DEBUG, "audio overview send_packet failed:%s\n", av_err2str(ret));
+        }
+        av_packet_unref(w->pkt);
+    }
+}
+
+static int overview_worker_thread(void *arg)
+{
+    MROverviewWorker *w = arg;
+
+    w->ret = overview_worker_open(w);
+    if (w->ret >= 0)
+        w->ret = overview_decode_segment(w);
+    if (w->ret < 0)
+        av_log(NULL, AV_LOG_WARNING, "audio overview segment %.3fs failed:%s\n",
+               w->first / (double)w->ctx->sample_rate, av_err2str(w->ret));
+    return 0;
+}
+
+static double overview_block_loudness(double energy)
+{
+    return -0.691 + 10.0 * log10(energy);
+}
+
+//BS.1770-4 gating over 400ms blocks overlapping by 75%
+static double overview_integrated_loudness(const MRLoudnessStep *steps, int64_t nb_steps)
+{
+    double gate = pow(10.0, (MR_LOUDNESS_ABSOLUTE_GATE + 0.691) / 10.0);
+    double loudness = MR_LOUDNESS_ABSOLUTE_GATE;
+
+    for (int pass = 0; pass < 2; pass++) {
+        double sum = 0;
+        int64_t nb_blocks = 0;
+
+        for (int64_t i = 0; i + MR_LOUDNESS_BLOCK_STEPS <= nb_steps; i++) {
+            double energy = 0;
+            int64_t n = 0;
+            int complete = 1;
+
+            for (int k = 0; k < MR_LOUDNESS_BLOCK_STEPS; k++) {
+                if (!steps[i + k].n)
+                    complete = 0;
+                energy += steps[i + k].energy;
+                n      += steps[i + k].n;
+            }
+            if (!complete)
+                continue;
+            energy /= n;
+            if (energy > gate) {
+                sum += energy;
+                nb_blocks++;
+            }
+        }
+        if (!nb_blocks)
+            return MR_LOUDNESS_ABSOLUTE_GATE;
+
+        loudness = overview_block_loudness(sum / nb_blocks);
+        //quiet material puts the relative gate below the absolute one, blocks must pass both
+        gate = pow(10.0, (FFMAX(loudness + MR_LOUDNESS_RELATIVE_GATE, MR_LOUDNESS_ABSOLUTE_GATE) + 0.691) / 10.0);
+    }
+    return FFMAX(loudness, MR_LOUDNESS_ABSOLUTE_GATE);
+}
+
+static MRAudioPeak overview_peak(const MRPeakAcc *acc)
+{
+    MRAudioPeak peak = {0};
+
+    if (acc->n) {
+        peak.min = av_clip_int16(lrintf(acc->min * 32767.0f));
+        peak.max = av_clip_int16(lrintf(acc->max * 32767.0f));
+        peak.rms = av_clip_uint16(lrintf(sqrtf(acc->sum_sq / acc->n) * 32767.0f));
+    }
+    return peak;
+}
+
+static MRAudioPeak overview_peak_merge(const MRAudioPeak *a, const MRAudioPeak *b)
+{
+    MRAudioPeak peak;
+
+    peak.min = FFMIN(a->min, b->min);
+    peak.max = FFMAX(a->max, b->max);
+    peak.rms = av_clip_uint16(lrint(sqrt(((double)a->rms * a->rms + (double)b->rms * b->rms) / 2.0)));
+    return peak;
+}
+
+static int overview_write(const char *path, MRAudioOverviewHeader *header, const MRAudioPeak *peaks,
+                          const MRAudioOverviewLevel *levels, int64_t nb_peaks)
+{
+    //written aside and renamed, a reader mapping the old sidecar never sees half a file
+    char *tmp = av_asprintf("%s.tmp", path);
+    FILE *fp;
+    int ok;
+
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    fp = fopen(tmp, "wb");
+    if (!fp) {
+        int ret = AVERROR(errno);
+        av_free(tmp);
+        return ret;
+    }
+    ok = fwrite(header, sizeof(*header), 1, fp) == 1 &&
+         fwrite(levels, sizeof(*levels), header->nb_levels, fp) == header->nb_levels &&
+         fwrite(peaks, sizeof(*peaks), nb_peaks, fp) == nb_peaks;
+    if (fclose(fp) != 0)
+        ok = 0;
+    if (ok && rename(tmp, path) != 0)
+        ok = 0;
+    if (!ok)
+        unlink(tmp);
+    av_free(tmp);
+    return ok ? 0 : AVERROR(EIO);
+}
+
+static int overview_finish(MROverviewContext *ctx, MROverviewWorker *workers, int nb_workers, const char *path)
+{
+    MRAudioOverviewHeader header = {0};
+    MRAudioOverviewLevel *levels = NULL;
+    MRPeakAcc *accs = NULL;
+    MRLoudnessStep *steps = NULL;
+    MRAudioPeak *peaks = NULL;
+    MRAudioPeak *level_peaks;
+    int64_t nb_samples = 0, nb_accs, nb_steps, nb_peaks = 0, count;
+    float sample_peak = 0;
+    int nb_levels = 0;
+    int ret;
+
+    for (int i = 0; i < nb_workers; i++) {
+        nb_samples  = FFMAX(nb_samples, workers[i].end);
+        sample_peak = FFMAX(sample_peak, workers[i].sample_peak);
+    }
+    if (nb_samples <= 0)
+        return AVERROR_INVALIDDATA;
+
+    nb_accs  = (nb_samples + ctx->samples_per_peak - 1) / ctx->samples_per_peak;
+    nb_steps = (nb_samples + ctx->step_samples - 1) / ctx->step_samples;
+    for (count = nb_accs; ; count = (count + 1) / 2) {
+        nb_peaks += count;
+        nb_levels++;
+        if (count == 1)
+            break;
+    }
+
+    accs   = av_calloc(nb_accs, sizeof(*accs));
+    steps  = av_calloc(nb_steps, sizeof(*steps));
+    peaks  = av_malloc_array(nb_peaks, sizeof(*peaks));
+    levels = av_calloc(nb_levels, sizeof(*levels));
+    if (!accs || !steps || !peaks || !levels) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    //min, max and sums combine in any order, so the segments' edges simply add up
+    for (int i = 0; i < nb_workers; i++) {
+        MROverviewWorker *w = &workers[i];
+        for (int k = 0; k < w->peaks_allocated && w->peak_base + k < nb_accs; k++) {
+            const MRPeakAcc *src = &w->peaks[k];
+            MRPeakAcc *dst = &accs[w->peak_base + k];
+            if (!src->n)
+                continue;
+            dst->min     = dst->n ? FFMIN(dst->min, src->min) : src->min;
+            dst->max     = dst->n ? FFMAX(dst->max, src->max) : src->max;
+            dst->sum_sq += src->sum_sq;
+            dst->n      += src->n;
+        }
+        for (int k = 0; k < w->steps_allocated && w->step_base + k < nb_steps; k++) {
+            steps[w->step_base + k].energy += w->steps[k].energy;
+            steps[w->step_base + k].n      += w->steps[k].n;
+        }
+    }
+
+    levels[0].offset = sizeof(header) + nb_levels * sizeof(*levels);
+    levels[0].count  = nb_accs;
+    for (int64_t i = 0; i < nb_accs; i++)
+        peaks[i] = overview_peak(&accs[i]);
+    level_peaks = peaks;
+    for (int l = 1; l < nb_levels; l++) {
+        const MRAudioPeak *src = level_peaks;
+        MRAudioPeak *dst = level_peaks + levels[l - 1].count;
+
+        levels[l].offset = levels[l - 1].offset + levels[l - 1].count * sizeof(*peaks);
+        levels[l].count  = (levels[l - 1].count + 1) / 2;
+        for (int64_t i = 0; i < levels[l].count; i++) {
+            if (2 * i + 1 < levels[l - 1].count)
+                dst[i] = overview_peak_merge(&src[2 * i], &src[2 * i + 1]);
+            else
+                dst[i] = src[2 * i];
+        }
+        level_peaks = dst;
+    }
+
+    header.magic            = MR_OVERVIEW_MAGIC;
+    header.version          = MR_OVERVIEW_VERSION;
+    header.sample_rate      = ctx->sample_rate;
+    header.channels         = ctx->ch_layout.nb_channels;
+    header.nb_samples       = nb_samples;
+    header.samples_per_peak = ctx->samples_per_peak;
+    header.nb_levels        = nb_levels;
+    header.loudness         = overview_integrated_loudness(steps, nb_steps);
+    header.sample_peak      = sample_peak > 0 ? 20.0 * log10(sample_peak) : -INFINITY;
+
+    ret = overview_write(path, &header, peaks, levels, nb_peaks);
+    if (ret >= 0)
+        av_log(NULL, AV_LOG_INFO, "audio overview %s: %.3fs, %d levels, %.1f LUFS, peak %.1f dBFS\n", ctx->url,
+               nb_samples / (double)ctx->sample_rate, nb_levels, header.loudness, header.sample_peak);
+end:
+    av_free(levels);
+    av_free(peaks);
+    av_free(steps);
+    av_free(accs);
+    return ret;
+}
+
+int mr_audio_overview_generate(const char *url, const MRAudioOverviewOptions *opt, const char *sidecar_path)
+{
+    MROverviewContext ctx = {0};
+    MROverviewWorker *workers = NULL;
+    AVFormatContext *ic = NULL;
+    int64_t estimated = 0;
+    int nb_workers;
+    int ret;
+
+    if (!url || !opt || !sidecar_path)
+        return AVERROR(EINVAL);
+
+    ctx.url              = url;
+    ctx.samples_per_peak = opt->samples_per_peak > 0 ? opt->samples_per_peak : MR_OVERVIEW_DEFAULT_SAMPLES;
+
+    ret = overview_prepare(&ctx, opt->stream_index, &ic);
+    if (ret < 0)
+        goto end;
+
+    nb_workers = opt->threads > 0 ? opt->threads : av_cpu_count();
+    nb_workers = av_clip(nb_workers, 1, MR_OVERVIEW_MAX_THREADS);
+    //without a duration there is nowhere to seek to, the whole stream is one segment
+    if (ctx.duration > 0) {
+        estimated  = av_rescale(ctx.duration, ctx.sample_rate, AV_TIME_BASE);
+        nb_workers = (int)FFMIN(nb_workers, estimated / ((int64_t)MR_OVERVIEW_MIN_SEGMENT * ctx.sample_rate) + 1);
+    } else {
+        nb_workers = 1;
+    }
+
+    workers = av_calloc(nb_workers, sizeof(MROverviewWorker));
+    if (!workers) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (int i = 0; i < nb_workers; i++) {
+        MROverviewWorker *w = &workers[i];
+        w->ctx   = &ctx;
+        w->first = estimated * i / nb_workers;
+        //the duration is only an estimate, the last segment reads on to the real end
+        w->last  = i + 1 < nb_workers ? estimated * (i + 1) / nb_workers : INT64_MAX;
+    }
+    //the probing demuxer is reused by the first worker
+    workers[0].ic = ic;
+    ic = NULL;
+
+    for (int i = 1; i < nb_workers; i++) {
+        MROverviewWorker *w = &workers[i];
+        w->tid = SDL_CreateThreadEx(&w->_tid, overview_worker_thread, w, "mr_audio_overview");
+        if (!w->tid)
+            overview_worker_thread(w);
+    }
+    overview_worker_thread(&workers[0]);
+    for (int i = 0; i < nb_workers; i++) {
+        MROverviewWorker *w = &workers[i];
+        if (w->tid)
+            SDL_WaitThread(w->tid, NULL);
+        //a segment missing from the middle would leave a silent hole in the waveform
+        if (w->ret < 0 && ret >= 0)
+            ret = w->ret;
+    }
+
+    if (ret >= 0)
+        ret = overview_finish(&ctx, workers, nb_workers, sidecar_path);
+    for (int i = 0; i < nb_workers; i++)
+        overview_worker_close(&workers[i]);
+end:
+    av_free(workers);
+    avformat_close_input(&ic);
+    avcodec_parameters_free(&ctx.par);
+    av_channel_layout_uninit(&ctx.ch_layout);
+    av_free(ctx.weights);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "audio overview %s failed:%s\n", url ? url : "", av_err2str(ret));
+    return ret;
+}
+
+int mr_audio_overview_open(const char *sidecar_path, MRAudioOverview **overview_out)
+{
+    const MRAudioOverviewHeader *header;
+    const MRAudioOverviewLevel *levels;
+    MRAudioOverview *ov;
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (!sidecar_path || !overview_out)
+        return AVERROR(EINVAL);
+
+    fd = open(sidecar_path, O_RDONLY);
+    if (fd < 0)
+        return AVERROR(errno);
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MRAudioOverviewHeader)) {
+        close(fd);
+        return AVERROR_INVALIDDATA;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return AVERROR(errno);
+
+    header = map;
+    levels = (const MRAudioOverviewLevel *)(header + 1);
+    if (header->magic != MR_OVERVIEW_MAGIC || header->version != MR_OVERVIEW_VERSION ||
+        header->nb_levels < 1 || header->nb_levels > 64 ||
+        sizeof(*header) + header->nb_levels * sizeof(*levels) > (size_t)st.st_size)
+        goto invalid;
+    for (int l = 0; l < header->nb_levels; l++) {
+        if (levels[l].offset % sizeof(int16_t) || levels[l].offset > (uint64_t)st.st_size ||
+            levels[l].count > ((uint64_t)st.st_size - levels[l].offset) / sizeof(MRAudioPeak))
+            goto invalid;
+    }
+
+    ov = av_mallocz(sizeof(MRAudioOverview));
+    if (!ov) {
+        munmap(map, st.st_size);
+        return AVERROR(ENOMEM);
+    }
+    ov->map    = map;
+    ov->size   = st.st_size;
+    ov->header = header;
+    ov->levels = levels;
+    *overview_out = ov;
+    return 0;
+invalid:
+    av_log(NULL, AV_LOG_ERROR, "audio overview %s is not a valid sidecar\n", sidecar_path);
+    munmap(map, st.st_size);
+    return AVERROR_INVALIDDATA;
+}
+
+void mr_audio_overview_close(MRAudioOverview **overview)
+{
+    if (!overview || !*overview)
+        return;
+    munmap((*overview)->map, (*overview)->size);
+    av_freep(overview);
+}
+
+int mr_audio_overview_sample_rate(const MRAudioOverview *overview)
+{
+    return overview ? overview->header->sample_rate : 0;
+}
+
+int mr_audio_overview_channels(const MRAudioOverview *overview)
+{
+    return overview ? overview->header->channels : 0;
+}
+
+int64_t mr_audio_overview_nb_samples(const MRAudioOverview *overview)
+{
+    return overview ? overview->header->nb_samples : 0;
+}
+
+int mr_audio_overview_nb_levels(const MRAudioOverview *overview)
+{
+    return overview ? overview->header->nb_levels : 0;
+}
+
+const MRAudioPeak *mr_audio_overview_level(const MRAudioOverview *overview, int level, int *count_out, int *samples_per_peak_out)
+{
+    const MRAudioOverviewLevel *l;
+
+    if (!overview || level < 0 || level >= overview->header->nb_levels)
+        return NULL;
+    l = &overview->levels[level];
+    if (count_out)
+        *count_out = (int)l->count;
+    if (samples_per_peak_out) {
+        //levels come from the sidecar, a deep one would overflow an int
+        uint64_t samples = level < 32 ? (uint64_t)overview->header->samples_per_peak << level : UINT64_MAX;
+        *samples_per_peak_out = (int)FFMIN(samples, INT_MAX);
+    }
+    return (const MRAudioPeak *)((const uint8_t *)overview->map + l->offset);
+}
+
+double mr_audio_overview_loudness(const MRAudioOverview *overview)
+{
+    return overview ? overview->header->loudness : MR_LOUDNESS_ABSOLUTE_GATE;
+}
+
+double mr_audio_overview_sample_peak(const MRAudioOverview *overview)
+{
+    return overview ? overview->header->sample_peak : -INFINITY;
+}
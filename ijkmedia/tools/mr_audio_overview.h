@@ -0,0 +1,55 @@
+//
+//  mr_audio_overview.h
+//
+// ijkplayer not use the file, but the file will be used by other module in app.
+//
+//  Waveform peaks and EBU R128 loudness of a whole audio stream, kept in a sidecar file.
+//
+
+#ifndef mr_audio_overview_h
+#define mr_audio_overview_h
+
+#include <stdint.h>
+
+typedef struct MRAudioOverviewOptions {
+    //audio stream to analyse, <0 picks the best one
+    int stream_index;
+    //source samples per peak of the finest level, 0 means 256
+    int samples_per_peak;
+    //file segments decoded in parallel, 0 picks from the cpu count
+    int threads;
+} MRAudioOverviewOptions;
+
+//one peak of the channels averaged to mono, full scale is 32767
+typedef struct MRAudioPeak {
+    int16_t min;
+    int16_t max;
+    uint16_t rms;
+} MRAudioPeak;
+
+typedef struct MRAudioOverview MRAudioOverview;
+
+/*
+ * decode the audio stream of url at full speed and write its overview to sidecar_path.
+ * level 0 holds one peak per samples_per_peak samples, every next level covers twice as
+ * many samples with half the peaks, up to a last level of a single peak.
+ * the sidecar is written in host byte order.
+ */
+int mr_audio_overview_generate(const char *url, const MRAudioOverviewOptions *opt, const char *sidecar_path);
+
+/* map a sidecar written by mr_audio_overview_generate, release with mr_audio_overview_close */
+int mr_audio_overview_open(const char *sidecar_path, MRAudioOverview **overview_out);
+void mr_audio_overview_close(MRAudioOverview **overview);
+
+int mr_audio_overview_sample_rate(const MRAudioOverview *overview);
+int mr_audio_overview_channels(const MRAudioOverview *overview);
+int64_t mr_audio_overview_nb_samples(const MRAudioOverview *overview);
+int mr_audio_overview_nb_levels(const MRAudioOverview *overview);
+/* peaks of level, points into the mapping, NULL when level is out of range */
+const MRAudioPeak *mr_audio_overview_level(const MRAudioOverview *overview, int level, int *count_out, int *samples_per_peak_out);
+/* EBU R128 integrated loudness in LUFS, -70 when everything is below the absolute gate */
+double mr_audio_overview_loudness(const MRAudioOverview *overview);
+/* highest sample of any channel in dBFS, not oversampled so it is not a true peak */
+double mr_audio_overview_sample_peak(const MRAudioOverview *overview);
+
+#endif /* mr_audio_overview_h */
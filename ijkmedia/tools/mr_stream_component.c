@@ -58,6 +58,17 @@ end:
     return stream_has_enough_packets(sc->packetq, 0);
 }
 
+/* sleep at the end of the stream until a seek or new packets, instead of polling */
+static void wait_for_seek_or_packets(MRStreamComponent *sc)
+{
+    PacketQueue *q = sc->packetq;
+
+    SDL_LockMutex(q->mutex);
+    while (!q->abort_request && q->nb_packets == 0 && sc->seek_req < 0)
+        SDL_CondWait(q->cond, q->mutex);
+    SDL_UnlockMutex(q->mutex);
+}
+
 static int fetch_a_packet(MRStreamComponent *sc, Decoder *d)
 {
     while (sc->packetq->abort_request == 0) {
@@ -80,6 +91,8 @@ static int fetch_a_packet(MRStreamComponent *sc, Decoder *d)
         } else if (r == 0) {
             if (read_enough_packets(sc) > 0) {
                 continue;
+            } else if (sc->eof) {
+                wait_for_seek_or_packets(sc);
             } else {
                 av_usleep(1000 * 3);
             }
@@ -277,7 +290,8 @@ static int sub_component_thread(void *arg)
                     av_frame_move_ref(sp->frame, frame);
                     frame_queue_push(sc->frameq);
                 } else {
-                    av_usleep(10);
+                    /* wake a reader blocked on the frame queue, it checks for the end of stream */
+                    frame_queue_signal(sc->frameq);
                     ret = -1;
                 }
                 break;
@@ -297,7 +311,8 @@ static int sub_component_thread(void *arg)
                     av_frame_move_ref(sp->frame, frame);
                     frame_queue_push(sc->frameq);
                 } else {
-                    av_usleep(10);
+                    /* wake a reader blocked on the frame queue, it checks for the end of stream */
+                    frame_queue_signal(sc->frameq);
                     ret = -1;
                 }
                 break;
@@ -364,7 +379,7 @@ int streamComponent_open(MRStreamComponent **scp, int stream_index, AVFormatCont
     sc->ic = ic;
     sc->pkt = av_packet_alloc();
     sc->eof = 0;
-    int ret = decoder_init(&sc->decoder, avctx, sc->packetq, NULL);
+    int ret = decoder_init(&sc->decoder, avctx, sc->packetq, NULL, NULL);
     
     if (ret < 0) {
         av_free(sc);
@@ -423,8 +438,11 @@ int streamComponent_seek_to(MRStreamComponent *sc, int sec)
     if (sec < 0) {
         sec = 0;
     }
+    SDL_LockMutex(sc->packetq->mutex);
     sc->seek_req = seconds_to_fftime(sec);
     sc->eof = 0;
+    SDL_CondSignal(sc->packetq->cond);
+    SDL_UnlockMutex(sc->packetq->mutex);
     return 0;
 }
 
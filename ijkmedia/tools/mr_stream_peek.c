@@ -18,6 +18,8 @@
 #define MRSampleFormat AV_SAMPLE_FMT_S16P
 #define MRSampleRate   16000
 #define MRNBChannels   1
+//longest single wait on the frame queue, the end of stream is checked in between
+#define MRFrameWaitMS  100
 
 typedef struct MRStreamPeeker {
     SDL_mutex* mutex;
@@ -39,6 +41,17 @@ typedef struct MRStreamPeeker {
     int audio_clock_serial;
     //video duration
     int duration;
+    char *file_name;
+    
+    //decode range worker
+    SDL_Thread *range_tid;
+    SDL_Thread _range_tid;
+    volatile int range_abort;
+    int range_ret;
+    double range_begin;
+    double range_end;
+    MRStreamPeekRangeCallback range_cb;
+    void *range_opaque;
 }MRStreamPeeker;
 
 int mr_stream_peek_create(MRStreamPeeker **spp,int frameCacheCount)
@@ -92,7 +105,9 @@ int mr_stream_peek_seek_to(MRStreamPeeker *sp, float sec)
 }
 
 //FILE *file_pcm_l = NULL;
-static int audio_decode_frame(MRStreamPeeker *sp)
+//deadline is an av_gettime_relative() time or -1 to wait for a frame as long as it takes,
+//returns AVERROR(EAGAIN) when it passed.
+static int audio_decode_frame(MRStreamPeeker *sp, int64_t deadline)
 {
     if (sp->pktq.abort_request)
         return -1;
@@ -101,12 +116,20 @@ static int audio_decode_frame(MRStreamPeeker *sp)
     
     //skip old audio frames.
     do {
-        af = frame_queue_peek_readable_noblock(&sp->frameq);
+        int wait_ms = MRFrameWaitMS;
+        if (deadline >= 0) {
+            int64_t left = deadline - av_gettime_relative();
+            if (left <= 0)
+                wait_ms = 0;
+            else
+                wait_ms = (int)FFMIN(left / 1000 + 1, MRFrameWaitMS);
+        }
+        af = frame_queue_peek_readable_timeout(&sp->frameq, wait_ms);
         if (af == NULL) {
-            if (streamComponent_eof_and_pkt_empty(sp->opaque)) {
+            if (sp->pktq.abort_request || streamComponent_eof_and_pkt_empty(sp->opaque)) {
                 return -1;
-            } else {
-                av_usleep(10);
+            } else if (deadline >= 0 && av_gettime_relative() >= deadline) {
+                return AVERROR(EAGAIN);
             }
         } else {
             if (af->serial != sp->pktq.serial) {
@@ -231,18 +254,31 @@ static int bytes_per_sec(void)
 }
 
 int mr_stream_peek_get_data(MRStreamPeeker *peeker, unsigned char *buffer, int len, double * pts_begin, double * pts_end)
+{
+    return mr_stream_peek_get_data_timeout(peeker, buffer, len, -1, pts_begin, pts_end);
+}
+
+int mr_stream_peek_get_data_timeout(MRStreamPeeker *peeker, unsigned char *buffer, int len, int timeout_ms, double * pts_begin, double * pts_end)
 {
     const int len_want = len;
     double begin = -1, end = -1;
+    int64_t deadline = -1;
     
     if (!peeker) {
         return -1;
     }
     
+    if (timeout_ms >= 0) {
+        deadline = av_gettime_relative() + (int64_t)timeout_ms * 1000;
+    }
+    
     while (len > 0) {
         if (peeker->audio_buf_index >= peeker->audio_buf_size) {
-            int audio_size = audio_decode_frame(peeker);
-            if (audio_size < 0) {
+            int audio_size = audio_decode_frame(peeker, deadline);
+            if (audio_size == AVERROR(EAGAIN)) {
+                //deadline passed, keep what was copied
+                break;
+            } else if (audio_size < 0) {
                 /* if error, just output silence */
                 peeker->audio_buf = NULL;
                 peeker->audio_buf_size = 0;
@@ -284,6 +320,220 @@ the_end:
     return len_want - len;
 }
 
+static int range_interrupt_cb(void *opaque)
+{
+    MRStreamPeeker *sp = opaque;
+    return sp->range_abort;
+}
+
+//resample a decoded frame and hand the part inside the range to the callback, returns 1 once the range end is reached
+static int range_deliver(MRStreamPeeker *sp, struct SwrContext *swr_ctx, AVFrame *frame, double pts, uint8_t **buf, unsigned int *buf_size)
+{
+    int bytes_per_sample = av_get_bytes_per_sample(MRSampleFormat) * MRNBChannels;
+    int out_count = (int)((int64_t)frame->nb_samples * MRSampleRate / frame->sample_rate + 256);
+    int out_size = av_samples_get_buffer_size(NULL, MRNBChannels, out_count, MRSampleFormat, 0);
+    int first = 0, last;
+    int nb_samples;
+
+    if (out_size < 0)
+        return out_size;
+    av_fast_malloc(buf, buf_size, out_size);
+    if (!*buf)
+        return AVERROR(ENOMEM);
+    nb_samples = swr_convert(swr_ctx, buf, out_count, (const uint8_t **)frame->extended_data, frame->nb_samples);
+    if (nb_samples < 0)
+        return nb_samples;
+
+    last = nb_samples;
+    if (pts < sp->range_begin)
+        first = (int)FFMIN(nb_samples, (sp->range_begin - pts) * MRSampleRate);
+    if (pts + (double)nb_samples / MRSampleRate > sp->range_end)
+        last = (int)FFMAX(first, (sp->range_end - pts) * MRSampleRate);
+
+    if (last > first &&
+        sp->range_cb(sp->range_opaque, *buf + first * bytes_per_sample, (last - first) * bytes_per_sample, pts + (double)first / MRSampleRate))
+        return 1;
+    return pts + (double)nb_samples / MRSampleRate >= sp->range_end;
+}
+
+//decodes the range with a demuxer and decoder of its own, so the peeker's streaming is left alone
+static int range_thread(void *arg)
+{
+    MRStreamPeeker *sp = arg;
+    AVFormatContext *ic = NULL;
+    AVCodecContext *avctx = NULL;
+    AVStream *stream;
+    const AVCodec *codec;
+    AVChannelLayout layout;
+    struct SwrContext *swr_ctx = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    uint8_t *buf = NULL;
+    unsigned int buf_size = 0;
+    double next_pts = sp->range_begin;
+    int idx = sp->stream_idx;
+    int eof = 0;
+    int ret;
+
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    if (!pkt || !frame || !(ic = avformat_alloc_context())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ic->interrupt_callback.callback = range_interrupt_cb;
+    ic->interrupt_callback.opaque = sp;
+    if ((ret = avformat_open_input(&ic, sp->file_name, NULL, NULL)) < 0)
+        goto end;
+    if ((ret = avformat_find_stream_info(ic, NULL)) < 0)
+        goto end;
+    if (idx >= ic->nb_streams || ic->streams[idx]->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+        ret = AVERROR_STREAM_NOT_FOUND;
+        goto end;
+    }
+    for (int i = 0; i < ic->nb_streams; i++)
+        ic->streams[i]->discard = i == idx ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    stream = ic->streams[idx];
+    codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec) {
+        ret = AVERROR_DECODER_NOT_FOUND;
+        goto end;
+    }
+    if (!(avctx = avcodec_alloc_context3(codec))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_to_context(avctx, stream->codecpar)) < 0)
+        goto end;
+    avctx->pkt_timebase = stream->time_base;
+    if ((ret = avcodec_open2(avctx, codec, NULL)) < 0)
+        goto end;
+
+    av_channel_layout_default(&layout, MRNBChannels);
+    if ((ret = swr_alloc_set_opts2(&swr_ctx,
+                                   &layout, MRSampleFormat, MRSampleRate,
+                                   &avctx->ch_layout, avctx->sample_fmt, avctx->sample_rate,
+                                   0, NULL)) < 0 ||
+        (ret = swr_init(swr_ctx)) < 0)
+        goto end;
+
+    if (sp->range_begin > 0) {
+        int64_t ts = (int64_t)(sp->range_begin * AV_TIME_BASE);
+        if (avformat_seek_file(ic, -1, INT64_MIN, ts, ts, 0) < 0)
+            av_log(NULL, AV_LOG_WARNING, "range decode could not seek to %0.3f, decoding from the start\n", sp->range_begin);
+    }
+
+    ret = 0;
+    while (!sp->range_abort && ret == 0) {
+        if (!eof) {
+            int r = av_read_frame(ic, pkt);
+            if (r == AVERROR_EOF) {
+                eof = 1;
+                avcodec_send_packet(avctx, NULL);
+            } else if (r < 0) {
+                ret = r;
+                break;
+            } else if (pkt->stream_index != idx) {
+                av_packet_unref(pkt);
+                continue;
+            } else {
+                r = avcodec_send_packet(avctx, pkt);
+                av_packet_unref(pkt);
+                if (r < 0 && r != AVERROR(EAGAIN) && r != AVERROR_INVALIDDATA) {
+                    ret = r;
+                    break;
+                }
+            }
+        }
+
+        while (ret == 0) {
+            int r = avcodec_receive_frame(avctx, frame);
+            if (r == AVERROR(EAGAIN) && !eof)
+                break;
+            if (r == AVERROR_EOF || r == AVERROR(EAGAIN)) {
+                ret = 1;
+                break;
+            }
+            if (r < 0) {
+                ret = r;
+                break;
+            }
+            if (frame->format != avctx->sample_fmt ||
+                frame->sample_rate != avctx->sample_rate ||
+                av_channel_layout_compare(&frame->ch_layout, &avctx->ch_layout)) {
+                //parameters changed mid stream, follow them
+                swr_free(&swr_ctx);
+                if ((r = swr_alloc_set_opts2(&swr_ctx,
+                                             &layout, MRSampleFormat, MRSampleRate,
+                                             &frame->ch_layout, frame->format, frame->sample_rate,
+                                             0, NULL)) < 0 ||
+                    (r = swr_init(swr_ctx)) < 0) {
+                    ret = r;
+                    break;
+                }
+                avctx->sample_fmt = frame->format;
+                avctx->sample_rate = frame->sample_rate;
+                av_channel_layout_copy(&avctx->ch_layout, &frame->ch_layout);
+            }
+            double pts = frame->pts != AV_NOPTS_VALUE ? frame->pts * av_q2d(stream->time_base) : next_pts;
+            next_pts = pts + (double)frame->nb_samples / frame->sample_rate;
+            ret = range_deliver(sp, swr_ctx, frame, pts, &buf, &buf_size);
+            av_frame_unref(frame);
+        }
+    }
+    if (ret > 0)
+        ret = 0;
+    if (sp->range_abort)
+        ret = AVERROR_EXIT;
+end:
+    av_freep(&buf);
+    swr_free(&swr_ctx);
+    avcodec_free_context(&avctx);
+    avformat_close_input(&ic);
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    sp->range_ret = ret;
+    return 0;
+}
+
+int mr_stream_peek_decode_range(MRStreamPeeker *peeker, double begin, double end, MRStreamPeekRangeCallback cb, void *opaque)
+{
+    if (!peeker || !peeker->file_name || peeker->stream_idx < 0 || !cb || end <= begin) {
+        return -1;
+    }
+    
+    if (peeker->range_tid) {
+        return -2;
+    }
+    
+    peeker->range_abort = 0;
+    peeker->range_ret = 0;
+    peeker->range_begin = FFMAX(begin, 0);
+    peeker->range_end = end;
+    peeker->range_cb = cb;
+    peeker->range_opaque = opaque;
+    peeker->range_tid = SDL_CreateThreadEx(&peeker->_range_tid, range_thread, peeker, "ff_peek_range");
+    if (!peeker->range_tid) {
+        return -3;
+    }
+    return 0;
+}
+
+int mr_stream_peek_wait_range(MRStreamPeeker *peeker, int cancel)
+{
+    if (!peeker || !peeker->range_tid) {
+        return -1;
+    }
+    
+    if (cancel) {
+        peeker->range_abort = 1;
+    }
+    SDL_WaitThread(peeker->range_tid, NULL);
+    peeker->range_tid = NULL;
+    return peeker->range_ret;
+}
+
 int mr_stream_peek_open_filepath(MRStreamPeeker *peeker, const char *file_name, int idx)
 {
     if (!peeker) {
@@ -392,6 +642,9 @@ int mr_stream_peek_open_filepath(MRStreamPeeker *peeker, const char *file_name,
     peeker->duration = (int)(ic->duration / AV_TIME_BASE);
     peeker->ic = ic;
     peeker->stream_idx = idx;
+    mr_stream_peek_wait_range(peeker, 1);
+    av_freep(&peeker->file_name);
+    peeker->file_name = av_strdup(file_name);
     return 0;
 fail:
     if (ret < 0) {
@@ -409,6 +662,9 @@ int mr_stream_peek_close(MRStreamPeeker *peeker)
         return -1;
     }
     
+    mr_stream_peek_wait_range(peeker, 1);
+    av_freep(&peeker->file_name);
+    
     MRStreamComponent *opaque = peeker->opaque;
     
     if(!opaque) {
@@ -17,7 +17,18 @@ int mr_stream_peek_open_filepath(MRStreamPeeker *peeker, const char *file_name,
 
 int mr_stream_peek_get_opened_stream_idx(MRStreamPeeker *peeker);
 int mr_stream_peek_seek_to(MRStreamPeeker *peeker, float sec);
+//blocks until len bytes are decoded or the stream ends, returns the bytes copied
 int mr_stream_peek_get_data(MRStreamPeeker *peeker, unsigned char *buffer, int len, double * pts_begin, double * pts_end);
+//same but gives up after timeout_ms, returns the bytes copied by then, -1 timeout_ms waits as long as it takes
+int mr_stream_peek_get_data_timeout(MRStreamPeeker *peeker, unsigned char *buffer, int len, int timeout_ms, double * pts_begin, double * pts_end);
+
+//pcm in the format of mr_stream_peek_get_data starting at pts, return non-zero to stop
+typedef int (*MRStreamPeekRangeCallback)(void *opaque, const unsigned char *buffer, int len, double pts);
+//decode [begin, end] seconds as fast as possible on a low priority worker with a demuxer and decoder of its own,
+//mr_stream_peek_get_data is not affected. cb runs on the worker.
+int mr_stream_peek_decode_range(MRStreamPeeker *peeker, double begin, double end, MRStreamPeekRangeCallback cb, void *opaque);
+//wait for the range worker, cancel stops it first; 0 when the range was decoded, <0 on error
+int mr_stream_peek_wait_range(MRStreamPeeker *peeker, int cancel);
 int mr_stream_peek_close(MRStreamPeeker *peeker);
 void mr_stream_peek_destroy(MRStreamPeeker **peeker_out);
 int mr_stream_peek_get_buffer_size(int millisecond);
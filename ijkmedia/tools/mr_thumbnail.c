@@ -0,0 +1,628 @@
+//
+//  mr_thumbnail.c
+//
+// ijkplayer not use the file, but the file will be used by other module in app.
+//
+//  Pull keyframe thumbnails or a storyboard sprite out of a media file without a player.
+//
+
+#include "mr_thumbnail.h"
+#include "ijksdl/ijksdl_thread.h"
+#include "ijksdl/ffmpeg/ijksdl_image_convert.h"
+#include "ijksdl/ffmpeg/ijksdl_tonemap.h"
+#include <math.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/cpu.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/time.h>
+#include <libswscale/swscale.h>
+
+#define MR_THUMBNAIL_DEFAULT_COUNT   10
+#define MR_THUMBNAIL_DEFAULT_QUALITY 80
+#define MR_THUMBNAIL_MAX_THREADS     8
+//video packets read after a seek before giving up on finding a keyframe
+#define MR_THUMBNAIL_MAX_PACKETS     1500
+
+typedef struct MRThumbnailContext {
+    const char *url;
+    int count;
+    int jpeg_quality;
+    //AV_PIX_FMT_RGBA, or AV_PIX_FMT_YUVJ420P when every thumbnail is encoded to jpeg
+    enum AVPixelFormat pix_fmt;
+    int width;
+    int height;
+
+    int stream_index;
+    int nb_streams;
+    int64_t start_time;
+    int64_t duration;
+    AVRational time_base;
+    AVCodecParameters *par;
+
+    MRThumbnail *thumbs;
+} MRThumbnailContext;
+
+typedef struct MRThumbnailWorker {
+    MRThumbnailContext *ctx;
+    //thumbnails [first, last) are decoded in order, so every seek goes forward
+    int first;
+    int last;
+
+    AVFormatContext *ic;
+    AVCodecContext *avctx;
+    AVCodecContext *jpeg;
+    struct SwsContext *sws;
+    AVPacket *pkt;
+    AVFrame *frame;
+    AVFrame *scaled;
+    //HDR keyframes are tone mapped into sdr before scaling, created on the first one
+    IJKToneMap *tonemap;
+    AVFrame *sdr;
+
+    SDL_Thread *tid;
+    SDL_Thread _tid;
+    int ret;
+} MRThumbnailWorker;
+
+static int thumbnail_open_input(MRThumbnailContext *ctx, AVFormatContext **icp)
+{
+    AVFormatContext *ic = NULL;
+    int ret = avformat_open_input(&ic, ctx->url, NULL, NULL);
+    if (ret < 0)
+        return ret;
+
+    //the decoder parameters come from the first demuxer, the others skip probing when the container has a header
+    if (!ctx->par || (ic->ctx_flags & AVFMTCTX_NOHEADER) || ic->nb_streams != ctx->nb_streams) {
+        ret = avformat_find_stream_info(ic, NULL);
+        if (ret < 0) {
+            avformat_close_input(&ic);
+            return ret;
+        }
+    }
+    *icp = ic;
+    return 0;
+}
+
+static int thumbnail_prepare(MRThumbnailContext *ctx, AVFormatContext **icp)
+{
+    AVFormatContext *ic = NULL;
+    AVStream *st;
+    AVRational sar;
+    int src_w, src_h, w, h;
+    int ret;
+
+    ret = thumbnail_open_input(ctx, &ic);
+    if (ret < 0)
+        return ret;
+
+    ret = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (ret < 0)
+        goto fail;
+    st = ic->streams[ret];
+    if ((st->disposition & AV_DISPOSITION_ATTACHED_PIC) || st->codecpar->width <= 0 || st->codecpar->height <= 0) {
+        ret = AVERROR_STREAM_NOT_FOUND;
+        goto fail;
+    }
+
+    ctx->par = avcodec_parameters_alloc();
+    if (!ctx->par) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = avcodec_parameters_copy(ctx->par, st->codecpar)) < 0)
+        goto fail;
+
+    ctx->stream_index = st->index;
+    ctx->nb_streams   = ic->nb_streams;
+    ctx->time_base    = st->time_base;
+    ctx->start_time   = ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0;
+    ctx->duration     = ic->duration > 0 ? ic->duration : 0;
+
+    src_w = st->codecpar->width;
+    src_h = st->codecpar->height;
+    sar = av_guess_sample_aspect_ratio(ic, st, NULL);
+    if (sar.num > 0 && sar.den > 0)
+        src_w = (int)av_rescale(src_w, sar.num, sar.den);
+
+    w = ctx->width;
+    h = ctx->height;
+    if (w <= 0 && h <= 0) {
+        w = src_w;
+        h = src_h;
+    } else if (w <= 0) {
+        w = (int)av_rescale(h, src_w, src_h);
+    } else if (h <= 0) {
+        h = (int)av_rescale(w, src_h, src_w);
+    }
+    //even sizes keep the chroma planes of jpeg exact
+    ctx->width  = FFMAX(2, w & ~1);
+    ctx->height = FFMAX(2, h & ~1);
+
+    *icp = ic;
+    return 0;
+fail:
+    avformat_close_input(&ic);
+    return ret;
+}
+
+static int64_t thumbnail_timestamp(MRThumbnailContext *ctx, int index)
+{
+    //middle of equal slices, so neither a fade in nor the end of the file is hit
+    return ctx->start_time + av_rescale(ctx->duration, 2 * index + 1, 2 * ctx->count);
+}
+
+static int thumbnail_worker_open(MRThumbnailWorker *w)
+{
+    MRThumbnailContext *ctx = w->ctx;
+    const AVCodec *codec;
+    int ret;
+
+    if (!w->ic && (ret = thumbnail_open_input(ctx, &w->ic)) < 0)
+        return ret;
+    if (ctx->stream_index >= w->ic->nb_streams ||
+        w->ic->streams[ctx->stream_index]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO)
+        return AVERROR_STREAM_NOT_FOUND;
+    for (int i = 0; i < w->ic->nb_streams; i++)
+        w->ic->streams[i]->discard = i == ctx->stream_index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    codec = avcodec_find_decoder(ctx->par->codec_id);
+    if (!codec)
+        return AVERROR_DECODER_NOT_FOUND;
+    w->avctx = avcodec_alloc_context3(codec);
+    if (!w->avctx)
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_parameters_to_context(w->avctx, ctx->par)) < 0)
+        return ret;
+    w->avctx->pkt_timebase = ctx->time_base;
+    //the parallelism is across demuxers, one decoding thread each
+    w->avctx->thread_count = 1;
+    w->avctx->skip_frame   = AVDISCARD_NONKEY;
+    if ((ret = avcodec_open2(w->avctx, codec, NULL)) < 0)
+        return ret;
+
+    w->pkt    = av_packet_alloc();
+    w->frame  = av_frame_alloc();
+    w->scaled = av_frame_alloc();
+    if (!w->pkt || !w->frame || !w->scaled)
+        return AVERROR(ENOMEM);
+    w->scaled->format = ctx->pix_fmt;
+    w->scaled->width  = ctx->width;
+    w->scaled->height = ctx->height;
+    return av_frame_get_buffer(w->scaled, 0);
+}
+
+static void thumbnail_worker_close(MRThumbnailWorker *w)
+{
+    ijk_tonemap_freep(&w->tonemap);
+    av_frame_free(&w->sdr);
+    av_frame_free(&w->scaled);
+    av_frame_free(&w->frame);
+    av_packet_free(&w->pkt);
+    sws_freeContext(w->sws);
+    w->sws = NULL;
+    avcodec_free_context(&w->jpeg);
+    avcodec_free_context(&w->avctx);
+    avformat_close_input(&w->ic);
+}
+
+static int thumbnail_decode_keyframe(MRThumbnailWorker *w, int64_t ts)
+{
+    int packets = 0;
+    int ret;
+
+    ret = avformat_seek_file(w->ic, -1, INT64_MIN, ts, ts, 0);
+    if (ret < 0)
+        return ret;
+    avcodec_flush_buffers(w->avctx);
+
+    for (;;) {
+        ret = avcodec_receive_frame(w->avctx, w->frame);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+        if (packets++ >= MR_THUMBNAIL_MAX_PACKETS)
+            return AVERROR_INVALIDDATA;
+
+        ret = av_read_frame(w->ic, w->pkt);
+        if (ret == AVERROR_EOF) {
+            //drain, the next receive returns the last keyframe or AVERROR_EOF
+            if ((ret = avcodec_send_packet(w->avctx, NULL)) < 0)
+                return ret;
+            continue;
+        }
+        if (ret < 0)
+            return ret;
+        if (w->pkt->stream_index == w->ctx->stream_index) {
+            ret = avcodec_send_packet(w->avctx, w->pkt);
+            if (ret < 0)
+                av_log(w->avctx, AV_LOG_DEBUG, "thumbnail send_packet failed:%s\n", av_err2str(ret));
+        }
+        av_packet_unref(w->pkt);
+    }
+}
+
+static int thumbnail_tonemap(MRThumbnailWorker *w, const AVFrame *src, const AVFrame **sdr_out)
+{
+    int ret;
+
+    //the workers already run in parallel, one slice each keeps the thread count flat
+    if (!w->tonemap && !(w->tonemap = ijk_tonemap_create(IJK_TONEMAP_BT2390, 1)))
+        return AVERROR(ENOMEM);
+    if (!w->sdr && !(w->sdr = av_frame_alloc()))
+        return AVERROR(ENOMEM);
+    if (w->sdr->width != src->width || w->sdr->height != src->height) {
+        av_frame_unref(w->sdr);
+        w->sdr->format = AV_PIX_FMT_YUV420P;
+        w->sdr->width  = src->width;
+        w->sdr->height = src->height;
+        if ((ret = av_frame_get_buffer(w->sdr, 0)) < 0)
+            return ret;
+    }
+    if (ijk_tonemap_convert(w->tonemap, src, w->sdr->format, w->sdr->data, w->sdr->linesize) < 0)
+        return AVERROR(EINVAL);
+    w->sdr->color_primaries = AVCOL_PRI_BT709;
+    w->sdr->color_trc       = AVCOL_TRC_BT709;
+    w->sdr->colorspace      = AVCOL_SPC_BT709;
+    w->sdr->color_range     = AVCOL_RANGE_MPEG;
+    *sdr_out = w->sdr;
+    return 0;
+}
+
+static int thumbnail_scale(struct SwsContext **sws, const AVFrame *src, AVFrame *dst)
+{
+    //libyuv first, like SDL_VoutConvertFrame, it can't resize though
+    if (src->width == dst->width && src->height == dst->height &&
+        !ijk_image_convert(src->width, src->height,
+                           dst->format, dst->data, dst->linesize,
+                           src->format, (const uint8_t **)src->data, src->linesize))
+        return 0;
+
+    *sws = sws_getCachedContext(*sws, src->width, src->height, src->format,
+                                dst->width, dst->height, dst->format,
+                                SWS_BILINEAR, NULL, NULL, NULL);
+    if (!*sws)
+        return AVERROR(EINVAL);
+    if (sws_scale(*sws, (const uint8_t * const *)src->data, src->linesize, 0, src->height,
+                  dst->data, dst->linesize) != dst->height)
+        return AVERROR(EINVAL);
+    return 0;
+}
+
+//1~100 to the mjpeg qscale 31~2
+static int thumbnail_jpeg_qscale(int quality)
+{
+    quality = av_clip(quality, 1, 100);
+    return 2 + (100 - quality) * 29 / 99;
+}
+
+static int thumbnail_encode_jpeg(AVCodecContext **encp, AVFrame *frame, int quality, MRThumbnail *thumb)
+{
+    AVCodecContext *enc = *encp;
+    AVPacket *pkt;
+    int ret;
+
+    if (!enc || enc->width != frame->width || enc->height != frame->height) {
+        const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+        if (!codec)
+            return AVERROR_ENCODER_NOT_FOUND;
+        avcodec_free_context(encp);
+        enc = *encp = avcodec_alloc_context3(codec);
+        if (!enc)
+            return AVERROR(ENOMEM);
+        enc->width          = frame->width;
+        enc->height         = frame->height;
+        enc->pix_fmt        = frame->format;
+        enc->color_range    = AVCOL_RANGE_JPEG;
+        enc->time_base      = (AVRational){1, 25};
+        enc->thread_count   = 1;
+        enc->flags         |= AV_CODEC_FLAG_QSCALE;
+        enc->global_quality = FF_QP2LAMBDA * thumbnail_jpeg_qscale(quality);
+        if ((ret = avcodec_open2(enc, codec, NULL)) < 0) {
+            avcodec_free_context(encp);
+            return ret;
+        }
+    }
+
+    pkt = av_packet_alloc();
+    if (!pkt)
+        return AVERROR(ENOMEM);
+    //mjpeg is intra only, every frame comes straight back as one packet
+    frame->quality = enc->global_quality;
+    ret = avcodec_send_frame(enc, frame);
+    if (ret >= 0)
+        ret = avcodec_receive_packet(enc, pkt);
+    if (ret >= 0) {
+        thumb->data = av_malloc(pkt->size);
+        if (thumb->data) {
+            memcpy(thumb->data, pkt->data, pkt->size);
+            thumb->size = pkt->size;
+        } else {
+            ret = AVERROR(ENOMEM);
+        }
+    }
+    av_packet_free(&pkt);
+    return ret;
+}
+
+static int thumbnail_copy_rgba(const AVFrame *frame, MRThumbnail *thumb)
+{
+    int linesize = frame->width * 4;
+
+    thumb->data = av_malloc(linesize * frame->height);
+    if (!thumb->data)
+        return AVERROR(ENOMEM);
+    av_image_copy_plane(thumb->data, linesize, frame->data[0], frame->linesize[0], linesize, frame->height);
+    thumb->linesize = linesize;
+    thumb->size = linesize * frame->height;
+    return 0;
+}
+
+static int thumbnail_output(MRThumbnailWorker *w, int64_t ts, MRThumbnail *thumb)
+{
+    MRThumbnailContext *ctx = w->ctx;
+    int64_t pts = w->frame->best_effort_timestamp;
+    const AVFrame *src = w->frame;
+    int ret;
+
+    if (ijk_tonemap_is_hdr(src) && (ret = thumbnail_tonemap(w, w->frame, &src)) < 0)
+        return ret;
+    ret = thumbnail_scale(&w->sws, src, w->scaled);
+    if (ret < 0)
+        return ret;
+    if (ctx->pix_fmt == AV_PIX_FMT_YUVJ420P) {
+        ret = thumbnail_encode_jpeg(&w->jpeg, w->scaled, ctx->jpeg_quality, thumb);
+        thumb->format = MR_THUMBNAIL_JPEG;
+    } else {
+        ret = thumbnail_copy_rgba(w->scaled, thumb);
+        thumb->format = MR_THUMBNAIL_RGBA;
+    }
+    if (ret < 0)
+        return ret;
+
+    if (pts != AV_NOPTS_VALUE)
+        thumb->pts = pts * av_q2d(ctx->time_base) - ctx->start_time / (double)AV_TIME_BASE;
+    else
+        thumb->pts = (ts - ctx->start_time) / (double)AV_TIME_BASE;
+    thumb->width  = ctx->width;
+    thumb->height = ctx->height;
+    return 0;
+}
+
+static int thumbnail_worker_thread(void *arg)
+{
+    MRThumbnailWorker *w = arg;
+    MRThumbnailContext *ctx = w->ctx;
+
+    w->ret = thumbnail_worker_open(w);
+    if (w->ret < 0) {
+        av_log(NULL, AV_LOG_WARNING, "thumbnail worker open %s failed:%s\n", ctx->url, av_err2str(w->ret));
+        return 0;
+    }
+
+    for (int i = w->first; i < w->last; i++) {
+        int64_t ts = thumbnail_timestamp(ctx, i);
+        int ret = thumbnail_decode_keyframe(w, ts);
+        if (ret >= 0)
+            ret = thumbnail_output(w, ts, &ctx->thumbs[i]);
+        av_frame_unref(w->frame);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_WARNING, "thumbnail %d at %.3fs failed:%s\n", i, ts / (double)AV_TIME_BASE, av_err2str(ret));
+            w->ret = ret;
+        }
+    }
+    return 0;
+}
+
+static int thumbnail_extract(const char *url, const MRThumbnailOptions *opt, enum AVPixelFormat pix_fmt, MRThumbnail **thumbs_out, int *count_out)
+{
+    MRThumbnailContext ctx = {0};
+    MRThumbnailWorker *workers = NULL;
+    AVFormatContext *ic = NULL;
+    int nb_workers, decoded = 0, err = 0;
+    int ret;
+
+    if (!url || !opt || !thumbs_out || !count_out)
+        return AVERROR(EINVAL);
+
+    ctx.url          = url;
+    ctx.count        = opt->count > 0 ? opt->count : MR_THUMBNAIL_DEFAULT_COUNT;
+    ctx.jpeg_quality = opt->jpeg_quality > 0 ? opt->jpeg_quality : MR_THUMBNAIL_DEFAULT_QUALITY;
+    ctx.pix_fmt      = pix_fmt;
+    ctx.width        = opt->width;
+    ctx.height       = opt->height;
+
+    ret = thumbnail_prepare(&ctx, &ic);
+    if (ret < 0)
+        goto end;
+    //without a duration every timestamp is the start, one thumbnail is all there is
+    if (ctx.duration <= 0)
+        ctx.count = 1;
+
+    nb_workers = opt->threads > 0 ? opt->threads : av_cpu_count();
+    nb_workers = av_clip(nb_workers, 1, FFMIN(ctx.count, MR_THUMBNAIL_MAX_THREADS));
+
+    ctx.thumbs = av_calloc(ctx.count, sizeof(MRThumbnail));
+    workers = av_calloc(nb_workers, sizeof(MRThumbnailWorker));
+    if (!ctx.thumbs || !workers) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (int i = 0; i < ctx.count; i++)
+        ctx.thumbs[i].pts = -1;
+
+    for (int i = 0; i < nb_workers; i++) {
+        MRThumbnailWorker *w = &workers[i];
+        w->ctx   = &ctx;
+        w->first = ctx.count * i / nb_workers;
+        w->last  = ctx.count * (i + 1) / nb_workers;
+    }
+    //the probing demuxer is reused by the first worker
+    workers[0].ic = ic;
+    ic = NULL;
+
+    for (int i = 1; i < nb_workers; i++) {
+        MRThumbnailWorker *w = &workers[i];
+        w->tid = SDL_CreateThreadEx(&w->_tid, thumbnail_worker_thread, w, "mr_thumbnail");
+        if (!w->tid)
+            thumbnail_worker_thread(w);
+    }
+    thumbnail_worker_thread(&workers[0]);
+    for (int i = 0; i < nb_workers; i++) {
+        MRThumbnailWorker *w = &workers[i];
+        if (w->tid)
+            SDL_WaitThread(w->tid, NULL);
+        if (w->ret < 0 && !err)
+            err = w->ret;
+        thumbnail_worker_close(w);
+    }
+
+    for (int i = 0; i < ctx.count; i++) {
+        if (ctx.thumbs[i].data)
+            decoded++;
+    }
+    if (!decoded) {
+        ret = err < 0 ? err : AVERROR_INVALIDDATA;
+        goto end;
+    }
+
+    *thumbs_out = ctx.thumbs;
+    *count_out  = ctx.count;
+    ctx.thumbs  = NULL;
+    ret = 0;
+end:
+    if (ctx.thumbs)
+        mr_thumbnail_free(&ctx.thumbs, ctx.count);
+    av_free(workers);
+    avformat_close_input(&ic);
+    avcodec_parameters_free(&ctx.par);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "thumbnail extract %s failed:%s\n", url ? url : "", av_err2str(ret));
+    return ret;
+}
+
+int mr_thumbnail_extract(const char *url, const MRThumbnailOptions *opt, MRThumbnail **thumbs_out, int *count_out)
+{
+    if (!opt)
+        return AVERROR(EINVAL);
+    return thumbnail_extract(url, opt, opt->format == MR_THUMBNAIL_JPEG ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_RGBA, thumbs_out, count_out);
+}
+
+static int storyboard_encode_jpeg(MRThumbnail *sprite, int quality)
+{
+    AVCodecContext *enc = NULL;
+    struct SwsContext *sws = NULL;
+    AVFrame *src = av_frame_alloc();
+    AVFrame *dst = av_frame_alloc();
+    MRThumbnail jpeg = *sprite;
+    int ret;
+
+    if (!src || !dst) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    src->format = AV_PIX_FMT_RGBA;
+    src->width  = sprite->width;
+    src->height = sprite->height;
+    src->data[0] = sprite->data;
+    src->linesize[0] = sprite->linesize;
+
+    dst->format = AV_PIX_FMT_YUVJ420P;
+    dst->width  = sprite->width;
+    dst->height = sprite->height;
+    if ((ret = av_frame_get_buffer(dst, 0)) < 0)
+        goto end;
+    if ((ret = thumbnail_scale(&sws, src, dst)) < 0)
+        goto end;
+
+    jpeg.data = NULL;
+    if ((ret = thumbnail_encode_jpeg(&enc, dst, quality, &jpeg)) < 0)
+        goto end;
+    av_free(sprite->data);
+    *sprite = jpeg;
+    sprite->format   = MR_THUMBNAIL_JPEG;
+    sprite->linesize = 0;
+end:
+    avcodec_free_context(&enc);
+    sws_freeContext(sws);
+    av_frame_free(&dst);
+    av_frame_free(&src);
+    return ret;
+}
+
+int mr_storyboard_extract(const char *url, const MRThumbnailOptions *opt, MRThumbnail *sprite_out, int *columns_out, int *rows_out)
+{
+    MRThumbnail *thumbs = NULL;
+    MRThumbnail sprite = {0};
+    int count = 0, columns, rows;
+    int tile_w = 0, tile_h = 0;
+    int ret;
+
+    if (!opt || !sprite_out)
+        return AVERROR(EINVAL);
+
+    //tiles stay rgba, only the finished sprite is encoded
+    ret = thumbnail_extract(url, opt, AV_PIX_FMT_RGBA, &thumbs, &count);
+    if (ret < 0)
+        return ret;
+
+    columns = opt->columns > 0 ? FFMIN(opt->columns, count) : (int)ceil(sqrt(count));
+    rows = (count + columns - 1) / columns;
+    for (int i = 0; i < count; i++) {
+        if (thumbs[i].data) {
+            tile_w = thumbs[i].width;
+            tile_h = thumbs[i].height;
+            break;
+        }
+    }
+
+    sprite.pts      = 0;
+    sprite.width    = tile_w * columns;
+    sprite.height   = tile_h * rows;
+    sprite.format   = MR_THUMBNAIL_RGBA;
+    sprite.linesize = sprite.width * 4;
+    sprite.size     = sprite.linesize * sprite.height;
+    sprite.data     = av_mallocz(sprite.size);
+    if (!sprite.data) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (int i = 0; i < count; i++) {
+        MRThumbnail *t = &thumbs[i];
+        if (!t->data)
+            continue;
+        av_image_copy_plane(sprite.data + (i / columns) * tile_h * sprite.linesize + (i % columns) * tile_w * 4,
+                            sprite.linesize, t->data, t->linesize, tile_w * 4, tile_h);
+    }
+
+    if (opt->format == MR_THUMBNAIL_JPEG &&
+        (ret = storyboard_encode_jpeg(&sprite, opt->jpeg_quality > 0 ? opt->jpeg_quality : MR_THUMBNAIL_DEFAULT_QUALITY)) < 0)
+        goto end;
+
+    *sprite_out = sprite;
+    sprite.data = NULL;
+    if (columns_out)
+        *columns_out = columns;
+    if (rows_out)
+        *rows_out = rows;
+end:
+    av_free(sprite.data);
+    mr_thumbnail_free(&thumbs, count);
+    return ret;
+}
+
+void mr_thumbnail_free(MRThumbnail **thumbs, int count)
+{
+    if (!thumbs || !*thumbs)
+        return;
+    for (int i = 0; i < count; i++)
+        av_freep(&(*thumbs)[i].data);
+    av_freep(thumbs);
+}
+
+void mr_storyboard_free(MRThumbnail *sprite)
+{
+    if (!sprite)
+        return;
+    av_freep(&sprite->data);
+    sprite->size = 0;
+}
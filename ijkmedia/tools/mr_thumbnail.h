@@ -0,0 +1,67 @@
+//
+//  mr_thumbnail.h
+//
+// ijkplayer not use the file, but the file will be used by other module in app.
+//
+//  Pull keyframe thumbnails or a storyboard sprite out of a media file without a player.
+//
+
+#ifndef mr_thumbnail_h
+#define mr_thumbnail_h
+
+#include <stdio.h>
+
+typedef enum MRThumbnailFormat {
+    MR_THUMBNAIL_RGBA = 0,
+    MR_THUMBNAIL_JPEG = 1,
+} MRThumbnailFormat;
+
+typedef struct MRThumbnailOptions {
+    //thumbnails evenly spaced over the duration, 0 means 10
+    int count;
+    //target size, 0 follows the display aspect ratio of the other one, both 0 keep the video size
+    int width;
+    int height;
+    //MRThumbnailFormat
+    int format;
+    //jpeg quality 1~100, 0 means 80
+    int jpeg_quality;
+    //demuxer instances decoding in parallel, 0 picks from the cpu count
+    int threads;
+    //storyboard only, 0 makes a grid as square as possible
+    int columns;
+} MRThumbnailOptions;
+
+typedef struct MRThumbnail {
+    //position of the decoded keyframe in seconds from the start, -1 when it could not be decoded
+    double pts;
+    int width;
+    int height;
+    //MRThumbnailFormat
+    int format;
+    //rgba only, bytes per row
+    int linesize;
+    //NULL when it could not be decoded
+    unsigned char *data;
+    int size;
+} MRThumbnail;
+
+/*
+ * decode the keyframe at or before each of opt->count evenly spaced timestamps,
+ * sparse keyframes can make neighbouring thumbnails identical.
+ * thumbs_out receives an array of count_out entries to release with mr_thumbnail_free,
+ * returns <0 when not a single thumbnail could be decoded.
+ */
+int mr_thumbnail_extract(const char *url, const MRThumbnailOptions *opt, MRThumbnail **thumbs_out, int *count_out);
+
+/*
+ * same thumbnails tiled into one sprite, row by row, columns_out * rows_out tiles of
+ * width * height, tiles that could not be decoded are left transparent.
+ * release sprite_out with mr_storyboard_free.
+ */
+int mr_storyboard_extract(const char *url, const MRThumbnailOptions *opt, MRThumbnail *sprite_out, int *columns_out, int *rows_out);
+
+void mr_thumbnail_free(MRThumbnail **thumbs, int count);
+void mr_storyboard_free(MRThumbnail *sprite);
+
+#endif /* mr_thumbnail_h */
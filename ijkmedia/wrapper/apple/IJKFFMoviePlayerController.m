@@ -712,7 +712,7 @@ void ffp_apple_log_extra_print(int level, const char *tag, const char *fmt, ...)
     if (!_mediaPlayer)
         return 0.0f;
 
-    NSTimeInterval ret = ijkmp_get_current_position(_mediaPlayer);
+    NSTimeInterval ret = ijkmp_get_current_position_nolock(_mediaPlayer);
     if (isnan(ret) || isinf(ret))
         return -1;
 